@@ -7,6 +7,8 @@
 
 #include "mumble_positional_audio_utils.h"
 
+#include <algorithm>
+#include <climits>
 #include <cstring>
 #include <sstream>
 
@@ -32,6 +34,34 @@ bool HostLinux::peek(const procptr_t address, void *dst, const size_t size) cons
 	return (ret != -1 && static_cast< size_t >(ret) == in.iov_len);
 }
 
+bool HostLinux::peek(const PeekRequests &requests) const {
+	// A single call of process_vm_readv() is limited to IOV_MAX vectors on each side
+	std::vector< iovec > in, out;
+	in.reserve(std::min< size_t >(requests.size(), IOV_MAX));
+	out.reserve(std::min< size_t >(requests.size(), IOV_MAX));
+
+	for (size_t begin = 0; begin < requests.size(); begin += IOV_MAX) {
+		const size_t end = std::min< size_t >(begin + IOV_MAX, requests.size());
+
+		in.clear();
+		out.clear();
+
+		size_t total = 0;
+		for (size_t i = begin; i < end; ++i) {
+			in.push_back({ reinterpret_cast< void * >(requests[i].address), requests[i].size });
+			out.push_back({ requests[i].dst, requests[i].size });
+			total += requests[i].size;
+		}
+
+		const auto ret = process_vm_readv(m_pid, out.data(), out.size(), in.data(), in.size(), 0);
+		if (ret == -1 || static_cast< size_t >(ret) != total) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
 Modules HostLinux::modules() const {
 	std::ostringstream path;
 	path << "/proc/";
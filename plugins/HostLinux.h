@@ -16,6 +16,9 @@ protected:
 
 public:
 	bool peek(const procptr_t address, void *dst, const size_t size) const;
+	/// Performs all of the given reads. Returns false if any of them fails, in which case the contents of the
+	/// destination buffers are undefined.
+	bool peek(const PeekRequests &requests) const;
 	Modules modules() const;
 
 	static bool isWine(const procid_t id);
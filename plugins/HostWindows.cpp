@@ -26,6 +26,17 @@ bool HostWindows::peek(const procptr_t address, void *dst, const size_t size) co
 	return (ok && read == size);
 }
 
+bool HostWindows::peek(const PeekRequests &requests) const {
+	// Windows has no counterpart to process_vm_readv(), the reads are performed one after the other
+	for (const auto &request : requests) {
+		if (!peek(request.address, request.dst, request.size)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
 Modules HostWindows::modules() const {
 	const auto processHandle = OpenProcess(PROCESS_QUERY_INFORMATION, false, m_pid);
 	if (!processHandle) {
@@ -9,6 +9,7 @@
 #include <set>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 typedef uint64_t procptr_t;
 
@@ -27,6 +28,15 @@ struct MemoryRegion {
 
 typedef std::set< MemoryRegion > MemoryRegions;
 
+/// A single read of a batch that is performed in one go (see Host::peek()).
+struct PeekRequest {
+	procptr_t address;
+	void *dst;
+	size_t size;
+};
+
+typedef std::vector< PeekRequest > PeekRequests;
+
 class Module {
 protected:
 	std::string m_name;
@@ -125,3 +125,44 @@ procid_t Process::find(const std::string &name, const std::multimap< std::wstrin
 
 	return static_cast< procid_t >(iter->second);
 }
+
+PointerChain::PointerChain(const procptr_t base, const std::vector< procptr_t > &offsets)
+	: m_base(base), m_offsets(offsets), m_basePointer(0), m_resolved(0) {
+}
+
+procptr_t PointerChain::resolve(const Process &proc) {
+	const auto basePointer = proc.peekPtr(m_base);
+	if (!basePointer) {
+		invalidate();
+		return 0;
+	}
+
+	if (basePointer == m_basePointer && m_resolved) {
+		return m_resolved;
+	}
+
+	procptr_t address = basePointer;
+	for (size_t i = 0; i < m_offsets.size(); ++i) {
+		if (i + 1 == m_offsets.size()) {
+			// The last offset points to the data, not to another pointer
+			address += m_offsets[i];
+			break;
+		}
+
+		address = proc.peekPtr(address + m_offsets[i]);
+		if (!address) {
+			invalidate();
+			return 0;
+		}
+	}
+
+	m_basePointer = basePointer;
+	m_resolved    = address;
+
+	return m_resolved;
+}
+
+void PointerChain::invalidate() {
+	m_basePointer = 0;
+	m_resolved    = 0;
+}
@@ -34,6 +34,12 @@ public:
 		return peek(address, &dst, sizeof(T));
 	}
 
+	/// Creates a request for reading a \p T at the specified address into \p dst, meant to be batched with others
+	/// and passed to peek(const PeekRequests &).
+	template< typename T > static inline PeekRequest request(const procptr_t address, T &dst) {
+		return { address, &dst, sizeof(T) };
+	}
+
 	template< typename T > T inline peek(const procptr_t address) const {
 		T ret;
 		if (!peek(address, &ret, sizeof(T))) {
@@ -110,4 +116,26 @@ public:
 	virtual ~Process();
 };
 
+/// Caches the address a chain of pointers resolves to.
+///
+/// Resolving "[[[base] + offsets[0]] + offsets[1]] + ..." takes one read per pointer. As long as the pointer stored
+/// at the base address stays the same, resolve() only reads that one pointer and returns the cached address.
+/// If a pointer further down the chain may change on its own, invalidate() has to be called when reading
+/// from the resolved address fails.
+class PointerChain {
+protected:
+	procptr_t m_base;
+	std::vector< procptr_t > m_offsets;
+	procptr_t m_basePointer;
+	procptr_t m_resolved;
+
+public:
+	/// Returns the address the chain resolves to or 0 if any of the pointers is null or can't be read.
+	procptr_t resolve(const Process &proc);
+	/// Forces the whole chain to be resolved again in the next call to resolve().
+	void invalidate();
+
+	PointerChain(const procptr_t base, const std::vector< procptr_t > &offsets);
+};
+
 #endif
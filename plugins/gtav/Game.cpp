@@ -50,12 +50,8 @@ Mumble_PositionalDataErrorCode Game::init() {
 		m_avatarPosAddr  = m_moduleBase + 0x1F7EAA0;
 		m_cameraPosAddr  = m_moduleBase + 0x1C58630;
 		m_avatarBaseAddr = m_moduleBase + 0x1B956C0;
-		// Avatar pointer
-		procptr_t avatarBase = m_proc.peekPtr(m_avatarBaseAddr);
-		if (!avatarBase)
-			return MUMBLE_PDEC_ERROR_TEMP;
-		m_avatarDirAddr  = avatarBase + 0x70;
-		m_avatarAxisAddr = avatarBase + 0x80;
+		// Avatar pointer, m_avatarDirAddr and m_avatarAxisAddr are set from it in fetchPositionalData()
+		m_avatarChain.reset(new PointerChain(m_avatarBaseAddr, { 0x70 }));
 		m_cameraDirAddr  = m_moduleBase + 0x1C5A0F0;
 		m_cameraAxisAddr = m_moduleBase + 0x1F7D9F0;
 		m_playerAddr     = m_moduleBase + 0x273DBAC;
@@ -87,6 +83,15 @@ Mumble_PositionalDataErrorCode Game::fetchPositionalData(float *avatarPos, float
 	// Char values for extra features
 	char state, player[50], vehicle[50], location[50], street[50];
 
+	if (m_avatarChain) {
+		const procptr_t avatarDir = m_avatarChain->resolve(m_proc);
+		if (!avatarDir)
+			return MUMBLE_PDEC_ERROR_TEMP;
+
+		m_avatarDirAddr  = avatarDir;
+		m_avatarAxisAddr = avatarDir + 0x10;
+	}
+
 	// Peekproc and assign game addresses to our containers, so we can retrieve positional data
 	ok = m_proc.peek(m_stateAddr, &state, 1)
 		 && // Magical state value: 0 when in single player, 2 when online and 3 when in a lobby.
@@ -103,8 +108,11 @@ Mumble_PositionalDataErrorCode Game::fetchPositionalData(float *avatarPos, float
 
 	// This prevents the plugin from linking to the game in case something goes wrong during values retrieval from
 	// memory addresses.
-	if (!ok)
+	if (!ok) {
+		if (m_avatarChain)
+			m_avatarChain->invalidate();
 		return MUMBLE_PDEC_ERROR_TEMP;
+	}
 
 	// State
 	if (state != 2) {      // If not in-game
@@ -9,6 +9,8 @@
 #include "ProcessWindows.h"
 #include "PluginComponents_v_1_0_x.h"
 
+#include <memory>
+
 class Game {
 public:
 	Game(const procid_t id, const std::string &name);
@@ -22,6 +24,8 @@ protected:
 	ProcessWindows m_proc;
 	procptr_t m_moduleBase = 0;
 	std::string m_identity;
+	/// Leads to the avatar's direction in the retail version, where it moves whenever the avatar is recreated
+	std::unique_ptr< PointerChain > m_avatarChain;
 
 	// Memory addresses
 	procptr_t m_stateAddr, m_avatarPosAddr, m_cameraPosAddr, m_avatarBaseAddr, m_avatarDirAddr, m_avatarAxisAddr,
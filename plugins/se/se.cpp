@@ -82,22 +82,15 @@ static int fetch(float *avatarPos, float *avatarFront, float *avatarTop, float *
 	}
 
 	float rotation[3];
-	if (!proc->peek(localPlayer + rotationOffset, rotation, sizeof(rotation))) {
-		return false;
-	}
-
 	float originPosition[3];
-	if (!proc->peek(localPlayer + originPositionOffset, originPosition, sizeof(originPosition))) {
-		return false;
-	}
-
 	float eyesPositionOffset[3];
-	if (!proc->peek(localPlayer + eyesPositionOffsetOffset, eyesPositionOffset, sizeof(eyesPositionOffset))) {
-		return false;
-	}
-
 	NetInfo ni;
-	if (!proc->peek(localClient + netInfoOffset, ni)) {
+
+	const PeekRequests requests = { Process::request(localPlayer + rotationOffset, rotation),
+									Process::request(localPlayer + originPositionOffset, originPosition),
+									Process::request(localPlayer + eyesPositionOffsetOffset, eyesPositionOffset),
+									Process::request(localClient + netInfoOffset, ni) };
+	if (!proc->peek(requests)) {
 		return false;
 	}
 
@@ -18,7 +18,8 @@ QHash< int, Channel * > Channel::c_qhChannels;
 QReadWriteLock Channel::c_qrwlChannels;
 #endif
 
-Channel::Channel(int id, const QString &name, QObject *p) : QObject(p) {
+Channel::Channel(int id, const QString &name, QObject *p)
+	: QObject(p), m_linkComponent(std::make_shared< QVector< Channel * > >(1, this)) {
 	iId         = id;
 	iPosition   = 0;
 	qsName      = name;
@@ -104,31 +105,63 @@ void Channel::link(Channel *l) {
 	qhLinks[l]++;
 	l->qsPermLinks.insert(this);
 	l->qhLinks[this]++;
+
+	mergeLinkComponents(l);
 }
 
 void Channel::unlink(Channel *l) {
 	if (l) {
+		const bool wasLinked = qhLinks.contains(l);
+
 		qsPermLinks.remove(l);
 		qhLinks.remove(l);
 		l->qsPermLinks.remove(this);
 		l->qhLinks.remove(this);
+
+		if (wasLinked) {
+			// Removing an edge might split the component in two. Union-find can't undo a union, so
+			// we rebuild the component(s) from the remaining links instead.
+			rebuildLinkComponent();
+			if (!isTransitivelyLinked(l)) {
+				l->rebuildLinkComponent();
+			}
+		}
 	} else {
 		foreach (Channel *c, qhLinks.keys())
 			unlink(c);
 	}
 }
 
-QSet< Channel * > Channel::allLinks() {
+void Channel::mergeLinkComponents(Channel *other) {
+	if (isTransitivelyLinked(other)) {
+		return;
+	}
+
+	// Union by size: Move the members of the smaller component over to the larger one
+	std::shared_ptr< QVector< Channel * > > larger  = m_linkComponent;
+	std::shared_ptr< QVector< Channel * > > smaller = other->m_linkComponent;
+	if (larger->size() < smaller->size()) {
+		std::swap(larger, smaller);
+	}
+
+	larger->append(*smaller);
+	for (Channel *c : *smaller) {
+		c->m_linkComponent = larger;
+	}
+}
+
+void Channel::rebuildLinkComponent() {
+	std::shared_ptr< QVector< Channel * > > component = std::make_shared< QVector< Channel * > >();
+
 	QSet< Channel * > seen;
 	seen.insert(this);
-	if (qhLinks.isEmpty())
-		return seen;
 
 	QStack< Channel * > stack;
 	stack.push(this);
 
 	while (!stack.isEmpty()) {
 		Channel *lnk = stack.pop();
+		component->append(lnk);
 		foreach (Channel *l, lnk->qhLinks.keys()) {
 			if (!seen.contains(l)) {
 				seen.insert(l);
@@ -136,7 +169,22 @@ QSet< Channel * > Channel::allLinks() {
 			}
 		}
 	}
-	return seen;
+
+	for (Channel *c : *component) {
+		c->m_linkComponent = component;
+	}
+}
+
+const QVector< Channel * > &Channel::linkedChannels() const {
+	return *m_linkComponent;
+}
+
+bool Channel::isTransitivelyLinked(const Channel *c) const {
+	return m_linkComponent == c->m_linkComponent;
+}
+
+QSet< Channel * > Channel::allLinks() {
+	return QSet< Channel * >(m_linkComponent->cbegin(), m_linkComponent->cend());
 }
 
 QSet< Channel * > Channel::allChildren() {
@@ -12,6 +12,9 @@
 #include <QtCore/QReadWriteLock>
 #include <QtCore/QSet>
 #include <QtCore/QString>
+#include <QtCore/QVector>
+
+#include <memory>
 
 #ifdef MUMBLE
 #	include <atomic>
@@ -30,6 +33,14 @@ private:
 private:
 	QSet< Channel * > qsUnseen;
 
+	/// The connected component of the link graph this channel belongs to. All channels that are
+	/// (transitively) linked to each other share the same instance, which makes checking whether
+	/// two channels are linked a simple pointer comparison.
+	std::shared_ptr< QVector< Channel * > > m_linkComponent;
+
+	void mergeLinkComponents(Channel *other);
+	void rebuildLinkComponent();
+
 public:
 	static constexpr int ROOT_ID = 0;
 
@@ -97,6 +108,13 @@ public:
 	void link(Channel *c);
 	void unlink(Channel *c = nullptr);
 
+	/// @returns All channels that are (transitively) linked to this channel, including this channel itself.
+	/// The returned list is maintained incrementally on link changes and thus cheap to obtain.
+	const QVector< Channel * > &linkedChannels() const;
+	/// @returns Whether the given channel is (transitively) linked to this channel. A channel is
+	/// always considered to be linked to itself.
+	bool isTransitivelyLinked(const Channel *c) const;
+
 	QSet< Channel * > allLinks();
 	QSet< Channel * > allChildren();
 
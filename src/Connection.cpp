@@ -189,6 +189,10 @@ void Connection::sendMessage(const QByteArray &qbaMsg) {
 		qtsSocket->write(qbaMsg);
 }
 
+qint64 Connection::bytesToWrite() const {
+	return qtsSocket->bytesToWrite();
+}
+
 void Connection::forceFlush() {
 	if (qtsSocket->state() != QAbstractSocket::ConnectedState)
 		return;
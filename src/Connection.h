@@ -66,6 +66,8 @@ public:
 	void sendMessage(const QByteArray &qbaMsg);
 	void disconnectSocket(bool force = false);
 	void forceFlush();
+	/// @returns The amount of bytes that are waiting to be written to the socket
+	qint64 bytesToWrite() const;
 	qint64 activityTime() const;
 	void resetActivityTime();
 
@@ -46,3 +46,101 @@ bool HTMLFilter::filter(const QString &in, QString &out) {
 	}
 	return true;
 }
+
+static bool isNameChar(QChar c) {
+	return c.isLetterOrNumber() || c == QLatin1Char('-') || c == QLatin1Char('_') || c == QLatin1Char(':');
+}
+
+static bool nameEquals(const QString &in, int start, int end, QLatin1String name) {
+	return (end - start == name.size()) && (in.midRef(start, end - start).compare(name, Qt::CaseInsensitive) == 0);
+}
+
+int HTMLFilter::textLength(const QString &in, int maxLength) {
+	const int size  = in.size();
+	int imageLength = 0;
+	int i           = 0;
+
+	while (i < size) {
+		const int tagStart = in.indexOf(QLatin1Char('<'), i);
+		if (tagStart == -1) {
+			break;
+		}
+
+		if ((maxLength > 0) && (tagStart - imageLength > maxLength)) {
+			return tagStart - imageLength;
+		}
+
+		// Tag name
+		i                   = tagStart + 1;
+		const int nameStart = i;
+		while (i < size && isNameChar(in.at(i))) {
+			++i;
+		}
+		const bool isImage = nameEquals(in, nameStart, i, QLatin1String("img"));
+
+		// Attributes
+		bool closed = false;
+		while (i < size) {
+			const QChar c = in.at(i);
+
+			if (c == QLatin1Char('>')) {
+				++i;
+				closed = true;
+				break;
+			} else if (c == QLatin1Char('"') || c == QLatin1Char('\'')) {
+				const int end = in.indexOf(c, i + 1);
+				if (end == -1) {
+					return -1;
+				}
+				i = end + 1;
+			} else if (isNameChar(c)) {
+				const int attributeStart = i;
+				while (i < size && isNameChar(in.at(i))) {
+					++i;
+				}
+				const bool isSource = isImage && nameEquals(in, attributeStart, i, QLatin1String("src"));
+
+				int j = i;
+				while (j < size && in.at(j).isSpace()) {
+					++j;
+				}
+				if (j >= size || in.at(j) != QLatin1Char('=')) {
+					// Attribute without a value
+					continue;
+				}
+				++j;
+				while (j < size && in.at(j).isSpace()) {
+					++j;
+				}
+
+				if (j < size && (in.at(j) == QLatin1Char('"') || in.at(j) == QLatin1Char('\''))) {
+					const int end = in.indexOf(in.at(j), j + 1);
+					if (end == -1) {
+						return -1;
+					}
+					if (isSource) {
+						imageLength += end - (j + 1);
+					}
+					i = end + 1;
+				} else {
+					const int valueStart = j;
+					while (j < size && !in.at(j).isSpace() && in.at(j) != QLatin1Char('>')) {
+						++j;
+					}
+					if (isSource) {
+						imageLength += j - valueStart;
+					}
+					i = j;
+				}
+			} else {
+				++i;
+			}
+		}
+
+		if (!closed) {
+			return -1;
+		}
+	}
+
+	return size - imageLength;
+}
@@ -33,6 +33,22 @@ public:
 	/// If the filtering failed, the function returns false
 	/// and out is left unchanged.
 	static bool filter(const QString &in, QString &out);
+
+	/// textLength returns the length of the in HTML
+	/// document, not counting the values of the src
+	/// attributes of <img> tags (which usually contain
+	/// the base64 encoded image data).
+	///
+	/// The document is scanned in a single pass and
+	/// nothing is copied. If maxLength is non-zero,
+	/// scanning stops as soon as the length seen so far
+	/// exceeds maxLength, in which case a value greater
+	/// than maxLength is returned.
+	///
+	/// If a tag or a quoted attribute value in the
+	/// document is not terminated, the function
+	/// returns -1.
+	static int textLength(const QString &in, int maxLength = 0);
 };
 
 #endif
@@ -15,6 +15,14 @@ namespace Plugins {
 
 	}; // namespace PluginMessage
 };     // namespace Plugins
+
+namespace Mixer {
+	/// The session audio that has been mixed by the server is sent with. Sessions are numbered from 1, so no user
+	/// ever has this one.
+	constexpr unsigned int MIXED_SESSION = 0;
+	/// The first client version that can play mixed audio. Older clients are sent the streams of all speakers.
+	constexpr unsigned int MIN_CLIENT_VERSION = 0x010500;
+}; // namespace Mixer
 };     // namespace Mumble
 
 #endif // MUMBLE_MUMBLECONSTANTS_H_
@@ -4,9 +4,14 @@
 // Mumble source tree or at <https://www.mumble.info/LICENSE>.
 
 #include "ProcessResolver.h"
+
+#include <codecvt>
 #include <cstring>
+#include <iterator>
+#include <locale>
+#include <stdexcept>
 
-ProcessResolver::ProcessResolver(bool resolveImmediately) : m_processMap() {
+ProcessResolver::ProcessResolver(bool resolveImmediately) : m_processMap(), m_generation(0), m_changed(false) {
 	if (resolveImmediately) {
 		resolve();
 	}
@@ -21,30 +26,114 @@ const ProcessResolver::ProcessMap &ProcessResolver::getProcessMap() const {
 }
 
 void ProcessResolver::resolve() {
-	// first clear the current lists
-	m_processMap.clear();
+	m_seen.clear();
+	m_changed = false;
 
 	doResolve();
+
+	// Drop the processes that have exited
+	std::vector< uint64_t > exited;
+	for (const auto &currentEntry : m_processMap) {
+		if (m_seen.find(currentEntry.first) == m_seen.end()) {
+			exited.push_back(currentEntry.first);
+		}
+	}
+	for (const uint64_t pid : exited) {
+		removeProcess(pid);
+	}
+
+	for (auto it = m_unnamed.begin(); it != m_unnamed.end();) {
+		it = m_seen.find(*it) == m_seen.end() ? m_unnamed.erase(it) : std::next(it);
+	}
+	for (auto it = m_unsettled.begin(); it != m_unsettled.end();) {
+		it = m_seen.find(it->first) == m_seen.end() ? m_unsettled.erase(it) : std::next(it);
+	}
+
+	if (m_changed) {
+		m_generation++;
+
+		m_names.clear();
+		m_pids.clear();
+		m_names.reserve(m_processMap.size());
+		m_pids.reserve(m_processMap.size());
+		for (const auto &currentEntry : m_processMap) {
+			m_pids.push_back(currentEntry.first);
+			m_names.push_back(currentEntry.second.get());
+		}
+	}
 }
 
 size_t ProcessResolver::amountOfProcesses() const {
 	return m_processMap.size();
 }
 
+const std::vector< const char * > &ProcessResolver::getNames() const {
+	return m_names;
+}
+
+const std::vector< uint64_t > &ProcessResolver::getPIDs() const {
+	return m_pids;
+}
+
+const ProcessResolver::NameIndex &ProcessResolver::getNameIndex() const {
+	return m_nameIndex;
+}
+
+uint64_t ProcessResolver::getGeneration() const {
+	return m_generation;
+}
+
+/// @returns The given UTF-8 encoded process name as a std::wstring, or an empty std::wstring if it isn't valid UTF-8
+static std::wstring toWideName(const char *name) {
+	try {
+		return std::wstring_convert< std::codecvt_utf8< wchar_t > >().from_bytes(name);
+	} catch (const std::range_error &) {
+		return std::wstring();
+	}
+}
+
+void ProcessResolver::foundProcess(uint64_t pid, const char *processName) {
+	m_seen.insert(pid);
+
+	auto it = m_processMap.find(pid);
+	if (it != m_processMap.end()) {
+		if (std::strcmp(it->second.get(), processName) == 0) {
+			return;
+		}
+
+		// The PID has been reused or the process has replaced its image
+		removeProcess(pid);
+	}
 
-/// Helper function for adding an entry to the given process map
-///
-/// @param pid The process's PID
-/// @param processName The name of the process
-/// @param map The map to add the entry to
-void addEntry(uint64_t pid, const char *processName, ProcessResolver::ProcessMap &map) {
 	// 	In order to make sure the name pointer stays valid until we need it, we have ot copy it
 	const size_t nameLength            = std::strlen(processName) + 1; // +1 for terminating NULL-byte
 	std::unique_ptr< char[] > nameCopy = std::make_unique< char[] >(nameLength);
 
 	std::strcpy(nameCopy.get(), processName);
 
-	map.insert(std::make_pair(pid, std::move(nameCopy)));
+	m_processMap.insert(std::make_pair(pid, std::move(nameCopy)));
+	m_nameIndex.insert(std::make_pair(toWideName(processName), pid));
+
+	m_changed = true;
+}
+
+void ProcessResolver::removeProcess(uint64_t pid) {
+	auto it = m_processMap.find(pid);
+	if (it == m_processMap.end()) {
+		return;
+	}
+
+	const auto range = m_nameIndex.equal_range(toWideName(it->second.get()));
+	for (auto indexIt = range.first; indexIt != range.second; ++indexIt) {
+		if (indexIt->second == pid) {
+			m_nameIndex.erase(indexIt);
+			break;
+		}
+	}
+
+	m_processMap.erase(it);
+
+	m_changed = true;
 }
 
 // The implementation of the doResolve-function is platfrom-dependent
@@ -99,7 +188,7 @@ void ProcessResolver::doResolve() {
 
 	while (ok) {
 		if (utf16ToUtf8(pe.szExeFile, sizeof(name), name)) {
-			addEntry(pe.th32ProcessID, name, m_processMap);
+			foundProcess(pe.th32ProcessID, name);
 		}
 #	ifndef QT_NO_DEBUG
 		else {
@@ -137,6 +226,23 @@ void ProcessResolver::doResolve() {
 			continue;
 		}
 
+		m_seen.insert(pid);
+
+		// Looking up the name of a process is expensive compared to listing the PIDs, so it is only done for processes
+		// that have just been started. Their name is looked up a few more times, as it may still change (see
+		// NAME_SETTLE_RESOLVES).
+		auto unsettled   = m_unsettled.find(pid);
+		const bool known = m_processMap.find(pid) != m_processMap.end() || m_unnamed.find(pid) != m_unnamed.end();
+		if (known && unsettled == m_unsettled.end()) {
+			continue;
+		}
+		if (!known) {
+			unsettled = m_unsettled.insert(std::make_pair(pid, NAME_SETTLE_RESOLVES)).first;
+		}
+		if (--unsettled->second <= 0) {
+			m_unsettled.erase(unsettled);
+		}
+
 		QString exe = QFile::symLinkTarget(QString::fromLatin1(PROC_DIR) + currentEntry + QString::fromLatin1("/exe"));
 		QFileInfo fi(exe);
 		QString firstPart      = fi.baseName();
@@ -170,7 +276,11 @@ void ProcessResolver::doResolve() {
 		}
 
 		if (!baseName.isEmpty()) {
-			addEntry(pid, baseName.toUtf8().constData(), m_processMap);
+			m_unnamed.erase(pid);
+			foundProcess(pid, baseName.toUtf8().constData());
+		} else {
+			m_unnamed.insert(pid);
+			removeProcess(pid);
 		}
 	}
 }
@@ -187,7 +297,7 @@ void ProcessResolver::doResolve() {
 		struct proc_bsdinfo proc;
 		int st = proc_pidinfo(pids[i], PROC_PIDTBSDINFO, 0, &proc, PROC_PIDTBSDINFO_SIZE);
 		if (st == PROC_PIDTBSDINFO_SIZE) {
-			addEntry(pids[i], proc.pbi_name, m_processMap);
+			foundProcess(pids[i], proc.pbi_name);
 		}
 	}
 }
@@ -208,7 +318,7 @@ void ProcessResolver::doResolve() {
 	}
 
 	for (int i = 0; i < n_procs; ++i) {
-		addEntry(procs_info[i].ki_pid, procs_info[i].ki_comm, m_processMap);
+		foundProcess(procs_info[i].ki_pid, procs_info[i].ki_comm);
 	}
 
 	free(procs_info);
@@ -261,7 +371,7 @@ void ProcessResolver::doResolve() {
 	}
 
 	for (int i = 0; i < n_procs; ++i) {
-		addEntry(procs_info[i].ki_pid, procs_info[i].ki_comm, m_processMap);
+		foundProcess(procs_info[i].ki_pid, procs_info[i].ki_comm);
 	}
 
 	kvm_cleanup(kd);
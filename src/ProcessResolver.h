@@ -9,14 +9,28 @@
 #include <QtCore/QVector>
 
 #include <cstdint>
+#include <map>
 #include <memory>
+#include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 /// This ProcessResolver can be used to get a QVector of running process names and associated PIDs on multiple
 /// platforms. This object is by no means thread-safe!
+///
+/// The resolver is meant to be kept around and to be asked to resolve() repeatedly. Every call only adds the
+/// processes that have been started and drops the ones that have exited since the previous call, so that users
+/// can tell by getGeneration() whether there has been any change at all.
 class ProcessResolver {
 public:
 	using ProcessMap = std::unordered_map< uint64_t, std::unique_ptr< char[] > >;
+	/// A mapping between process names and PIDs, in the format expected by legacy plugins
+	using NameIndex = std::multimap< std::wstring, unsigned long long int >;
+
+	/// On Linux the name of a new process is looked up in this many calls to resolve(), before it is assumed
+	/// to stay the same. Launchers usually fork() first and exec() the game only afterwards.
+	static constexpr int NAME_SETTLE_RESOLVES = 3;
 
 	/// @param resolveImmediately Whether the constructor should directly invoke ProcesResolver::resolve()
 	ProcessResolver(bool resolveImmediately = true);
@@ -29,10 +43,36 @@ public:
 	const ProcessMap &getProcessMap() const;
 	/// @returns The amount of processes that have been resolved by this object
 	size_t amountOfProcesses() const;
+	/// @returns The names of all processes. The PID of each process is found at the same position in getPIDs().
+	const std::vector< const char * > &getNames() const;
+	/// @returns The PIDs of all processes. The name of each process is found at the same position in getNames().
+	const std::vector< uint64_t > &getPIDs() const;
+	/// @returns An index of all processes by their name
+	const NameIndex &getNameIndex() const;
+	/// @returns A number that is incremented by every call to resolve() that finds processes to have been started
+	/// or to have exited
+	uint64_t getGeneration() const;
 
 protected:
 	/// A map containing the PID->name mapping for the found processes
 	ProcessMap m_processMap;
+	NameIndex m_nameIndex;
+	std::vector< const char * > m_names;
+	std::vector< uint64_t > m_pids;
+	uint64_t m_generation;
+	/// Whether the current call to resolve() has found any change
+	bool m_changed;
+	/// The PIDs of the processes that have been found by the current call to resolve()
+	std::unordered_set< uint64_t > m_seen;
+	/// Processes whose name couldn't be determined (e.g. kernel threads)
+	std::unordered_set< uint64_t > m_unnamed;
+	/// Processes whose name is still looked up again, along with the amount of remaining lookups
+	std::unordered_map< uint64_t, int > m_unsettled;
+
+	/// Records that a process with the given PID and name is running
+	void foundProcess(uint64_t pid, const char *name);
+	/// Removes the process with the given PID, if it is known
+	void removeProcess(uint64_t pid);
 
 	/// The OS specific implementation of filling in details about running process names and PIDs
 	void doResolve();
@@ -6,6 +6,7 @@
 #include "ACLEditor.h"
 
 #include "ACL.h"
+#include "BlobCache.h"
 #include "Channel.h"
 #include "ClientUser.h"
 #include "Database.h"
@@ -315,7 +316,7 @@ void ACLEditor::accept() {
 			const QString &descriptionText = rteChannelDescription->text();
 			mpcs.set_description(u8(descriptionText));
 			needs_update = true;
-			Global::get().db->setBlob(sha1(descriptionText), descriptionText.toUtf8());
+			Global::get().bc->setBlob(sha1(descriptionText), descriptionText.toUtf8());
 		}
 		if (pChannel->iPosition != qsbChannelPosition->value()) {
 			mpcs.set_position(qsbChannelPosition->value());
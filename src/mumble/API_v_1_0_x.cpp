@@ -5,6 +5,7 @@
 
 #include "API.h"
 #include "AudioOutput.h"
+#include "BlobCache.h"
 #include "Channel.h"
 #include "ClientUser.h"
 #include "Database.h"
@@ -805,21 +806,19 @@ void MumbleAPI::getUserComment_v_1_0_x(mumble_plugin_id_t callerID, mumble_conne
 		EXIT_WITH(MUMBLE_EC_USER_NOT_FOUND);
 	}
 
-	if (user->qsComment.isEmpty() && !user->qbaCommentHash.isEmpty()) {
-		user->qsComment = QString::fromUtf8(Global::get().db->blob(user->qbaCommentHash));
+	const QByteArray comment = Global::get().bc->blob(user->qbaCommentHash);
 
-		if (user->qsComment.isEmpty()) {
-			// The user's comment hasn't been synchronized to this client yet
-			EXIT_WITH(MUMBLE_EC_UNSYNCHRONIZED_BLOB);
-		}
+	if (comment.isEmpty() && !user->qbaCommentHash.isEmpty()) {
+		// The user's comment hasn't been synchronized to this client yet
+		EXIT_WITH(MUMBLE_EC_UNSYNCHRONIZED_BLOB);
 	}
 
 	// +1 for NULL terminator
-	size_t size = user->qsComment.toUtf8().size() + 1;
+	size_t size = comment.size() + 1;
 
 	char *nameArray = reinterpret_cast< char * >(malloc(size * sizeof(char)));
 
-	std::strcpy(nameArray, user->qsComment.toUtf8().data());
+	std::strcpy(nameArray, comment.constData());
 
 	m_curator.m_entries.insert({ nameArray, { defaultDeleter, callerID, "getUserComment" } });
 
@@ -858,7 +857,7 @@ void MumbleAPI::getChannelDescription_v_1_0_x(mumble_plugin_id_t callerID, mumbl
 	}
 
 	if (channel->qsDesc.isEmpty() && !channel->qbaDescHash.isEmpty()) {
-		channel->qsDesc = QString::fromUtf8(Global::get().db->blob(channel->qbaDescHash));
+		channel->qsDesc = QString::fromUtf8(Global::get().bc->blob(channel->qbaDescHash));
 
 		if (channel->qsDesc.isEmpty()) {
 			// The channel's description hasn't been synchronized to this client yet
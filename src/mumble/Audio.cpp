@@ -12,6 +12,7 @@
 #	include "OpusCodec.h"
 #endif
 #include "Log.h"
+#include "MumbleConstants.h"
 #include "PacketDataStream.h"
 #include "PluginManager.h"
 #include "Global.h"
@@ -28,6 +29,7 @@ public:
 #define DOUBLE_RAND (rand() / static_cast< double >(RAND_MAX))
 
 LoopUser LoopUser::lpLoopy;
+MixedUser MixedUser::muMixed;
 CodecInit ciInit;
 
 void CodecInit::initialize() {
@@ -169,6 +171,16 @@ void LoopUser::fetchFrames() {
 	qetLastFetch.restart();
 }
 
+MixedUser::MixedUser() {
+	qsName    = QLatin1String("Mixed");
+	uiSession = Mumble::Mixer::MIXED_SESSION;
+	iId       = 0;
+	bMute = bDeaf = bSuppress = false;
+	bLocalIgnore = bLocalMute = bSelfDeaf = false;
+	tsState                               = Settings::Passive;
+	cChannel                              = nullptr;
+}
+
 RecordUser::RecordUser() : LoopUser() {
 	qsName = QLatin1String("Recorder");
 }
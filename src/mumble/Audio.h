@@ -51,6 +51,18 @@ public:
 	void addFrame(const QByteArray &packet) Q_DECL_OVERRIDE;
 };
 
+/// The user audio mixed by the server is played as (see Mumble::Mixer::MIXED_SESSION). Like LoopUser it isn't part
+/// of the user list.
+class MixedUser : public ClientUser {
+private:
+	Q_DISABLE_COPY(MixedUser)
+protected:
+	MixedUser();
+
+public:
+	static MixedUser muMixed;
+};
+
 namespace Audio {
 void startInput(const QString &input = QString());
 void stopInput();
@@ -0,0 +1,90 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "BlobCache.h"
+
+#include "Database.h"
+#include "Global.h"
+
+#include <QtCore/QBuffer>
+#include <QtGui/QImageReader>
+
+BlobCache::BlobCache() : qcBlobs(BLOB_BUDGET), qcImages(IMAGE_BUDGET) {
+}
+
+QByteArray BlobCache::imageKey(const QByteArray &hash, const QSize &size) {
+	QByteArray key = hash;
+	key.append(QByteArray::number(size.width()));
+	key.append('x');
+	key.append(QByteArray::number(size.height()));
+	return key;
+}
+
+int BlobCache::cost(int bytes) {
+	// Every entry costs at least 1 KiB to account for the bookkeeping overhead
+	return bytes / 1024 + 1;
+}
+
+bool BlobCache::contains(const QByteArray &hash) const {
+	return qcBlobs.contains(hash);
+}
+
+QByteArray BlobCache::blob(const QByteArray &hash) {
+	if (hash.isEmpty())
+		return QByteArray();
+
+	if (const QByteArray *cached = qcBlobs.object(hash))
+		return *cached;
+
+	const QByteArray data = Global::get().db->blob(hash);
+	if (!data.isEmpty())
+		qcBlobs.insert(hash, new QByteArray(data), cost(data.size()));
+
+	return data;
+}
+
+void BlobCache::setBlob(const QByteArray &hash, const QByteArray &data) {
+	if (hash.isEmpty() || data.isEmpty())
+		return;
+
+	qcBlobs.insert(hash, new QByteArray(data), cost(data.size()));
+	removeImages(hash);
+
+	Global::get().db->setBlob(hash, data);
+}
+
+QImage BlobCache::image(const QByteArray &hash, const QByteArray &format, const QSize &size) {
+	const QByteArray key = imageKey(hash, size);
+
+	if (const QImage *cached = qcImages.object(key))
+		return *cached;
+
+	QByteArray data = blob(hash);
+	if (data.isEmpty())
+		return QImage();
+
+	QBuffer qb(&data);
+	qb.open(QIODevice::ReadOnly);
+
+	QImageReader qir(&qb, format);
+	if (size.isValid()) {
+		QSize sz = qir.size();
+		sz.scale(size, Qt::KeepAspectRatio);
+		qir.setScaledSize(sz);
+	}
+
+	const QImage img = qir.read();
+	if (!img.isNull())
+		qcImages.insert(key, new QImage(img), cost(img.bytesPerLine() * img.height()));
+
+	return img;
+}
+
+void BlobCache::removeImages(const QByteArray &hash) {
+	foreach (const QByteArray &key, qcImages.keys()) {
+		if (key.startsWith(hash))
+			qcImages.remove(key);
+	}
+}
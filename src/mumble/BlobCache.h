@@ -0,0 +1,65 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MUMBLE_BLOBCACHE_H_
+#define MUMBLE_MUMBLE_BLOBCACHE_H_
+
+#include <QtCore/QByteArray>
+#include <QtCore/QCache>
+#include <QtCore/QSize>
+#include <QtGui/QImage>
+
+/// A bounded in-memory cache for the blobs (textures, comments and channel descriptions) that are
+/// stored in the client database, addressed by their SHA1 hash.
+///
+/// Besides the raw blobs, images decoded from them are cached as well. As every consumer (user list,
+/// overlay, ...) displays avatars at a different size, decoded images are cached per requested size.
+/// Both caches evict the least recently used entries once they exceed their memory budget; evicted
+/// blobs are read from the database again.
+///
+/// The client doesn't keep copies of users' textures and comments (ClientUser::qbaTexture and
+/// ClientUser::qsComment stay empty), only their hashes. Everything that displays them reads them
+/// through this cache, so the memory used for them is bounded by the budgets below.
+class BlobCache {
+private:
+	Q_DISABLE_COPY(BlobCache)
+
+protected:
+	/// Raw blobs, costs are measured in KiB
+	QCache< QByteArray, QByteArray > qcBlobs;
+	/// Decoded images, keyed by the blob's hash followed by the requested size. Costs are measured in KiB.
+	QCache< QByteArray, QImage > qcImages;
+
+	static QByteArray imageKey(const QByteArray &hash, const QSize &size);
+	static int cost(int bytes);
+
+public:
+	/// The memory budget for raw blobs, in KiB
+	static const int BLOB_BUDGET = 16 * 1024;
+	/// The memory budget for decoded images, in KiB
+	static const int IMAGE_BUDGET = 16 * 1024;
+
+	BlobCache();
+
+	/// @returns Whether the blob with the given hash is currently held in memory
+	bool contains(const QByteArray &hash) const;
+	/// @returns The blob with the given hash or an empty QByteArray if it is unknown
+	QByteArray blob(const QByteArray &hash);
+	/// Stores the given blob in the cache as well as in the database
+	void setBlob(const QByteArray &hash, const QByteArray &data);
+
+	/// @param hash The hash of the blob containing the encoded image
+	/// @param format The format of the encoded image. If empty, the format is auto-detected.
+	/// @param size The size the image shall be scaled to (keeping its aspect ratio). If invalid, the
+	/// 	image is returned in its original size.
+	/// @returns The decoded image or a null image if the blob is unknown or can't be decoded
+	QImage image(const QByteArray &hash, const QByteArray &format = QByteArray(), const QSize &size = QSize());
+
+	/// Drops all decoded images of the blob with the given hash, e.g. because the blob has been
+	/// found to be invalid.
+	void removeImages(const QByteArray &hash);
+};
+
+#endif
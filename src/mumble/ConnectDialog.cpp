@@ -12,18 +12,19 @@
 #include "Channel.h"
 #include "Database.h"
 #include "ServerHandler.h"
+#include "ServerPinger.h"
 #include "ServerResolver.h"
 #include "Utils.h"
 #include "WebFetch.h"
 #include "Global.h"
 
 #include <QtCore/QMimeData>
+#include <QtCore/QThread>
 #include <QtCore/QUrlQuery>
 #include <QtCore/QtEndian>
 #include <QtGui/QClipboard>
 #include <QtGui/QDesktopServices>
 #include <QtGui/QPainter>
-#include <QtNetwork/QUdpSocket>
 #include <QtWidgets/QInputDialog>
 #include <QtWidgets/QMenu>
 #include <QtWidgets/QMessageBox>
@@ -60,6 +61,7 @@ void PingStats::init() {
 
 	asQuantile  = new asQuantileType(boost::accumulators::tag::extended_p_square::probabilities = probs);
 	dPing       = 0.0;
+	dJitter     = 0.0;
 	uiPing      = 0;
 	uiPingSort  = 0;
 	uiUsers     = 0;
@@ -513,6 +515,9 @@ QVariant ServerItem::data(int column, int role) const {
 								.arg(ConnectDialog::tr("Ping (95%)"),
 									 ConnectDialog::tr("%1 ms").arg(
 										 boost::accumulators::extended_p_square(*asQuantile)[2] / 1000., 0, 'f', 2))
+						  + QString::fromLatin1("<tr><th align=left>%1</th><td>%2</td></tr>")
+								.arg(ConnectDialog::tr("Jitter"),
+									 ConnectDialog::tr("%1 ms").arg(dJitter / 1000., 0, 'f', 2))
 						  + QString::fromLatin1("<tr><th align=left>%1</th><td>%2</td></tr>")
 								.arg(ConnectDialog::tr("Bandwidth"),
 									 ConnectDialog::tr("%1 kbit/s").arg(uiBandwidth / 1000))
@@ -1041,12 +1046,17 @@ ConnectDialog::ConnectDialog(QWidget *p, bool autoconnect) : QDialog(p), bAutoCo
 	qtPingTick = new QTimer(this);
 	connect(qtPingTick, SIGNAL(timeout()), this, SLOT(timeTick()));
 
-	qusSocket4 = new QUdpSocket(this);
-	qusSocket6 = new QUdpSocket(this);
-	bIPv4      = qusSocket4->bind(QHostAddress(QHostAddress::Any), 0);
-	bIPv6      = qusSocket6->bind(QHostAddress(QHostAddress::AnyIPv6), 0);
-	connect(qusSocket4, SIGNAL(readyRead()), this, SLOT(udpReply()));
-	connect(qusSocket6, SIGNAL(readyRead()), this, SLOT(udpReply()));
+	// Pinging (and processing the replies of) thousands of public servers is done on a separate thread in
+	// order to keep the dialog responsive
+	qtPingThread = new QThread(this);
+	spPinger     = new ServerPinger();
+	spPinger->moveToThread(qtPingThread);
+	connect(qtPingThread, &QThread::started, spPinger, &ServerPinger::start);
+	connect(qtPingThread, &QThread::finished, spPinger, &QObject::deleteLater);
+	connect(this, &ConnectDialog::pingRequested, spPinger, &ServerPinger::ping);
+	connect(this, &ConnectDialog::pingForgotten, spPinger, &ServerPinger::forget);
+	connect(spPinger, &ServerPinger::results, this, &ConnectDialog::pingResults);
+	qtPingThread->start();
 
 	if (qtwServers->siFavorite->isHidden() && (!qtwServers->siLAN || qtwServers->siLAN->isHidden())
 		&& qtwServers->siPublic) {
@@ -1071,6 +1081,9 @@ ConnectDialog::ConnectDialog(QWidget *p, bool autoconnect) : QDialog(p), bAutoCo
 }
 
 ConnectDialog::~ConnectDialog() {
+	qtPingThread->quit();
+	qtPingThread->wait();
+
 #ifdef USE_ZEROCONF
 	if (bAllowZeroconf && Global::get().zeroconf && Global::get().zeroconf->isOk()) {
 		Global::get().zeroconf->stopBrowser();
@@ -1525,37 +1538,63 @@ void ConnectDialog::timeTick() {
 		}
 	}
 
-	if (!si) {
-		if (qlItems.isEmpty())
-			return;
+	QList< ServerAddress > addresses;
+	int count = 0;
 
-		bool expanded;
+	if (si) {
+		addresses << si->qlAddresses;
+		++count;
 
-		do {
-			++iPingIndex;
-			if (iPingIndex >= qlItems.count()) {
-				if (tRestart.isElapsed(1000000ULL))
-					iPingIndex = 0;
-				else
-					return;
-			}
-			si = qlItems.at(iPingIndex);
+		if (si == current)
+			tCurrent.restart();
+		if (si == hover)
+			tHover.restart();
+	}
 
-			ServerItem *p = si->siParent;
-			expanded      = true;
-			while (p && expanded) {
-				expanded = expanded && p->isExpanded();
-				p        = p->siParent;
-			}
-		} while (si->qlAddresses.isEmpty() || !expanded);
+	// Send the pings for a couple of servers at once, so that even long lists are cycled through in time
+	while (count < PING_BATCH) {
+		si = nextPingItem();
+		if (!si)
+			break;
+
+		addresses << si->qlAddresses;
+		++count;
+
+		if (si == current)
+			tCurrent.restart();
+		if (si == hover)
+			tHover.restart();
 	}
 
-	if (si == current)
-		tCurrent.restart();
-	if (si == hover)
-		tHover.restart();
+	sendPing(addresses);
+}
+
+ServerItem *ConnectDialog::nextPingItem() {
+	if (qlItems.isEmpty())
+		return nullptr;
 
-	foreach (const ServerAddress &addr, si->qlAddresses) { sendPing(addr.host.toAddress(), addr.port); }
+	ServerItem *si;
+	bool expanded;
+
+	do {
+		++iPingIndex;
+		if (iPingIndex >= qlItems.count()) {
+			if (tRestart.isElapsed(1000000ULL))
+				iPingIndex = 0;
+			else
+				return nullptr;
+		}
+		si = qlItems.at(iPingIndex);
+
+		ServerItem *p = si->siParent;
+		expanded      = true;
+		while (p && expanded) {
+			expanded = expanded && p->isExpanded();
+			p        = p->siParent;
+		}
+	} while (si->qlAddresses.isEmpty() || !expanded);
+
+	return si;
 }
 
 void ConnectDialog::filterPublicServerList() const {
@@ -1659,7 +1698,7 @@ void ConnectDialog::stopDns(ServerItem *si) {
 			qhPings[addr].remove(si);
 			if (qhPings[addr].isEmpty()) {
 				qhPings.remove(addr);
-				qhPingRand.remove(addr);
+				emit pingForgotten(addr);
 			}
 		}
 	}
@@ -1717,80 +1756,33 @@ void ConnectDialog::lookedUp() {
 	}
 
 	if (bAllowPing) {
-		foreach (const ServerAddress &addr, qs) { sendPing(addr.host.toAddress(), addr.port); }
+		sendPing(qs.values());
 	}
 }
 
-void ConnectDialog::sendPing(const QHostAddress &host, unsigned short port) {
-	char blob[16];
-
-	ServerAddress addr(HostAddress(host), port);
-
-	quint64 uiRand;
-	if (qhPingRand.contains(addr)) {
-		uiRand = qhPingRand.value(addr);
-	} else {
-#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
-		uiRand = QRandomGenerator::global()->generate64() << 32;
-#else
-		// Qt 5.10 introduces the QRandomGenerator class and in Qt 5.15 qrand got deprecated in its favor
-		uiRand = (static_cast< quint64 >(qrand()) << 32) | static_cast< quint64 >(qrand());
-#endif
-		qhPingRand.insert(addr, uiRand);
-	}
-
-	memset(blob, 0, sizeof(blob));
-	*reinterpret_cast< quint64 * >(blob + 8) = tPing.elapsed() ^ uiRand;
-
-	if (bIPv4 && host.protocol() == QAbstractSocket::IPv4Protocol)
-		qusSocket4->writeDatagram(blob + 4, 12, host, port);
-	else if (bIPv6 && host.protocol() == QAbstractSocket::IPv6Protocol)
-		qusSocket6->writeDatagram(blob + 4, 12, host, port);
-	else
-		return;
-
-	const QSet< ServerItem * > &qs = qhPings.value(addr);
-
-	foreach (ServerItem *si, qs)
-		++si->uiSent;
+void ConnectDialog::sendPing(const QList< ServerAddress > &addresses) {
+	if (!addresses.isEmpty())
+		emit pingRequested(addresses);
 }
 
-void ConnectDialog::udpReply() {
-	QUdpSocket *sock = qobject_cast< QUdpSocket * >(sender());
-
-	while (sock->hasPendingDatagrams()) {
-		char blob[64];
-
-		QHostAddress host;
-		unsigned short port;
-
-		qint64 len = sock->readDatagram(blob + 4, 24, &host, &port);
-		if (len == 24) {
-			if (host.scopeId() == QLatin1String("0"))
-				host.setScopeId(QLatin1String(""));
-
-			ServerAddress address(HostAddress(host), port);
-
-			if (qhPings.contains(address)) {
-				quint32 *ping = reinterpret_cast< quint32 * >(blob + 4);
-				quint64 *ts   = reinterpret_cast< quint64 * >(blob + 8);
-
-				quint64 elapsed = tPing.elapsed() - (*ts ^ qhPingRand.value(address));
+void ConnectDialog::pingResults(const QVector< ServerPinger::Reply > &replies, const QVector< ServerAddress > &sent) {
+	foreach (const ServerAddress &address, sent) {
+		foreach (ServerItem *si, qhPings.value(address))
+			++si->uiSent;
+	}
 
-				foreach (ServerItem *si, qhPings.value(address)) {
-					si->uiVersion    = qFromBigEndian(ping[0]);
-					quint32 users    = qFromBigEndian(ping[3]);
-					quint32 maxusers = qFromBigEndian(ping[4]);
-					si->uiBandwidth  = qFromBigEndian(ping[5]);
+	foreach (const ServerPinger::Reply &reply, replies) {
+		foreach (ServerItem *si, qhPings.value(reply.address)) {
+			si->uiVersion   = reply.uiVersion;
+			si->uiBandwidth = reply.uiBandwidth;
+			si->dJitter     = reply.dJitter;
 
-					if (!si->uiPingSort)
-						si->uiPingSort = qmPingCache.value(UnresolvedServerAddress(si->qsHostname, si->usPort));
+			if (!si->uiPingSort)
+				si->uiPingSort = qmPingCache.value(UnresolvedServerAddress(si->qsHostname, si->usPort));
 
-					si->setDatas(static_cast< double >(elapsed), users, maxusers);
-					if (si->itType == ServerItem::PublicType) {
-						filterServer(si);
-					}
-				}
+			si->setDatas(static_cast< double >(reply.uiElapsed), reply.uiUsers, reply.uiMaxUsers);
+			if (si->itType == ServerItem::PublicType) {
+				filterServer(si);
 			}
 		}
 	}
@@ -28,11 +28,12 @@
 #include "HostAddress.h"
 #include "Net.h"
 #include "ServerAddress.h"
+#include "ServerPinger.h"
 #include "Timer.h"
 #include "UnresolvedServerAddress.h"
 
 struct FavoriteServer;
-class QUdpSocket;
+class QThread;
 
 struct PublicInfo {
 	QString qsName;
@@ -62,6 +63,8 @@ public:
 	quint32 uiRecv;
 
 	double dPing;
+	/// The variation of the round-trip time, in microseconds
+	double dJitter;
 
 	typedef boost::accumulators::accumulator_set<
 		double,
@@ -244,10 +247,10 @@ protected:
 	bool bPublicInit;
 	bool bAutoConnect;
 
-	Timer tPing;
 	Timer tCurrent, tHover, tRestart;
-	QUdpSocket *qusSocket4;
-	QUdpSocket *qusSocket6;
+	/// The thread the pinger lives in
+	QThread *qtPingThread;
+	ServerPinger *spPinger;
 	QTimer *qtPingTick;
 	QList< ServerItem * > qlItems;
 
@@ -258,7 +261,6 @@ protected:
 	QHash< UnresolvedServerAddress, QSet< ServerItem * > > qhDNSWait;
 	QHash< UnresolvedServerAddress, QList< ServerAddress > > qhDNSCache;
 
-	QHash< ServerAddress, quint64 > qhPingRand;
 	QHash< ServerAddress, QSet< ServerItem * > > qhPings;
 
 	QMap< UnresolvedServerAddress, unsigned int > qmPingCache;
@@ -266,8 +268,6 @@ protected:
 	QString qsSearchServername;
 	QString qsSearchLocation;
 
-	bool bIPv4;
-	bool bIPv6;
 	int iPingIndex;
 
 	bool bLastFound;
@@ -289,7 +289,13 @@ protected:
 	bool bAllowFilters;
 
 
-	void sendPing(const QHostAddress &, unsigned short port);
+	/// The maximum amount of servers pinged in the course of one ConnectDialog::timeTick
+	static const int PING_BATCH = 10;
+
+	void sendPing(const QList< ServerAddress > &addresses);
+	/// @returns The next server item to be pinged when cycling through the list, or nullptr
+	/// 	if the current cycle has finished and the next one may not be started yet
+	ServerItem *nextPingItem();
 
 	void initList();
 	void fillList();
@@ -319,7 +325,7 @@ public slots:
 	void accept();
 	void fetched(QByteArray xmlData, QUrl, QMap< QString, QString >);
 
-	void udpReply();
+	void pingResults(const QVector< ServerPinger::Reply > &replies, const QVector< ServerAddress > &sent);
 	void lookedUp();
 	void timeTick();
 
@@ -347,6 +353,12 @@ public slots:
 	void on_qtwServers_itemCollapsed(QTreeWidgetItem *item);
 	void OnSortChanged(int, Qt::SortOrder);
 
+signals:
+	/// Asks the pinger to ping the given addresses
+	void pingRequested(const QList< ServerAddress > &addresses);
+	/// Tells the pinger that the given address is no longer of interest
+	void pingForgotten(const ServerAddress &address);
+
 public:
 	QString qsServer, qsUsername, qsPassword;
 	unsigned short usPort;
@@ -17,13 +17,18 @@
 #include <QtGui/QClipboard>
 #include <QtGui/QContextMenuEvent>
 #include <QtGui/QKeyEvent>
+#include <QtGui/QTextBlock>
+#include <QtGui/QTextDocumentFragment>
 #include <QtWidgets/QScrollBar>
 
-LogTextBrowser::LogTextBrowser(QWidget *p) : QTextBrowser(p) {
+LogTextBrowser::LogTextBrowser(QWidget *p)
+	: QTextBrowser(p), uiWindowBegin(0), uiWindowEnd(0), bRebuilding(false) {
+	connect(verticalScrollBar(), &QScrollBar::valueChanged, this, &LogTextBrowser::scrolled);
 }
 
 void LogTextBrowser::resizeEvent(QResizeEvent *e) {
-	scrollLogToBottom();
+	if (uiWindowEnd == lhHistory.end())
+		scrollLogToBottom();
 	QTextBrowser::resizeEvent(e);
 }
 
@@ -50,6 +55,147 @@ void LogTextBrowser::scrollLogToBottom() {
 	verticalScrollBar()->setValue(verticalScrollBar()->maximum());
 }
 
+int LogTextBrowser::insertEntry(QTextCursor &tc, const LogEntry &entry) {
+	// We copy the value from the settings in order to make sure that
+	// we use the same margin for the whole entry.
+	const int msgMargin = Global::get().s.iChatMessageMargins;
+
+	if (entry.bFramed) {
+		// The message ends with one or more blank lines (or lines only containing whitespace),
+		// so paint a border around it to make clear that it contains invisible parts.
+		QTextFrameFormat qttf;
+		qttf.setBorder(1);
+		qttf.setPadding(2);
+		qttf.setMargin(msgMargin);
+		qttf.setBorderStyle(QTextFrameFormat::BorderStyle_Dashed);
+		tc.insertFrame(qttf);
+	} else if (!tc.block().text().isEmpty()) {
+		// Only insert a block if the current block is not empty. It may be empty because
+		// it is the default block of an empty document. Another cause might be that apparently
+		// a new empty block is automatically inserted after a frame.
+		tc.insertBlock();
+	}
+
+	QTextBlockFormat format = tc.blockFormat();
+	format.setTopMargin(msgMargin);
+	format.setBottomMargin(msgMargin);
+	tc.setBlockFormat(format);
+
+	const int position = tc.position();
+
+	if (!entry.qsPrefix.isEmpty())
+		tc.insertHtml(entry.qsPrefix);
+	tc.insertFragment(QTextDocumentFragment::fromHtml(entry.html()));
+	tc.movePosition(QTextCursor::End);
+
+	return position;
+}
+
+int LogTextBrowser::showWindow(quint64 begin, quint64 end, quint64 anchor) {
+	bRebuilding = true;
+
+	document()->clear();
+
+	QTextCursor tc(document());
+	int anchorPosition = -1;
+	for (quint64 i = begin; i < end; ++i) {
+		const int position = insertEntry(tc, lhHistory.at(i));
+		if (i == anchor)
+			anchorPosition = position;
+	}
+	setTextCursor(tc);
+
+	uiWindowBegin = begin;
+	uiWindowEnd   = end;
+
+	int y = 0;
+	if (anchorPosition >= 0) {
+		const QTextBlock block = document()->findBlock(anchorPosition);
+		y = static_cast< int >(document()->documentLayout()->blockBoundingRect(block).top());
+	}
+
+	bRebuilding = false;
+
+	return y;
+}
+
+void LogTextBrowser::showLatest() {
+	const quint64 end   = lhHistory.end();
+	const quint64 begin = qMax(lhHistory.first(), end > WINDOW_ENTRIES ? end - WINDOW_ENTRIES : 0);
+
+	showWindow(begin, end, end);
+	scrollLogToBottom();
+}
+
+void LogTextBrowser::scrolled(int value) {
+	if (bRebuilding)
+		return;
+
+	if (value == verticalScrollBar()->minimum() && uiWindowBegin > lhHistory.first()) {
+		// Move the window towards older entries, keeping the entry that has been on top in place
+		const quint64 anchor = qMin(uiWindowBegin, lhHistory.end());
+		const quint64 begin  = qMax(lhHistory.first(), anchor > PAGE_ENTRIES ? anchor - PAGE_ENTRIES : 0);
+		const quint64 end    = qMin(qMin(uiWindowEnd, lhHistory.end()), begin + WINDOW_ENTRIES);
+
+		setLogScroll(showWindow(begin, end, anchor));
+	} else if (value == verticalScrollBar()->maximum() && uiWindowEnd < lhHistory.end()) {
+		// Move the window towards newer entries, keeping the entry that has been at the bottom in place
+		const quint64 anchor = qMax(uiWindowEnd, lhHistory.first());
+		const quint64 end    = qMin(lhHistory.end(), anchor + PAGE_ENTRIES);
+		const quint64 begin  = qMax(lhHistory.first(), end > WINDOW_ENTRIES ? end - WINDOW_ENTRIES : 0);
+
+		setLogScroll(showWindow(begin, end, anchor) - viewport()->height());
+	}
+}
+
+void LogTextBrowser::appendEntry(const LogEntry &entry, bool scrollToBottom) {
+	const bool live = uiWindowEnd == lhHistory.end();
+
+	lhHistory.append(entry);
+
+	if (!live) {
+		// The user is looking at older messages, so the entry will be shown once they scroll down to it
+		if (scrollToBottom)
+			showLatest();
+		return;
+	}
+
+	const int oldscrollvalue = getLogScroll();
+	const bool scroll        = scrollToBottom || (oldscrollvalue == getLogScrollMaximum());
+
+	if (uiWindowEnd - uiWindowBegin >= 2 * WINDOW_ENTRIES) {
+		// Don't let the document grow without bounds. If the user is following the log, shrink the
+		// window to the latest entries. Otherwise leave the document alone until they scroll down.
+		if (scroll)
+			showLatest();
+		return;
+	}
+
+	QTextCursor tc = textCursor();
+	tc.movePosition(QTextCursor::End);
+	insertEntry(tc, entry);
+	setTextCursor(tc);
+
+	uiWindowEnd = lhHistory.end();
+
+	if (scroll)
+		scrollLogToBottom();
+	else
+		setLogScroll(oldscrollvalue);
+}
+
+void LogTextBrowser::setMaximumEntries(int maxEntries) {
+	lhHistory.setMaximumEntries(maxEntries);
+}
+
+void LogTextBrowser::clearLog() {
+	lhHistory.clear();
+	clear();
+
+	uiWindowBegin = lhHistory.end();
+	uiWindowEnd   = lhHistory.end();
+}
+
 
 void ChatbarTextEdit::focusInEvent(QFocusEvent *qfe) {
 	inFocus(true);
@@ -6,26 +6,70 @@
 #ifndef MUMBLE_MUMBLE_CUSTOMELEMENTS_H_
 #define MUMBLE_MUMBLE_CUSTOMELEMENTS_H_
 
+#include "LogHistory.h"
+
 #include <QtCore/QObject>
 #include <QtWidgets/QLabel>
 #include <QtWidgets/QTextBrowser>
 #include <QtWidgets/QTextEdit>
 
+/// The chat log.
+///
+/// All messages are kept in a LogHistory, but only a window of them is laid out in the document. Once the
+/// user scrolls to either end of that window, it is moved further into the history.
 class LogTextBrowser : public QTextBrowser {
 private:
 	Q_OBJECT
 	Q_DISABLE_COPY(LogTextBrowser)
 protected:
+	LogHistory lhHistory;
+	/// The index of the first entry of the history that is shown in the document
+	quint64 uiWindowBegin;
+	/// The index following the one of the last entry of the history that is shown in the document
+	quint64 uiWindowEnd;
+	bool bRebuilding;
+
 	void resizeEvent(QResizeEvent *e) Q_DECL_OVERRIDE;
 	bool event(QEvent *e) Q_DECL_OVERRIDE;
 
+	/// Appends the given entry to the document.
+	///
+	/// @returns The position in the document at which the entry starts
+	int insertEntry(QTextCursor &tc, const LogEntry &entry);
+	/// Replaces the document's contents by the entries [begin, end) of the history.
+	///
+	/// @param anchor The index of an entry whose vertical position in the rebuilt document is to be returned
+	/// @returns The vertical position of the anchor in the document or 0 if it isn't part of the window
+	int showWindow(quint64 begin, quint64 end, quint64 anchor);
+	void showLatest();
+
+protected slots:
+	void scrolled(int value);
+
 public:
+	/// The amount of entries laid out in the document
+	static const int WINDOW_ENTRIES = 250;
+	/// The amount of entries the window is moved by when scrolling to its end
+	static const int PAGE_ENTRIES = 50;
+
 	LogTextBrowser(QWidget *p = nullptr);
 
+	/// Adds an entry to the history and, if the newest messages are currently shown, to the document.
+	///
+	/// @param scrollToBottom Whether to scroll to the new entry even if the log isn't scrolled to the bottom
+	void appendEntry(const LogEntry &entry, bool scrollToBottom);
+	/// @param maxEntries The maximum amount of entries kept in the history. If 0, it is only limited by the
+	/// 	history's memory budget.
+	void setMaximumEntries(int maxEntries);
+
 	int getLogScroll();
 	int getLogScrollMaximum();
 	void setLogScroll(int scroll_pos);
 	void scrollLogToBottom();
+
+public slots:
+	/// Removes all entries from the history and the document
+	void clearLog();
 };
 
 class ChatbarTextEdit : public QTextEdit {
@@ -5,6 +5,7 @@
 
 #include "Database.h"
 
+#include "DatabaseWriter.h"
 #include "Message.h"
 #include "MumbleApplication.h"
 #include "Net.h"
@@ -238,25 +239,90 @@ Database::Database(const QString &dbname) {
 	execQueryAndLogFailure(query, QLatin1String("VACUUM"));
 
 	execQueryAndLogFailure(query, QLatin1String("PRAGMA synchronous = NORMAL"));
+
+	// With a write-ahead log, reads on this connection are not blocked while the writer thread commits.
+	// The journal mode is a property of the database file, so this also applies to the writer's connection.
+	QString journalMode;
+	if (execQueryAndLogFailure(query, QLatin1String("PRAGMA journal_mode = WAL")) && query.next())
+		journalMode = query.value(0).toString();
+
+	if (journalMode.compare(QLatin1String("wal"), Qt::CaseInsensitive) != 0) {
+		qWarning("Database: Write-ahead logging is not available, reads may wait for pending writes");
 #ifdef Q_OS_WIN
-	// Windows can not handle TRUNCATE with multiple connections to the DB. Thus less performant DELETE.
-	execQueryAndLogFailure(query, QLatin1String("PRAGMA journal_mode = DELETE"));
+		// Windows can not handle TRUNCATE with multiple connections to the DB. Thus less performant DELETE.
+		execQueryAndLogFailure(query, QLatin1String("PRAGMA journal_mode = DELETE"));
 #else
-	execQueryAndLogFailure(query, QLatin1String("PRAGMA journal_mode = TRUNCATE"));
+		execQueryAndLogFailure(query, QLatin1String("PRAGMA journal_mode = TRUNCATE"));
 #endif
+	}
 
 	execQueryAndLogFailure(query, QLatin1String("SELECT sqlite_version()"));
 	while (query.next())
 		qWarning() << "Database SQLite:" << query.value(0).toString();
+
+	loadTables();
+
+	dwWriter = new DatabaseWriter(db.databaseName(), db.connectionName() + QLatin1String("_writer"));
+	dwWriter->start(QThread::LowPriority);
 }
 
 Database::~Database() {
+	// Make sure everything has been written before the database is compacted
+	dwWriter->stop();
+	delete dwWriter;
+
 	QSqlQuery query(db);
 	execQueryAndLogFailure(query, QLatin1String("PRAGMA journal_mode = DELETE"));
 	execQueryAndLogFailure(query, QLatin1String("VACUUM"));
 }
 
+void Database::loadTables() {
+	QSqlQuery query(db);
+
+	query.prepare(QLatin1String("SELECT `hash` FROM `ignored`"));
+	execQueryAndLogFailure(query);
+	while (query.next())
+		qsIgnored.insert(query.value(0).toString());
+
+	query.prepare(QLatin1String("SELECT `hash` FROM `ignored_tts`"));
+	execQueryAndLogFailure(query);
+	while (query.next())
+		qsIgnoredTTS.insert(query.value(0).toString());
+
+	query.prepare(QLatin1String("SELECT `hash` FROM `muted`"));
+	execQueryAndLogFailure(query);
+	while (query.next())
+		qsMuted.insert(query.value(0).toString());
+
+	query.prepare(QLatin1String("SELECT `hash`, `volume` FROM `volume`"));
+	execQueryAndLogFailure(query);
+	while (query.next())
+		qhVolumes.insert(query.value(0).toString(), query.value(1).toString().toFloat());
+
+	query.prepare(QLatin1String("SELECT `hash`, `nickname` FROM `nicknames`"));
+	execQueryAndLogFailure(query);
+	while (query.next())
+		qhNicknames.insert(query.value(0).toString(), query.value(1).toString());
+
+	query.prepare(QLatin1String("SELECT `server_cert_digest`, `channel_id` FROM `filtered_channels`"));
+	execQueryAndLogFailure(query);
+	while (query.next())
+		qsFilteredChannels.insert(qMakePair(query.value(0).toByteArray(), query.value(1).toInt()));
+
+	query.prepare(QLatin1String("SELECT `who`, `comment` FROM `comments`"));
+	execQueryAndLogFailure(query);
+	while (query.next())
+		qsSeenComments.insert(qMakePair(query.value(0).toString(), query.value(1).toByteArray()));
+
+	query.prepare(QLatin1String("SELECT `name`, `hash` FROM `friends`"));
+	execQueryAndLogFailure(query);
+	while (query.next())
+		qhFriends.insert(query.value(1).toString(), query.value(0).toString());
+}
+
 QList< FavoriteServer > Database::getFavorites() {
+	dwWriter->flush();
+
 	QSqlQuery query(db);
 	QList< FavoriteServer > ql;
 
@@ -278,158 +344,125 @@ QList< FavoriteServer > Database::getFavorites() {
 }
 
 void Database::setFavorites(const QList< FavoriteServer > &servers) {
-	QSqlQuery query(db);
-	QSqlDatabase::database().transaction();
+	QList< DatabaseStatement > statements;
 
-	query.prepare(QLatin1String("DELETE FROM `servers`"));
-	execQueryAndLogFailure(query);
+	statements << DatabaseStatement(QLatin1String("DELETE FROM `servers`"));
 
-	query.prepare(QLatin1String(
-		"REPLACE INTO `servers` (`name`, `hostname`, `port`, `username`, `password`, `url`) VALUES (?,?,?,?,?,?)"));
 	foreach (const FavoriteServer &s, servers) {
-		query.addBindValue(s.qsName);
-		query.addBindValue(s.qsHostname);
-		query.addBindValue(s.usPort);
-		query.addBindValue(s.qsUsername);
-		query.addBindValue(s.qsPassword);
-		query.addBindValue(s.qsUrl);
-		execQueryAndLogFailure(query);
+		statements << DatabaseStatement(
+			QLatin1String("REPLACE INTO `servers` (`name`, `hostname`, `port`, `username`, `password`, `url`) "
+						  "VALUES (?,?,?,?,?,?)"),
+			QVariantList() << s.qsName << s.qsHostname << s.usPort << s.qsUsername << s.qsPassword << s.qsUrl);
 	}
 
-	QSqlDatabase::database().commit();
+	dwWriter->enqueue(QLatin1String("servers"), statements);
 }
 
 bool Database::isLocalIgnored(const QString &hash) {
-	QSqlQuery query(db);
-
-	query.prepare(QLatin1String("SELECT `hash` FROM `ignored` WHERE `hash` = ?"));
-	query.addBindValue(hash);
-	execQueryAndLogFailure(query);
-	return query.next();
+	return qsIgnored.contains(hash);
 }
 
 void Database::setLocalIgnored(const QString &hash, bool ignored) {
-	QSqlQuery query(db);
-
-	if (ignored)
-		query.prepare(QLatin1String("INSERT INTO `ignored` (`hash`) VALUES (?)"));
-	else
-		query.prepare(QLatin1String("DELETE FROM `ignored` WHERE `hash` = ?"));
-	query.addBindValue(hash);
-	execQueryAndLogFailure(query);
+	if (ignored) {
+		qsIgnored.insert(hash);
+		dwWriter->enqueue(QLatin1String("ignored:") + hash,
+						  DatabaseStatement(QLatin1String("INSERT OR IGNORE INTO `ignored` (`hash`) VALUES (?)"),
+											QVariantList() << hash));
+	} else {
+		qsIgnored.remove(hash);
+		dwWriter->enqueue(QLatin1String("ignored:") + hash,
+						  DatabaseStatement(QLatin1String("DELETE FROM `ignored` WHERE `hash` = ?"),
+											QVariantList() << hash));
+	}
 }
 
 bool Database::isLocalIgnoredTTS(const QString &hash) {
-	QSqlQuery query(db);
-
-	query.prepare(QLatin1String("SELECT `hash` FROM `ignored_tts` WHERE `hash` = ?"));
-	query.addBindValue(hash);
-	execQueryAndLogFailure(query);
-	return query.next();
+	return qsIgnoredTTS.contains(hash);
 }
 
 void Database::setLocalIgnoredTTS(const QString &hash, bool ignoredTTS) {
-	QSqlQuery query(db);
-
-	if (ignoredTTS)
-		query.prepare(QLatin1String("INSERT INTO `ignored_tts` (`hash`) VALUES (?)"));
-	else
-		query.prepare(QLatin1String("DELETE FROM `ignored_tts` WHERE `hash` = ?"));
-	query.addBindValue(hash);
-	execQueryAndLogFailure(query);
+	if (ignoredTTS) {
+		qsIgnoredTTS.insert(hash);
+		dwWriter->enqueue(QLatin1String("ignored_tts:") + hash,
+						  DatabaseStatement(QLatin1String("INSERT OR IGNORE INTO `ignored_tts` (`hash`) VALUES (?)"),
+											QVariantList() << hash));
+	} else {
+		qsIgnoredTTS.remove(hash);
+		dwWriter->enqueue(QLatin1String("ignored_tts:") + hash,
+						  DatabaseStatement(QLatin1String("DELETE FROM `ignored_tts` WHERE `hash` = ?"),
+											QVariantList() << hash));
+	}
 }
 
 bool Database::isLocalMuted(const QString &hash) {
-	QSqlQuery query(db);
-
-	query.prepare(QLatin1String("SELECT `hash` FROM `muted` WHERE `hash` = ?"));
-	query.addBindValue(hash);
-	execQueryAndLogFailure(query);
-	return query.next();
+	return qsMuted.contains(hash);
 }
 
 void Database::setUserLocalVolume(const QString &hash, float volume) {
-	QSqlQuery query(db);
+	qhVolumes.insert(hash, volume);
 
-	query.prepare(QLatin1String("INSERT OR REPLACE INTO `volume` (`hash`, `volume`) VALUES (?,?)"));
-	query.addBindValue(hash);
-	query.addBindValue(QString::number(volume));
-	execQueryAndLogFailure(query);
+	dwWriter->enqueue(
+		QLatin1String("volume:") + hash,
+		DatabaseStatement(QLatin1String("INSERT OR REPLACE INTO `volume` (`hash`, `volume`) VALUES (?,?)"),
+						  QVariantList() << hash << QString::number(volume)));
 }
 
 float Database::getUserLocalVolume(const QString &hash) {
-	QSqlQuery query(db);
-
-	query.prepare(QLatin1String("SELECT `volume` FROM `volume` WHERE `hash` = ?"));
-	query.addBindValue(hash);
-	execQueryAndLogFailure(query);
-	if (query.first()) {
-		return query.value(0).toString().toFloat();
-	}
-	return 1.0f;
+	return qhVolumes.value(hash, 1.0f);
 }
 
 void Database::setUserLocalNickname(const QString &hash, const QString &nickname) {
-	QSqlQuery query(db);
+	qhNicknames.insert(hash, nickname);
 
-	query.prepare(QLatin1String("INSERT OR REPLACE INTO `nicknames` (`hash`, `nickname`) VALUES (?,?)"));
-	query.addBindValue(hash);
-	query.addBindValue(nickname);
-	execQueryAndLogFailure(query);
+	dwWriter->enqueue(
+		QLatin1String("nicknames:") + hash,
+		DatabaseStatement(QLatin1String("INSERT OR REPLACE INTO `nicknames` (`hash`, `nickname`) VALUES (?,?)"),
+						  QVariantList() << hash << nickname));
 }
 
 QString Database::getUserLocalNickname(const QString &hash) {
-	QSqlQuery query(db);
-
-	query.prepare(QLatin1String("SELECT `nickname` FROM `nicknames` WHERE `hash` = ?"));
-	query.addBindValue(hash);
-	execQueryAndLogFailure(query);
-	if (query.first()) {
-		return query.value(0).toString();
-	}
-	return QString();
+	return qhNicknames.value(hash);
 }
 
 void Database::setLocalMuted(const QString &hash, bool muted) {
-	QSqlQuery query(db);
-
-	if (muted)
-		query.prepare(QLatin1String("INSERT INTO `muted` (`hash`) VALUES (?)"));
-	else
-		query.prepare(QLatin1String("DELETE FROM `muted` WHERE `hash` = ?"));
-	query.addBindValue(hash);
-	execQueryAndLogFailure(query);
+	if (muted) {
+		qsMuted.insert(hash);
+		dwWriter->enqueue(QLatin1String("muted:") + hash,
+						  DatabaseStatement(QLatin1String("INSERT OR IGNORE INTO `muted` (`hash`) VALUES (?)"),
+											QVariantList() << hash));
+	} else {
+		qsMuted.remove(hash);
+		dwWriter->enqueue(
+			QLatin1String("muted:") + hash,
+			DatabaseStatement(QLatin1String("DELETE FROM `muted` WHERE `hash` = ?"), QVariantList() << hash));
+	}
 }
 
 bool Database::isChannelFiltered(const QByteArray &server_cert_digest, const int channel_id) {
-	QSqlQuery query(db);
-
-	query.prepare(QLatin1String(
-		"SELECT `channel_id` FROM `filtered_channels` WHERE `server_cert_digest` = ? AND `channel_id` = ?"));
-	query.addBindValue(server_cert_digest);
-	query.addBindValue(channel_id);
-	execQueryAndLogFailure(query);
-
-	return query.next();
+	return qsFilteredChannels.contains(qMakePair(server_cert_digest, channel_id));
 }
 
 void Database::setChannelFiltered(const QByteArray &server_cert_digest, const int channel_id, const bool hidden) {
-	QSqlQuery query(db);
-
-	if (hidden)
-		query.prepare(
-			QLatin1String("INSERT INTO `filtered_channels` (`server_cert_digest`, `channel_id`) VALUES (?, ?)"));
-	else
-		query.prepare(
-			QLatin1String("DELETE FROM `filtered_channels` WHERE `server_cert_digest` = ? AND `channel_id` = ?"));
-
-	query.addBindValue(server_cert_digest);
-	query.addBindValue(channel_id);
-
-	execQueryAndLogFailure(query);
+	const QString key = QString::fromLatin1("filtered_channels:%1:%2")
+							.arg(QString::fromLatin1(server_cert_digest.toHex()))
+							.arg(channel_id);
+
+	if (hidden) {
+		qsFilteredChannels.insert(qMakePair(server_cert_digest, channel_id));
+		dwWriter->enqueue(key, DatabaseStatement(QLatin1String("INSERT OR IGNORE INTO `filtered_channels` "
+															   "(`server_cert_digest`, `channel_id`) VALUES (?, ?)"),
+												 QVariantList() << server_cert_digest << channel_id));
+	} else {
+		qsFilteredChannels.remove(qMakePair(server_cert_digest, channel_id));
+		dwWriter->enqueue(key, DatabaseStatement(QLatin1String("DELETE FROM `filtered_channels` WHERE "
+															   "`server_cert_digest` = ? AND `channel_id` = ?"),
+												 QVariantList() << server_cert_digest << channel_id));
+	}
 }
 
 QMap< UnresolvedServerAddress, unsigned int > Database::getPingCache() {
+	dwWriter->flush();
+
 	QSqlQuery query(db);
 	QMap< UnresolvedServerAddress, unsigned int > map;
 
@@ -444,55 +477,47 @@ QMap< UnresolvedServerAddress, unsigned int > Database::getPingCache() {
 }
 
 void Database::setPingCache(const QMap< UnresolvedServerAddress, unsigned int > &map) {
-	QSqlQuery query(db);
+	QList< DatabaseStatement > statements;
 	QMap< UnresolvedServerAddress, unsigned int >::const_iterator i;
 
-	QSqlDatabase::database().transaction();
-
-	query.prepare(QLatin1String("DELETE FROM `pingcache`"));
-	execQueryAndLogFailure(query);
+	statements << DatabaseStatement(QLatin1String("DELETE FROM `pingcache`"));
 
-	query.prepare(QLatin1String("REPLACE INTO `pingcache` (`hostname`, `port`, `ping`) VALUES (?,?,?)"));
 	for (i = map.constBegin(); i != map.constEnd(); ++i) {
-		query.addBindValue(i.key().hostname);
-		query.addBindValue(i.key().port);
-		query.addBindValue(i.value());
-		execQueryAndLogFailure(query);
+		statements << DatabaseStatement(
+			QLatin1String("REPLACE INTO `pingcache` (`hostname`, `port`, `ping`) VALUES (?,?,?)"),
+			QVariantList() << i.key().hostname << i.key().port << i.value());
 	}
 
-	QSqlDatabase::database().commit();
+	dwWriter->enqueue(QLatin1String("pingcache"), statements);
 }
 
 bool Database::seenComment(const QString &hash, const QByteArray &commenthash) {
-	QSqlQuery query(db);
+	if (!qsSeenComments.contains(qMakePair(hash, commenthash)))
+		return false;
 
-	query.prepare(QLatin1String("SELECT COUNT(*) FROM `comments` WHERE `who` = ? AND `comment` = ?"));
-	query.addBindValue(hash);
-	query.addBindValue(commenthash);
-	execQueryAndLogFailure(query);
-	if (query.next()) {
-		if (query.value(0).toInt() > 0) {
-			query.prepare(
-				QLatin1String("UPDATE `comments` SET `seen` = datetime('now') WHERE `who` = ? AND `comment` = ?"));
-			query.addBindValue(hash);
-			query.addBindValue(commenthash);
-			execQueryAndLogFailure(query);
-			return true;
-		}
-	}
-	return false;
+	// Refresh the time the comment has been seen, so it doesn't expire
+	setSeenComment(hash, commenthash);
+
+	return true;
 }
 
 void Database::setSeenComment(const QString &hash, const QByteArray &commenthash) {
-	QSqlQuery query(db);
+	qsSeenComments.insert(qMakePair(hash, commenthash));
 
-	query.prepare(QLatin1String("REPLACE INTO `comments` (`who`, `comment`, `seen`) VALUES (?, ?, datetime('now'))"));
-	query.addBindValue(hash);
-	query.addBindValue(commenthash);
-	execQueryAndLogFailure(query);
+	dwWriter->enqueue(
+		QString::fromLatin1("comments:%1:%2").arg(hash, QString::fromLatin1(commenthash.toHex())),
+		DatabaseStatement(
+			QLatin1String("REPLACE INTO `comments` (`who`, `comment`, `seen`) VALUES (?, ?, datetime('now'))"),
+			QVariantList() << hash << commenthash));
 }
 
 QByteArray Database::blob(const QByteArray &hash) {
+	const QString key = QLatin1String("blobs:") + QString::fromLatin1(hash.toHex());
+
+	// Only wait for the writer if the requested blob is among the pending writes
+	if (dwWriter->isPending(key))
+		dwWriter->flush();
+
 	QSqlQuery query(db);
 
 	query.prepare(QLatin1String("SELECT `data` FROM `blobs` WHERE `hash` = ?"));
@@ -501,9 +526,10 @@ QByteArray Database::blob(const QByteArray &hash) {
 	if (query.next()) {
 		QByteArray qba = query.value(0).toByteArray();
 
-		query.prepare(QLatin1String("UPDATE `blobs` SET `seen` = datetime('now') WHERE `hash` = ?"));
-		query.addBindValue(hash);
-		execQueryAndLogFailure(query);
+		dwWriter->enqueue(
+			QLatin1String("blobs_seen:") + QString::fromLatin1(hash.toHex()),
+			DatabaseStatement(QLatin1String("UPDATE `blobs` SET `seen` = datetime('now') WHERE `hash` = ?"),
+							  QVariantList() << hash));
 
 		return qba;
 	}
@@ -514,15 +540,15 @@ void Database::setBlob(const QByteArray &hash, const QByteArray &data) {
 	if (hash.isEmpty() || data.isEmpty())
 		return;
 
-	QSqlQuery query(db);
-
-	query.prepare(QLatin1String("REPLACE INTO `blobs` (`hash`, `data`, `seen`) VALUES (?, ?, datetime('now'))"));
-	query.addBindValue(hash);
-	query.addBindValue(data);
-	execQueryAndLogFailure(query);
+	dwWriter->enqueue(
+		QLatin1String("blobs:") + QString::fromLatin1(hash.toHex()),
+		DatabaseStatement(QLatin1String("REPLACE INTO `blobs` (`hash`, `data`, `seen`) VALUES (?, ?, datetime('now'))"),
+						  QVariantList() << hash << data));
 }
 
 QStringList Database::getTokens(const QByteArray &digest) {
+	dwWriter->flush();
+
 	QList< QString > qsl;
 	QSqlQuery query(db);
 
@@ -536,21 +562,21 @@ QStringList Database::getTokens(const QByteArray &digest) {
 }
 
 void Database::setTokens(const QByteArray &digest, QStringList &tokens) {
-	QSqlQuery query(db);
+	QList< DatabaseStatement > statements;
 
-	query.prepare(QLatin1String("DELETE FROM `tokens` WHERE `digest` = ?"));
-	query.addBindValue(digest);
-	execQueryAndLogFailure(query);
+	statements << DatabaseStatement(QLatin1String("DELETE FROM `tokens` WHERE `digest` = ?"), QVariantList() << digest);
 
-	query.prepare(QLatin1String("INSERT INTO `tokens` (`digest`, `token`) VALUES (?,?)"));
 	foreach (const QString &qs, tokens) {
-		query.addBindValue(digest);
-		query.addBindValue(qs);
-		execQueryAndLogFailure(query);
+		statements << DatabaseStatement(QLatin1String("INSERT INTO `tokens` (`digest`, `token`) VALUES (?,?)"),
+										QVariantList() << digest << qs);
 	}
+
+	dwWriter->enqueue(QLatin1String("tokens:") + QString::fromLatin1(digest.toHex()), statements);
 }
 
 QList< Shortcut > Database::getShortcuts(const QByteArray &digest) {
+	dwWriter->flush();
+
 	QList< Shortcut > ql;
 	QSqlQuery query(db);
 
@@ -583,87 +609,83 @@ QList< Shortcut > Database::getShortcuts(const QByteArray &digest) {
 }
 
 bool Database::setShortcuts(const QByteArray &digest, QList< Shortcut > &shortcuts) {
-	QSqlQuery query(db);
+	QList< DatabaseStatement > statements;
 	bool updated = false;
 
-	query.prepare(QLatin1String("DELETE FROM `shortcut` WHERE `digest` = ?"));
-	query.addBindValue(digest);
-	execQueryAndLogFailure(query);
+	statements << DatabaseStatement(QLatin1String("DELETE FROM `shortcut` WHERE `digest` = ?"),
+									QVariantList() << digest);
 
 	const QList< Shortcut > scs = shortcuts;
 
-	query.prepare(
-		QLatin1String("INSERT INTO `shortcut` (`digest`, `shortcut`, `target`, `suppress`) VALUES (?,?,?,?)"));
 	foreach (const Shortcut &sc, scs) {
 		if (sc.isServerSpecific()) {
 			shortcuts.removeAll(sc);
 			updated = true;
 
-			query.addBindValue(digest);
-
-			QByteArray a;
+			QByteArray buttons;
 			{
-				QDataStream s(&a, QIODevice::WriteOnly);
+				QDataStream s(&buttons, QIODevice::WriteOnly);
 				s.setVersion(QDataStream::Qt_4_0);
 				s << sc.qlButtons;
 			}
-			query.addBindValue(a);
 
-			a.clear();
+			QByteArray target;
 			{
-				QDataStream s(&a, QIODevice::WriteOnly);
+				QDataStream s(&target, QIODevice::WriteOnly);
 				s.setVersion(QDataStream::Qt_4_0);
 				s << sc.qvData;
 			}
-			query.addBindValue(a);
 
-			query.addBindValue(sc.bSuppress);
-			execQueryAndLogFailure(query);
+			statements << DatabaseStatement(
+				QLatin1String("INSERT INTO `shortcut` (`digest`, `shortcut`, `target`, `suppress`) VALUES (?,?,?,?)"),
+				QVariantList() << digest << buttons << target << sc.bSuppress);
 		}
 	}
+
+	dwWriter->enqueue(QLatin1String("shortcut:") + QString::fromLatin1(digest.toHex()), statements);
+
 	return updated;
 }
 
 const QMap< QString, QString > Database::getFriends() {
 	QMap< QString, QString > qm;
-	QSqlQuery query(db);
 
-	query.prepare(QLatin1String("SELECT `name`, `hash` FROM `friends`"));
-	execQueryAndLogFailure(query);
-	while (query.next())
-		qm.insert(query.value(0).toString(), query.value(1).toString());
+	for (auto it = qhFriends.constBegin(); it != qhFriends.constEnd(); ++it)
+		qm.insert(it.value(), it.key());
+
 	return qm;
 }
 
 const QString Database::getFriend(const QString &hash) {
-	QSqlQuery query(db);
-
-	query.prepare(QLatin1String("SELECT `name` FROM `friends` WHERE `hash` = ?"));
-	query.addBindValue(hash);
-	execQueryAndLogFailure(query);
-	if (query.next())
-		return query.value(0).toString();
-	return QString();
+	return qhFriends.value(hash);
 }
 
 void Database::addFriend(const QString &name, const QString &hash) {
-	QSqlQuery query(db);
+	// Both the name and the hash are unique, so REPLACE drops any other entry using either of them
+	for (auto it = qhFriends.begin(); it != qhFriends.end();) {
+		if (it.value() == name)
+			it = qhFriends.erase(it);
+		else
+			++it;
+	}
+	qhFriends.insert(hash, name);
 
-	query.prepare(QLatin1String("REPLACE INTO `friends` (`name`, `hash`) VALUES (?,?)"));
-	query.addBindValue(name);
-	query.addBindValue(hash);
-	execQueryAndLogFailure(query);
+	dwWriter->enqueue(QLatin1String("friends:") + hash,
+					  DatabaseStatement(QLatin1String("REPLACE INTO `friends` (`name`, `hash`) VALUES (?,?)"),
+										QVariantList() << name << hash));
 }
 
 void Database::removeFriend(const QString &hash) {
-	QSqlQuery query(db);
+	qhFriends.remove(hash);
 
-	query.prepare(QLatin1String("DELETE FROM `friends` WHERE `hash` = ?"));
-	query.addBindValue(hash);
-	execQueryAndLogFailure(query);
+	dwWriter->enqueue(
+		QLatin1String("friends:") + hash,
+		DatabaseStatement(QLatin1String("DELETE FROM `friends` WHERE `hash` = ?"), QVariantList() << hash));
 }
 
 const QString Database::getDigest(const QString &hostname, unsigned short port) {
+	dwWriter->flush();
+
 	QSqlQuery query(db);
 
 	query.prepare(QLatin1String("SELECT `digest` FROM `cert` WHERE `hostname` = ? AND `port` = ?"));
@@ -677,26 +699,22 @@ const QString Database::getDigest(const QString &hostname, unsigned short port)
 }
 
 void Database::setDigest(const QString &hostname, unsigned short port, const QString &digest) {
-	QSqlQuery query(db);
-	query.prepare(QLatin1String("REPLACE INTO `cert` (`hostname`,`port`,`digest`) VALUES (?,?,?)"));
-	query.addBindValue(hostname);
-	query.addBindValue(port);
-	query.addBindValue(digest);
-	execQueryAndLogFailure(query);
+	dwWriter->enqueue(
+		QString::fromLatin1("cert:%1:%2").arg(hostname).arg(port),
+		DatabaseStatement(QLatin1String("REPLACE INTO `cert` (`hostname`,`port`,`digest`) VALUES (?,?,?)"),
+						  QVariantList() << hostname << port << digest));
 }
 
 void Database::setPassword(const QString &hostname, unsigned short port, const QString &uname, const QString &pw) {
-	QSqlQuery query(db);
-	query.prepare(
-		QLatin1String("UPDATE `servers` SET `password` = ? WHERE `hostname` = ? AND `port` = ? AND `username` = ?"));
-	query.addBindValue(pw);
-	query.addBindValue(hostname);
-	query.addBindValue(port);
-	query.addBindValue(uname);
-	execQueryAndLogFailure(query);
+	dwWriter->enqueue(QString::fromLatin1("password:%1:%2:%3").arg(hostname).arg(port).arg(uname),
+					  DatabaseStatement(QLatin1String("UPDATE `servers` SET `password` = ? WHERE `hostname` = ? AND "
+													  "`port` = ? AND `username` = ?"),
+										QVariantList() << pw << hostname << port << uname));
 }
 
 bool Database::getUdp(const QByteArray &digest) {
+	dwWriter->flush();
+
 	QSqlQuery query(db);
 	query.prepare(QLatin1String("SELECT COUNT(*) FROM `udp` WHERE `digest` = ? "));
 	query.addBindValue(digest);
@@ -708,17 +726,20 @@ bool Database::getUdp(const QByteArray &digest) {
 }
 
 void Database::setUdp(const QByteArray &digest, bool udp) {
-	QSqlQuery query(db);
+	const QString key = QLatin1String("udp:") + QString::fromLatin1(digest.toHex());
+
 	if (!udp)
-		query.prepare(QLatin1String("REPLACE INTO `udp` (`digest`) VALUES (?)"));
+		dwWriter->enqueue(key, DatabaseStatement(QLatin1String("REPLACE INTO `udp` (`digest`) VALUES (?)"),
+												 QVariantList() << digest));
 	else
-		query.prepare(QLatin1String("DELETE FROM `udp` WHERE `digest` = ?"));
-	query.addBindValue(digest);
-	execQueryAndLogFailure(query);
+		dwWriter->enqueue(key, DatabaseStatement(QLatin1String("DELETE FROM `udp` WHERE `digest` = ?"),
+												 QVariantList() << digest));
 }
 
 
 QList< int > Database::getChannelListeners(const QByteArray &digest) {
+	dwWriter->flush();
+
 	QList< int > channelIDs;
 
 	QSqlQuery query(db);
@@ -735,23 +756,25 @@ QList< int > Database::getChannelListeners(const QByteArray &digest) {
 }
 
 void Database::setChannelListeners(const QByteArray &digest, const QSet< int > &channelIDs) {
-	QSqlQuery query(db);
+	QList< DatabaseStatement > statements;
 
 	// Delete old set of ChannelListeners for this server
-	query.prepare(QLatin1String("DELETE FROM `channel_listeners` WHERE `digest` = ?"));
-	query.addBindValue(digest);
-	execQueryAndLogFailure(query);
+	statements << DatabaseStatement(QLatin1String("DELETE FROM `channel_listeners` WHERE `digest` = ?"),
+									QVariantList() << digest);
 
-	query.prepare(QLatin1String("INSERT INTO `channel_listeners` (`digest`, `channel_id`) VALUES (?,?)"));
 	QSetIterator< int > it(channelIDs);
 	while (it.hasNext()) {
-		query.addBindValue(digest);
-		query.addBindValue(it.next());
-		execQueryAndLogFailure(query);
+		statements << DatabaseStatement(
+			QLatin1String("INSERT INTO `channel_listeners` (`digest`, `channel_id`) VALUES (?,?)"),
+			QVariantList() << digest << it.next());
 	}
+
+	dwWriter->enqueue(QLatin1String("channel_listeners:") + QString::fromLatin1(digest.toHex()), statements);
 }
 
 QHash< int, float > Database::getChannelListenerLocalVolumeAdjustments(const QByteArray &digest) {
+	dwWriter->flush();
+
 	QHash< int, float > volumeMap;
 
 	QSqlQuery query(db);
@@ -769,25 +792,26 @@ QHash< int, float > Database::getChannelListenerLocalVolumeAdjustments(const QBy
 
 void Database::setChannelListenerLocalVolumeAdjustments(const QByteArray &digest,
 														const QHash< int, float > &volumeMap) {
-	QSqlQuery query(db);
+	QList< DatabaseStatement > statements;
 
 	// Delete old set of volume adjustments for this server
-	query.prepare(QLatin1String("DELETE FROM `listener_volume` WHERE `digest` = ?"));
-	query.addBindValue(digest);
-	execQueryAndLogFailure(query);
+	statements << DatabaseStatement(QLatin1String("DELETE FROM `listener_volume` WHERE `digest` = ?"),
+									QVariantList() << digest);
 
-	query.prepare(QLatin1String("INSERT INTO `listener_volume` (`digest`, `channel_id`, `volume`) VALUES (?,?,?)"));
 	QHashIterator< int, float > it(volumeMap);
 	while (it.hasNext()) {
 		it.next();
-		query.addBindValue(digest);
-		query.addBindValue(it.key());
-		query.addBindValue(it.value());
-		execQueryAndLogFailure(query);
+		statements << DatabaseStatement(
+			QLatin1String("INSERT INTO `listener_volume` (`digest`, `channel_id`, `volume`) VALUES (?,?,?)"),
+			QVariantList() << digest << it.key() << it.value());
 	}
+
+	dwWriter->enqueue(QLatin1String("listener_volume:") + QString::fromLatin1(digest.toHex()), statements);
 }
 
 bool Database::fuzzyMatch(QString &name, QString &user, QString &pw, QString &hostname, unsigned short port) {
+	dwWriter->flush();
+
 	QSqlQuery query(db);
 	if (!user.isEmpty()) {
 		query.prepare(QLatin1String("SELECT `username`, `password`, `hostname`, `name` FROM `servers` WHERE `username` "
@@ -10,6 +10,12 @@
 #include "UnresolvedServerAddress.h"
 #include <QSqlDatabase>
 
+#include <QtCore/QHash>
+#include <QtCore/QPair>
+#include <QtCore/QSet>
+
+class DatabaseWriter;
+
 struct FavoriteServer {
 	QString qsName;
 	QString qsUsername;
@@ -25,10 +31,28 @@ private:
 	Q_DISABLE_COPY(Database)
 
 	QSqlDatabase db;
+	/// All writes are performed asynchronously by this writer. Reads that are not served from
+	/// the in-memory copies below have to flush it first in order to see their effects.
+	DatabaseWriter *dwWriter;
+
+	/// In-memory copies of the tables that are queried per user (or per channel) and thus
+	/// frequently. They are loaded on startup and kept in sync with every write.
+	QSet< QString > qsIgnored;
+	QSet< QString > qsIgnoredTTS;
+	QSet< QString > qsMuted;
+	QHash< QString, float > qhVolumes;
+	QHash< QString, QString > qhNicknames;
+	QSet< QPair< QByteArray, int > > qsFilteredChannels;
+	QSet< QPair< QString, QByteArray > > qsSeenComments;
+	/// Maps a user's hash to the name of the friend
+	QHash< QString, QString > qhFriends;
+
 	/// This function is called when no database location is configured
 	/// in the config file. It tries to find an existing database file and
 	/// creates a new one if none was found.
 	bool findOrCreateDatabase();
+	/// Fills the in-memory copies of the frequently queried tables
+	void loadTables();
 
 public:
 	Database(const QString &dbname);
@@ -0,0 +1,151 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "DatabaseWriter.h"
+
+#include <QtCore/QDebug>
+#include <QtSql/QSqlDatabase>
+#include <QtSql/QSqlError>
+#include <QtSql/QSqlQuery>
+
+#include <algorithm>
+
+DatabaseStatement::DatabaseStatement(const QString &query, const QVariantList &values)
+	: qsQuery(query), qvlValues(values) {
+}
+
+DatabaseWriter::DatabaseWriter(const QString &databaseName, const QString &connectionName, QObject *parent)
+	: QThread(parent), qsDatabaseName(databaseName), qsConnectionName(connectionName), uiQueued(0), uiCommitted(0),
+	  bFlush(false), bStop(false) {
+}
+
+DatabaseWriter::~DatabaseWriter() {
+	stop();
+}
+
+void DatabaseWriter::enqueue(const QString &key, const QList< DatabaseStatement > &statements) {
+	QMutexLocker l(&qmLock);
+
+	const bool wasEmpty = qhPending.isEmpty();
+
+	PendingWrite &write = qhPending[key];
+	write.uiSequence    = ++uiQueued;
+	write.qlStatements  = statements;
+
+	// Only wake the writer for the first write of a batch. Waking it for every write would cut
+	// short the interval during which further writes are coalesced.
+	if (wasEmpty)
+		qwcWake.wakeAll();
+}
+
+void DatabaseWriter::enqueue(const QString &key, const DatabaseStatement &statement) {
+	enqueue(key, QList< DatabaseStatement >() << statement);
+}
+
+bool DatabaseWriter::isPending(const QString &key) {
+	QMutexLocker l(&qmLock);
+
+	return qhPending.contains(key) || qhCommitting.contains(key);
+}
+
+void DatabaseWriter::flush() {
+	QMutexLocker l(&qmLock);
+
+	const quint64 target = uiQueued;
+	if (uiCommitted >= target)
+		return;
+
+	bFlush = true;
+	qwcWake.wakeAll();
+
+	while (uiCommitted < target && isRunning())
+		qwcCommitted.wait(&qmLock);
+}
+
+void DatabaseWriter::stop() {
+	{
+		QMutexLocker l(&qmLock);
+		bStop = true;
+		qwcWake.wakeAll();
+	}
+
+	wait();
+}
+
+void DatabaseWriter::commit(QSqlDatabase &db, const QHash< QString, PendingWrite > &writes) {
+	QList< PendingWrite > ordered = writes.values();
+	std::sort(ordered.begin(), ordered.end(),
+			  [](const PendingWrite &a, const PendingWrite &b) { return a.uiSequence < b.uiSequence; });
+
+	db.transaction();
+
+	QSqlQuery query(db);
+	foreach (const PendingWrite &write, ordered) {
+		foreach (const DatabaseStatement &statement, write.qlStatements) {
+			query.prepare(statement.qsQuery);
+			foreach (const QVariant &value, statement.qvlValues)
+				query.addBindValue(value);
+
+			if (!query.exec()) {
+				qWarning() << "SQL Query failed" << query.lastQuery();
+				qWarning() << query.lastError().nativeErrorCode() << query.lastError().text();
+			}
+		}
+	}
+
+	if (!db.commit())
+		qWarning() << "DatabaseWriter: Failed to commit:" << db.lastError().text();
+}
+
+void DatabaseWriter::run() {
+	{
+		QSqlDatabase db = QSqlDatabase::addDatabase(QLatin1String("QSQLITE"), qsConnectionName);
+		db.setDatabaseName(qsDatabaseName);
+
+		if (db.open()) {
+			QSqlQuery query(db);
+			query.exec(QLatin1String("PRAGMA synchronous = NORMAL"));
+		} else {
+			qWarning() << "DatabaseWriter: Failed to open database:" << db.lastError().text();
+		}
+
+		forever {
+			quint64 sequence;
+			{
+				QMutexLocker l(&qmLock);
+
+				while (qhPending.isEmpty() && !bStop)
+					qwcWake.wait(&qmLock);
+
+				// Give further writes the chance to be coalesced with the ones already pending
+				if (!bStop && !bFlush)
+					qwcWake.wait(&qmLock, COMMIT_INTERVAL);
+
+				if (qhPending.isEmpty() && bStop)
+					break;
+
+				qhCommitting.swap(qhPending);
+				sequence = uiQueued;
+				bFlush   = false;
+			}
+
+			// qhCommitting is only ever modified by this thread, so it can safely be read without holding the lock
+			if (db.isOpen())
+				commit(db, qhCommitting);
+
+			QMutexLocker l(&qmLock);
+			qhCommitting.clear();
+			uiCommitted = sequence;
+			qwcCommitted.wakeAll();
+		}
+
+		db.close();
+	}
+
+	QSqlDatabase::removeDatabase(qsConnectionName);
+
+	QMutexLocker l(&qmLock);
+	qwcCommitted.wakeAll();
+}
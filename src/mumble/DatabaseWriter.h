@@ -0,0 +1,93 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MUMBLE_DATABASEWRITER_H_
+#define MUMBLE_MUMBLE_DATABASEWRITER_H_
+
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+#include <QtCore/QThread>
+#include <QtCore/QVariant>
+#include <QtCore/QWaitCondition>
+
+class QSqlDatabase;
+
+/// A single SQL statement along with the values to bind to its placeholders (in order)
+struct DatabaseStatement {
+	QString qsQuery;
+	QVariantList qvlValues;
+
+	DatabaseStatement() = default;
+	DatabaseStatement(const QString &query, const QVariantList &values = QVariantList());
+};
+
+/// Performs the writes to the client database on a dedicated thread using its own connection.
+///
+/// Every write is queued under a key describing what it modifies (e.g. the local volume of a given user). Queuing
+/// a write for a key that already has one pending replaces the pending one, so only the last value actually hits
+/// the disk. Pending writes are committed in a single transaction once they have been given COMMIT_INTERVAL
+/// milliseconds to accumulate, or right away if someone is waiting for them in flush().
+class DatabaseWriter : public QThread {
+private:
+	Q_OBJECT
+	Q_DISABLE_COPY(DatabaseWriter)
+
+protected:
+	struct PendingWrite {
+		/// Determines the order in which the writes are committed
+		quint64 uiSequence;
+		QList< DatabaseStatement > qlStatements;
+	};
+
+	/// The file name of the SQLite database
+	QString qsDatabaseName;
+	/// The name of the connection used by the writer thread
+	QString qsConnectionName;
+
+	QMutex qmLock;
+	/// Wakes the writer thread
+	QWaitCondition qwcWake;
+	/// Wakes everyone waiting in flush()
+	QWaitCondition qwcCommitted;
+
+	/// The writes that have not been picked up by the writer thread yet
+	QHash< QString, PendingWrite > qhPending;
+	/// The writes the writer thread is currently committing
+	QHash< QString, PendingWrite > qhCommitting;
+	/// The sequence number of the most recently queued write
+	quint64 uiQueued;
+	/// The sequence number up to which all writes have been committed
+	quint64 uiCommitted;
+	bool bFlush;
+	bool bStop;
+
+	void commit(QSqlDatabase &db, const QHash< QString, PendingWrite > &writes);
+
+public:
+	/// The time in milliseconds writes are held back in order to coalesce them with further writes
+	static const int COMMIT_INTERVAL = 1000;
+
+	DatabaseWriter(const QString &databaseName, const QString &connectionName, QObject *parent = nullptr);
+	~DatabaseWriter() Q_DECL_OVERRIDE;
+
+	/// Queues the given statements to be executed (in order) under the given key, replacing whatever is still
+	/// pending for that key.
+	void enqueue(const QString &key, const QList< DatabaseStatement > &statements);
+	void enqueue(const QString &key, const DatabaseStatement &statement);
+
+	/// @returns Whether a write for the given key has been queued but not committed yet
+	bool isPending(const QString &key);
+
+	/// Blocks until all writes queued so far have been committed to the database
+	void flush();
+	/// Commits all pending writes and terminates the writer thread
+	void stop();
+
+	void run() Q_DECL_OVERRIDE;
+};
+
+#endif
@@ -6,8 +6,13 @@
 #include "DeveloperConsole.h"
 
 #include "LogEmitter.h"
+#include "MainWindow.h"
+#include "UserModel.h"
 #include "Global.h"
 
+#include <QtCore/QTimer>
+#include <QtWidgets/QLabel>
+#include <QtWidgets/QStatusBar>
 #include <QtWidgets/QTextBrowser>
 
 DeveloperConsole::DeveloperConsole(QObject *parent) : QObject(parent) {
@@ -28,6 +33,15 @@ void DeveloperConsole::show() {
 		mw->setCentralWidget(tb);
 		mw->setWindowTitle(tr("Developer Console"));
 
+		QLabel *statistics = new QLabel();
+		mw->statusBar()->addWidget(statistics);
+		m_statistics = QPointer< QLabel >(statistics);
+
+		QTimer *timer = new QTimer(mw);
+		connect(timer, &QTimer::timeout, this, &DeveloperConsole::updateStatistics);
+		timer->start(1000);
+		updateStatistics();
+
 		connect(Global::get().le.data(), SIGNAL(newLogEntry(const QString &)), tb, SLOT(append(const QString &)));
 
 		foreach (const QString &m, m_logEntries)
@@ -45,3 +59,17 @@ void DeveloperConsole::addLogMessage(const QString &msg) {
 
 	m_logEntries.append(msg);
 }
+
+void DeveloperConsole::updateStatistics() {
+	if (m_statistics.isNull() || !Global::get().mw || !Global::get().mw->pmModel)
+		return;
+
+	const UserModel::RepaintStatistics &stats = Global::get().mw->pmModel->repaintStatistics();
+	const QString text = QString::fromLatin1("User list updates: %1 requested, %2 dropped, %3 merged, %4 emitted")
+							 .arg(stats.requested)
+							 .arg(stats.dropped)
+							 .arg(stats.merged)
+							 .arg(stats.emitted);
+
+	m_statistics.data()->setText(text);
+}
@@ -11,6 +11,8 @@
 #include <QtCore/QStringList>
 #include <QtWidgets/QMainWindow>
 
+class QLabel;
+
 class DeveloperConsole : public QObject {
 private:
 	Q_OBJECT
@@ -19,8 +21,11 @@ private:
 protected:
 	QPointer< QMainWindow > m_window;
 	QStringList m_logEntries;
+	QPointer< QLabel > m_statistics;
 public slots:
 	void addLogMessage(const QString &);
+	/// Refreshes the performance counters shown in the console's status bar
+	void updateStatistics();
 
 public:
 	DeveloperConsole(QObject *parent = nullptr);
@@ -23,6 +23,7 @@ class MainWindow;
 class ServerHandler;
 class AudioInput;
 class AudioOutput;
+class BlobCache;
 class Database;
 class Log;
 class PluginManager;
@@ -55,6 +56,10 @@ public:
 	 * @remark Must only be accessed from the main event loop
 	 */
 	Database *db;
+	/**
+	 * @remark Must only be accessed from the main event loop
+	 */
+	BlobCache *bc;
 	Log *l;
 	/// A pointer to the PluginManager that is used in this session
 	PluginManager *pluginManager;
@@ -311,7 +311,7 @@ void LCD::updateUserView() {
 
 		QMap< unsigned int, Timer > speaking;
 
-		foreach (Channel *c, home->allLinks()) {
+		foreach (Channel *c, home->linkedChannels()) {
 			foreach (User *p, c->qlUsers) {
 				ClientUser *u = static_cast< ClientUser * >(p);
 				bool bTalk    = (u->tsState != Settings::Passive);
@@ -5,6 +5,7 @@
 
 #include "LegacyPlugin.h"
 #include "MumblePlugin_v_1_0_x.h"
+#include "ProcessResolver.h"
 
 #include <codecvt>
 #include <cstdlib>
@@ -185,12 +186,10 @@ bool LegacyPlugin::showConfigDialog(QWidget *parent) const {
 
 uint8_t LegacyPlugin::initPositionalData(const char *const *programNames, const uint64_t *programPIDs,
 										 size_t programCount) {
-	int retCode;
+	// Create and populate a multimap holding the names and PIDs to pass to the tryLock-function
+	std::multimap< std::wstring, unsigned long long int > pidMap;
 
 	if (m_mumPlug2) {
-		// Create and populate a multimap holding the names and PIDs to pass to the tryLock-function
-		std::multimap< std::wstring, unsigned long long int > pidMap;
-
 		for (size_t i = 0; i < programCount; i++) {
 			std::string currentName = programNames[i];
 			std::wstring currentNameWstr =
@@ -198,7 +197,21 @@ uint8_t LegacyPlugin::initPositionalData(const char *const *programNames, const
 
 			pidMap.insert(std::pair< std::wstring, unsigned long long int >(currentNameWstr, programPIDs[i]));
 		}
+	}
+
+	return lockPositionalData(pidMap);
+}
 
+uint8_t LegacyPlugin::initPositionalData(const ProcessResolver &processes) {
+	// The resolver keeps an index in the format the legacy plugins expect, so there is no need to build one
+	// for every plugin
+	return lockPositionalData(processes.getNameIndex());
+}
+
+uint8_t LegacyPlugin::lockPositionalData(const std::multimap< std::wstring, unsigned long long int > &pidMap) {
+	int retCode;
+
+	if (m_mumPlug2) {
 		retCode = m_mumPlug2->trylock(pidMap);
 	} else {
 		// The default MumblePlugin doesn't take the name and PID arguments
@@ -10,6 +10,7 @@
 
 #include <QtCore/QString>
 
+#include <map>
 #include <memory>
 #include <string>
 
@@ -58,6 +59,9 @@ protected:
 	virtual bool showConfigDialog(QWidget *parent) const override;
 	virtual uint8_t initPositionalData(const char *const *programNames, const uint64_t *programPIDs,
 									   size_t programCount) override;
+	virtual uint8_t initPositionalData(const ProcessResolver &processes) override;
+	/// Asks the plugin to lock onto one of the given processes
+	uint8_t lockPositionalData(const std::multimap< std::wstring, unsigned long long int > &pidMap);
 	virtual bool fetchPositionalData(Position3D &avatarPos, Vector3D &avatarDir, Vector3D &avatarAxis,
 									 Position3D &cameraPos, Vector3D &cameraDir, Vector3D &cameraAxis, QString &context,
 									 QString &identity) const override;
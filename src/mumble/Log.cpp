@@ -17,10 +17,13 @@
 #	include "TextToSpeech.h"
 #endif
 #include "Utils.h"
+#include "crypto/CryptographicRandom.h"
 #include "Global.h"
 
 #include <QSignalBlocker>
+#include <QtCore/QCryptographicHash>
 #include <QtCore/QMutexLocker>
+#include <QtCore/QRegularExpression>
 #include <QtGui/QImageWriter>
 #include <QtGui/QScreen>
 #include <QtGui/QTextBlock>
@@ -290,7 +293,7 @@ void LogConfig::accept() const {
 #ifndef USE_NO_TTS
 	Global::get().l->tts->setVolume(s.iTTSVolume);
 #endif
-	Global::get().mw->qteLog->document()->setMaximumBlockCount(s.iMaxLogBlocks);
+	Global::get().mw->qteLog->setMaximumEntries(s.iMaxLogBlocks);
 }
 
 void LogConfig::on_qtwMessages_itemChanged(QTreeWidgetItem *i, int column) {
@@ -354,6 +357,8 @@ void LogConfig::browseForAudioFile() {
 
 QMutex Log::qmDeferredLogs;
 QVector< LogMessage > Log::qvDeferredLogs;
+QCache< QByteArray, QByteArray > Log::qcImages(Log::IMAGE_BUDGET);
+QCache< QByteArray, QImage > Log::qcDecodedImages(Log::DECODED_IMAGE_BUDGET);
 
 
 Log::Log(QObject *p) : QObject(p) {
@@ -578,6 +583,69 @@ QString Log::imageToImg(QImage img, int maxSize) {
 	return QString();
 }
 
+QString Log::storeImages(const QString &html) {
+	static const QRegularExpression dataImage(
+		QLatin1String("src\\s*=\\s*[\"']data:image/[^;,\"']*;base64,([^\"']*)[\"']"),
+		QRegularExpression::CaseInsensitiveOption);
+	static const QRegularExpression logImage(QLatin1String("src\\s*=\\s*[\"']\\s*logimage:[^\"']*[\"']"),
+											 QRegularExpression::CaseInsensitiveOption);
+
+	// Only references created below may point into the image cache. Others would allow the message to show
+	// images that were sent with other messages.
+	QString source = html;
+	source.replace(logImage, QLatin1String("src=\"\""));
+
+	// Every message gets its own random prefix for the keys of its images, so that they can't be guessed
+	QByteArray prefix(IMAGE_KEY_PREFIX_SIZE, Qt::Uninitialized);
+	CryptographicRandom::fillBuffer(prefix.data(), prefix.size());
+
+	QString result;
+	int last = 0;
+
+	QRegularExpressionMatchIterator it = dataImage.globalMatch(source);
+	while (it.hasNext()) {
+		const QRegularExpressionMatch match = it.next();
+
+		// Images are usually percent-encoded and wrapped (see imageToImg()). Characters that aren't part of
+		// the Base64 alphabet are skipped when decoding.
+		const QByteArray data =
+			QByteArray::fromBase64(QByteArray::fromPercentEncoding(match.captured(1).toLatin1()));
+
+		QByteArray fmt;
+		if (!RichTextImage::isValidImage(data, fmt))
+			continue;
+
+		const QByteArray key = prefix + QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+		// Every entry costs at least 1 KiB to account for the bookkeeping overhead
+		qcImages.insert(key, new QByteArray(data), data.size() / 1024 + 1);
+
+		result.append(source.midRef(last, match.capturedStart() - last));
+		result.append(QString::fromLatin1("src=\"logimage:%1\"").arg(QLatin1String(key.toHex())));
+		last = match.capturedEnd();
+	}
+
+	if (last == 0)
+		return source;
+
+	result.append(source.midRef(last));
+	return result;
+}
+
+QImage Log::storedImage(const QByteArray &key) {
+	if (const QImage *cached = qcDecodedImages.object(key))
+		return *cached;
+
+	const QByteArray *data = qcImages.object(key);
+	if (!data)
+		return QImage();
+
+	QImage img;
+	if (img.loadFromData(*data))
+		qcDecodedImages.insert(key, new QImage(img), img.bytesPerLine() * img.height() / 1024 + 1);
+
+	return img;
+}
+
 QString Log::validHtml(const QString &html, QTextCursor *tc) {
 	LogDocument qtd;
 
@@ -666,66 +734,38 @@ void Log::log(MsgType mt, const QString &console, const QString &terse, bool own
 
 	// Message output on console
 	if ((flags & Settings::LogConsole)) {
-		QTextCursor tc = Global::get().mw->qteLog->textCursor();
-
-		// We copy the value from the settings in order to make sure that
-		// we use the same margin everywhere while in this method (even if
-		// the setting might change in that time).
-		const int msgMargin = Global::get().s.iChatMessageMargins;
-
-		QTextBlockFormat format = tc.blockFormat();
-		format.setTopMargin(msgMargin);
-		format.setBottomMargin(msgMargin);
-		tc.setBlockFormat(format);
-
-		LogTextBrowser *tlog     = Global::get().mw->qteLog;
-		const int oldscrollvalue = tlog->getLogScroll();
-		const bool scroll        = (oldscrollvalue == tlog->getLogScrollMaximum());
-
-		tc.movePosition(QTextCursor::End);
+		LogTextBrowser *tlog = Global::get().mw->qteLog;
 
 		if (qdDate != dt.date()) {
 			qdDate = dt.date();
-			tc.insertBlock();
-			tc.insertHtml(
-				tr("[Date changed to %1]\n").arg(qdDate.toString(Qt::DefaultLocaleShortDate).toHtmlEscaped()));
-			tc.movePosition(QTextCursor::End);
+			tlog->appendEntry(
+				LogEntry(QString(),
+						 tr("[Date changed to %1]\n").arg(qdDate.toString(Qt::DefaultLocaleShortDate).toHtmlEscaped()),
+						 false),
+				false);
 		}
 
 		// Convert CRLF to unix-style LF and old mac-style LF (single \r) to unix-style as well
 		QString fixedNLPlain =
 			plain.replace(QLatin1String("\r\n"), QLatin1String("\n")).replace(QLatin1String("\r"), QLatin1String("\n"));
 
-		if (fixedNLPlain.contains(QRegExp(QLatin1String("\\n[ \\t]*$")))) {
-			// If the message ends with one or more blank lines (or lines only containing whitespace)
-			// paint a border around the message to make clear that it contains invisible parts.
-			// The beginning of the message is clear anyway (the date and potentially the "To XY" part)
-			// so we don't have to care about that.
-			QTextFrameFormat qttf;
-			qttf.setBorder(1);
-			qttf.setPadding(2);
-			qttf.setMargin(msgMargin);
-			qttf.setBorderStyle(QTextFrameFormat::BorderStyle_Dashed);
-			tc.insertFrame(qttf);
-		} else if (!tc.block().text().isEmpty()) {
-			// Only insert a block if the current block is not empty. It may be empty because
-			// it is the default block of an empty document. Another cause might be that apparently
-			// a new empty block is automatically inserted after a frame.
-			tc.insertBlock();
-		}
+		// If the message ends with one or more blank lines (or lines only containing whitespace)
+		// it is shown in a frame. The beginning of the message is clear anyway (the date and
+		// potentially the "To XY" part) so we don't have to care about that.
+		const bool framed = fixedNLPlain.contains(QRegExp(QLatin1String("\\n[ \\t]*$")));
 
 		const QString timeString =
 			dt.time().toString(QLatin1String(Global::get().s.bLog24HourClock ? "HH:mm:ss" : "hh:mm:ss AP"));
-		tc.insertHtml(Log::msgColor(QString::fromLatin1("[%1] ").arg(timeString.toHtmlEscaped()), Log::Time));
 
-		validHtml(console, &tc);
-		tc.movePosition(QTextCursor::End);
-		Global::get().mw->qteLog->setTextCursor(tc);
+		// The message is validated only once, here. The log keeps the validated HTML and lays it out
+		// again whenever the message is scrolled back into view.
+		QTextDocument validated;
+		QTextCursor tc(&validated);
+		validHtml(storeImages(console), &tc);
 
-		if (scroll || ownMessage)
-			tlog->scrollLogToBottom();
-		else
-			tlog->setLogScroll(oldscrollvalue);
+		const QString timeHtml =
+			Log::msgColor(QString::fromLatin1("[%1] ").arg(timeString.toHtmlEscaped()), Log::Time);
+		tlog->appendEntry(LogEntry(timeHtml, QTextDocumentFragment(&validated).toHtml(), framed), ownMessage);
 	}
 
 	if (!ownMessage) {
@@ -865,6 +905,14 @@ QVariant LogDocument::loadResource(int type, const QUrl &url) {
 	}
 
 	QImage qi(1, 1, QImage::Format_Mono);
+
+	if (url.scheme() == QLatin1String("logimage")) {
+		// Images of log messages are taken from Log's image cache whenever they are needed instead of
+		// being added as a resource, so that they don't stay in memory for as long as the document does.
+		const QImage img = Log::storedImage(QByteArray::fromHex(url.path().toLatin1()));
+		return img.isNull() ? qi : img;
+	}
+
 	addResource(type, url, qi);
 
 	if (!url.isValid()) {
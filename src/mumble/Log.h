@@ -6,9 +6,11 @@
 #ifndef MUMBLE_MUMBLE_LOG_H_
 #define MUMBLE_MUMBLE_LOG_H_
 
+#include <QtCore/QCache>
 #include <QtCore/QDate>
 #include <QtCore/QMutex>
 #include <QtCore/QVector>
+#include <QtGui/QImage>
 #include <QtGui/QTextCursor>
 #include <QtGui/QTextDocument>
 
@@ -117,6 +119,13 @@ protected:
 	/// A vector containing deferred log messages
 	static QVector< LogMessage > qvDeferredLogs;
 
+	/// Images of log messages (see storeImages()), keyed by the random prefix of their message followed by their
+	/// SHA1 hash. They are only kept in memory and never written to the database; once IMAGE_BUDGET is exceeded,
+	/// the least recently used ones are dropped and shown as a placeholder from then on.
+	static QCache< QByteArray, QByteArray > qcImages;
+	/// Decoded versions of the images in qcImages, so that they don't have to be decoded on every repaint
+	static QCache< QByteArray, QImage > qcDecodedImages;
+
 	QHash< MsgType, int > qmIgnore;
 	static const char *msgNames[];
 	static const char *colorClasses[];
@@ -130,11 +139,27 @@ protected:
 	void postQtNotification(MsgType mt, const QString &plain);
 
 public:
+	/// The memory budget for the encoded images of log messages, in KiB
+	static const int IMAGE_BUDGET = 32 * 1024;
+	/// The memory budget for decoded images of log messages, in KiB
+	static const int DECODED_IMAGE_BUDGET = 16 * 1024;
+	/// The size of the random prefix of the keys in qcImages, in bytes
+	static const int IMAGE_KEY_PREFIX_SIZE = 16;
+
 	Log(QObject *p = nullptr);
 	QString msgName(MsgType t) const;
 	void setIgnore(MsgType t, int ignore = 1 << 30);
 	void clearIgnore();
 	static QString validHtml(const QString &html, QTextCursor *tc = nullptr);
+	/// Moves the data URL images of the given HTML into the in-memory image cache (see qcImages).
+	///
+	/// logimage: references that are already contained in the given HTML are removed.
+	///
+	/// @returns The HTML with every valid data URL image replaced by a logimage: reference
+	static QString storeImages(const QString &html);
+	/// @returns The image with the given key that has been stored by storeImages(), or a null image if it has
+	/// 	been dropped in the meantime
+	static QImage storedImage(const QByteArray &key);
 	static QString imageToImg(const QByteArray &format, const QByteArray &image);
 	static QString imageToImg(QImage img, int maxSize = 0);
 	static QString msgColor(const QString &text, LogColorType t);
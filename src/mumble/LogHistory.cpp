@@ -0,0 +1,97 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "LogHistory.h"
+
+LogEntry::LogEntry() : bCompressed(false), bFramed(false) {
+}
+
+LogEntry::LogEntry(const QString &prefix, const QString &html, bool framed)
+	: qsPrefix(prefix), bCompressed(false), bFramed(framed) {
+	const QByteArray utf8 = html.toUtf8();
+
+	if (utf8.size() >= COMPRESSION_THRESHOLD) {
+		qbaHtml     = qCompress(utf8);
+		bCompressed = true;
+	} else {
+		qbaHtml = utf8;
+	}
+}
+
+QString LogEntry::html() const {
+	return QString::fromUtf8(bCompressed ? qUncompress(qbaHtml) : qbaHtml);
+}
+
+int LogEntry::size() const {
+	return static_cast< int >(sizeof(LogEntry)) + qsPrefix.size() * static_cast< int >(sizeof(QChar))
+		   + qbaHtml.size();
+}
+
+LogHistory::LogHistory() : iHead(0), iCount(0), uiFirst(0), iBytes(0), iMaxEntries(0) {
+}
+
+void LogHistory::append(const LogEntry &entry) {
+	if (iCount == qvEntries.size()) {
+		// Grow the ring buffer, moving the entries so that the oldest one is at the start again
+		const int capacity = qMax(64, qvEntries.size() * 2);
+
+		QVector< LogEntry > entries;
+		entries.reserve(capacity);
+		for (int i = 0; i < iCount; ++i)
+			entries.append(qvEntries.at((iHead + i) % qvEntries.size()));
+		entries.resize(capacity);
+
+		qvEntries.swap(entries);
+		iHead = 0;
+	}
+
+	qvEntries[(iHead + iCount) % qvEntries.size()] = entry;
+	iCount++;
+	iBytes += entry.size();
+
+	while (iCount > 1 && (iBytes > MEMORY_BUDGET || (iMaxEntries > 0 && iCount > iMaxEntries)))
+		removeFirst();
+}
+
+void LogHistory::removeFirst() {
+	LogEntry &entry = qvEntries[iHead];
+
+	iBytes -= entry.size();
+	entry = LogEntry();
+
+	iHead = (iHead + 1) % qvEntries.size();
+	iCount--;
+	uiFirst++;
+}
+
+void LogHistory::clear() {
+	uiFirst += iCount;
+
+	qvEntries.clear();
+	iHead  = 0;
+	iCount = 0;
+	iBytes = 0;
+}
+
+void LogHistory::setMaximumEntries(int maxEntries) {
+	iMaxEntries = maxEntries;
+
+	while (iMaxEntries > 0 && iCount > iMaxEntries)
+		removeFirst();
+}
+
+quint64 LogHistory::first() const {
+	return uiFirst;
+}
+
+quint64 LogHistory::end() const {
+	return uiFirst + iCount;
+}
+
+const LogEntry &LogHistory::at(quint64 index) const {
+	Q_ASSERT(index >= uiFirst && index < end());
+
+	return qvEntries.at(static_cast< int >((iHead + (index - uiFirst)) % qvEntries.size()));
+}
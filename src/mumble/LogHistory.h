@@ -0,0 +1,79 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MUMBLE_LOGHISTORY_H_
+#define MUMBLE_MUMBLE_LOGHISTORY_H_
+
+#include <QtCore/QByteArray>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+/// A single message of the chat log.
+class LogEntry {
+public:
+	/// HTML that is shown in front of the message (e.g. its timestamp)
+	QString qsPrefix;
+	/// The message's HTML. It has already been validated and is stored compressed if that pays off.
+	QByteArray qbaHtml;
+	bool bCompressed;
+	/// Whether the message ends in blank lines and is thus shown within a frame
+	bool bFramed;
+
+	/// Entries whose HTML is shorter than this are not compressed
+	static const int COMPRESSION_THRESHOLD = 256;
+
+	LogEntry();
+	LogEntry(const QString &prefix, const QString &html, bool framed);
+
+	QString html() const;
+	/// @returns The amount of memory used by this entry, in bytes
+	int size() const;
+};
+
+/// The history of the chat log.
+///
+/// The history is a ring buffer of LogEntry objects. Entries are addressed by an index that keeps on counting
+/// up over the lifetime of the history, so that an index stays valid (or becomes invalid, if the entry has been
+/// dropped) no matter how many entries are added afterwards. Once the history exceeds its memory budget or
+/// the maximum amount of entries, the oldest entries are dropped.
+class LogHistory {
+private:
+	Q_DISABLE_COPY(LogHistory)
+
+protected:
+	QVector< LogEntry > qvEntries;
+	/// The position of the oldest entry in qvEntries
+	int iHead;
+	int iCount;
+	/// The index of the oldest entry
+	quint64 uiFirst;
+	/// The amount of memory used by all entries, in bytes
+	qint64 iBytes;
+	int iMaxEntries;
+
+	void removeFirst();
+
+public:
+	/// The amount of memory the history may use, in bytes
+	static const qint64 MEMORY_BUDGET = 128 * 1024 * 1024;
+
+	LogHistory();
+
+	void append(const LogEntry &entry);
+	void clear();
+
+	/// @param maxEntries The maximum amount of entries kept in the history. If 0, the amount is only limited
+	/// 	by the memory budget.
+	void setMaximumEntries(int maxEntries);
+
+	/// @returns The index of the oldest entry in the history
+	quint64 first() const;
+	/// @returns The index following the one of the newest entry in the history
+	quint64 end() const;
+	/// @param index The index of the entry. Has to be within [first(), end()).
+	const LogEntry &at(quint64 index) const;
+};
+
+#endif
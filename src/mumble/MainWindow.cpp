@@ -12,6 +12,7 @@
 #include "AudioStats.h"
 #include "AudioWizard.h"
 #include "BanEditor.h"
+#include "BlobCache.h"
 #include "CELTCodec.h"
 #ifdef USE_OPUS
 #	include "OpusCodec.h"
@@ -322,7 +323,7 @@ void MainWindow::setupGui() {
 	LogDocument *ld = new LogDocument(qteLog);
 	qteLog->setDocument(ld);
 
-	qteLog->document()->setMaximumBlockCount(Global::get().s.iMaxLogBlocks);
+	qteLog->setMaximumEntries(Global::get().s.iMaxLogBlocks);
 	qteLog->document()->setDefaultStyleSheet(qApp->styleSheet());
 
 	pmModel = new UserModel(qtvUsers);
@@ -875,7 +876,7 @@ void MainWindow::on_qteLog_customContextMenuRequested(const QPoint &mpos) {
 	}
 
 	menu->addSeparator();
-	menu->addAction(tr("Clear"), qteLog, SLOT(clear(void)));
+	menu->addAction(tr("Clear"), qteLog, SLOT(clearLog(void)));
 	menu->exec(qteLog->mapToGlobal(mpos));
 	delete menu;
 }
@@ -1381,22 +1382,20 @@ void MainWindow::on_qaSelfComment_triggered() {
 	if (!p)
 		return;
 
-	if (!p->qbaCommentHash.isEmpty() && p->qsComment.isEmpty()) {
-		p->qsComment = QString::fromUtf8(Global::get().db->blob(p->qbaCommentHash));
-		if (p->qsComment.isEmpty()) {
-			pmModel->uiSessionComment = ~(p->uiSession);
-			MumbleProto::RequestBlob mprb;
-			mprb.add_session_comment(p->uiSession);
-			Global::get().sh->sendMessage(mprb);
-			return;
-		}
+	const QString comment = QString::fromUtf8(Global::get().bc->blob(p->qbaCommentHash));
+	if (!p->qbaCommentHash.isEmpty() && comment.isEmpty()) {
+		pmModel->uiSessionComment = ~(p->uiSession);
+		MumbleProto::RequestBlob mprb;
+		mprb.add_session_comment(p->uiSession);
+		Global::get().sh->sendMessage(mprb);
+		return;
 	}
 
 	unsigned int session = p->uiSession;
 
 	::TextMessage *texm = new ::TextMessage(this, tr("Change your comment"));
 
-	texm->rteMessage->setText(p->qsComment);
+	texm->rteMessage->setText(comment);
 	int res = texm->exec();
 
 	p = ClientUser::get(session);
@@ -1409,7 +1408,7 @@ void MainWindow::on_qaSelfComment_triggered() {
 		Global::get().sh->sendMessage(mpus);
 
 		if (!msg.isEmpty())
-			Global::get().db->setBlob(sha1(msg), msg.toUtf8());
+			Global::get().bc->setBlob(sha1(msg), msg.toUtf8());
 	}
 	delete texm;
 }
@@ -1984,22 +1983,20 @@ void MainWindow::on_qaUserCommentView_triggered() {
 	if (!p)
 		return;
 
-	if (!p->qbaCommentHash.isEmpty() && p->qsComment.isEmpty()) {
-		p->qsComment = QString::fromUtf8(Global::get().db->blob(p->qbaCommentHash));
-		if (p->qsComment.isEmpty()) {
-			pmModel->uiSessionComment = ~(p->uiSession);
-			MumbleProto::RequestBlob mprb;
-			mprb.add_session_comment(p->uiSession);
-			Global::get().sh->sendMessage(mprb);
-			return;
-		}
+	const QString comment = QString::fromUtf8(Global::get().bc->blob(p->qbaCommentHash));
+	if (!p->qbaCommentHash.isEmpty() && comment.isEmpty()) {
+		pmModel->uiSessionComment = ~(p->uiSession);
+		MumbleProto::RequestBlob mprb;
+		mprb.add_session_comment(p->uiSession);
+		Global::get().sh->sendMessage(mprb);
+		return;
 	}
 
 	pmModel->seenComment(pmModel->index(p));
 
 	::TextMessage *texm = new ::TextMessage(this, tr("View comment on user %1").arg(p->qsName));
 
-	texm->rteMessage->setText(p->qsComment, true);
+	texm->rteMessage->setText(comment, true);
 	texm->setAttribute(Qt::WA_DeleteOnClose, true);
 	texm->show();
 }
@@ -2222,7 +2219,7 @@ void MainWindow::qmChannel_aboutToShow() {
 			c = Channel::get(Channel::ROOT_ID);
 		unlinkall = (home->qhLinks.count() > 0);
 		if (home != c) {
-			if (c->allLinks().contains(home))
+			if (c->isTransitivelyLinked(home))
 				unlink = true;
 			else
 				link = true;
@@ -2329,7 +2326,7 @@ void MainWindow::on_qaChannelACL_triggered() {
 	int id = c->iId;
 
 	if (!c->qbaDescHash.isEmpty() && c->qsDesc.isEmpty()) {
-		c->qsDesc = QString::fromUtf8(Global::get().db->blob(c->qbaDescHash));
+		c->qsDesc = QString::fromUtf8(Global::get().bc->blob(c->qbaDescHash));
 		if (c->qsDesc.isEmpty()) {
 			MumbleProto::RequestBlob mprb;
 			mprb.add_channel_description(id);
@@ -3181,6 +3178,10 @@ void MainWindow::serverConnected() {
 #endif
 	Global::get().iCodecBeta = 0;
 
+	// The server is about to send its complete state. Build the tree silently and publish it
+	// in one go once ServerSync has been received.
+	pmModel->beginBulkSync();
+
 #ifdef Q_OS_MAC
 	// Suppress AppNap while we're connected to a server.
 	MUSuppressAppNap(true);
@@ -3307,6 +3308,8 @@ void MainWindow::serverDisconnected(QAbstractSocket::SocketError err, QString re
 	qlUserActions.clear();
 
 	pmModel->removeAll();
+	// In case the connection has been lost before the server finished synchronizing
+	pmModel->endBulkSync();
 	qtvUsers->setRowHidden(0, QModelIndex(), true);
 
 	// Update QActions and menues
@@ -13,6 +13,7 @@
 #include "AudioStats.h"
 #include "AudioWizard.h"
 #include "BanEditor.h"
+#include "BlobCache.h"
 #include "Channel.h"
 #include "ConnectDialog.h"
 #include "Connection.h"
@@ -125,6 +126,9 @@ void MainWindow::msgServerSync(const MumbleProto::ServerSync &msg) {
 	}
 	Global::get().uiSession = msg.session();
 
+	// All channels and users known at this point have been received as part of the initial synchronization
+	pmModel->endBulkSync();
+
 	Global::get().sh->sendPing(); // Send initial ping to establish UDP connection
 
 	Global::get().pPermissions = ChanACL::Permissions(static_cast< unsigned int >(msg.permissions()));
@@ -570,7 +574,7 @@ void MainWindow::msgUserState(const MumbleProto::UserState &msg) {
 			pDst->setSelfDeaf(msg.self_deaf());
 
 		if (pSelf && pDst != pSelf
-			&& ((pDst->cChannel == pSelf->cChannel) || pDst->cChannel->allLinks().contains(pSelf->cChannel))) {
+			&& ((pDst->cChannel == pSelf->cChannel) || pDst->cChannel->isTransitivelyLinked(pSelf->cChannel))) {
 			if (pDst->bSelfMute && pDst->bSelfDeaf)
 				Global::get().l->log(Log::OtherSelfMute,
 									 tr("%1 is now muted and deafened.").arg(Log::formatClientUser(pDst, Log::Target)));
@@ -594,7 +598,7 @@ void MainWindow::msgUserState(const MumbleProto::UserState &msg) {
 				} else {
 					Global::get().l->log(Log::Recording, tr("Recording stopped"));
 				}
-			} else if (pDst->cChannel->allLinks().contains(pSelf->cChannel)) {
+			} else if (pDst->cChannel->isTransitivelyLinked(pSelf->cChannel)) {
 				if (pDst->bRecording) {
 					Global::get().l->log(Log::Recording,
 										 tr("%1 started recording.").arg(Log::formatClientUser(pDst, Log::Source)));
@@ -608,7 +612,7 @@ void MainWindow::msgUserState(const MumbleProto::UserState &msg) {
 
 	if (msg.has_priority_speaker()) {
 		if (pSelf
-			&& ((pDst->cChannel == pSelf->cChannel) || (pDst->cChannel->allLinks().contains(pSelf->cChannel))
+			&& ((pDst->cChannel == pSelf->cChannel) || (pDst->cChannel->isTransitivelyLinked(pSelf->cChannel))
 				|| (pSrc == pSelf))) {
 			if ((pSrc == pDst) && (pSrc == pSelf)) {
 				if (pDst->bPrioritySpeaker) {
@@ -670,7 +674,7 @@ void MainWindow::msgUserState(const MumbleProto::UserState &msg) {
 			pDst->setSuppress(msg.suppress());
 
 		if (pSelf
-			&& ((pDst->cChannel == pSelf->cChannel) || (pDst->cChannel->allLinks().contains(pSelf->cChannel))
+			&& ((pDst->cChannel == pSelf->cChannel) || (pDst->cChannel->isTransitivelyLinked(pSelf->cChannel))
 				|| (pSrc == pSelf))) {
 			if (pDst == pSelf) {
 				if (msg.has_mute() && msg.has_deaf() && pDst->bMute && pDst->bDeaf) {
@@ -806,18 +810,17 @@ void MainWindow::msgUserState(const MumbleProto::UserState &msg) {
 
 	if (msg.has_texture_hash()) {
 		pDst->qbaTextureHash = blob(msg.texture_hash());
-		pDst->qbaTexture     = QByteArray();
 #ifdef USE_OVERLAY
 		Global::get().o->verifyTexture(pDst);
 #endif
 	}
 	if (msg.has_texture()) {
-		pDst->qbaTexture = blob(msg.texture());
-		if (pDst->qbaTexture.isEmpty()) {
+		const QByteArray texture = blob(msg.texture());
+		if (texture.isEmpty()) {
 			pDst->qbaTextureHash = QByteArray();
 		} else {
-			pDst->qbaTextureHash = sha1(pDst->qbaTexture);
-			Global::get().db->setBlob(pDst->qbaTextureHash, pDst->qbaTexture);
+			pDst->qbaTextureHash = sha1(texture);
+			Global::get().bc->setBlob(pDst->qbaTextureHash, texture);
 		}
 #ifdef USE_OVERLAY
 		Global::get().o->verifyTexture(pDst);
@@ -866,7 +869,7 @@ void MainWindow::msgUserRemove(const MumbleProto::UserRemove &msg) {
 									 .arg(reason)
 									 .arg(Log::formatClientUser(pDst, Log::Target)));
 	} else {
-		if (pDst->cChannel == pSelf->cChannel || pDst->cChannel->allLinks().contains(pSelf->cChannel)) {
+		if (pDst->cChannel == pSelf->cChannel || pDst->cChannel->isTransitivelyLinked(pSelf->cChannel)) {
 			Global::get().l->log(Log::ChannelLeaveDisconnect,
 								 tr("%1 left channel and disconnected.").arg(Log::formatClientUser(pDst, Log::Source)));
 		} else {
@@ -5,6 +5,7 @@
 
 #include "Overlay.h"
 
+#include "BlobCache.h"
 #include "Channel.h"
 #include "ClientUser.h"
 #include "Database.h"
@@ -345,17 +346,19 @@ void Overlay::verifyTexture(ClientUser *cp, bool allowupdate) {
 	ClientUser *self = ClientUser::get(Global::get().uiSession);
 	allowupdate      = allowupdate && self && self->cChannel->isLinked(cp->cChannel);
 
-	if (allowupdate && !cp->qbaTextureHash.isEmpty() && cp->qbaTexture.isEmpty())
-		cp->qbaTexture = Global::get().db->blob(cp->qbaTextureHash);
+	// Textures that aren't in memory are only loaded (and checked) if they are about to be shown
+	QByteArray texture;
+	if (!cp->qbaTextureHash.isEmpty() && (allowupdate || Global::get().bc->contains(cp->qbaTextureHash)))
+		texture = Global::get().bc->blob(cp->qbaTextureHash);
 
-	if (!cp->qbaTexture.isEmpty()) {
+	if (!texture.isEmpty()) {
 		bool valid = true;
 
-		if (cp->qbaTexture.length() < static_cast< int >(sizeof(unsigned int))) {
+		if (texture.length() < static_cast< int >(sizeof(unsigned int))) {
 			valid = false;
-		} else if (qFromBigEndian< unsigned int >(reinterpret_cast< const unsigned char * >(cp->qbaTexture.constData()))
+		} else if (qFromBigEndian< unsigned int >(reinterpret_cast< const unsigned char * >(texture.constData()))
 				   == 600 * 60 * 4) {
-			QByteArray qba = qUncompress(cp->qbaTexture);
+			QByteArray qba = qUncompress(texture);
 			if (qba.length() != 600 * 60 * 4) {
 				valid = false;
 			} else {
@@ -407,25 +410,27 @@ void Overlay::verifyTexture(ClientUser *cp, bool allowupdate) {
 						imgp.setCompositionMode(QPainter::CompositionMode_Source);
 						imgp.drawImage(0, 0, srcimg);
 					}
-					cp->qbaTexture = QByteArray();
-
-					QBuffer qb(&cp->qbaTexture);
+					QByteArray png;
+					QBuffer qb(&png);
 					qb.open(QIODevice::WriteOnly);
 					QImageWriter qiw(&qb, "png");
 					qiw.write(img);
 
+					// Store the converted texture under the hash the server knows it by, so that it is only
+					// converted once
+					Global::get().bc->setBlob(cp->qbaTextureHash, png);
 					cp->qbaTextureFormat = QString::fromLatin1("png").toUtf8();
 				}
 			}
 		} else {
-			QBuffer qb(&cp->qbaTexture);
+			QBuffer qb(&texture);
 			qb.open(QIODevice::ReadOnly);
 
 			QImageReader qir;
 			qir.setAutoDetectImageFormat(false);
 
 			QByteArray fmt;
-			if (RichTextImage::isValidImage(cp->qbaTexture, fmt)) {
+			if (RichTextImage::isValidImage(texture, fmt)) {
 				qir.setFormat(fmt);
 				qir.setDevice(&qb);
 				if (!qir.canRead() || (qir.size().width() > 1024) || (qir.size().height() > 1024)) {
@@ -440,7 +445,7 @@ void Overlay::verifyTexture(ClientUser *cp, bool allowupdate) {
 			}
 		}
 		if (!valid) {
-			cp->qbaTexture     = QByteArray();
+			Global::get().bc->removeImages(cp->qbaTextureHash);
 			cp->qbaTextureHash = QByteArray();
 		}
 	}
@@ -480,9 +485,8 @@ void Overlay::updateOverlay() {
 }
 
 void Overlay::requestTexture(ClientUser *cu) {
-	if (cu->qbaTexture.isEmpty() && !qsQueried.contains(cu->uiSession)) {
-		cu->qbaTexture = Global::get().db->blob(cu->qbaTextureHash);
-		if (cu->qbaTexture.isEmpty())
+	if (!qsQueried.contains(cu->uiSession)) {
+		if (Global::get().bc->blob(cu->qbaTextureHash).isEmpty())
 			qsQuery.insert(cu->uiSession);
 		else
 			verifyTexture(cu, false);
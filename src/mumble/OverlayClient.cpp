@@ -26,6 +26,14 @@
 #include <QtGui/QImageReader>
 #include <QtWidgets/QGraphicsProxyWidget>
 
+#include <algorithm>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	include <emmintrin.h>
+#	define OVERLAY_COPY_SSE2
+#endif
+
 #ifdef Q_OS_WIN
 #	include <psapi.h>
 #endif
@@ -566,6 +574,81 @@ void OverlayClient::changed(const QList< QRectF > &region) {
 	QMetaObject::invokeMethod(this, "render", Qt::QueuedConnection);
 }
 
+static qint64 area(const QRect &r) {
+	return static_cast< qint64 >(r.width()) * r.height();
+}
+
+QList< QRect > OverlayClient::dirtyRects(const QList< QRectF > &region, const QRect &bounds) {
+	QList< QRect > rects;
+
+	foreach (const QRectF &rf, region) {
+		QRect r = rf.toAlignedRect().intersected(bounds);
+		if (r.isEmpty())
+			continue;
+
+		// Merge the rect with all rects that it overlaps or nearly touches, as long as the merged rect
+		// doesn't mostly consist of area that isn't dirty.
+		for (int i = 0; i < rects.size();) {
+			const QRect &other = rects.at(i);
+			const QRect united = r.united(other);
+			const qint64 dirty = area(r) + area(other) - area(r.intersected(other));
+
+			if ((area(united) - dirty) * 4 <= area(united)) {
+				r = united;
+				rects.removeAt(i);
+				i = 0;
+			} else {
+				++i;
+			}
+		}
+
+		rects << r;
+	}
+
+	// Don't flood the overlay with blits. Merge the rects whose union grows the least until there are few enough.
+	while (rects.size() > MAX_BLITS) {
+		int bestA = 0, bestB = 1;
+		qint64 bestGrowth = std::numeric_limits< qint64 >::max();
+
+		for (int i = 0; i < rects.size(); ++i) {
+			for (int j = i + 1; j < rects.size(); ++j) {
+				const qint64 growth = area(rects.at(i).united(rects.at(j))) - area(rects.at(i)) - area(rects.at(j));
+				if (growth < bestGrowth) {
+					bestGrowth = growth;
+					bestA      = i;
+					bestB      = j;
+				}
+			}
+		}
+
+		rects[bestA] = rects.at(bestA).united(rects.at(bestB));
+		rects.removeAt(bestB);
+	}
+
+	return rects;
+}
+
+/// Copies the premultiplied ARGB pixels of src into dst, with the top left corner of src ending up at pos. This
+/// is what drawing src with CompositionMode_Source does, minus the overhead of a QPainter pass.
+static void copyPixels(QImage &dst, const QPoint &pos, const QImage &src) {
+	const int width = src.width();
+
+	for (int y = 0; y < src.height(); ++y) {
+		const quint32 *s = reinterpret_cast< const quint32 * >(src.constScanLine(y));
+		quint32 *d       = reinterpret_cast< quint32 * >(dst.scanLine(pos.y() + y)) + pos.x();
+
+		int x = 0;
+#ifdef OVERLAY_COPY_SSE2
+		// Four pixels at a time
+		for (; x + 4 <= width; x += 4) {
+			_mm_storeu_si128(reinterpret_cast< __m128i * >(d + x),
+							 _mm_loadu_si128(reinterpret_cast< const __m128i * >(s + x)));
+		}
+#endif
+		std::copy(s + x, s + width, d + x);
+	}
+}
+
 void OverlayClient::render() {
 	const QList< QRectF > region = qlDirty;
 	qlDirty.clear();
@@ -574,42 +657,35 @@ void OverlayClient::render() {
 		return;
 
 	QRect active;
-	QRectF dirtyf;
 
 	if (region.isEmpty())
 		return;
 
-	foreach (const QRectF &r, region) { dirtyf |= r; }
-
-
-	QRect dirty = dirtyf.toAlignedRect();
-	dirty       = dirty.intersected(QRect(0, 0, uiWidth, uiHeight));
-
-	if ((dirty.width() <= 0) || (dirty.height() <= 0))
+	const QList< QRect > rects = dirtyRects(region, QRect(0, 0, uiWidth, uiHeight));
+	if (rects.isEmpty())
 		return;
 
-	QRect target = dirty;
-	target.moveTo(0, 0);
-
+	// The overlay process may read the shared memory at any time, so every dirty rect is rendered off-screen
+	// first. Clearing the shared memory before painting would make it show half-drawn frames. The finished
+	// rect is then copied over row by row, which is cheaper than a second QPainter pass.
 	QImage img(reinterpret_cast< unsigned char * >(smMem->data()), uiWidth, uiHeight,
 			   QImage::Format_ARGB32_Premultiplied);
-	QImage qi(target.size(), QImage::Format_ARGB32_Premultiplied);
-	qi.fill(0);
 
 	QPainter p;
-	p.begin(&qi);
-	p.setRenderHints(p.renderHints(), false);
-	p.setCompositionMode(QPainter::CompositionMode_SourceOver);
-	qgs.render(&p, target, dirty, Qt::IgnoreAspectRatio);
-	p.end();
-
-	p.begin(&img);
-	p.setRenderHints(p.renderHints(), false);
-	p.setCompositionMode(QPainter::CompositionMode_Source);
-	p.drawImage(dirty.x(), dirty.y(), qi);
-	p.end();
-
-	if (dirty.isValid()) {
+	foreach (const QRect &dirty, rects) {
+		QImage qi(dirty.size(), QImage::Format_ARGB32_Premultiplied);
+		qi.fill(0);
+
+		p.begin(&qi);
+		p.setRenderHints(p.renderHints(), false);
+		p.setCompositionMode(QPainter::CompositionMode_SourceOver);
+		qgs.render(&p, QRect(QPoint(0, 0), dirty.size()), dirty, Qt::IgnoreAspectRatio);
+		p.end();
+
+		copyPixels(img, dirty.topLeft(), qi);
+	}
+
+	foreach (const QRect &dirty, rects) {
 		OverlayMsg om;
 		om.omh.uiMagic = OVERLAY_MAGIC_NUMBER;
 		om.omh.uiType  = OVERLAY_MSGTYPE_BLIT;
@@ -66,12 +66,18 @@ protected:
 	void readyReadMsgInit(unsigned int length);
 
 	QList< QRectF > qlDirty;
+	/// Turns the regions the scene reported as changed into the rects that are to be rendered and blitted.
+	/// Overlapping and nearby regions are merged, far apart ones are kept separate.
+	static QList< QRect > dirtyRects(const QList< QRectF > &region, const QRect &bounds);
 protected slots:
 	void readyRead();
 	void changed(const QList< QRectF > &);
 	void render();
 
 public:
+	/// The maximum amount of rects that are blitted per rendered frame
+	static const int MAX_BLITS = 16;
+
 	QGraphicsView qgv;
 	unsigned int uiWidth, uiHeight;
 	int iMouseX, iMouseY;
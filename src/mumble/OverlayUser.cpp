@@ -5,6 +5,7 @@
 
 #include "OverlayUser.h"
 
+#include "BlobCache.h"
 #include "Channel.h"
 #include "ClientUser.h"
 #include "Database.h"
@@ -190,7 +191,7 @@ void OverlayUser::updateUser() {
 
 		QImage img;
 
-		if (!qbaAvatar.isNull() && cuUser->qbaTexture.isEmpty()) {
+		if (!qbaAvatar.isNull() && !Global::get().bc->contains(qbaAvatar)) {
 			Global::get().o->requestTexture(cuUser);
 		} else if (qbaAvatar.isNull()) {
 			QImageReader qir(QLatin1String("skin:default_avatar.svg"));
@@ -199,14 +200,7 @@ void OverlayUser::updateUser() {
 			qir.setScaledSize(sz);
 			img = qir.read();
 		} else {
-			QBuffer qb(&cuUser->qbaTexture);
-			qb.open(QIODevice::ReadOnly);
-
-			QImageReader qir(&qb, cuUser->qbaTextureFormat);
-			QSize sz = qir.size();
-			sz.scale(SCALESIZE(Avatar), Qt::KeepAspectRatio);
-			qir.setScaledSize(sz);
-			img = qir.read();
+			img = Global::get().bc->image(qbaAvatar, cuUser->qbaTextureFormat, QSize(SCALESIZE(Avatar)));
 		}
 
 		qgpiAvatar->setPixmap(QPixmap::fromImage(img));
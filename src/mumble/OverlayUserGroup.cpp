@@ -290,7 +290,7 @@ void OverlayUserGroup::updateUsers() {
 
 		switch (os->osShow) {
 			case OverlaySettings::LinkedChannels:
-				foreach (Channel *c, home->allLinks())
+				foreach (Channel *c, home->linkedChannels())
 					foreach (User *p, c->qlUsers)
 						showusers << static_cast< ClientUser * >(p);
 				foreach (ClientUser *cu, ClientUser::getTalking())
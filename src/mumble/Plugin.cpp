@@ -5,6 +5,7 @@
 
 #include "Plugin.h"
 #include "API.h"
+#include "ProcessResolver.h"
 #include "Version.h"
 
 #include <QMutexLocker>
@@ -430,6 +431,19 @@ uint32_t Plugin::getFeatures() const {
 	}
 }
 
+bool Plugin::implementsAudioHook(PluginAudioHook hook) const {
+	switch (hook) {
+		case PluginAudioHook::Input:
+			return m_pluginFnc.onAudioInput != nullptr;
+		case PluginAudioHook::SourceFetched:
+			return m_pluginFnc.onAudioSourceFetched != nullptr;
+		case PluginAudioHook::OutputAboutToPlay:
+			return m_pluginFnc.onAudioOutputAboutToPlay != nullptr;
+	}
+
+	return false;
+}
+
 uint32_t Plugin::deactivateFeatures(uint32_t features) const {
 	assertPluginLoaded(this);
 
@@ -471,6 +485,10 @@ uint8_t Plugin::initPositionalData(const char *const *programNames, const uint64
 	}
 }
 
+uint8_t Plugin::initPositionalData(const ProcessResolver &processes) {
+	return initPositionalData(processes.getNames().data(), processes.getPIDs().data(), processes.amountOfProcesses());
+}
+
 bool Plugin::fetchPositionalData(Position3D &avatarPos, Vector3D &avatarDir, Vector3D &avatarAxis,
 								 Position3D &cameraPos, Vector3D &cameraDir, Vector3D &cameraAxis, QString &context,
 								 QString &identity) const {
@@ -101,6 +101,7 @@ public:
 };
 
 class Plugin;
+class ProcessResolver;
 
 /// Typedef for the plugin ID
 typedef uint32_t plugin_id_t;
@@ -109,6 +110,9 @@ typedef std::shared_ptr< Plugin > plugin_ptr_t;
 /// Typedef for a const plugin pointer
 typedef std::shared_ptr< const Plugin > const_plugin_ptr_t;
 
+/// The audio callbacks a plugin may implement. They are invoked from the audio threads for every audio frame.
+enum class PluginAudioHook { Input, SourceFetched, OutputAboutToPlay };
+
 /// A class representing a plugin library attached to Mumble. It can be used to manage (load/unload) and access plugin
 /// libraries.
 class Plugin : public QObject {
@@ -225,6 +229,10 @@ protected:
 	/// @params programCount The length of the two previous arrays
 	virtual uint8_t initPositionalData(const char *const *programNames, const uint64_t *programPIDs,
 									   size_t programCount);
+	/// Initializes the positional data gathering
+	///
+	/// @params processes The resolver holding the currently running programs
+	virtual uint8_t initPositionalData(const ProcessResolver &processes);
 	/// Fetches the positional data
 	///
 	/// @param[out] avatarPos The position of the ingame avatar (player)
@@ -423,6 +431,9 @@ public:
 	/// @returns The plugin's features or'ed together (See the PluginFeature enum in MumblePlugin.h for what features
 	/// are available)
 	virtual uint32_t getFeatures() const;
+	/// @param hook The audio callback to check for
+	/// @returns Whether this plugin implements the given audio callback
+	virtual bool implementsAudioHook(PluginAudioHook hook) const;
 	/// @return Whether the plugin has found a new/updated version of itself available for download
 	virtual bool hasUpdate() const;
 	/// @return The URL to download the updated plugin. May be empty
@@ -27,8 +27,10 @@
 #include "PluginUpdater.h"
 #include "ProcessResolver.h"
 #include "ServerHandler.h"
+#include "Timer.h"
 #include "Global.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <memory>
 #include <vector>
@@ -45,7 +47,11 @@
 PluginManager::PluginManager(QSet< QString > *additionalSearchPaths, QObject *p)
 	: QObject(p), m_pluginCollectionLock(QReadWriteLock::NonRecursive), m_pluginHashMap(), m_positionalData(),
 	  m_positionalDataCheckTimer(), m_sentDataMutex(), m_sentData(),
-	  m_activePosDataPluginLock(QReadWriteLock::NonRecursive), m_activePositionalDataPlugin(), m_updater() {
+	  m_activePosDataPluginLock(QReadWriteLock::NonRecursive), m_activePositionalDataPlugin(), m_processResolver(false),
+	  m_checkedProcessGeneration(std::numeric_limits< uint64_t >::max()), m_skippedPositionalDataChecks(0),
+	  m_updater(), m_audioHookLock(QReadWriteLock::NonRecursive), m_audioHooks() {
+	qRegisterMetaType< plugin_id_t >("plugin_id_t");
+
 	// Setup search-paths
 	if (additionalSearchPaths) {
 		for (const auto &currentPath : *additionalSearchPaths) {
@@ -102,6 +108,10 @@ PluginManager::PluginManager(QSet< QString > *additionalSearchPaths, QObject *p)
 	QObject::connect(serverSyncTimer, &QTimer::timeout, this, &PluginManager::on_syncPositionalData);
 	serverSyncTimer->start(POSITIONAL_SERVER_SYNC_INTERVAL);
 
+	QTimer *audioHookReportTimer = new QTimer(this);
+	QObject::connect(audioHookReportTimer, &QTimer::timeout, this, &PluginManager::reportAudioHookStats);
+	audioHookReportTimer->start(AUDIO_HOOK_REPORT_INTERVAL);
+
 	// Install this manager as a global eventFilter in order to get notified about all keypresses
 	if (QCoreApplication::instance()) {
 		QCoreApplication::instance()->installEventFilter(this);
@@ -189,7 +199,7 @@ void PluginManager::clearPlugins() {
 	m_pluginHashMap.clear();
 }
 
-bool PluginManager::selectActivePositionalDataPlugin() {
+bool PluginManager::selectActivePositionalDataPlugin(bool onlyIfProcessesChanged) {
 	QReadLocker pluginLock(&m_pluginCollectionLock);
 	QWriteLocker activePluginLock(&m_activePosDataPluginLock);
 
@@ -201,19 +211,22 @@ bool PluginManager::selectActivePositionalDataPlugin() {
 		return false;
 	}
 
-	const ProcessResolver procRes(true);
-	const ProcessResolver::ProcessMap &map = procRes.getProcessMap();
+	m_processResolver.resolve();
 
-	// We require 2 separate arrays holding the names and the PIDs -> create them from the given map
-	std::vector< uint64_t > pids;
-	std::vector< const char * > names;
-	pids.reserve(procRes.amountOfProcesses());
-	names.reserve(procRes.amountOfProcesses());
-	for (const std::pair< const uint64_t, std::unique_ptr< char[] > > &currentEntry : map) {
-		pids.push_back(currentEntry.first);
-		names.push_back(currentEntry.second.get());
+	if (onlyIfProcessesChanged && m_processResolver.getGeneration() == m_checkedProcessGeneration
+		&& m_skippedPositionalDataChecks < MAX_SKIPPED_POSITIONAL_DATA_CHECKS) {
+		// No program has been started or has exited since the plugins have last been asked, so they'd most likely
+		// give the same answer. They might be waiting for their game to finish loading though, which is why they are
+		// asked again every once in a while anyway.
+		m_skippedPositionalDataChecks++;
+		m_activePositionalDataPlugin = nullptr;
+
+		return false;
 	}
 
+	m_checkedProcessGeneration    = m_processResolver.getGeneration();
+	m_skippedPositionalDataChecks = 0;
+
 	auto it = m_pluginHashMap.begin();
 
 	// We assume that there is only one (enabled) plugin for the currently played game so we don't have to remember
@@ -222,7 +235,7 @@ bool PluginManager::selectActivePositionalDataPlugin() {
 		plugin_ptr_t currentPlugin = it.value();
 
 		if (currentPlugin->isPositionalDataEnabled() && currentPlugin->isLoaded()) {
-			switch (currentPlugin->initPositionalData(names.data(), pids.data(), procRes.amountOfProcesses())) {
+			switch (currentPlugin->initPositionalData(m_processResolver)) {
 				case MUMBLE_PDEC_OK:
 					// the plugin is ready to provide positional data
 					m_activePositionalDataPlugin = currentPlugin;
@@ -520,7 +533,11 @@ bool PluginManager::loadPlugin(plugin_id_t pluginID) const {
 			return true;
 		}
 
-		return plugin->init() == MUMBLE_STATUS_OK;
+		if (plugin->init() == MUMBLE_STATUS_OK) {
+			addAudioHooks(plugin);
+
+			return true;
+		}
 	}
 
 	return false;
@@ -541,7 +558,9 @@ void PluginManager::unloadPlugin(plugin_id_t pluginID) const {
 
 void PluginManager::unloadPlugin(Plugin &plugin) const {
 	if (plugin.isLoaded()) {
-		// Only shut down loaded plugins
+		// Only shut down loaded plugins. The audio threads must not call into the plugin during or after its shutdown.
+		removeAudioHooks(plugin.getID());
+
 		plugin.shutdown();
 	}
 }
@@ -589,6 +608,79 @@ bool PluginManager::pluginExists(plugin_id_t pluginID) const {
 	return m_pluginHashMap.contains(pluginID);
 }
 
+QVector< PluginManager_AudioHookStats > PluginManager::getAudioHookStats() const {
+	QReadLocker lock(&m_audioHookLock);
+
+	QVector< PluginManager_AudioHookStats > stats;
+
+	for (std::size_t i = 0; i < m_audioHooks.size(); i++) {
+		for (const auto &entry : m_audioHooks[i]) {
+			PluginManager_AudioHookStats current;
+			current.pluginID  = entry->plugin->getID();
+			current.hook      = static_cast< PluginAudioHook >(i);
+			current.calls     = entry->calls.load(std::memory_order_relaxed);
+			current.totalTime = entry->totalTime.load(std::memory_order_relaxed);
+			current.maxTime   = entry->maxTime.load(std::memory_order_relaxed);
+			current.slowCalls = entry->slowCalls.load(std::memory_order_relaxed);
+			current.suspended = entry->suspended.load(std::memory_order_relaxed);
+
+			stats << current;
+		}
+	}
+
+	return stats;
+}
+
+void PluginManager::addAudioHooks(const plugin_ptr_t &plugin) const {
+	QWriteLocker lock(&m_audioHookLock);
+
+	for (std::size_t i = 0; i < m_audioHooks.size(); i++) {
+		if (plugin->implementsAudioHook(static_cast< PluginAudioHook >(i))) {
+			auto entry    = std::make_shared< PluginManager_AudioHookEntry >();
+			entry->plugin = plugin;
+
+			m_audioHooks[i].push_back(std::move(entry));
+		}
+	}
+}
+
+void PluginManager::removeAudioHooks(plugin_id_t pluginID) const {
+	// This waits for the audio threads to leave the callbacks. Should a plugin make an API call from within one of
+	// them, that call times out instead of waiting for the main thread forever.
+	QWriteLocker lock(&m_audioHookLock);
+
+	for (auto &table : m_audioHooks) {
+		table.erase(std::remove_if(table.begin(), table.end(),
+								   [pluginID](const std::shared_ptr< PluginManager_AudioHookEntry > &entry) {
+									   return entry->plugin->getID() == pluginID;
+								   }),
+					table.end());
+	}
+}
+
+void PluginManager::accountAudioHook(PluginManager_AudioHookEntry &entry, uint64_t elapsed) const {
+	entry.calls.fetch_add(1, std::memory_order_relaxed);
+	entry.totalTime.fetch_add(elapsed, std::memory_order_relaxed);
+	if (elapsed > entry.maxTime.load(std::memory_order_relaxed)) {
+		entry.maxTime.store(elapsed, std::memory_order_relaxed);
+	}
+
+	const int budget = Global::get().s.iPluginAudioBudget;
+	if (budget <= 0 || elapsed <= static_cast< uint64_t >(budget)) {
+		entry.overruns = 0;
+		return;
+	}
+
+	entry.slowCalls.fetch_add(1, std::memory_order_relaxed);
+	entry.overruns++;
+	if (entry.overruns >= MAX_AUDIO_HOOK_OVERRUNS && !entry.suspended.exchange(true)) {
+		// The audio thread must not wait for the plugin to shut down, so the actual unloading is done by the main
+		// thread. Until then the suspended plugin is skipped.
+		QMetaObject::invokeMethod(const_cast< PluginManager * >(this), "on_audioHookOverrun", Qt::QueuedConnection,
+								  Q_ARG(plugin_id_t, entry.plugin->getID()));
+	}
+}
+
 void PluginManager::foreachPlugin(std::function< void(Plugin &) > pluginProcessor) const {
 	QReadLocker lock(&m_pluginCollectionLock);
 
@@ -737,11 +829,17 @@ void PluginManager::on_audioInput(short *inputPCM, unsigned int sampleCount, uns
 			 << "samples per channel. IsSpeech:" << isSpeech;
 #endif
 
-	foreachPlugin([inputPCM, sampleCount, channelCount, sampleRate, isSpeech](Plugin &plugin) {
-		if (plugin.isLoaded()) {
-			plugin.onAudioInput(inputPCM, sampleCount, channelCount, sampleRate, isSpeech);
+	QReadLocker lock(&m_audioHookLock);
+
+	for (const auto &entry : m_audioHooks[static_cast< std::size_t >(PluginAudioHook::Input)]) {
+		if (entry->suspended.load(std::memory_order_relaxed)) {
+			continue;
 		}
-	});
+
+		const Timer timer;
+		entry->plugin->onAudioInput(inputPCM, sampleCount, channelCount, sampleRate, isSpeech);
+		accountAudioHook(*entry, timer.elapsed());
+	}
 }
 
 void PluginManager::on_audioSourceFetched(float *outputPCM, unsigned int sampleCount, unsigned int channelCount,
@@ -754,12 +852,18 @@ void PluginManager::on_audioSourceFetched(float *outputPCM, unsigned int sampleC
 	}
 #endif
 
-	foreachPlugin([outputPCM, sampleCount, channelCount, sampleRate, isSpeech, user](Plugin &plugin) {
-		if (plugin.isLoaded()) {
-			plugin.onAudioSourceFetched(outputPCM, sampleCount, channelCount, sampleRate, isSpeech,
-										user ? user->uiSession : -1);
+	QReadLocker lock(&m_audioHookLock);
+
+	for (const auto &entry : m_audioHooks[static_cast< std::size_t >(PluginAudioHook::SourceFetched)]) {
+		if (entry->suspended.load(std::memory_order_relaxed)) {
+			continue;
 		}
-	});
+
+		const Timer timer;
+		entry->plugin->onAudioSourceFetched(outputPCM, sampleCount, channelCount, sampleRate, isSpeech,
+											user ? user->uiSession : -1);
+		accountAudioHook(*entry, timer.elapsed());
+	}
 }
 
 void PluginManager::on_audioOutputAboutToPlay(float *outputPCM, unsigned int sampleCount, unsigned int channelCount,
@@ -768,13 +872,19 @@ void PluginManager::on_audioOutputAboutToPlay(float *outputPCM, unsigned int sam
 	qDebug() << "PluginManager: AudioOutput with" << channelCount << "channels and" << sampleCount
 			 << "samples per channel";
 #endif
-	foreachPlugin([outputPCM, sampleCount, channelCount, sampleRate, modifiedAudio](Plugin &plugin) {
-		if (plugin.isLoaded()) {
-			if (plugin.onAudioOutputAboutToPlay(outputPCM, sampleCount, channelCount, sampleRate)) {
-				*modifiedAudio = true;
-			}
+	QReadLocker lock(&m_audioHookLock);
+
+	for (const auto &entry : m_audioHooks[static_cast< std::size_t >(PluginAudioHook::OutputAboutToPlay)]) {
+		if (entry->suspended.load(std::memory_order_relaxed)) {
+			continue;
 		}
-	});
+
+		const Timer timer;
+		if (entry->plugin->onAudioOutputAboutToPlay(outputPCM, sampleCount, channelCount, sampleRate)) {
+			*modifiedAudio = true;
+		}
+		accountAudioHook(*entry, timer.elapsed());
+	}
 }
 
 void PluginManager::on_receiveData(const ClientUser *sender, const uint8_t *data, size_t dataLength,
@@ -942,6 +1052,64 @@ void PluginManager::on_updatesAvailable() {
 	}
 }
 
+void PluginManager::on_audioHookOverrun(plugin_id_t pluginID) {
+	plugin_ptr_t plugin;
+	{
+		QReadLocker lock(&m_pluginCollectionLock);
+
+		plugin = m_pluginHashMap.value(pluginID);
+	}
+
+	if (!plugin || !plugin->isLoaded()) {
+		return;
+	}
+
+	// Unloading the plugin drops its statistics
+	reportAudioHookStats();
+
+	unloadPlugin(*plugin);
+
+	// Keep the plugin disabled across restarts until the user enables it again
+	const QString pluginKey =
+		QLatin1String(QCryptographicHash::hash(plugin->getFilePath().toUtf8(), QCryptographicHash::Sha1).toHex());
+	Global::get().s.qhPluginSettings.insert(pluginKey, { plugin->getFilePath(), false,
+														 plugin->isPositionalDataEnabled(),
+														 plugin->isKeyboardMonitoringAllowed() });
+
+	Global::get().l->log(Log::Warning, tr("Plugin \"%1\" has been disabled because it repeatedly took longer than "
+										  "%2 ms to process audio. It can be enabled again in the plugin settings.")
+										   .arg(plugin->getName().toHtmlEscaped())
+										   .arg(Global::get().s.iPluginAudioBudget / 1000.0));
+}
+
+void PluginManager::reportAudioHookStats() {
+	static const char *hookNames[] = { "input", "source fetched", "output about to play" };
+
+	foreach (const PluginManager_AudioHookStats &stats, getAudioHookStats()) {
+		const QPair< plugin_id_t, int > key(stats.pluginID, static_cast< int >(stats.hook));
+
+		uint64_t &reported = m_reportedSlowCalls[key];
+		if (stats.slowCalls < reported) {
+			// The plugin has been loaded again in the meantime, which starts its statistics from scratch
+			reported = 0;
+		}
+		if (stats.slowCalls == reported) {
+			continue;
+		}
+
+		const_plugin_ptr_t plugin = getPlugin(stats.pluginID);
+		qWarning("PluginManager: Plugin \"%s\" exceeded the audio budget in its %s callback %llu times since the "
+				 "last report (%llu calls, %.1f us on average, %llu us at most)",
+				 plugin ? qUtf8Printable(plugin->getName()) : "?", hookNames[static_cast< int >(stats.hook)],
+				 static_cast< unsigned long long >(stats.slowCalls - reported),
+				 static_cast< unsigned long long >(stats.calls),
+				 stats.calls ? static_cast< double >(stats.totalTime) / static_cast< double >(stats.calls) : 0.0,
+				 static_cast< unsigned long long >(stats.maxTime));
+
+		reported = stats.slowCalls;
+	}
+}
+
 void PluginManager::checkForAvailablePositionalDataPlugin() {
 	bool performSearch = false;
 	{
@@ -951,6 +1119,6 @@ void PluginManager::checkForAvailablePositionalDataPlugin() {
 	}
 
 	if (performSearch) {
-		selectActivePositionalDataPlugin();
+		selectActivePositionalDataPlugin(true);
 	}
 }
@@ -21,6 +21,7 @@
 #include "MumbleApplication.h"
 #include "Plugin.h"
 #include "PositionalData.h"
+#include "ProcessResolver.h"
 
 #include "Channel.h"
 #include "ClientUser.h"
@@ -28,7 +29,11 @@
 #include "Settings.h"
 #include "User.h"
 
+#include <array>
+#include <atomic>
 #include <functional>
+#include <memory>
+#include <vector>
 
 /// A struct for holding the values of the current context and identity that have been sent to the server
 struct PluginManager_SentData {
@@ -36,6 +41,37 @@ struct PluginManager_SentData {
 	QString identity;
 };
 
+/// An entry in the dispatch table of one of the audio callbacks. Besides the plugin it holds the statistics about the
+/// time the plugin spends in that callback. These are only written by the audio thread invoking the callback.
+struct PluginManager_AudioHookEntry {
+	plugin_ptr_t plugin;
+	/// The amount of times the callback has been invoked
+	std::atomic< uint64_t > calls{ 0 };
+	/// The total time spent in the callback, in microseconds
+	std::atomic< uint64_t > totalTime{ 0 };
+	/// The longest time spent in a single invocation of the callback, in microseconds
+	std::atomic< uint64_t > maxTime{ 0 };
+	/// The total amount of invocations that have exceeded the audio budget
+	std::atomic< uint64_t > slowCalls{ 0 };
+	/// The amount of invocations in a row that have exceeded the audio budget
+	int overruns = 0;
+	/// Whether the plugin has exceeded the audio budget too often and is no longer called
+	std::atomic< bool > suspended{ false };
+};
+
+/// A snapshot of the statistics about the time a plugin spends in one of the audio callbacks
+struct PluginManager_AudioHookStats {
+	plugin_id_t pluginID;
+	PluginAudioHook hook;
+	uint64_t calls;
+	/// In microseconds
+	uint64_t totalTime;
+	/// In microseconds
+	uint64_t maxTime;
+	uint64_t slowCalls;
+	bool suspended;
+};
+
 
 /// The plugin manager is the central object dealing with everything plugin-related. It is responsible for
 /// finding, loading and managing the plugins. It also is responsible for invoking callback functions in the plugins
@@ -77,9 +113,26 @@ protected:
 	/// The plugin that is currently used to retrieve positional data. You have to aquire activePosDataPluginLock before
 	/// accessing this field.
 	plugin_ptr_t m_activePositionalDataPlugin;
+	/// The currently running programs. You have to aquire a write-lock on activePosDataPluginLock before accessing
+	/// this field.
+	ProcessResolver m_processResolver;
+	/// The generation of processResolver the plugins have last been asked to initialize positional data for
+	uint64_t m_checkedProcessGeneration;
+	/// The amount of checks for positional data plugins in a row that have been skipped because no program has
+	/// been started or has exited in the meantime
+	int m_skippedPositionalDataChecks;
 	/// The PluginUpdater used to handle plugin updates.
 	PluginUpdater m_updater;
 
+	/// The lock for audioHooks. The audio threads hold a read-lock on it while invoking the audio callbacks.
+	mutable QReadWriteLock m_audioHookLock;
+	/// For every audio callback (indexed by PluginAudioHook) the loaded plugins that implement it. You have to aquire
+	/// audioHookLock before accessing this field.
+	mutable std::array< std::vector< std::shared_ptr< PluginManager_AudioHookEntry > >, 3 > m_audioHooks;
+	/// The amount of slow invocations per plugin and audio callback that has already been reported by
+	/// reportAudioHookStats(). Only accessed by the main thread.
+	QHash< QPair< plugin_id_t, int >, uint64_t > m_reportedSlowCalls;
+
 	// We override the QObject::eventFilter function in order to be able to install the pluginManager as an event filter
 	// to the main application in order to get notified about keystrokes.
 	bool eventFilter(QObject *target, QEvent *event) Q_DECL_OVERRIDE;
@@ -91,8 +144,27 @@ protected:
 	/// Iterates over the plugins and tries to select a plugin that currently claims to be able to deliver positional
 	/// data. If it found a plugin, activePositionalDataPlugin is set accordingly. If not, it is set to nullptr.
 	///
+	/// @param onlyIfProcessesChanged Whether to skip asking the plugins if the running programs haven't changed
+	/// 	since they have last been asked (unless that has been skipped MAX_SKIPPED_POSITIONAL_DATA_CHECKS times)
 	/// @returns Whether this function succeeded in finding such a plugin
-	bool selectActivePositionalDataPlugin();
+	bool selectActivePositionalDataPlugin(bool onlyIfProcessesChanged = false);
+
+	/// Adds the given plugin to the dispatch tables of all audio callbacks it implements. Has to be called after the
+	/// plugin has been loaded.
+	///
+	/// @param plugin The plugin to add
+	void addAudioHooks(const plugin_ptr_t &plugin) const;
+	/// Removes the plugin with the given ID from the dispatch tables of the audio callbacks. Has to be called before
+	/// the plugin is unloaded. Once this function returns, no audio thread is within one of the plugin's callbacks.
+	///
+	/// @param pluginID The ID of the plugin to remove
+	void removeAudioHooks(plugin_id_t pluginID) const;
+	/// Accounts the time a plugin has spent in one of the audio callbacks and suspends the plugin if it has exceeded
+	/// the audio budget too often in a row.
+	///
+	/// @param entry The dispatch table entry of the plugin
+	/// @param elapsed The time spent in the callback, in microseconds
+	void accountAudioHook(PluginManager_AudioHookEntry &entry, uint64_t elapsed) const;
 
 	/// A internal helper function that iterates over all plugins and calls the given function providing the current
 	/// plugin as a parameter.
@@ -103,6 +175,12 @@ public:
 	static constexpr int POSITIONAL_SERVER_SYNC_INTERVAL = 500;
 	// How often the manager should check for available positional data plugins
 	static constexpr int POSITIONAL_DATA_CHECK_INTERVAL = 1000;
+	// How many checks for positional data plugins may be skipped in a row if no program has been started or exited
+	static constexpr int MAX_SKIPPED_POSITIONAL_DATA_CHECKS = 4;
+	// How many invocations of an audio callback in a row may exceed the audio budget before the plugin gets disabled
+	static constexpr int MAX_AUDIO_HOOK_OVERRUNS = 50;
+	// How often the statistics of audio callbacks that exceeded the audio budget are written to the log (in ms)
+	static constexpr int AUDIO_HOOK_REPORT_INTERVAL = 60000;
 
 	/// Constructor
 	///
@@ -171,6 +249,8 @@ public:
 	/// @param pluginID The ID to check
 	/// @returns Whether such a plugin exists
 	bool pluginExists(plugin_id_t pluginID) const;
+	/// @returns The statistics about the time the loaded plugins spend in the audio callbacks
+	QVector< PluginManager_AudioHookStats > getAudioHookStats() const;
 
 public slots:
 	/// Rescans the plugin directory and load all plugins from there after having cleared the current plugin list
@@ -277,6 +357,13 @@ public slots:
 	void on_updatesAvailable();
 
 protected slots:
+	/// Unloads a plugin that has been suspended for exceeding the audio budget and informs the user about it.
+	///
+	/// @param pluginID The ID of the plugin
+	void on_audioHookOverrun(plugin_id_t pluginID);
+	/// Writes the statistics of the audio callbacks that have exceeded the audio budget since the last report to the
+	/// developer console.
+	void reportAudioHookStats();
 	/// If there is no active positional data plugin, this function will initiate searching for a
 	/// new one.
 	void checkForAvailablePositionalDataPlugin();
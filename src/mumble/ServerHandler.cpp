@@ -11,6 +11,7 @@
 
 #include "ServerHandler.h"
 
+#include "Audio.h"
 #include "AudioInput.h"
 #include "AudioOutput.h"
 #include "Cert.h"
@@ -19,6 +20,7 @@
 #include "HostAddress.h"
 #include "MainWindow.h"
 #include "Message.h"
+#include "MumbleConstants.h"
 #include "Net.h"
 #include "NetworkConfig.h"
 #include "OSInfo.h"
@@ -264,7 +266,8 @@ void ServerHandler::handleVoicePacket(unsigned int msgFlags, PacketDataStream &p
 									  MessageHandler::UDPMessageType type) {
 	unsigned int uiSession;
 	pds >> uiSession;
-	ClientUser *p     = ClientUser::get(uiSession);
+	// Audio mixed by the server is sent with a session of its own, which no user has
+	ClientUser *p     = (uiSession == Mumble::Mixer::MIXED_SESSION) ? &MixedUser::muMixed : ClientUser::get(uiSession);
 	AudioOutputPtr ao = Global::get().ao;
 	if (ao && p && !(((msgFlags & 0x1f) == 2) && Global::get().s.bWhisperFriends && p->qsFriendName.isEmpty())) {
 		unsigned int iSeq;
@@ -0,0 +1,181 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "ServerPinger.h"
+
+#include <QtCore/QTimer>
+#include <QtCore/QtEndian>
+#include <QtNetwork/QUdpSocket>
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+#	include <QtCore/QRandomGenerator>
+#endif
+
+#include <cmath>
+#include <cstring>
+
+ServerPinger::ServerPinger()
+	: QObject(), qusSocket4(nullptr), qusSocket6(nullptr), bIPv4(false), bIPv6(false), qtTick(nullptr),
+	  qtReport(nullptr), qvWheel(WHEEL_SIZE), iWheelPos(0) {
+	qRegisterMetaType< ServerAddress >();
+	qRegisterMetaType< QList< ServerAddress > >();
+	qRegisterMetaType< QVector< ServerAddress > >();
+	qRegisterMetaType< QVector< ServerPinger::Reply > >();
+}
+
+ServerPinger::~ServerPinger() {
+}
+
+void ServerPinger::start() {
+	qusSocket4 = new QUdpSocket(this);
+	qusSocket6 = new QUdpSocket(this);
+	bIPv4      = qusSocket4->bind(QHostAddress(QHostAddress::Any), 0);
+	bIPv6      = qusSocket6->bind(QHostAddress(QHostAddress::AnyIPv6), 0);
+	connect(qusSocket4, &QUdpSocket::readyRead, this, &ServerPinger::readReplies);
+	connect(qusSocket6, &QUdpSocket::readyRead, this, &ServerPinger::readReplies);
+
+	qtTick = new QTimer(this);
+	connect(qtTick, &QTimer::timeout, this, &ServerPinger::tick);
+	qtTick->start(TICK_INTERVAL);
+
+	qtReport = new QTimer(this);
+	connect(qtReport, &QTimer::timeout, this, &ServerPinger::report);
+	qtReport->start(REPORT_INTERVAL);
+}
+
+void ServerPinger::ping(const QList< ServerAddress > &addresses) {
+	foreach (const ServerAddress &address, addresses) {
+		qhStates[address].iRetries = 0;
+		send(address);
+	}
+}
+
+void ServerPinger::forget(const ServerAddress &address) {
+	// Stale entries on the timing wheel are skipped once they come up
+	qhStates.remove(address);
+}
+
+void ServerPinger::send(const ServerAddress &address) {
+	State &state = qhStates[address];
+
+	if (state.uiRand == 0) {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+		state.uiRand = QRandomGenerator::global()->generate64() << 32;
+#else
+		// Qt 5.10 introduces the QRandomGenerator class and in Qt 5.15 qrand got deprecated in its favor
+		state.uiRand = (static_cast< quint64 >(qrand()) << 32) | static_cast< quint64 >(qrand());
+#endif
+	}
+
+	char blob[16];
+	memset(blob, 0, sizeof(blob));
+
+	state.uiSent                             = tPing.elapsed();
+	*reinterpret_cast< quint64 * >(blob + 8) = state.uiSent ^ state.uiRand;
+
+	const QHostAddress host = address.host.toAddress();
+	if (bIPv4 && host.protocol() == QAbstractSocket::IPv4Protocol)
+		qusSocket4->writeDatagram(blob + 4, 12, host, address.port);
+	else if (bIPv6 && host.protocol() == QAbstractSocket::IPv6Protocol)
+		qusSocket6->writeDatagram(blob + 4, 12, host, address.port);
+	else
+		return;
+
+	state.bAwaiting = true;
+	qvSent << address;
+
+	schedule(address, RETRY_TICKS);
+}
+
+void ServerPinger::schedule(const ServerAddress &address, int ticks) {
+	qvWheel[(iWheelPos + qBound(1, ticks, WHEEL_SIZE - 1)) % WHEEL_SIZE] << address;
+}
+
+void ServerPinger::tick() {
+	iWheelPos = (iWheelPos + 1) % WHEEL_SIZE;
+
+	QList< ServerAddress > due;
+	due.swap(qvWheel[iWheelPos]);
+
+	foreach (const ServerAddress &address, due) {
+		auto it = qhStates.find(address);
+		if (it == qhStates.end() || !it->bAwaiting)
+			continue;
+
+		// Only the latest ping to an address is tracked. If it has been sent again in the meantime,
+		// this is the entry of an older ping and the one of the newer ping is still ahead on the wheel.
+		if (tPing.elapsed() - it->uiSent < static_cast< quint64 >(RETRY_TICKS - 1) * TICK_INTERVAL * 1000ULL)
+			continue;
+
+		if (it->iRetries >= MAX_RETRIES) {
+			it->bAwaiting = false;
+			continue;
+		}
+
+		it->iRetries++;
+		send(address);
+	}
+}
+
+void ServerPinger::readReplies() {
+	QUdpSocket *sock = qobject_cast< QUdpSocket * >(sender());
+
+	while (sock->hasPendingDatagrams()) {
+		char blob[64];
+
+		QHostAddress host;
+		unsigned short port;
+
+		qint64 len = sock->readDatagram(blob + 4, 24, &host, &port);
+		if (len != 24)
+			continue;
+
+		if (host.scopeId() == QLatin1String("0"))
+			host.setScopeId(QLatin1String(""));
+
+		ServerAddress address(HostAddress(host), port);
+
+		auto it = qhStates.find(address);
+		if (it == qhStates.end())
+			continue;
+
+		const quint32 *ping = reinterpret_cast< const quint32 * >(blob + 4);
+		const quint64 *ts   = reinterpret_cast< const quint64 * >(blob + 8);
+
+		Reply reply;
+		reply.address   = address;
+		reply.uiElapsed = tPing.elapsed() - (*ts ^ it->uiRand);
+
+		// Smoothed round-trip time and its variation as used for TCP's retransmission timer (RFC 6298)
+		const double sample = static_cast< double >(reply.uiElapsed);
+		if (it->dSmoothed == 0.0) {
+			it->dSmoothed = sample;
+			it->dJitter   = sample / 2.0;
+		} else {
+			it->dJitter   = 0.75 * it->dJitter + 0.25 * std::fabs(it->dSmoothed - sample);
+			it->dSmoothed = 0.875 * it->dSmoothed + 0.125 * sample;
+		}
+		it->bAwaiting = false;
+
+		reply.dSmoothed   = it->dSmoothed;
+		reply.dJitter     = it->dJitter;
+		reply.uiVersion   = qFromBigEndian(ping[0]);
+		reply.uiUsers     = qFromBigEndian(ping[3]);
+		reply.uiMaxUsers  = qFromBigEndian(ping[4]);
+		reply.uiBandwidth = qFromBigEndian(ping[5]);
+
+		qvReplies << reply;
+	}
+}
+
+void ServerPinger::report() {
+	if (qvReplies.isEmpty() && qvSent.isEmpty())
+		return;
+
+	emit results(qvReplies, qvSent);
+
+	qvReplies.clear();
+	qvSent.clear();
+}
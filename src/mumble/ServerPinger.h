@@ -0,0 +1,119 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MUMBLE_SERVERPINGER_H_
+#define MUMBLE_MUMBLE_SERVERPINGER_H_
+
+#include "ServerAddress.h"
+#include "Timer.h"
+
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QMetaType>
+#include <QtCore/QObject>
+#include <QtCore/QVector>
+
+class QTimer;
+class QUdpSocket;
+
+/// Sends the UDP pings used by the ConnectDialog to determine the latency and population of servers.
+///
+/// The pinger is meant to be moved to a thread of its own, so that sending and receiving pings for
+/// thousands of public servers doesn't block the GUI. Pings that haven't been answered are retried using
+/// a timing wheel. Results are not reported one by one, but collected and handed to the GUI in batches a
+/// few times per second.
+class ServerPinger : public QObject {
+private:
+	Q_OBJECT
+	Q_DISABLE_COPY(ServerPinger)
+
+public:
+	struct Reply {
+		ServerAddress address;
+		/// The round-trip time measured by this reply, in microseconds
+		quint64 uiElapsed;
+		/// The smoothed round-trip time of all replies from this address, in microseconds
+		double dSmoothed;
+		/// The variation of the round-trip time of this address (jitter), in microseconds
+		double dJitter;
+		quint32 uiVersion;
+		quint32 uiUsers;
+		quint32 uiMaxUsers;
+		quint32 uiBandwidth;
+	};
+
+	/// The interval at which the timing wheel advances, in milliseconds
+	static const int TICK_INTERVAL = 50;
+	/// The amount of slots on the timing wheel. A ping can't be scheduled further than this many ticks ahead.
+	static const int WHEEL_SIZE = 64;
+	/// The amount of ticks after which an unanswered ping is retried
+	static const int RETRY_TICKS = 20;
+	/// How often an unanswered ping is retried before giving up
+	static const int MAX_RETRIES = 2;
+	/// The interval at which results are reported, in milliseconds
+	static const int REPORT_INTERVAL = 250;
+
+	ServerPinger();
+	~ServerPinger() Q_DECL_OVERRIDE;
+
+signals:
+	/// Reports the results gathered since the last report.
+	///
+	/// @param replies The replies that have been received
+	/// @param sent An entry for every ping that has been sent (including retries)
+	void results(const QVector< ServerPinger::Reply > &replies, const QVector< ServerAddress > &sent);
+
+public slots:
+	/// Sets up the sockets and timers. Has to be called from within the thread the pinger has been moved to.
+	void start();
+	/// Pings all of the given addresses right away
+	void ping(const QList< ServerAddress > &addresses);
+	/// Drops all state kept about the given address
+	void forget(const ServerAddress &address);
+
+protected slots:
+	void readReplies();
+	void tick();
+	void report();
+
+protected:
+	struct State {
+		/// Random value the timestamps sent to this address are obfuscated with
+		quint64 uiRand = 0;
+		/// The time the last ping has been sent at
+		quint64 uiSent = 0;
+		/// The amount of retries for the last ping
+		int iRetries = 0;
+		/// Whether the last ping is still unanswered
+		bool bAwaiting = false;
+		double dSmoothed = 0.0;
+		double dJitter   = 0.0;
+	};
+
+	QUdpSocket *qusSocket4;
+	QUdpSocket *qusSocket6;
+	bool bIPv4;
+	bool bIPv6;
+
+	QTimer *qtTick;
+	QTimer *qtReport;
+	Timer tPing;
+
+	QHash< ServerAddress, State > qhStates;
+	/// The timing wheel. Every slot holds the addresses whose ping is to be checked for an answer in that tick.
+	QVector< QList< ServerAddress > > qvWheel;
+	int iWheelPos;
+
+	QVector< Reply > qvReplies;
+	QVector< ServerAddress > qvSent;
+
+	void send(const ServerAddress &address);
+	void schedule(const ServerAddress &address, int ticks);
+};
+
+Q_DECLARE_METATYPE(ServerAddress);
+Q_DECLARE_METATYPE(ServerPinger::Reply);
+
+#endif
@@ -303,8 +303,9 @@ Settings::Settings() {
 	qRegisterMetaType< Search::SearchDialog::UserAction >("SearchDialog::UserAction");
 	qRegisterMetaType< Search::SearchDialog::ChannelAction >("SearchDialog::ChannelAction");
 
-	atTransmit        = VAD;
-	bTransmitPosition = false;
+	atTransmit         = VAD;
+	bTransmitPosition  = false;
+	iPluginAudioBudget = 2000;
 	bMute = bDeaf                  = false;
 	bTTS                           = false;
 	bTTSMessageReadBack            = false;
@@ -803,6 +804,7 @@ void Settings::load(QSettings *settings_ptr) {
 	LOAD(bWhisperFriends, "audio/whisperfriends");
 	LOAD(iMessageLimitUserThreshold, "audio/messagelimitusers");
 	LOAD(bTransmitPosition, "audio/postransmit");
+	LOAD(iPluginAudioBudget, "audio/pluginaudiobudget");
 
 	if (settings_ptr->contains("audio/echooptionid")) {
 		// Load the new echo cancel option instead
@@ -1243,6 +1245,7 @@ void Settings::save() {
 	SAVE(bWhisperFriends, "audio/whisperfriends");
 	SAVE(iMessageLimitUserThreshold, "audio/messagelimitusers");
 	SAVE(bTransmitPosition, "audio/postransmit");
+	SAVE(iPluginAudioBudget, "audio/pluginaudiobudget");
 	SAVEFLAG(echoOption, "audio/echooptionid");
 
 	SAVE(iJitterBufferSize, "net/jitterbuffer");
@@ -182,6 +182,9 @@ struct Settings {
 	QString qsTxMuteCue;
 
 	bool bTransmitPosition;
+	/// The time a plugin may spend in a single invocation of one of its audio callbacks, in microseconds. A plugin
+	/// exceeding this too often in a row gets disabled. If 0, the time is not limited.
+	int iPluginAudioBudget;
 	bool bMute, bDeaf;
 	bool bTTS;
 	bool bUserTop;
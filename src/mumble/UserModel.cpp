@@ -5,6 +5,7 @@
 
 #include "UserModel.h"
 
+#include "BlobCache.h"
 #include "Channel.h"
 #include "ClientUser.h"
 #include "Database.h"
@@ -23,11 +24,16 @@
 
 #include <QtCore/QMimeData>
 #include <QtCore/QStack>
+#include <QtCore/QTimer>
+#include <QtGui/QGuiApplication>
 #include <QtGui/QImageReader>
+#include <QtGui/QScreen>
 #include <QtWidgets/QMessageBox>
 #include <QtWidgets/QToolTip>
 #include <QtWidgets/QWhatsThis>
 
+#include <algorithm>
+
 QHash< const Channel *, ModelItem * > ModelItem::c_qhChannels;
 QHash< const ClientUser *, ModelItem * > ModelItem::c_qhUsers;
 QHash< const ClientUser *, QList< ModelItem * > > ModelItem::s_userProxies;
@@ -157,38 +163,87 @@ int ModelItem::rows() const {
 	return qlChildren.count();
 }
 
-int ModelItem::insertIndex(Channel *c) const {
-	QList< Channel * > qlpc;
-	ModelItem *item;
+/// Finds the position at which an item has to be inserted into the sorted group of children
+/// [first, last) of the given list, using binary search. The child at index skip (if not -1) is
+/// ignored, which allows finding the new position of an item that is already part of the group
+/// but might be out of order (e.g. because it has been renamed).
+///
+/// @param isLess Returns whether the given child has to be sorted before the item to be inserted
+/// @returns The position relative to the start of the group, not counting the skipped child
+template< typename LessThan >
+static int groupInsertIndex(const QList< ModelItem * > &list, int first, int last, int skip, LessThan isLess) {
+	if (first < 0) {
+		return 0;
+	}
+
+	int lo = 0;
+	int hi = last - first - (skip >= 0 ? 1 : 0);
+	while (lo < hi) {
+		const int mid = lo + (hi - lo) / 2;
+
+		int idx = first + mid;
+		if (skip >= 0 && idx >= skip) {
+			idx++;
+		}
+
+		if (isLess(list.at(idx))) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	return lo;
+}
 
+int ModelItem::insertIndex(Channel *c) const {
+	int first  = -1;
+	int last   = -1;
+	int self   = -1;
 	int ocount = 0;
 
-	foreach (item, qlChildren) {
+	for (int i = 0; i < qlChildren.count(); ++i) {
+		const ModelItem *item = qlChildren.at(i);
 		if (item->cChan) {
-			if (item->cChan != c) {
-				qlpc << item->cChan;
+			if (first < 0) {
+				first = i;
+			}
+			last = i + 1;
+
+			if (item->cChan == c) {
+				self = i;
 			}
-		} else
+		} else {
 			ocount++;
+		}
 	}
-	qlpc << c;
-	std::sort(qlpc.begin(), qlpc.end(), Channel::lessThan);
-	return qlpc.indexOf(c) + (bUsersTop ? ocount : 0);
+
+	// The channels are kept sorted, so there is no need to sort them again
+	const int pos = groupInsertIndex(qlChildren, first, last, self,
+									 [c](const ModelItem *item) { return Channel::lessThan(item->cChan, c); });
+
+	return pos + (bUsersTop ? ocount : 0);
 }
 
 int ModelItem::insertIndex(ClientUser *p, bool isListener) const {
-	QList< ClientUser * > qlclientuser;
-	ModelItem *item;
-
+	int first         = -1;
+	int last          = -1;
+	int self          = -1;
 	int ocount        = 0;
 	int listenerCount = 0;
 
-	foreach (item, qlChildren) {
+	for (int i = 0; i < qlChildren.count(); ++i) {
+		const ModelItem *item = qlChildren.at(i);
 		if (item->pUser) {
-			if (item->pUser != p) {
-				// Make sure listeners and non-listeners are all grouped together and not mixed
-				if ((isListener && item->isListener) || (!isListener && !item->isListener)) {
-					qlclientuser << item->pUser;
+			// Make sure listeners and non-listeners are all grouped together and not mixed
+			if (item->isListener == isListener) {
+				if (first < 0) {
+					first = i;
+				}
+				last = i + 1;
+
+				if (item->pUser == p) {
+					self = i;
 				}
 			}
 
@@ -200,13 +255,14 @@ int ModelItem::insertIndex(ClientUser *p, bool isListener) const {
 		}
 	}
 
-	qlclientuser << p;
-	std::sort(qlclientuser.begin(), qlclientuser.end(), ClientUser::lessThan);
+	// The users are kept sorted, so there is no need to sort them again
+	const int pos = groupInsertIndex(qlChildren, first, last, self,
+									 [p](const ModelItem *item) { return ClientUser::lessThan(item->pUser, p); });
 
 	// Make sure that the a user is always added to other users either all above or all below
 	// sub-channels) and also make sure that listeners are grouped together and directly above
 	// normal users.
-	return qlclientuser.indexOf(p) + (bUsersTop ? 0 : ocount) + (isListener ? 0 : listenerCount);
+	return pos + (bUsersTop ? 0 : ocount) + (isListener ? 0 : listenerCount);
 }
 
 QString ModelItem::hash() const {
@@ -264,6 +320,21 @@ UserModel::UserModel(QObject *p) : QAbstractItemModel(p) {
 	uiSessionComment    = 0;
 	iChannelDescription = -1;
 	bClicked            = false;
+	bBulkSync           = false;
+
+	// Talking state changes can arrive at a much higher rate than the screen is able to display them. Thus
+	// they are collected and flushed to the view at most once per display refresh.
+	qreal refreshRate = 0;
+	if (QScreen *screen = QGuiApplication::primaryScreen())
+		refreshRate = screen->refreshRate();
+	if (refreshRate < 1)
+		refreshRate = 60;
+
+	qtRepaint = new QTimer(this);
+	qtRepaint->setSingleShot(true);
+	qtRepaint->setTimerType(Qt::PreciseTimer);
+	qtRepaint->setInterval(static_cast< int >(1000 / refreshRate));
+	connect(qtRepaint, &QTimer::timeout, this, &UserModel::flushDirtyUsers);
 
 	miRoot = new ModelItem(Channel::get(Channel::ROOT_ID));
 }
@@ -607,26 +678,27 @@ QVariant UserModel::otherRoles(const QModelIndex &idx, int role) const {
 					if (isUser) {
 						QString qsImage;
 						if (!p->qbaTextureHash.isEmpty()) {
-							if (p->qbaTexture.isEmpty()) {
-								p->qbaTexture = Global::get().db->blob(p->qbaTextureHash);
-								if (p->qbaTexture.isEmpty()) {
-									MumbleProto::RequestBlob mprb;
-									mprb.add_session_texture(p->uiSession);
-									Global::get().sh->sendMessage(mprb);
-								} else {
+							const bool cached  = Global::get().bc->contains(p->qbaTextureHash);
+							QByteArray texture = Global::get().bc->blob(p->qbaTextureHash);
+							if (texture.isEmpty()) {
+								MumbleProto::RequestBlob mprb;
+								mprb.add_session_texture(p->uiSession);
+								Global::get().sh->sendMessage(mprb);
+							} else if (!cached) {
 #ifdef USE_OVERLAY
-									Global::get().o->verifyTexture(p);
+								// The texture may be invalid or converted by the check
+								Global::get().o->verifyTexture(p);
+								texture = Global::get().bc->blob(p->qbaTextureHash);
 #endif
-								}
 							}
-							if (!p->qbaTexture.isEmpty()) {
-								QBuffer qb(&p->qbaTexture);
+							if (!texture.isEmpty()) {
+								QBuffer qb(&texture);
 								qb.open(QIODevice::ReadOnly);
 								QImageReader qir(&qb, p->qbaTextureFormat);
 								QSize sz = qir.size();
 								if (sz.width() > 0) {
 									qsImage = QString::fromLatin1("<img src=\"data:;base64,");
-									qsImage.append(QString::fromLatin1(p->qbaTexture.toBase64().toPercentEncoding()));
+									qsImage.append(QString::fromLatin1(texture.toBase64().toPercentEncoding()));
 									if (sz.width() > 128) {
 										int targ = sz.width() / ((sz.width() + 127) / 128);
 										qsImage.append(QString::fromLatin1("\" width=\"%1\" />").arg(targ));
@@ -643,19 +715,17 @@ QVariant UserModel::otherRoles(const QModelIndex &idx, int role) const {
 							else
 								return p->qsName;
 						} else {
-							if (p->qsComment.isEmpty()) {
-								p->qsComment = QString::fromUtf8(Global::get().db->blob(p->qbaCommentHash));
-								if (p->qsComment.isEmpty()) {
-									const_cast< UserModel * >(this)->uiSessionComment = p->uiSession;
-
-									MumbleProto::RequestBlob mprb;
-									mprb.add_session_comment(p->uiSession);
-									Global::get().sh->sendMessage(mprb);
-									return QVariant();
-								}
+							const QString comment = QString::fromUtf8(Global::get().bc->blob(p->qbaCommentHash));
+							if (comment.isEmpty()) {
+								const_cast< UserModel * >(this)->uiSessionComment = p->uiSession;
+
+								MumbleProto::RequestBlob mprb;
+								mprb.add_session_comment(p->uiSession);
+								Global::get().sh->sendMessage(mprb);
+								return QVariant();
 							}
 							const_cast< UserModel * >(this)->seenComment(idx);
-							QString base = Log::validHtml(p->qsComment);
+							QString base = Log::validHtml(comment);
 							if (!qsImage.isEmpty())
 								return QString::fromLatin1(
 										   "<table><tr><td valign=\"top\">%1</td><td>%2</td></tr></table>")
@@ -667,7 +737,7 @@ QVariant UserModel::otherRoles(const QModelIndex &idx, int role) const {
 							return c->qsName;
 						} else {
 							if (c->qsDesc.isEmpty()) {
-								c->qsDesc = QString::fromUtf8(Global::get().db->blob(c->qbaDescHash));
+								c->qsDesc = QString::fromUtf8(Global::get().bc->blob(c->qbaDescHash));
 								if (c->qsDesc.isEmpty()) {
 									const_cast< UserModel * >(this)->iChannelDescription = c->iId;
 
@@ -851,6 +921,23 @@ ModelItem *UserModel::moveItem(ModelItem *oldparent, ModelItem *newparent, Model
 		newrow = newparent->insertIndex(oldItem->pUser);
 	}
 
+	if (bBulkSync) {
+		// No view is looking at the tree's contents right now, so there are no persistent indices or
+		// selections to take care of and the item can be moved over directly.
+		oldparent->qlChildren.removeAt(oldrow);
+		newparent->qlChildren.insert(newrow, oldItem);
+		oldItem->parent = newparent;
+
+		if (oldItem->cChan) {
+			oldparent->cChan->removeChannel(oldItem->cChan);
+			newparent->cChan->addChannel(oldItem->cChan);
+		} else {
+			newparent->cChan->addClientUser(oldItem->pUser);
+		}
+
+		return oldItem;
+	}
+
 	if ((oldparent == newparent) && (newrow == oldrow)) {
 		// This is a no-op. We still claim that the data has changed in order
 		// to trigger potential event handlers.
@@ -956,6 +1043,9 @@ ModelItem *UserModel::moveItem(ModelItem *oldparent, ModelItem *newparent, Model
 }
 
 void UserModel::expandAll(Channel *c) {
+	if (bBulkSync)
+		return;
+
 	QStack< Channel * > chans;
 
 	while (c) {
@@ -969,6 +1059,9 @@ void UserModel::expandAll(Channel *c) {
 }
 
 void UserModel::collapseEmpty(Channel *c) {
+	if (bBulkSync)
+		return;
+
 	while (c) {
 		ModelItem *mi = ModelItem::c_qhChannels.value(c);
 		if (mi->iUsers == 0)
@@ -1013,7 +1106,8 @@ void UserModel::recheckLinks() {
 
 	foreach (Channel *c, changed) {
 		QModelIndex idx = index(c);
-		emit dataChanged(idx, idx);
+		if (!bBulkSync)
+			emit dataChanged(idx, idx);
 		bChanged = true;
 	}
 	if (bChanged)
@@ -1040,10 +1134,12 @@ ClientUser *UserModel::addUser(unsigned int id, const QString &name) {
 
 	int row = citem->insertIndex(p);
 
-	beginInsertRows(index(citem), row, row);
+	if (!bBulkSync)
+		beginInsertRows(index(citem), row, row);
 	citem->qlChildren.insert(row, item);
 	c->addClientUser(p);
-	endInsertRows();
+	if (!bBulkSync)
+		endInsertRows();
 
 	while (citem) {
 		citem->iUsers++;
@@ -1069,10 +1165,12 @@ void UserModel::removeUser(ClientUser *p) {
 
 	int row = citem->qlChildren.indexOf(item);
 
-	beginRemoveRows(index(citem), row, row);
+	if (!bBulkSync)
+		beginRemoveRows(index(citem), row, row);
 	c->removeUser(p);
 	citem->qlChildren.removeAt(row);
-	endRemoveRows();
+	if (!bBulkSync)
+		endRemoveRows();
 
 	p->cChannel = nullptr;
 
@@ -1139,7 +1237,8 @@ void UserModel::renameUser(ClientUser *p, const QString &name) {
 void UserModel::setUserId(ClientUser *p, int id) {
 	p->iId          = id;
 	QModelIndex idx = index(p, 0);
-	emit dataChanged(idx, idx);
+	if (!bBulkSync)
+		emit dataChanged(idx, idx);
 }
 
 void UserModel::setHash(ClientUser *p, const QString &hash) {
@@ -1153,21 +1252,24 @@ void UserModel::setHash(ClientUser *p, const QString &hash) {
 void UserModel::setFriendName(ClientUser *p, const QString &name) {
 	p->qsFriendName = name;
 	QModelIndex idx = index(p, 0);
-	emit dataChanged(idx, idx);
+	if (!bBulkSync)
+		emit dataChanged(idx, idx);
 }
 
 void UserModel::setComment(ClientUser *cu, const QString &comment) {
-	cu->qbaCommentHash = comment.isEmpty() ? QByteArray() : sha1(comment);
+	const QByteArray hash = comment.isEmpty() ? QByteArray() : sha1(comment);
 
-	if (comment != cu->qsComment) {
+	// The text itself is only kept in the BlobCache, so a comment we receive again (e.g. because we requested it)
+	// is handled like a new one
+	if (hash != cu->qbaCommentHash || !comment.isEmpty()) {
 		ModelItem *item = ModelItem::c_qhUsers.value(cu);
-		int oldstate    = (cu->qsComment.isEmpty() && cu->qbaCommentHash.isEmpty()) ? 0 : (item->bCommentSeen ? 2 : 1);
+		int oldstate    = cu->qbaCommentHash.isEmpty() ? 0 : (item->bCommentSeen ? 2 : 1);
 		int newstate    = 0;
 
-		cu->qsComment = comment;
+		cu->qbaCommentHash = hash;
 
 		if (!comment.isEmpty()) {
-			Global::get().db->setBlob(cu->qbaCommentHash, cu->qsComment.toUtf8());
+			Global::get().bc->setBlob(cu->qbaCommentHash, comment.toUtf8());
 			if (cu->uiSession == uiSessionComment) {
 				uiSessionComment   = 0;
 				item->bCommentSeen = false;
@@ -1197,7 +1299,8 @@ void UserModel::setComment(ClientUser *cu, const QString &comment) {
 
 		if (oldstate != newstate) {
 			QModelIndex idx = index(cu, 0);
-			emit dataChanged(idx, idx);
+			if (!bBulkSync)
+				emit dataChanged(idx, idx);
 		}
 	}
 }
@@ -1205,10 +1308,9 @@ void UserModel::setComment(ClientUser *cu, const QString &comment) {
 void UserModel::setCommentHash(ClientUser *cu, const QByteArray &hash) {
 	if (hash != cu->qbaCommentHash) {
 		ModelItem *item = ModelItem::c_qhUsers.value(cu);
-		int oldstate    = (cu->qsComment.isEmpty() && cu->qbaCommentHash.isEmpty()) ? 0 : (item->bCommentSeen ? 2 : 1);
+		int oldstate    = cu->qbaCommentHash.isEmpty() ? 0 : (item->bCommentSeen ? 2 : 1);
 		int newstate;
 
-		cu->qsComment      = QString();
 		cu->qbaCommentHash = hash;
 
 		item->bCommentSeen = Global::get().db->seenComment(item->hash(), cu->qbaCommentHash);
@@ -1216,7 +1318,8 @@ void UserModel::setCommentHash(ClientUser *cu, const QByteArray &hash) {
 
 		if (oldstate != newstate) {
 			QModelIndex idx = index(cu, 0);
-			emit dataChanged(idx, idx);
+			if (!bBulkSync)
+				emit dataChanged(idx, idx);
 		}
 	}
 }
@@ -1232,7 +1335,7 @@ void UserModel::setComment(Channel *c, const QString &comment) {
 		c->qsDesc = comment;
 
 		if (!comment.isEmpty()) {
-			Global::get().db->setBlob(c->qbaDescHash, c->qsDesc.toUtf8());
+			Global::get().bc->setBlob(c->qbaDescHash, c->qsDesc.toUtf8());
 
 			if (c->iId == iChannelDescription) {
 				iChannelDescription = -1;
@@ -1255,7 +1358,8 @@ void UserModel::setComment(Channel *c, const QString &comment) {
 
 		if (oldstate != newstate) {
 			QModelIndex idx = index(c, 0);
-			emit dataChanged(idx, idx);
+			if (!bBulkSync)
+				emit dataChanged(idx, idx);
 		}
 	}
 }
@@ -1274,7 +1378,8 @@ void UserModel::setCommentHash(Channel *c, const QByteArray &hash) {
 
 		if (oldstate != newstate) {
 			QModelIndex idx = index(c, 0);
-			emit dataChanged(idx, idx);
+			if (!bBulkSync)
+				emit dataChanged(idx, idx);
 		}
 	}
 }
@@ -1301,7 +1406,8 @@ void UserModel::renameChannel(Channel *c, const QString &name) {
 
 	if (c->iId == 0) {
 		QModelIndex idx = index(c);
-		emit dataChanged(idx, idx);
+		if (!bBulkSync)
+			emit dataChanged(idx, idx);
 	} else {
 		Channel *pc     = c->cParent;
 		ModelItem *pi   = ModelItem::c_qhChannels.value(pc);
@@ -1318,7 +1424,8 @@ void UserModel::repositionChannel(Channel *c, const int position) {
 
 	if (c->iId == 0) {
 		QModelIndex idx = index(c);
-		emit dataChanged(idx, idx);
+		if (!bBulkSync)
+			emit dataChanged(idx, idx);
 	} else {
 		Channel *pc     = c->cParent;
 		ModelItem *pi   = ModelItem::c_qhChannels.value(pc);
@@ -1341,12 +1448,14 @@ Channel *UserModel::addChannel(int id, Channel *p, const QString &name) {
 
 	int row = citem->insertIndex(c);
 
-	beginInsertRows(index(citem), row, row);
+	if (!bBulkSync)
+		beginInsertRows(index(citem), row, row);
 	p->addChannel(c);
 	citem->qlChildren.insert(row, item);
-	endInsertRows();
+	if (!bBulkSync)
+		endInsertRows();
 
-	if (Global::get().s.ceExpand == Settings::AllChannels)
+	if (!bBulkSync && Global::get().s.ceExpand == Settings::AllChannels)
 		Global::get().mw->qtvUsers->setExpanded(index(item), true);
 
 
@@ -1363,9 +1472,11 @@ void UserModel::addChannelListener(ClientUser *p, Channel *c) {
 
 	int row = citem->insertIndex(p, true);
 
-	beginInsertRows(index(citem), row, row);
+	if (!bBulkSync)
+		beginInsertRows(index(citem), row, row);
 	citem->qlChildren.insert(row, item);
-	endInsertRows();
+	if (!bBulkSync)
+		endInsertRows();
 
 	while (citem) {
 		citem->iUsers++;
@@ -1460,9 +1571,11 @@ void UserModel::removeChannelListener(ModelItem *item, ModelItem *citem) {
 
 	int row = citem->qlChildren.indexOf(item);
 
-	beginRemoveRows(index(citem), row, row);
+	if (!bBulkSync)
+		beginRemoveRows(index(citem), row, row);
 	citem->qlChildren.removeAt(row);
-	endRemoveRows();
+	if (!bBulkSync)
+		endRemoveRows();
 
 	while (citem) {
 		citem->iUsers--;
@@ -1504,11 +1617,13 @@ bool UserModel::removeChannel(Channel *c, const bool onlyIfUnoccupied) {
 
 	int row = citem->rowOf(c);
 
-	beginRemoveRows(index(citem), row, row);
+	if (!bBulkSync)
+		beginRemoveRows(index(citem), row, row);
 	p->removeChannel(c);
 	citem->qlChildren.removeAt(row);
 	qsLinked.remove(c);
-	endRemoveRows();
+	if (!bBulkSync)
+		endRemoveRows();
 
 	Channel::remove(c);
 
@@ -1586,6 +1701,45 @@ void UserModel::removeAll() {
 	updateOverlay();
 }
 
+void UserModel::beginBulkSync() {
+	if (bBulkSync)
+		return;
+
+	beginResetModel();
+	bBulkSync = true;
+
+	// The model reset repaints every row, so pending row updates are obsolete
+	qtRepaint->stop();
+	qsDirtyUsers.clear();
+}
+
+void UserModel::endBulkSync() {
+	if (!bBulkSync)
+		return;
+
+	bBulkSync = false;
+	endResetModel();
+
+	switch (Global::get().s.ceExpand) {
+		case Settings::AllChannels:
+			foreach (ModelItem *item, ModelItem::c_qhChannels)
+				Global::get().mw->qtvUsers->setExpanded(index(item), true);
+			break;
+		case Settings::ChannelsWithUsers:
+			foreach (ModelItem *item, ModelItem::c_qhUsers)
+				expandAll(item->pUser->cChannel);
+			break;
+		default:
+			break;
+	}
+
+	// Make the view re-apply its channel filter, as a reset clears all hidden rows
+	const QModelIndex root = index(miRoot);
+	emit dataChanged(root, root);
+
+	updateOverlay();
+}
+
 ClientUser *UserModel::getUser(const QModelIndex &idx) const {
 	if (!idx.isValid())
 		return nullptr;
@@ -1687,15 +1841,73 @@ Channel *UserModel::getSubChannel(Channel *p, int idx) const {
 void UserModel::userStateChanged() {
 	ClientUser *user = qobject_cast< ClientUser * >(sender());
 
-	if (!user)
+	if (!user || bBulkSync)
 		return;
 
-	const QModelIndex idx = index(user);
-	emit dataChanged(idx, idx);
+	rsRepaint.requested++;
+
+	if (qsDirtyUsers.contains(user->uiSession)) {
+		// The row is going to be repainted anyway
+		rsRepaint.dropped++;
+		return;
+	}
+
+	qsDirtyUsers.insert(user->uiSession);
+
+	if (!qtRepaint->isActive())
+		qtRepaint->start();
+}
+
+void UserModel::flushDirtyUsers() {
+	// Rows must not be announced while the model is being reset
+	if (bBulkSync || qsDirtyUsers.isEmpty())
+		return;
+
+	// Group the affected rows by their parent, so that adjacent rows can be merged into a single notification
+	QHash< ModelItem *, QVector< int > > rows;
+	foreach (unsigned int session, qsDirtyUsers) {
+		ClientUser *user = ClientUser::get(session);
+		ModelItem *item  = user ? ModelItem::c_qhUsers.value(user) : nullptr;
+
+		if (!item || !item->parent) {
+			// The user has left in the meantime
+			rsRepaint.dropped++;
+			continue;
+		}
+
+		rows[item->parent] << item->parent->qlChildren.indexOf(item);
+	}
+	qsDirtyUsers.clear();
+
+	for (auto it = rows.begin(); it != rows.end(); ++it) {
+		ModelItem *parent    = it.key();
+		QVector< int > &list = it.value();
+
+		std::sort(list.begin(), list.end());
+
+		int first = 0;
+		while (first < list.count()) {
+			int last = first;
+			while (last + 1 < list.count() && list.at(last + 1) == list.at(last) + 1)
+				++last;
+
+			rsRepaint.merged += static_cast< quint64 >(last - first);
+			rsRepaint.emitted++;
+
+			emit dataChanged(createIndex(list.at(first), 0, parent->qlChildren.at(list.at(first))),
+							 createIndex(list.at(last), 0, parent->qlChildren.at(list.at(last))));
+
+			first = last + 1;
+		}
+	}
 
 	updateOverlay();
 }
 
+const UserModel::RepaintStatistics &UserModel::repaintStatistics() const {
+	return rsRepaint;
+}
+
 void UserModel::on_channelListenerLocalVolumeAdjustmentChanged(int channelID, float oldValue, float newValue) {
 	Q_UNUSED(oldValue);
 	Q_UNUSED(newValue);
@@ -1957,6 +2169,9 @@ bool UserModel::dropMimeData(const QMimeData *md, Qt::DropAction, int row, int c
 }
 
 void UserModel::updateOverlay() const {
+	if (bBulkSync)
+		return;
+
 #ifdef USE_OVERLAY
 	Global::get().o->updateOverlay();
 #endif
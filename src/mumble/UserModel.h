@@ -12,6 +12,7 @@
 #include <QtCore/QSet>
 #include <QtGui/QIcon>
 
+class QTimer;
 class User;
 class ClientUser;
 class Channel;
@@ -83,6 +84,14 @@ protected:
 	QMap< QString, ClientUser * > qmHashes;
 
 	bool bClicked;
+	/// Whether the model is currently being populated with the initial server state. While this is the case,
+	/// no per-row notifications are emitted as all changes are published by a single model reset instead.
+	bool bBulkSync;
+
+	/// Sessions of the users whose row has to be repainted with the next flush
+	QSet< unsigned int > qsDirtyUsers;
+	/// Timer used to flush the dirty users at most once per display refresh
+	QTimer *qtRepaint;
 
 	void recursiveClone(const ModelItem *old, ModelItem *item, QModelIndexList &from, QModelIndexList &to);
 	ModelItem *moveItem(ModelItem *oldparent, ModelItem *newparent, ModelItem *item);
@@ -102,6 +111,18 @@ protected:
 	void removeChannelListener(ModelItem *item, ModelItem *citem = nullptr);
 
 public:
+	/// Counters describing how well state changes of users are being coalesced into repaints
+	struct RepaintStatistics {
+		/// The amount of state changes that requested a repaint
+		quint64 requested = 0;
+		/// The amount of state changes for users that already had a repaint pending
+		quint64 dropped = 0;
+		/// The amount of rows that have been merged with an adjacent row into a single notification
+		quint64 merged = 0;
+		/// The amount of dataChanged notifications that have actually been emitted
+		quint64 emitted = 0;
+	};
+
 	UserModel(QObject *parent = 0);
 	~UserModel() Q_DECL_OVERRIDE;
 
@@ -189,11 +210,20 @@ public:
 
 	void removeAll();
 
+	/// Starts populating the model with the state sent by the server on connect. Until endBulkSync() is
+	/// called, users and channels are inserted into the tree without notifying the attached views.
+	void beginBulkSync();
+	/// Publishes all changes made since beginBulkSync() by means of a single model reset and applies the
+	/// configured channel expansion. Calling this while not in bulk sync mode does nothing.
+	void endBulkSync();
+
 	void expandAll(Channel *c);
 	void collapseEmpty(Channel *c);
 
 	QVariant otherRoles(const QModelIndex &idx, int role) const;
 
+	const RepaintStatistics &repaintStatistics() const;
+
 	unsigned int uiSessionComment;
 	int iChannelDescription;
 
@@ -205,6 +235,10 @@ public:
 	/// @param parentChannel The channel in which the listener resides. May be nullptr, if isChannelListener is false
 	/// @return The created display string
 	static QString createDisplayString(const ClientUser &user, bool isChannelListener, const Channel *parentChannel);
+
+protected:
+	RepaintStatistics rsRepaint;
+
 public slots:
 	/// Invalidates the model data of the ClientUser triggering this slot.
 	void userStateChanged();
@@ -213,6 +247,9 @@ public slots:
 	void recheckLinks();
 	void updateOverlay() const;
 	void toggleChannelFiltered(Channel *c);
+protected slots:
+	/// Emits the (merged) dataChanged notifications for all users whose state has changed since the last flush
+	void flushDirtyUsers();
 signals:
 	/// A signal emitted whenever a user is added to the model.
 	///
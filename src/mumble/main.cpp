@@ -9,6 +9,7 @@
 #include "AudioInput.h"
 #include "AudioOutput.h"
 #include "AudioWizard.h"
+#include "BlobCache.h"
 #include "Cert.h"
 #include "Database.h"
 #include "DeveloperConsole.h"
@@ -632,6 +633,7 @@ int main(int argc, char **argv) {
 
 	// Initialize database
 	Global::get().db = new Database(QLatin1String("main"));
+	Global::get().bc = new BlobCache();
 
 #ifdef USE_ZEROCONF
 	// Initialize zeroconf
@@ -848,6 +850,7 @@ int main(int argc, char **argv) {
 	delete Global::get().nam;
 	delete Global::get().lcd;
 
+	delete Global::get().bc;
 	delete Global::get().db;
 	delete Global::get().l;
 	Global::get().l = nullptr; // Make it clear to any destruction code that Log no longer exists
@@ -187,6 +187,8 @@ void Server::initializeCert() {
 		}
 	}
 
+	initializeTlsConfiguration();
+
 	// Drain OpenSSL's per-thread error queue
 	// to ensure that errors from the operations
 	// we've done in here do not leak out into
@@ -0,0 +1,138 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "EgressPacer.h"
+
+#include <cmath>
+
+EgressPacer::EgressPacer()
+	: dRate(0.0), uiRateUpdated(0), dCapacity(0.0), dTokens(0.0), uiTokensUpdated(0), uiGood(0), uiLate(0),
+	  uiLost(0) {
+}
+
+bool EgressPacer::admit(quint64 now, const char *data, int len, bool *dropped) {
+	if (dropped)
+		*dropped = false;
+
+	if (dCapacity <= 0.0 && qqPackets.isEmpty()) {
+		account(now, len);
+		return true;
+	}
+
+	refill(now);
+
+	// Packets mustn't overtake the ones that are queued already
+	if (qqPackets.isEmpty() && dTokens >= len) {
+		dTokens -= len;
+		account(now, len);
+		return true;
+	}
+
+	if (qqPackets.count() >= MAX_QUEUED) {
+		qqPackets.dequeue();
+		if (dropped)
+			*dropped = true;
+	}
+	qqPackets.enqueue(QByteArray(data, len));
+
+	return false;
+}
+
+bool EgressPacer::release(quint64 now, QByteArray &packet) {
+	if (qqPackets.isEmpty())
+		return false;
+
+	if (dCapacity > 0.0) {
+		refill(now);
+		if (dTokens < qqPackets.head().size())
+			return false;
+		dTokens -= qqPackets.head().size();
+	}
+
+	packet = qqPackets.dequeue();
+	account(now, packet.size());
+
+	return true;
+}
+
+int EgressPacer::queued() const {
+	return qqPackets.count();
+}
+
+int EgressPacer::reset() {
+	const int dropped = qqPackets.count();
+	qqPackets.clear();
+	dCapacity = 0.0;
+	dTokens   = 0.0;
+	return dropped;
+}
+
+void EgressPacer::report(quint64 now, quint32 good, quint32 late, quint32 lost) {
+	if (good < uiGood) {
+		// The client's statistics have been reset
+		uiGood = good;
+		uiLate = late;
+		uiLost = lost;
+		return;
+	}
+
+	// The client takes back packets it counted as lost if they turn up late, so these may go down
+	const qint64 newGood = static_cast< qint64 >(good) - uiGood;
+	const qint64 newBad  = qMax< qint64 >(static_cast< qint64 >(late) - uiLate, 0)
+						  + qMax< qint64 >(static_cast< qint64 >(lost) - uiLost, 0);
+
+	if (newGood + newBad < MIN_PACKETS)
+		return;
+
+	uiGood = good;
+	uiLate = late;
+	uiLost = lost;
+
+	const double loss = static_cast< double >(newBad) / static_cast< double >(newGood + newBad);
+	const double sent = rate(now);
+
+	if (loss > LOSS_HIGH) {
+		const bool start = dCapacity <= 0.0;
+		dCapacity        = qMax(MIN_CAPACITY, (start ? sent : qMin(dCapacity, sent)) * 0.85);
+		if (start) {
+			dTokens         = burst();
+			uiTokensUpdated = now;
+		} else {
+			dTokens = qMin(dTokens, burst());
+		}
+	} else if (dCapacity > 0.0 && loss < LOSS_LOW) {
+		dCapacity *= 1.1;
+		// Pacing doesn't limit anything anymore
+		if (dCapacity > 4.0 * qMax(sent, MIN_CAPACITY) && qqPackets.isEmpty())
+			dCapacity = 0.0;
+	}
+}
+
+double EgressPacer::capacity() const {
+	return dCapacity;
+}
+
+double EgressPacer::rate(quint64 now) const {
+	if (now <= uiRateUpdated)
+		return dRate;
+	return dRate * std::exp(-static_cast< double >(now - uiRateUpdated) / RATE_WINDOW);
+}
+
+void EgressPacer::account(quint64 now, int len) {
+	dRate         = rate(now) + len * 1000000.0 / RATE_WINDOW;
+	uiRateUpdated = qMax(now, uiRateUpdated);
+}
+
+void EgressPacer::refill(quint64 now) {
+	if (now > uiTokensUpdated) {
+		dTokens         = qMin(burst(), dTokens + dCapacity * static_cast< double >(now - uiTokensUpdated) / 1000000.0);
+		uiTokensUpdated = now;
+	}
+}
+
+double EgressPacer::burst() const {
+	// Always allow for a couple of large packets, however low the capacity is
+	return qMax(dCapacity * MAX_BURST / 1000000.0, 3000.0);
+}
@@ -0,0 +1,89 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_EGRESSPACER_H_
+#define MUMBLE_MURMUR_EGRESSPACER_H_
+
+#include <QtCore/QByteArray>
+#include <QtCore/QQueue>
+
+/// Keeps the voice packets sent to a user through UDP from exceeding the capacity of the user's downstream.
+///
+/// As long as the user doesn't report any loss, packets are sent as they come. Once the loss the user reports in
+/// their pings (see Server::msgPing()) goes above LOSS_HIGH, the capacity is estimated from the rate of data that
+/// was sent to them and packets are paced through a token bucket that is refilled at that rate:
+///  - Packets that would exceed the capacity are queued and sent once there are enough tokens again. If the queue
+///    grows beyond MAX_QUEUED, the oldest packet is dropped; a late packet is of no use to the jitter buffer.
+///  - While the user reports a loss of less than LOSS_LOW, the capacity is increased step by step. Once it is way
+///    above the rate of data that is sent, pacing stops again.
+///
+/// Not thread-safe, see ServerUser::qmEgress.
+class EgressPacer {
+public:
+	/// Time window the rate of sent data is averaged over, in microseconds
+	static const quint64 RATE_WINDOW = 1000000ULL;
+	/// Amount of packets the loss has to be computed from at least
+	static const unsigned int MIN_PACKETS = 25;
+	/// Loss above which the capacity is decreased
+	static constexpr double LOSS_HIGH = 0.05;
+	/// Loss below which the capacity is increased
+	static constexpr double LOSS_LOW = 0.01;
+	/// Lowest capacity that is assumed, in bytes per second
+	static constexpr double MIN_CAPACITY = 2000.0;
+	/// The longest burst that is sent at once, in microseconds worth of capacity
+	static const quint64 MAX_BURST = 60000ULL;
+	/// Amount of packets that may be waiting to be sent
+	static const int MAX_QUEUED = 16;
+	/// How often queued packets are released while there are any, in milliseconds
+	static const int RELEASE_INTERVAL = 5;
+
+	EgressPacer();
+
+	/// Accounts a packet that is about to be sent.
+	///
+	/// @param now The current time, in microseconds
+	/// @param dropped Set to true if the oldest packet had to be dropped in order to queue this one
+	/// @returns True if the packet may be sent right away. Otherwise it has been queued and is handed out by
+	/// 	release() later on.
+	bool admit(quint64 now, const char *data, int len, bool *dropped = nullptr);
+	/// Hands out the next queued packet if it may be sent by now.
+	///
+	/// @returns False if there is no packet that may be sent
+	bool release(quint64 now, QByteArray &packet);
+	/// @returns The amount of queued packets
+	int queued() const;
+	/// Drops the queued packets and forgets the capacity estimate, so that packets are sent right away again. The
+	/// statistics last reported by the user are kept, as report() only looks at what changed since then.
+	///
+	/// @returns The amount of packets that were dropped
+	int reset();
+
+	/// Updates the capacity estimate with the statistics the user reported about the packets they received from us.
+	/// The arguments are the totals since the connection was established.
+	void report(quint64 now, quint32 good, quint32 late, quint32 lost);
+
+	/// @returns The estimated capacity of the user's downstream in bytes per second, or 0 if no loss has been seen
+	double capacity() const;
+	/// @returns The rate of voice data that was sent to the user recently, in bytes per second
+	double rate(quint64 now) const;
+
+protected:
+	double dRate;
+	quint64 uiRateUpdated;
+	double dCapacity;
+	double dTokens;
+	quint64 uiTokensUpdated;
+	QQueue< QByteArray > qqPackets;
+
+	quint32 uiGood;
+	quint32 uiLate;
+	quint32 uiLost;
+
+	void account(quint64 now, int len);
+	void refill(quint64 now);
+	double burst() const;
+};
+
+#endif
@@ -0,0 +1,239 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "HandshakePool.h"
+
+#include <QtCore/QStringList>
+#include <QtCore/QThread>
+#include <QtNetwork/QSslSocket>
+
+HandshakeWorker::HandshakeWorker(HandshakePool *pool, int timeout) : QObject(), hpPool(pool), iTimeout(timeout) {
+	qtTimeout = new QTimer(this);
+	connect(qtTimeout, SIGNAL(timeout()), this, SLOT(checkTimeout()));
+}
+
+HandshakeWorker::~HandshakeWorker() {
+	qDeleteAll(qhHandshakes.keys());
+}
+
+void HandshakeWorker::start(QSslSocket *sock, int server, const QString &peer) {
+	Handshake &hs = qhHandshakes[sock];
+	hs.iServer    = server;
+	hs.qsPeer     = peer;
+	hs.bVerified  = true;
+	hs.bEncrypted = false;
+	hs.tStarted.restart();
+
+	connect(sock, SIGNAL(sslErrors(const QList< QSslError > &)), this, SLOT(sslErrors(const QList< QSslError > &)));
+	connect(sock, SIGNAL(encrypted()), this, SLOT(encrypted()));
+	connect(sock, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(error(QAbstractSocket::SocketError)));
+	connect(sock, SIGNAL(disconnected()), this, SLOT(disconnected()));
+
+	sock->startServerEncryption();
+
+	// The timer has to be started from within the worker thread
+	if (!qtTimeout->isActive())
+		qtTimeout->start(1000);
+}
+
+void HandshakeWorker::sslErrors(const QList< QSslError > &errors) {
+	QSslSocket *sock = qobject_cast< QSslSocket * >(sender());
+	auto it          = qhHandshakes.find(sock);
+	if (it == qhHandshakes.end())
+		return;
+
+	QList< QSslError > fatal;
+	HandshakePool::classifySslErrors(errors, it->bVerified, fatal);
+
+	if (fatal.isEmpty()) {
+		sock->ignoreSslErrors();
+		return;
+	}
+
+	QStringList reasons;
+	foreach (const QSslError &e, fatal)
+		reasons << e.errorString();
+	it->qsReason = QString("SSL Error: %1").arg(reasons.join(QLatin1String(", ")));
+
+	// We are inside of the handshake here, so the socket must not be aborted (see Server::sslError).
+	sock->disconnectFromHost();
+}
+
+void HandshakeWorker::encrypted() {
+	QSslSocket *sock = qobject_cast< QSslSocket * >(sender());
+	auto it          = qhHandshakes.find(sock);
+	if (it == qhHandshakes.end())
+		return;
+
+	it->bEncrypted = true;
+
+	// Qt is still busy with the socket, so it is handed over once control returns to the event loop
+	QMetaObject::invokeMethod(this, "finish", Qt::QueuedConnection, Q_ARG(QSslSocket *, sock));
+}
+
+void HandshakeWorker::error(QAbstractSocket::SocketError) {
+	QSslSocket *sock = qobject_cast< QSslSocket * >(sender());
+	auto it          = qhHandshakes.constFind(sock);
+	if (it == qhHandshakes.constEnd() || it->bEncrypted)
+		return;
+
+	// See Server::connectionClosed
+	if (sock->errorString().contains(QLatin1String("140E0197")))
+		return;
+
+	fail(sock, it->qsReason.isEmpty() ? sock->errorString() : it->qsReason);
+}
+
+void HandshakeWorker::disconnected() {
+	QSslSocket *sock = qobject_cast< QSslSocket * >(sender());
+	auto it          = qhHandshakes.constFind(sock);
+	if (it == qhHandshakes.constEnd() || it->bEncrypted)
+		return;
+
+	fail(sock, it->qsReason.isEmpty() ? QString("Connection closed") : it->qsReason);
+}
+
+void HandshakeWorker::finish(QSslSocket *sock) {
+	auto it = qhHandshakes.find(sock);
+	if (it == qhHandshakes.end())
+		return;
+
+	if (sock->state() != QAbstractSocket::ConnectedState) {
+		fail(sock, QString("Connection closed"));
+		return;
+	}
+
+	const Handshake hs = *it;
+	qhHandshakes.erase(it);
+
+	disconnect(sock, nullptr, this, nullptr);
+	sock->moveToThread(hpPool->thread());
+
+	hpPool->recordCompleted(hs.tStarted.elapsed());
+	emit hpPool->encrypted(sock, hs.iServer, hs.bVerified);
+}
+
+void HandshakeWorker::fail(QSslSocket *sock, const QString &reason) {
+	const Handshake hs = qhHandshakes.take(sock);
+
+	disconnect(sock, nullptr, this, nullptr);
+	// This may be called from within the handshake, so the socket can't be deleted right away
+	sock->deleteLater();
+
+	hpPool->iPending--;
+	hpPool->uiFailed++;
+	emit hpPool->failed(hs.iServer, hs.qsPeer, reason);
+}
+
+void HandshakeWorker::checkTimeout() {
+	QList< QSslSocket * > expired;
+
+	for (auto it = qhHandshakes.constBegin(); it != qhHandshakes.constEnd(); ++it) {
+		if (!it->bEncrypted && it->tStarted.elapsed() > iTimeout * 1000000ULL)
+			expired << it.key();
+	}
+
+	foreach (QSslSocket *sock, expired)
+		fail(sock, QString("Handshake timed out"));
+
+	if (qhHandshakes.isEmpty())
+		qtTimeout->stop();
+}
+
+HandshakePool::HandshakePool(int threads, int timeout, int statsInterval, QObject *p)
+	: QObject(p), iNextWorker(0), iPending(0), uiCompleted(0), uiFailed(0), uiTotalUsec(0), uiMaxUsec(0) {
+	qRegisterMetaType< QSslSocket * >();
+
+	if (threads <= 0)
+		threads = qMax(1, QThread::idealThreadCount());
+
+	for (int i = 0; i < threads; ++i) {
+		QThread *thread = new QThread(this);
+		thread->setObjectName(QString::fromLatin1("Handshake %1").arg(i));
+
+		HandshakeWorker *worker = new HandshakeWorker(this, timeout);
+		worker->moveToThread(thread);
+		thread->start();
+
+		qlThreads << thread;
+		qlWorkers << worker;
+	}
+
+	if (statsInterval > 0) {
+		connect(&qtStatistics, &QTimer::timeout, this, &HandshakePool::logStatistics);
+		qtStatistics.start(statsInterval * 1000);
+	}
+}
+
+HandshakePool::~HandshakePool() {
+	foreach (QThread *thread, qlThreads) {
+		thread->quit();
+		thread->wait();
+	}
+
+	qDeleteAll(qlWorkers);
+}
+
+void HandshakePool::handshake(QSslSocket *sock, int server, const QString &peer) {
+	HandshakeWorker *worker = qlWorkers.at(iNextWorker);
+	iNextWorker             = (iNextWorker + 1) % qlWorkers.size();
+
+	iPending++;
+
+	sock->setParent(nullptr);
+	sock->moveToThread(worker->thread());
+
+	QMetaObject::invokeMethod(worker, "start", Qt::QueuedConnection, Q_ARG(QSslSocket *, sock), Q_ARG(int, server),
+							  Q_ARG(QString, peer));
+}
+
+void HandshakePool::recordCompleted(quint64 usec) {
+	iPending--;
+	uiCompleted++;
+	uiTotalUsec += usec;
+
+	quint64 max = uiMaxUsec.load();
+	while (usec > max && !uiMaxUsec.compare_exchange_weak(max, usec)) {
+	}
+}
+
+void HandshakePool::classifySslErrors(const QList< QSslError > &errors, bool &verified, QList< QSslError > &fatal) {
+	foreach (const QSslError &e, errors) {
+		switch (e.error()) {
+			case QSslError::InvalidPurpose:
+				// Allow email certificates.
+				break;
+			case QSslError::NoPeerCertificate:
+			case QSslError::SelfSignedCertificate:
+			case QSslError::SelfSignedCertificateInChain:
+			case QSslError::UnableToGetLocalIssuerCertificate:
+			case QSslError::UnableToVerifyFirstCertificate:
+			case QSslError::HostNameMismatch:
+			case QSslError::CertificateNotYetValid:
+			case QSslError::CertificateExpired:
+				verified = false;
+				break;
+			default:
+				fatal << e;
+		}
+	}
+}
+
+void HandshakePool::logStatistics() {
+	const double seconds    = static_cast< double >(tStatistics.restart()) / 1000000.0;
+	const quint64 completed = uiCompleted.exchange(0);
+	const quint64 failed    = uiFailed.exchange(0);
+	const quint64 totalUsec = uiTotalUsec.exchange(0);
+	const quint64 maxUsec   = uiMaxUsec.exchange(0);
+
+	if (completed == 0 && failed == 0)
+		return;
+
+	qWarning("HandshakePool: %llu handshakes completed in %.0f s (%.1f/s, %.1f ms avg, %.1f ms max), %llu failed, "
+			 "%d in progress",
+			 static_cast< unsigned long long >(completed), seconds, static_cast< double >(completed) / seconds,
+			 completed ? static_cast< double >(totalUsec) / 1000.0 / static_cast< double >(completed) : 0.0,
+			 static_cast< double >(maxUsec) / 1000.0, static_cast< unsigned long long >(failed), iPending.load());
+}
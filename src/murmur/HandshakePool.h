@@ -0,0 +1,134 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_HANDSHAKEPOOL_H_
+#define MUMBLE_MURMUR_HANDSHAKEPOOL_H_
+
+#include "Timer.h"
+
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QObject>
+#include <QtCore/QTimer>
+#include <QtNetwork/QAbstractSocket>
+#include <QtNetwork/QSslError>
+
+#include <atomic>
+
+class HandshakePool;
+class QSslSocket;
+class QThread;
+
+/// Performs the TLS handshakes assigned to one of the threads of a HandshakePool.
+class HandshakeWorker : public QObject {
+private:
+	Q_OBJECT;
+	Q_DISABLE_COPY(HandshakeWorker);
+
+protected:
+	struct Handshake {
+		int iServer;
+		QString qsPeer;
+		bool bVerified;
+		bool bEncrypted;
+		QString qsReason;
+		Timer tStarted;
+	};
+
+	HandshakePool *hpPool;
+	QHash< QSslSocket *, Handshake > qhHandshakes;
+	QTimer *qtTimeout;
+	int iTimeout;
+
+	void fail(QSslSocket *sock, const QString &reason);
+
+public:
+	HandshakeWorker(HandshakePool *pool, int timeout);
+	~HandshakeWorker() Q_DECL_OVERRIDE;
+
+public slots:
+	void start(QSslSocket *sock, int server, const QString &peer);
+
+protected slots:
+	void sslErrors(const QList< QSslError > &errors);
+	void encrypted();
+	void error(QAbstractSocket::SocketError err);
+	void disconnected();
+	void finish(QSslSocket *sock);
+	void checkTimeout();
+};
+
+/// Runs the TLS handshakes of incoming connections.
+///
+/// A full handshake takes up about a millisecond of CPU time. When thousands of clients reconnect at once (e.g. after
+/// a restart of Murmur), doing them on the main thread would stall everything else for quite a while. The pool spreads
+/// the handshakes over a set of worker threads instead. Once a handshake has completed, the socket is moved back to
+/// the main thread and handed over via encrypted().
+class HandshakePool : public QObject {
+	friend class HandshakeWorker;
+
+private:
+	Q_OBJECT;
+	Q_DISABLE_COPY(HandshakePool);
+
+protected:
+	QList< QThread * > qlThreads;
+	QList< HandshakeWorker * > qlWorkers;
+	int iNextWorker;
+
+	QTimer qtStatistics;
+	Timer tStatistics;
+
+	std::atomic< int > iPending;
+	std::atomic< quint64 > uiCompleted;
+	std::atomic< quint64 > uiFailed;
+	/// The time spent on completed handshakes, in microseconds
+	std::atomic< quint64 > uiTotalUsec;
+	std::atomic< quint64 > uiMaxUsec;
+
+	void recordCompleted(quint64 usec);
+
+public:
+	/// @param threads The amount of worker threads. If 0, one thread per CPU core is used.
+	/// @param timeout The time a client may take to complete the handshake, in seconds
+	/// @param statsInterval The interval in which statistics about the handshakes are written to the log, in
+	/// 	seconds. If 0, no statistics are written.
+	HandshakePool(int threads, int timeout, int statsInterval, QObject *p = nullptr);
+	~HandshakePool() Q_DECL_OVERRIDE;
+
+	/// Starts the server side of the handshake on the given socket. The socket must have been set up with the
+	/// server's TLS configuration already and must not have a parent, as it is moved to one of the worker threads.
+	///
+	/// @param sock The socket of the new connection
+	/// @param server The number of the virtual server the connection belongs to
+	/// @param peer The address of the client, used for logging
+	void handshake(QSslSocket *sock, int server, const QString &peer);
+
+	/// Sorts the errors that occurred while verifying a client's certificate.
+	///
+	/// @param errors The errors to sort
+	/// @param[out] verified Set to false if an error means that the client's certificate can't be trusted
+	/// @param[out] fatal The errors that rule out the connection
+	static void classifySslErrors(const QList< QSslError > &errors, bool &verified, QList< QSslError > &fatal);
+
+signals:
+	/// The handshake on the given socket has completed. The socket has been moved to the main thread.
+	///
+	/// @param sock The socket of the connection. The receiver takes ownership of it.
+	/// @param server The number of the virtual server the connection belongs to
+	/// @param verified Whether the client's certificate could be verified
+	void encrypted(QSslSocket *sock, int server, bool verified);
+	/// The handshake on a socket has failed. The socket has already been deleted.
+	///
+	/// @param server The number of the virtual server the connection belonged to
+	/// @param peer The address of the client
+	/// @param reason Why the handshake failed
+	void failed(int server, const QString &peer, const QString &reason);
+
+protected slots:
+	void logStatistics();
+};
+
+#endif
@@ -17,6 +17,7 @@
 #include "Version.h"
 #include "crypto/CryptState.h"
 
+#include <QtCore/QBitArray>
 #include <QtCore/QStack>
 #include <QtCore/QtEndian>
 
@@ -187,6 +188,7 @@ void Server::msgAuthenticate(ServerUser *uSource, MumbleProto::Authenticate &msg
 		qhUsers.insert(uSource->uiSession, uSource);
 		qhHostUsers[uSource->haAddress].insert(uSource);
 	}
+	armTimeout(uSource);
 
 	Channel *root = qhChannels.value(0);
 	Channel *c;
@@ -1354,15 +1356,39 @@ void Server::msgChannelRemove(ServerUser *uSource, MumbleProto::ChannelRemove &m
 
 void Server::msgTextMessage(ServerUser *uSource, MumbleProto::TextMessage &msg) {
 	MSG_SETUP(ServerUser::Authenticated);
-	QMutexLocker qml(&qmCache);
 
 	// For signal userTextMessage (RPC consumers)
 	TextMessage tm;
 
-	// List of users to route the message to
-	QSet< ServerUser * > users;
+	// List of users to route the message to. Duplicates are filtered out using a bitmap
+	// indexed by session ID, which is a lot cheaper than hashing every recipient.
+	QVector< ServerUser * > users;
+	QBitArray seenSessions;
 	// List of channels used if dest is a tree of channels
-	QQueue< Channel * > q;
+	QStack< Channel * > channelStack;
+
+	auto addRecipient = [&users, &seenSessions](ServerUser *u) {
+		const int session = static_cast< int >(u->uiSession);
+		if (session >= seenSessions.size()) {
+			seenSessions.resize(qMax(session + 1, seenSessions.size() * 2));
+		}
+		if (!seenSessions.testBit(session)) {
+			seenSessions.setBit(session);
+			users.append(u);
+		}
+	};
+	auto addChannelRecipients = [&](const Channel *c) {
+		// Users directly in that channel
+		foreach (User *p, c->qlUsers) { addRecipient(static_cast< ServerUser * >(p)); }
+
+		// Users only listening in that channel
+		foreach (unsigned int session, m_channelListenerManager.getListenersForChannel(c->iId)) {
+			ServerUser *currentUser = qhUsers.value(session);
+			if (currentUser) {
+				addRecipient(currentUser);
+			}
+		}
+	};
 
 	RATELIMIT(uSource);
 
@@ -1409,6 +1435,10 @@ void Server::msgTextMessage(ServerUser *uSource, MumbleProto::TextMessage &msg)
 
 	msg.set_actor(uSource->uiSession);
 
+	// The ACL cache only needs to be locked while collecting the recipients. Filtering the text
+	// (above) and sending the message (below) are done without holding it.
+	QMutexLocker qml(&qmCache);
+
 	// Send the message to all users that are in (= have joined) OR are
 	// "listening" to channels to which the message has been directed to
 	for (int i = 0; i < msg.channel_id_size(); ++i) {
@@ -1424,22 +1454,13 @@ void Server::msgTextMessage(ServerUser *uSource, MumbleProto::TextMessage &msg)
 			return;
 		}
 
-		// Users directly in that channel
-		foreach (User *p, c->qlUsers) { users.insert(static_cast< ServerUser * >(p)); }
-
-		// Users only listening in that channel
-		foreach (unsigned int session, m_channelListenerManager.getListenersForChannel(c->iId)) {
-			ServerUser *currentUser = qhUsers.value(session);
-			if (currentUser) {
-				users.insert(currentUser);
-			}
-		}
+		addChannelRecipients(c);
 
 		tm.qlChannels.append(id);
 	}
 
 	// If the message is sent to trees of channels, find all affected channels
-	// and append them to q
+	// and push them onto channelStack
 	for (int i = 0; i < msg.tree_id_size(); ++i) {
 		unsigned int id = msg.tree_id(i);
 
@@ -1453,27 +1474,20 @@ void Server::msgTextMessage(ServerUser *uSource, MumbleProto::TextMessage &msg)
 			return;
 		}
 
-		q.enqueue(c);
+		channelStack.push(c);
 
 		tm.qlTrees.append(id);
 	}
 
-	// Go through all channels in q and append all users in those channels
-	// to the list of recipients
-	// Sub-channels are enqued so they are also checked by a later loop-iteration
-	while (!q.isEmpty()) {
-		Channel *c = q.dequeue();
+	// Go through all channels on the stack and add all users in those channels
+	// to the list of recipients. Sub-channels are pushed as well, unless the sender
+	// lacks the permission to write to their parent, in which case the whole subtree is skipped.
+	while (!channelStack.isEmpty()) {
+		Channel *c = channelStack.pop();
 		if (ChanACL::hasPermission(uSource, c, ChanACL::TextMessage, &acCache)) {
-			foreach (Channel *sub, c->qlChannels) { q.enqueue(sub); }
-			// Users directly in that channel
-			foreach (User *p, c->qlUsers) { users.insert(static_cast< ServerUser * >(p)); }
-			// Users only listening in that channel
-			foreach (unsigned int session, m_channelListenerManager.getListenersForChannel(c->iId)) {
-				ServerUser *currentUser = qhUsers.value(session);
-				if (currentUser) {
-					users.insert(currentUser);
-				}
-			}
+			foreach (Channel *sub, c->qlChannels) { channelStack.push(sub); }
+
+			addChannelRecipients(c);
 		}
 	}
 
@@ -1486,17 +1500,22 @@ void Server::msgTextMessage(ServerUser *uSource, MumbleProto::TextMessage &msg)
 				PERM_DENIED(uSource, u->cChannel, ChanACL::TextMessage);
 				return;
 			}
-			users.insert(u);
+			addRecipient(u);
 		}
 
 		tm.qlSessions.append(session);
 	}
 
-	// Remove the message sender from the list of users to send the message to
-	users.remove(uSource);
+	qml.unlock();
 
-	// Actually send the original message to the affected users
-	foreach (ServerUser *u, users) { sendMessage(u, msg); }
+	// Actually send the original message to the affected users (except for the sender).
+	// The message is serialized only once and the result is shared by all recipients.
+	QByteArray cache;
+	for (ServerUser *u : users) {
+		if (u != uSource) {
+			u->sendMessage(msg, MessageHandler::TextMessage, cache);
+		}
+	}
 
 	// Emit the signal for RPC consumers
 	emit userTextMessage(uSource, tm);
@@ -1803,6 +1822,12 @@ void Server::msgQueryUsers(ServerUser *uSource, MumbleProto::QueryUsers &msg) {
 void Server::msgPing(ServerUser *uSource, MumbleProto::Ping &msg) {
 	MSG_SETUP_NO_UNIDLE(ServerUser::Authenticated);
 
+	if (bEgressPacing) {
+		// The client's statistics tell how many of the packets we sent it got lost on the way
+		QMutexLocker l(&uSource->qmEgress);
+		uSource->epEgress.report(tUptime.elapsed(), msg.good(), msg.late(), msg.lost());
+	}
+
 	QMutexLocker l(&uSource->qmCrypt);
 
 	uSource->csCrypt->uiRemoteGood   = msg.good();
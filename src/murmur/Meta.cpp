@@ -8,14 +8,23 @@
 #include "Connection.h"
 #include "EnvUtils.h"
 #include "FFDHE.h"
+#include "HandshakePool.h"
+#include "Metrics.h"
 #include "Net.h"
 #include "OSInfo.h"
 #include "SSL.h"
 #include "Server.h"
 #include "ServerDB.h"
+#include "Supervisor.h"
 #include "Version.h"
 
+#ifdef USE_MIXER
+#	include "Mixer.h"
+#endif
+
 #include <QtCore/QCoreApplication>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
 #include <QtCore/QSettings>
 
 #ifdef Q_OS_WIN
@@ -56,6 +65,11 @@ MetaParams::MetaParams() {
 	iMaxBandwidth              = 558000;
 	iMaxUsers                  = 1000;
 	iMaxUsersPerChannel        = 0;
+	iMaxSpeakersPerChannel     = 0;
+	iMixChannelSize            = 0;
+	iMixerThreads              = 1;
+	iMixerBudget               = 50;
+	bEgressPacing              = false;
 	iMaxListenersPerChannel    = -1;
 	iMaxListenerProxiesPerUser = -1;
 	iMaxTextMessageLength      = 5000;
@@ -70,7 +84,12 @@ MetaParams::MetaParams() {
 	qsWelcomeTextFile          = QString();
 	qsDatabase                 = QString();
 	iSQLiteWAL                 = 0;
+	iWorkers                   = 0;
+	iWorkerIndex               = -1;
 	iDBPort                    = 0;
+	iDBStatsInterval           = 0;
+	iSSLHandshakeThreads       = 0;
+	iSSLStatsInterval          = 0;
 	qsDBusService              = "net.sourceforge.mumble.murmur";
 	qsDBDriver                 = "QSQLITE";
 	qsLogfile                  = "murmur.log";
@@ -310,6 +329,11 @@ void MetaParams::read(QString fname) {
 	iRememberChanDuration      = typeCheckedFromSettings("rememberchannelduration", iRememberChanDuration);
 	iMaxUsers                  = typeCheckedFromSettings("users", iMaxUsers);
 	iMaxUsersPerChannel        = typeCheckedFromSettings("usersperchannel", iMaxUsersPerChannel);
+	iMaxSpeakersPerChannel     = typeCheckedFromSettings("speakersperchannel", iMaxSpeakersPerChannel);
+	iMixChannelSize            = typeCheckedFromSettings("mixchannelsize", iMixChannelSize);
+	iMixerThreads              = typeCheckedFromSettings("mixerthreads", iMixerThreads);
+	iMixerBudget               = typeCheckedFromSettings("mixerbudget", iMixerBudget);
+	bEgressPacing              = typeCheckedFromSettings("egresspacing", bEgressPacing);
 	iMaxListenersPerChannel    = typeCheckedFromSettings("listenersperchannel", iMaxListenersPerChannel);
 	iMaxListenerProxiesPerUser = typeCheckedFromSettings("listenersperuser", iMaxListenerProxiesPerUser);
 	qsWelcomeText              = typeCheckedFromSettings("welcometext", qsWelcomeText);
@@ -328,6 +352,11 @@ void MetaParams::read(QString fname) {
 	qsDBOpts     = typeCheckedFromSettings("dbOpts", qsDBOpts);
 	iDBPort      = typeCheckedFromSettings("dbPort", iDBPort);
 
+	iDBStatsInterval = typeCheckedFromSettings("dbStatsInterval", iDBStatsInterval);
+
+	iSSLHandshakeThreads = typeCheckedFromSettings("sslHandshakeThreads", iSSLHandshakeThreads);
+	iSSLStatsInterval    = typeCheckedFromSettings("sslStatsInterval", iSSLStatsInterval);
+
 	qsIceEndpoint    = typeCheckedFromSettings("ice", qsIceEndpoint);
 	qsIceSecretRead  = typeCheckedFromSettings("icesecret", qsIceSecretRead);
 	qsIceSecretRead  = typeCheckedFromSettings("icesecretread", qsIceSecretRead);
@@ -338,12 +367,17 @@ void MetaParams::read(QString fname) {
 	qsGRPCKey        = typeCheckedFromSettings("grpckey", qsGRPCKey);
 	qsGRPCAuthorized = typeCheckedFromSettings("grpcauthorized", qsGRPCAuthorized);
 
+	qsMetricsAddress = typeCheckedFromSettings("metrics", qsMetricsAddress);
+
 	iLogDays = typeCheckedFromSettings("logdays", iLogDays);
 
 	qsDBus        = typeCheckedFromSettings("dbus", qsDBus);
 	qsDBusService = typeCheckedFromSettings("dbusservice", qsDBusService);
 	qsLogfile     = typeCheckedFromSettings("logfile", qsLogfile);
 	qsPid         = typeCheckedFromSettings("pidfile", qsPid);
+	qsSnapshotDir = typeCheckedFromSettings("snapshotdir", qsSnapshotDir);
+	iWorkers      = typeCheckedFromSettings("workers", iWorkers);
+	qsWorkerCPUs  = typeCheckedFromSettings("workercpus", qsWorkerCPUs);
 
 	qsRegName     = typeCheckedFromSettings("registerName", qsRegName);
 	qsRegPassword = typeCheckedFromSettings("registerPassword", qsRegPassword);
@@ -685,6 +719,28 @@ Meta::Meta() {
 			Connection::setQoS(hQoS);
 	}
 #endif
+
+	hpHandshakes = new HandshakePool(mp.iSSLHandshakeThreads, mp.iTimeout, mp.iSSLStatsInterval, this);
+	connect(hpHandshakes, &HandshakePool::encrypted, this, &Meta::handshakeEncrypted);
+	connect(hpHandshakes, &HandshakePool::failed, this, &Meta::handshakeFailed);
+
+	connect(&qtAttempts, &QTimer::timeout, this, &Meta::expireAttempts);
+
+	bWarmBoot = false;
+
+	msMetrics = nullptr;
+	if (!mp.qsMetricsAddress.isEmpty())
+		msMetrics = new MetricsServer(mp.qsMetricsAddress, this);
+
+#ifdef USE_MIXER
+	// Mixing can be enabled for single virtual servers, so the threads are always started. They only run while there
+	// is something to mix.
+	mpMixer = new MixerPool(mp.iMixerThreads, mp.iMixerBudget, this);
+	if (!mpMixer->isValid()) {
+		delete mpMixer;
+		mpMixer = nullptr;
+	}
+#endif
 }
 
 Meta::~Meta() {
@@ -711,12 +767,73 @@ bool Meta::reloadSSLSettings() {
 			s->initializeCert();
 		} else {
 			s->log("Not reloading certificates; server does not use Meta certificate");
+			// The CA certificates and ciphers might have changed nevertheless
+			s->initializeTlsConfiguration();
 		}
 	}
 
 	return true;
 }
 
+void Meta::expireAttempts() {
+	foreach (const QHostAddress &addr, twAttempts.advance()) {
+		bool tracked      = false;
+		quint64 remaining = 0;
+
+		auto ban = qhBans.find(addr);
+		if (ban != qhBans.end()) {
+			const quint64 elapsed = ban->elapsed();
+			if (elapsed >= 1000000ULL * mp.iBanTime) {
+				qhBans.erase(ban);
+			} else {
+				tracked   = true;
+				remaining = 1000000ULL * mp.iBanTime - elapsed;
+			}
+		}
+
+		auto attempts = qhAttempts.find(addr);
+		if (attempts != qhAttempts.end()) {
+			QList< Timer > &ql = *attempts;
+			while (!ql.isEmpty() && (ql.at(0).elapsed() > (1000000ULL * mp.iBanTimeframe)))
+				ql.removeFirst();
+
+			if (ql.isEmpty()) {
+				qhAttempts.erase(attempts);
+			} else {
+				const quint64 elapsed = ql.at(0).elapsed();
+				const quint64 window  = 1000000ULL * mp.iBanTimeframe;
+
+				tracked   = true;
+				remaining = qMax(remaining, elapsed < window ? window - elapsed : 0);
+			}
+		}
+
+		if (tracked)
+			twAttempts.schedule(addr, remaining / 1000000ULL + 1);
+	}
+
+	if (twAttempts.count() == 0)
+		qtAttempts.stop();
+}
+
+void Meta::handshakeEncrypted(QSslSocket *sock, int server, bool verified) {
+	Server *s = qhServers.value(server);
+	if (!s) {
+		// The server has been stopped in the meantime
+		sock->disconnectFromHost();
+		sock->deleteLater();
+		return;
+	}
+
+	s->acceptClient(sock, verified);
+}
+
+void Meta::handshakeFailed(int server, const QString &peer, const QString &reason) {
+	Server *s = qhServers.value(server);
+	if (s)
+		s->log(QString("TLS handshake with %1 failed: %2").arg(peer, reason));
+}
+
 void Meta::getOSInfo() {
 	qsOS        = OSInfo::getOS();
 	qsOSVersion = OSInfo::getOSDisplayableVersion();
@@ -724,13 +841,27 @@ void Meta::getOSInfo() {
 
 void Meta::bootAll() {
 	QList< int > ql = ServerDB::getBootServers();
+
+	bWarmBoot = !mp.qsSnapshotDir.isEmpty();
 	foreach (int snum, ql)
 		boot(snum);
+	bWarmBoot = false;
+
+	// The snapshots of servers that haven't been booted would be outdated by the time they are
+	if (!mp.qsSnapshotDir.isEmpty()) {
+		// Only touch our own servers' snapshots, the other workers may not have booted theirs yet
+		foreach (int snum, ServerDB::getAllServers()) {
+			if (Supervisor::owns(snum) && !qhServers.contains(snum))
+				QFile::remove(Server::snapshotPath(snum));
+		}
+	}
 }
 
 bool Meta::boot(int srvnum) {
 	if (qhServers.contains(srvnum))
 		return false;
+	if (!Supervisor::owns(srvnum))
+		return false;
 	if (!ServerDB::serverExists(srvnum))
 		return false;
 	Server *s = new Server(srvnum, this);
@@ -784,6 +915,8 @@ void Meta::kill(int srvnum) {
 
 void Meta::killAll() {
 	foreach (Server *s, qhServers) {
+		if (!mp.qsSnapshotDir.isEmpty())
+			s->saveSnapshot();
 		emit stopped(s);
 		delete s;
 	}
@@ -792,7 +925,12 @@ void Meta::killAll() {
 
 void Meta::successfulConnectionFrom(const QHostAddress &addr) {
 	if (!mp.bBanSuccessful) {
-		QList< Timer > &ql = qhAttempts[addr];
+		// Addresses that aren't tracked must not be added here, as they'd never be removed again
+		auto it = qhAttempts.find(addr);
+		if (it == qhAttempts.end())
+			return;
+
+		QList< Timer > &ql = *it;
 		// Seems like this is the most efficient way to clear the list, given:
 		// 1. ql.clear() allocates a new array
 		// 2. ql has less than iBanAttempts members
@@ -807,11 +945,15 @@ bool Meta::banCheck(const QHostAddress &addr) {
 	if ((mp.iBanTries <= 0) || (mp.iBanTimeframe <= 0))
 		return false;
 
-	if (qhBans.contains(addr)) {
-		Timer t = qhBans.value(addr);
-		if (t.elapsed() < (1000000ULL * mp.iBanTime))
-			return true;
-		qhBans.remove(addr);
+	// Expired bans are removed by expireAttempts()
+	const bool tracked = qhBans.contains(addr);
+	if (tracked && qhBans.value(addr).elapsed() < (1000000ULL * mp.iBanTime))
+		return true;
+
+	if (!tracked && !qhAttempts.contains(addr)) {
+		twAttempts.schedule(addr, static_cast< quint64 >(mp.iBanTimeframe) + 1);
+		if (!qtAttempts.isActive())
+			qtAttempts.start(1000);
 	}
 
 	QList< Timer > &ql = qhAttempts[addr];
@@ -7,6 +7,7 @@
 #define MUMBLE_MURMUR_META_H_
 
 #include "Timer.h"
+#include "TimerWheel.h"
 
 #ifdef Q_OS_WIN
 #	include "win.h"
@@ -14,6 +15,7 @@
 
 #include <QtCore/QDir>
 #include <QtCore/QList>
+#include <QtCore/QTimer>
 #include <QtCore/QUrl>
 #include <QtCore/QVariant>
 #include <QtNetwork/QHostAddress>
@@ -21,8 +23,12 @@
 #include <QtNetwork/QSslCipher>
 #include <QtNetwork/QSslKey>
 
+class HandshakePool;
+class MetricsServer;
+class MixerPool;
 class Server;
 class QSettings;
+class QSslSocket;
 
 class MetaParams {
 public:
@@ -34,6 +40,17 @@ public:
 	int iMaxBandwidth;
 	int iMaxUsers;
 	int iMaxUsersPerChannel;
+	/// The amount of users whose speech is forwarded to a channel at the same time (0 for no limit)
+	int iMaxSpeakersPerChannel;
+	/// The amount of users from which on a channel's audio is mixed on the server (0 to never mix)
+	int iMixChannelSize;
+	/// The amount of threads channels are mixed on
+	int iMixerThreads;
+	/// The share of the time of an audio frame a mixer thread may spend mixing, in percent
+	int iMixerBudget;
+	/// Whether voice packets are paced for users whose downstream is congested, and speakers are asked to lower
+	/// their bitrate for them
+	bool bEgressPacing;
 	int iMaxListenersPerChannel;
 	int iMaxListenerProxiesPerUser;
 	int iDefaultChan;
@@ -72,6 +89,14 @@ public:
 	QString qsDBPrefix;
 	QString qsDBOpts;
 	int iDBPort;
+	/// Interval (in seconds) in which the latency statistics of database queries are written
+	/// to the log. Zero disables collecting these statistics.
+	int iDBStatsInterval;
+	/// The amount of threads TLS handshakes with new clients are performed on. Zero means one thread per CPU core.
+	int iSSLHandshakeThreads;
+	/// Interval (in seconds) in which statistics about the TLS handshakes are written to the log.
+	/// Zero disables them.
+	int iSSLStatsInterval;
 
 	int iLogDays;
 
@@ -83,6 +108,14 @@ public:
 	QString qsDBusService;
 	QString qsLogfile;
 	QString qsPid;
+	/// The directory snapshots of the servers are written to on shutdown, see Server::saveSnapshot()
+	QString qsSnapshotDir;
+	/// The amount of worker processes the servers are spread over (0 to host them all in this process), see Supervisor
+	int iWorkers;
+	/// The CPUs each worker is pinned to, separated by semicolons
+	QString qsWorkerCPUs;
+	/// The worker this process is, or -1 if it isn't a worker. Set from the command line.
+	int iWorkerIndex;
 	QString qsIceEndpoint;
 	QString qsIceSecretRead, qsIceSecretWrite;
 
@@ -91,6 +124,9 @@ public:
 	QString qsGRPCKey;
 	QString qsGRPCAuthorized;
 
+	/// The address ("host:port") the metrics are served on through HTTP. Empty if they aren't served.
+	QString qsMetricsAddress;
+
 	QString qsRegName;
 	QString qsRegPassword;
 	QString qsRegHost;
@@ -180,8 +216,19 @@ public:
 	QHash< int, Server * > qhServers;
 	QHash< QHostAddress, QList< Timer > > qhAttempts;
 	QHash< QHostAddress, Timer > qhBans;
+	/// Holds a single entry for every address in qhAttempts or qhBans, which fires once the address'
+	/// oldest attempt or its ban may have expired. Advanced once a second by qtAttempts.
+	TimerWheel< QHostAddress > twAttempts;
+	QTimer qtAttempts;
 	QString qsOS, qsOSVersion;
 	Timer tUptime;
+	HandshakePool *hpHandshakes;
+	MetricsServer *msMetrics;
+	/// Whether servers may restore their state from a snapshot when they are booted. Only set by bootAll().
+	bool bWarmBoot;
+#ifdef USE_MIXER
+	MixerPool *mpMixer;
+#endif
 
 #ifdef Q_OS_WIN
 	static HANDLE hQoS;
@@ -211,6 +258,11 @@ public:
 signals:
 	void started(Server *);
 	void stopped(Server *);
+
+protected slots:
+	void handshakeEncrypted(QSslSocket *sock, int server, bool verified);
+	void handshakeFailed(int server, const QString &peer, const QString &reason);
+	void expireAttempts();
 };
 
 extern Meta *meta;
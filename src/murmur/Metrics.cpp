@@ -0,0 +1,230 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "Metrics.h"
+
+#include "Meta.h"
+#include "Server.h"
+#include "ServerUser.h"
+
+#include <QtCore/QTimer>
+#include <QtCore/QUrl>
+#include <QtCore/QtAlgorithms>
+#include <QtNetwork/QTcpServer>
+#include <QtNetwork/QTcpSocket>
+
+#include <algorithm>
+
+MetricsCounter::MetricsCounter() {
+	for (Shard &s : qaShards)
+		s.uiValue = 0;
+}
+
+quint64 MetricsCounter::value() const {
+	quint64 sum = 0;
+	for (const Shard &s : qaShards)
+		sum += s.uiValue.load(std::memory_order_relaxed);
+	return sum;
+}
+
+int MetricsCounter::shard() {
+	static std::atomic< int > next(0);
+	static thread_local int index = next++ % SHARDS;
+	return index;
+}
+
+MetricsServer::MetricsServer(const QString &address, QObject *p) : QObject(p) {
+	const QUrl url(QLatin1String("http://") + address);
+	const QHostAddress host(url.host());
+
+	qtsServer = new QTcpServer(this);
+	connect(qtsServer, SIGNAL(newConnection()), this, SLOT(newConnection()));
+
+	if (host.isNull() || url.port() <= 0) {
+		qWarning("MetricsServer: Invalid address %s", qPrintable(address));
+	} else if (!qtsServer->listen(host, static_cast< quint16 >(url.port()))) {
+		qWarning("MetricsServer: Failed to listen on %s: %s", qPrintable(address),
+				 qPrintable(qtsServer->errorString()));
+	} else {
+		qWarning("MetricsServer: Serving metrics on http://%s/metrics", qPrintable(address));
+	}
+}
+
+void MetricsServer::newConnection() {
+	while (QTcpSocket *sock = qtsServer->nextPendingConnection()) {
+		qhRequests.insert(sock, QByteArray());
+
+		connect(sock, SIGNAL(readyRead()), this, SLOT(readyRead()));
+		connect(sock, SIGNAL(disconnected()), this, SLOT(disconnected()));
+
+		// Don't let idle connections linger around
+		QTimer::singleShot(10000, sock, SLOT(abort()));
+	}
+}
+
+void MetricsServer::readyRead() {
+	QTcpSocket *sock = qobject_cast< QTcpSocket * >(sender());
+	auto it          = qhRequests.find(sock);
+	if (it == qhRequests.end())
+		return;
+
+	QByteArray &request = *it;
+	request.append(sock->readAll());
+
+	if (!request.contains("\r\n\r\n") && !request.contains("\n\n")) {
+		if (request.size() > MAX_REQUEST_SIZE)
+			sock->abort();
+		return;
+	}
+
+	const QList< QByteArray > line = request.left(request.indexOf('\n')).trimmed().split(' ');
+	qhRequests.erase(it);
+
+	if (line.count() != 3 || !line.at(2).startsWith("HTTP/")) {
+		reply(sock, "400 Bad Request", "text/plain", "Bad Request\n");
+	} else if (line.at(0) != "GET") {
+		reply(sock, "405 Method Not Allowed", "text/plain", "Method Not Allowed\n");
+	} else if (line.at(1) != "/metrics" && !line.at(1).startsWith("/metrics?")) {
+		reply(sock, "404 Not Found", "text/plain", "Not Found\n");
+	} else {
+		reply(sock, "200 OK", "application/openmetrics-text; version=1.0.0; charset=utf-8", exposition());
+	}
+}
+
+void MetricsServer::disconnected() {
+	QTcpSocket *sock = qobject_cast< QTcpSocket * >(sender());
+	qhRequests.remove(sock);
+	sock->deleteLater();
+}
+
+void MetricsServer::reply(QTcpSocket *sock, const QByteArray &status, const QByteArray &contentType,
+						  const QByteArray &body) {
+	QByteArray response;
+	response.reserve(body.size() + 128);
+	response.append("HTTP/1.1 ").append(status).append("\r\n");
+	response.append("Content-Type: ").append(contentType).append("\r\n");
+	response.append("Content-Length: ").append(QByteArray::number(body.size())).append("\r\n");
+	response.append("Connection: close\r\n\r\n");
+	response.append(body);
+
+	sock->write(response);
+	sock->disconnectFromHost();
+}
+
+static void family(QByteArray &out, const char *name, const char *type, const char *help) {
+	out.append("# TYPE ").append(name).append(' ').append(type).append('\n');
+	out.append("# HELP ").append(name).append(' ').append(help).append('\n');
+}
+
+static void sample(QByteArray &out, const QByteArray &name, const QByteArray &labels, const QByteArray &value) {
+	out.append(name);
+	if (!labels.isEmpty())
+		out.append('{').append(labels).append('}');
+	out.append(' ').append(value).append('\n');
+}
+
+static QByteArray serverLabel(const Server *s) {
+	return "server=\"" + QByteArray::number(s->iServerNum) + "\"";
+}
+
+QByteArray MetricsServer::exposition() {
+	QList< Server * > servers = meta->qhServers.values();
+	std::sort(servers.begin(), servers.end(),
+			  [](const Server *a, const Server *b) { return a->iServerNum < b->iServerNum; });
+
+	QByteArray out;
+
+	family(out, "murmur_uptime_seconds", "gauge", "Time since Murmur was started.");
+	sample(out, "murmur_uptime_seconds", QByteArray(), QByteArray::number(meta->tUptime.elapsed() / 1000000ULL));
+
+	family(out, "murmur_users", "gauge", "Users connected to a server.");
+	foreach (Server *s, servers)
+		sample(out, "murmur_users", serverLabel(s), QByteArray::number(s->qhUsers.count()));
+
+	// The bytes that are waiting to be written to the TCP connections of the users, as sum and maximum per server
+	QList< QPair< qint64, qint64 > > queues;
+	foreach (Server *s, servers) {
+		qint64 sum = 0;
+		qint64 max = 0;
+		foreach (ServerUser *u, s->qhUsers) {
+			qint64 queued = u->bytesToWrite();
+			{
+				QMutexLocker l(&u->qmTunnel);
+				queued += u->qbaTunnel.size();
+			}
+			sum += queued;
+			max = qMax(max, queued);
+		}
+		queues << qMakePair(sum, max);
+	}
+
+	family(out, "murmur_tcp_queue_bytes", "gauge", "Bytes waiting to be written to the TCP connections of a server.");
+	for (int i = 0; i < servers.count(); ++i)
+		sample(out, "murmur_tcp_queue_bytes", serverLabel(servers.at(i)), QByteArray::number(queues.at(i).first));
+
+	family(out, "murmur_tcp_queue_max_bytes", "gauge",
+		   "Bytes waiting to be written to the most backed up TCP connection of a server.");
+	for (int i = 0; i < servers.count(); ++i)
+		sample(out, "murmur_tcp_queue_max_bytes", serverLabel(servers.at(i)), QByteArray::number(queues.at(i).second));
+
+	const auto counter = [&](const char *name, const char *help, MetricsCounter ServerMetrics::*member) {
+		family(out, name, "counter", help);
+		foreach (Server *s, servers)
+			sample(out, QByteArray(name) + "_total", serverLabel(s),
+				   QByteArray::number((s->smMetrics.*member).value()));
+	};
+
+	counter("murmur_udp_packets_received", "UDP packets received by the voice thread.", &ServerMetrics::mcUdpReceived);
+	counter("murmur_udp_decrypt_failures", "UDP packets that could not be decrypted.",
+			&ServerMetrics::mcDecryptFailures);
+	counter("murmur_crypt_resyncs", "Crypt resyncs requested from clients.", &ServerMetrics::mcCryptResyncs);
+	counter("murmur_voice_packets_received", "Voice packets received from clients.", &ServerMetrics::mcVoiceReceived);
+	counter("murmur_voice_packets_suppressed", "Voice packets dropped because enough louder users were talking.",
+			&ServerMetrics::mcVoiceSuppressed);
+	counter("murmur_voice_packets_paced", "Voice packets delayed because the recipient's downstream is congested.",
+			&ServerMetrics::mcVoicePaced);
+	counter("murmur_voice_packets_paced_dropped", "Delayed voice packets dropped because too many were waiting.",
+			&ServerMetrics::mcVoicePacingDropped);
+
+	family(out, "murmur_udp_packets_sent", "counter",
+		   "Voice and ping packets sent to clients, either through UDP or tunneled through TCP.");
+	foreach (Server *s, servers) {
+		sample(out, "murmur_udp_packets_sent_total", serverLabel(s) + ",transport=\"udp\"",
+			   QByteArray::number(s->smMetrics.mcUdpSent.value()));
+		sample(out, "murmur_udp_packets_sent_total", serverLabel(s) + ",transport=\"tcp\"",
+			   QByteArray::number(s->smMetrics.mcTunnelSent.value()));
+	}
+
+	// Histograms are exported with a bucket for every power of two up to 2^maxExponent
+	const auto histogram = [&](const char *name, const char *help, MetricsHistogram ServerMetrics::*member,
+							   int maxExponent, double scale) {
+		family(out, name, "histogram", help);
+		foreach (Server *s, servers) {
+			const MetricsHistogram &h = s->smMetrics.*member;
+			// The histogram may be written to while it is exported, so the buckets are capped at the count
+			const quint64 count = h.count();
+
+			for (int e = 0; e <= maxExponent; ++e) {
+				const quint64 bound = Q_UINT64_C(1) << e;
+				sample(out, QByteArray(name) + "_bucket",
+					   serverLabel(s) + ",le=\"" + QByteArray::number(static_cast< double >(bound) * scale) + "\"",
+					   QByteArray::number(qMin(h.countAtMost(bound), count)));
+			}
+			sample(out, QByteArray(name) + "_bucket", serverLabel(s) + ",le=\"+Inf\"", QByteArray::number(count));
+			sample(out, QByteArray(name) + "_count", serverLabel(s), QByteArray::number(count));
+			sample(out, QByteArray(name) + "_sum", serverLabel(s),
+				   QByteArray::number(static_cast< double >(h.sum()) * scale));
+		}
+	};
+
+	histogram("murmur_voice_fanout", "Users a voice packet is sent to.", &ServerMetrics::mhFanout, 10, 1.0);
+	histogram("murmur_voice_processing_seconds", "Time it takes to route a voice packet.",
+			  &ServerMetrics::mhVoiceProcessing, 20, 0.000001);
+	histogram("murmur_voice_lock_wait_seconds", "Time the voice thread waits for the lock on the user list.",
+			  &ServerMetrics::mhVoiceLockWait, 20, 0.000001);
+
+	out.append("# EOF\n");
+	return out;
+}
@@ -0,0 +1,107 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_METRICS_H_
+#define MUMBLE_MURMUR_METRICS_H_
+
+#include "MetricsHistogram.h"
+
+#include <QtCore/QByteArray>
+#include <QtCore/QHash>
+#include <QtCore/QObject>
+
+#include <array>
+#include <atomic>
+
+class QTcpServer;
+class QTcpSocket;
+
+/// A counter that may be incremented by any thread.
+///
+/// The counter is split into shards, and every thread only ever increments the shard it has been assigned to. Each
+/// shard sits on a cache line of its own, so threads incrementing the same counter don't slow each other down.
+class MetricsCounter {
+private:
+	Q_DISABLE_COPY(MetricsCounter);
+
+public:
+	static const int SHARDS = 8;
+
+	MetricsCounter();
+
+	void add(quint64 n = 1) { qaShards[shard()].uiValue.fetch_add(n, std::memory_order_relaxed); }
+	/// @returns The sum of all shards
+	quint64 value() const;
+
+	/// @returns The shard the calling thread increments
+	static int shard();
+
+protected:
+	struct Shard {
+		std::atomic< quint64 > uiValue;
+		char cPadding[64 - sizeof(std::atomic< quint64 >)];
+	};
+
+	std::array< Shard, SHARDS > qaShards;
+};
+
+/// The metrics collected by a virtual server.
+struct ServerMetrics {
+	/// UDP packets received by the voice thread
+	MetricsCounter mcUdpReceived;
+	/// UDP packets that could not be decrypted
+	MetricsCounter mcDecryptFailures;
+	/// Crypt resyncs requested from clients after they failed to decrypt for too long
+	MetricsCounter mcCryptResyncs;
+	/// Voice packets received from clients, through UDP and TCP
+	MetricsCounter mcVoiceReceived;
+	/// Voice packets that were dropped because louder users were talking in the same channel (see SpeakerSelection)
+	MetricsCounter mcVoiceSuppressed;
+	/// Voice packets that had to wait because the recipient's downstream is congested (see EgressPacer)
+	MetricsCounter mcVoicePaced;
+	/// Paced voice packets that were dropped because too many were waiting
+	MetricsCounter mcVoicePacingDropped;
+	/// Voice and ping packets sent to clients through UDP
+	MetricsCounter mcUdpSent;
+	/// Voice and ping packets sent to clients through the TCP tunnel
+	MetricsCounter mcTunnelSent;
+
+	/// The amount of users a voice packet is sent to
+	MetricsHistogram mhFanout;
+	/// The time it takes to route a voice packet, in microseconds
+	MetricsHistogram mhVoiceProcessing;
+	/// The time the voice thread waits for the read lock on Server::qrwlVoiceThread, in microseconds
+	MetricsHistogram mhVoiceLockWait;
+};
+
+/// Serves the metrics of all servers in the OpenMetrics text format through HTTP.
+class MetricsServer : public QObject {
+private:
+	Q_OBJECT;
+	Q_DISABLE_COPY(MetricsServer);
+
+protected:
+	QTcpServer *qtsServer;
+	QHash< QTcpSocket *, QByteArray > qhRequests;
+
+	/// Requests may not be longer than this, in bytes
+	static const int MAX_REQUEST_SIZE = 8192;
+
+	void reply(QTcpSocket *sock, const QByteArray &status, const QByteArray &contentType, const QByteArray &body);
+
+public:
+	/// @param address The address to listen on, in the form "host:port"
+	MetricsServer(const QString &address, QObject *p = nullptr);
+
+	/// @returns The metrics of the whole process in the OpenMetrics text format. Has to be called from the main thread.
+	static QByteArray exposition();
+
+protected slots:
+	void newConnection();
+	void readyRead();
+	void disconnected();
+};
+
+#endif
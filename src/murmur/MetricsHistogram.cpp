@@ -0,0 +1,67 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "MetricsHistogram.h"
+
+MetricsHistogram::MetricsHistogram() : uiCount(0), uiSum(0) {
+	for (std::atomic< quint64 > &b : qaBuckets)
+		b = 0;
+}
+
+void MetricsHistogram::record(quint64 value) {
+	// The buckets are shifted by one, so that every power of two is the upper (inclusive) bound of a bucket and
+	// countAtMost() is exact for those.
+	qaBuckets[bucket(value > 0 ? value - 1 : 0)].fetch_add(1, std::memory_order_relaxed);
+	uiSum.fetch_add(value, std::memory_order_relaxed);
+	uiCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+quint64 MetricsHistogram::count() const {
+	return uiCount.load(std::memory_order_relaxed);
+}
+
+quint64 MetricsHistogram::sum() const {
+	return uiSum.load(std::memory_order_relaxed);
+}
+
+quint64 MetricsHistogram::countAtMost(quint64 bound) const {
+	quint64 count = 0;
+
+	const int last = bound > 0 ? bucket(bound) : 0;
+	for (int i = 0; i < last; ++i)
+		count += qaBuckets[i].load(std::memory_order_relaxed);
+	return count;
+}
+
+quint64 MetricsHistogram::quantile(double q) const {
+	const quint64 total = count();
+	if (total == 0)
+		return 0;
+
+	const quint64 rank = qMax< quint64 >(1, static_cast< quint64 >(q * static_cast< double >(total) + 0.5));
+	quint64 seen       = 0;
+	for (int i = 0; i < BUCKETS - 1; ++i) {
+		seen += qaBuckets[i].load(std::memory_order_relaxed);
+		if (seen >= rank)
+			return lowerBound(i + 1);
+	}
+	return lowerBound(BUCKETS - 1);
+}
+
+int MetricsHistogram::bucket(quint64 value) {
+	if (value < SUB_BUCKETS)
+		return static_cast< int >(value);
+
+	const int shift = 63 - static_cast< int >(qCountLeadingZeroBits(value)) - SUB_BITS;
+	return (shift + 1) * SUB_BUCKETS + static_cast< int >((value >> shift) & (SUB_BUCKETS - 1));
+}
+
+quint64 MetricsHistogram::lowerBound(int bucket) {
+	if (bucket < SUB_BUCKETS)
+		return static_cast< quint64 >(bucket);
+
+	const int shift = bucket / SUB_BUCKETS - 1;
+	return static_cast< quint64 >(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+}
@@ -0,0 +1,58 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_METRICSHISTOGRAM_H_
+#define MUMBLE_MURMUR_METRICSHISTOGRAM_H_
+
+#include <QtCore/QtGlobal>
+
+#include <array>
+#include <atomic>
+
+/// A histogram with a fixed relative precision, in the vein of HdrHistogram.
+///
+/// Values are sorted into buckets by their most significant bit and the SUB_BITS bits following it, so that any
+/// value can be recorded with a constant amount of work and the upper bound of a bucket is never more than
+/// 1 / 2^SUB_BITS off the values in it.
+///
+/// Any thread may record values. A server's voice thread records most of them, but voice that is tunneled through TCP
+/// is routed on the main thread, so every update is an atomic increment. Unlike MetricsCounter the buckets aren't
+/// sharded, as the second writer is rare and a record() already touches three cache lines anyway. Readers may see
+/// the count, sum and buckets of a value that is being recorded at slightly different times.
+class MetricsHistogram {
+private:
+	Q_DISABLE_COPY(MetricsHistogram);
+
+public:
+	static const int SUB_BITS    = 3;
+	static const int SUB_BUCKETS = 1 << SUB_BITS;
+	static const int BUCKETS     = (64 - SUB_BITS + 1) * SUB_BUCKETS;
+
+	MetricsHistogram();
+
+	void record(quint64 value);
+
+	quint64 count() const;
+	quint64 sum() const;
+	/// @returns The amount of values that are smaller than or equal to the given bound. Exact for bounds that are
+	/// 	powers of two, for others values up to the bound's bucket are included.
+	quint64 countAtMost(quint64 bound) const;
+
+	/// @returns An upper bound of the given quantile (0 to 1) of the recorded values, which is at most 1 / 2^SUB_BITS
+	/// 	above the exact quantile
+	quint64 quantile(double q) const;
+
+	/// @returns The index of the bucket the given value belongs into
+	static int bucket(quint64 value);
+	/// @returns The smallest value that belongs into the given bucket
+	static quint64 lowerBound(int bucket);
+
+protected:
+	std::array< std::atomic< quint64 >, BUCKETS > qaBuckets;
+	std::atomic< quint64 > uiCount;
+	std::atomic< quint64 > uiSum;
+};
+
+#endif
@@ -0,0 +1,488 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "Mixer.h"
+
+#include "Channel.h"
+#include "Message.h"
+#include "MixerMath.h"
+#include "MumbleConstants.h"
+#include "PacketDataStream.h"
+#include "Server.h"
+#include "ServerUser.h"
+#include "SpeechFlags.h"
+
+#include <QtCore/QStringList>
+#include <QtCore/QThread>
+
+#include <algorithm>
+#include <iterator>
+
+#ifdef Q_CC_GNU
+#	define RESOLVE(var)                                                        \
+		{                                                                       \
+			var    = reinterpret_cast< __typeof__(var) >(qlOpus.resolve(#var)); \
+			bValid = bValid && var;                                             \
+		}
+#else
+#	define RESOLVE(var)                                                                      \
+		{                                                                                     \
+			*reinterpret_cast< void ** >(&var) = static_cast< void * >(qlOpus.resolve(#var)); \
+			bValid                             = bValid && var;                               \
+		}
+#endif
+
+/// Time a channel is forwarded instead of mixed for after its worker ran over budget, in microseconds
+static const quint64 BYPASS_TIME = 10000000ULL;
+
+MixerCodec::MixerCodec() {
+	bValid = false;
+	qlOpus.setLoadHints(QLibrary::ResolveAllSymbolsHint);
+
+	QStringList alternatives;
+#if defined(Q_OS_MAC)
+	alternatives << QString::fromLatin1("libopus0.dylib");
+	alternatives << QString::fromLatin1("opus0.dylib");
+	alternatives << QString::fromLatin1("libopus.dylib");
+	alternatives << QString::fromLatin1("opus.dylib");
+#elif defined(Q_OS_UNIX)
+	alternatives << QString::fromLatin1("libopus.so.0");
+	alternatives << QString::fromLatin1("libopus0.so");
+	alternatives << QString::fromLatin1("libopus.so");
+	alternatives << QString::fromLatin1("opus.so");
+#else
+	alternatives << QString::fromLatin1("opus0.dll");
+	alternatives << QString::fromLatin1("opus.dll");
+#endif
+	foreach (const QString &lib, alternatives) {
+		qlOpus.setFileName(lib);
+		if (qlOpus.load()) {
+			bValid = true;
+			break;
+		}
+	}
+
+	RESOLVE(opus_get_version_string);
+
+	RESOLVE(opus_encode);
+	RESOLVE(opus_decode_float);
+
+	RESOLVE(opus_encoder_create);
+	RESOLVE(opus_encoder_ctl);
+	RESOLVE(opus_encoder_destroy);
+	RESOLVE(opus_decoder_create);
+	RESOLVE(opus_decoder_destroy);
+}
+
+MixerCodec::~MixerCodec() {
+	qlOpus.unload();
+}
+
+bool MixerCodec::isValid() const {
+	return bValid;
+}
+
+QString MixerCodec::version() const {
+	return QString::fromLatin1("%1 from %2").arg(QLatin1String(opus_get_version_string()), qlOpus.fileName());
+}
+
+#undef RESOLVE
+
+MixerWorker::MixerWorker(MixerCodec *codec, quint64 budget)
+	: QObject(), mcCodec(codec), uiBudget(budget), bIdle(true), dLoad(0.0) {
+	qtTick = new QTimer(this);
+	qtTick->setTimerType(Qt::PreciseTimer);
+	connect(qtTick, SIGNAL(timeout()), this, SLOT(tick()));
+}
+
+MixerWorker::~MixerWorker() {
+	for (MixedChannel &mc : qhChannels)
+		destroy(mc);
+}
+
+bool MixerWorker::push(const Input &input) {
+	QMutexLocker l(&qmInput);
+
+	auto it = qhBypassed.find(ChannelKey(input.server, input.iChannel));
+	if (it != qhBypassed.end()) {
+		if (tClock.elapsed() < *it)
+			return false;
+		qhBypassed.erase(it);
+	}
+
+	qlInput << input;
+
+	if (bIdle) {
+		// The timer has to be started from within the worker thread
+		bIdle = false;
+		QMetaObject::invokeMethod(this, "start", Qt::QueuedConnection);
+	}
+
+	return true;
+}
+
+void MixerWorker::start() {
+	if (!qtTick->isActive())
+		qtTick->start(1000 * FRAME_SIZE / SAMPLE_RATE);
+}
+
+void MixerWorker::tick() {
+	Timer t;
+
+	QList< Input > input;
+	{
+		QMutexLocker l(&qmInput);
+		input.swap(qlInput);
+	}
+
+	foreach (const Input &i, input)
+		decode(i);
+
+	for (auto it = qhChannels.begin(); it != qhChannels.end();) {
+		if (mix(it.key(), *it)) {
+			++it;
+		} else {
+			destroy(*it);
+			it = qhChannels.erase(it);
+		}
+	}
+
+	// Occasional slow frames are absorbed by the clients' jitter buffers, so only the average time counts
+	dLoad = dLoad * 0.9 + static_cast< double >(t.elapsed()) * 0.1;
+	if (dLoad > static_cast< double >(uiBudget) && !qhChannels.isEmpty()) {
+		auto busiest = qhChannels.begin();
+		for (auto it = qhChannels.begin(); it != qhChannels.end(); ++it) {
+			if (it->qhSpeakers.count() > busiest->qhSpeakers.count())
+				busiest = it;
+		}
+
+		qWarning("MixerWorker: Over budget (%.0f us per frame), forwarding channel %d of server %d instead of "
+				 "mixing it",
+				 dLoad, busiest.key().second, busiest.key().first->iServerNum);
+
+		{
+			QMutexLocker l(&qmInput);
+			qhBypassed.insert(busiest.key(), tClock.elapsed() + BYPASS_TIME);
+		}
+
+		destroy(*busiest);
+		qhChannels.erase(busiest);
+		dLoad = 0.0;
+	}
+
+	if (qhChannels.isEmpty()) {
+		QMutexLocker l(&qmInput);
+		if (qlInput.isEmpty()) {
+			qtTick->stop();
+			bIdle = true;
+		}
+	}
+}
+
+void MixerWorker::decode(const Input &input) {
+	const ChannelKey key(input.server, input.iChannel);
+
+	auto cit = qhChannels.find(key);
+	if (cit == qhChannels.end()) {
+		MixedChannel mc;
+		mc.oeMix = createEncoder();
+		if (!mc.oeMix)
+			return;
+		mc.uiSequence = 0;
+		mc.bActive    = false;
+		cit           = qhChannels.insert(key, mc);
+	}
+
+	auto sit = cit->qhSpeakers.find(input.uiSession);
+	if (sit == cit->qhSpeakers.end()) {
+		int error = 0;
+		Speaker s;
+		s.odDecoder = mcCodec->opus_decoder_create(SAMPLE_RATE, 1, &error);
+		if (!s.odDecoder)
+			return;
+		s.oeMinusSelf = nullptr;
+		s.bPlaying    = false;
+		s.bEnded      = false;
+		s.iUnderruns  = 0;
+		s.bMixed      = false;
+		sit           = cit->qhSpeakers.insert(input.uiSession, s);
+	}
+
+	Speaker &s = *sit;
+	s.bEnded   = input.bTerminator;
+
+	if (input.qbaFrame.isEmpty())
+		return;
+
+	float pcm[MAX_DECODED];
+	const int samples =
+		mcCodec->opus_decode_float(s.odDecoder, reinterpret_cast< const unsigned char * >(input.qbaFrame.constData()),
+								   input.qbaFrame.size(), pcm, MAX_DECODED, 0);
+	if (samples <= 0)
+		return;
+
+	s.qvBuffer.reserve(MAX_BUFFERED + MAX_DECODED);
+	std::copy(pcm, pcm + samples, std::back_inserter(s.qvBuffer));
+	if (s.qvBuffer.size() > MAX_BUFFERED)
+		s.qvBuffer.remove(0, s.qvBuffer.size() - MAX_BUFFERED);
+}
+
+bool MixerWorker::mix(const ChannelKey &key, MixedChannel &mc) {
+	QVector< float > mixed(FRAME_SIZE, 0.0f);
+	int mixedIn = 0;
+
+	for (Speaker &s : mc.qhSpeakers) {
+		s.bMixed = false;
+
+		if (!s.bPlaying && (s.qvBuffer.size() >= PREBUFFER || (s.bEnded && !s.qvBuffer.isEmpty())))
+			s.bPlaying = true;
+
+		if (!s.bPlaying) {
+			s.iUnderruns++;
+			continue;
+		}
+
+		const int n = qMin(FRAME_SIZE, s.qvBuffer.size());
+		s.qvFrame.fill(0.0f, FRAME_SIZE);
+		std::copy(s.qvBuffer.constBegin(), s.qvBuffer.constBegin() + n, s.qvFrame.begin());
+		s.qvBuffer.remove(0, n);
+
+		if (n < FRAME_SIZE)
+			s.iUnderruns++;
+		else
+			s.iUnderruns = 0;
+
+		if (n == 0)
+			continue;
+
+		MixerMath::add(mixed.data(), s.qvFrame.constData(), FRAME_SIZE);
+		s.bMixed = true;
+		mixedIn++;
+	}
+
+	unsigned char buffer[1024];
+	QByteArray common;
+	QHash< unsigned int, QByteArray > own;
+
+	if (mixedIn > 0) {
+		const int len = encode(mc.oeMix, mixed, buffer, sizeof(buffer));
+		if (len > 0)
+			common = QByteArray(reinterpret_cast< const char * >(buffer), len);
+
+		for (auto it = mc.qhSpeakers.begin(); it != mc.qhSpeakers.end(); ++it) {
+			Speaker &s = *it;
+			if (!s.bMixed)
+				continue;
+
+			if (mixedIn == 1) {
+				// Nobody else is talking, so there is nothing to send to the speaker
+				own.insert(it.key(), QByteArray());
+				continue;
+			}
+
+			if (!s.oeMinusSelf)
+				s.oeMinusSelf = createEncoder();
+			if (!s.oeMinusSelf)
+				continue;
+
+			QVector< float > minus(FRAME_SIZE);
+			MixerMath::subtract(mixed.constData(), s.qvFrame.constData(), minus.data(), FRAME_SIZE);
+
+			const int ownLen = encode(s.oeMinusSelf, minus, buffer, sizeof(buffer));
+			own.insert(it.key(), ownLen > 0 ? QByteArray(reinterpret_cast< const char * >(buffer), ownLen)
+											: QByteArray());
+		}
+
+		send(key.first, key.second, own, common, mc.uiSequence, false);
+		mc.bActive = true;
+	} else if (mc.bActive) {
+		// End the stream with a frame of silence, so that the clients know nobody is talking anymore
+		const int len = encode(mc.oeMix, mixed, buffer, sizeof(buffer));
+		if (len > 0)
+			common = QByteArray(reinterpret_cast< const char * >(buffer), len);
+
+		send(key.first, key.second, own, common, mc.uiSequence, true);
+		mc.bActive = false;
+	}
+
+	// Sequence numbers count 10 ms frames
+	mc.uiSequence += static_cast< quint32 >(FRAME_SIZE * 100 / SAMPLE_RATE);
+
+	for (auto it = mc.qhSpeakers.begin(); it != mc.qhSpeakers.end();) {
+		if ((it->bEnded && it->qvBuffer.isEmpty()) || it->iUnderruns > MAX_UNDERRUNS) {
+			destroy(*it);
+			it = mc.qhSpeakers.erase(it);
+		} else {
+			++it;
+		}
+	}
+
+	return mc.bActive || !mc.qhSpeakers.isEmpty();
+}
+
+int MixerWorker::encode(OpusEncoder *encoder, const QVector< float > &pcm, unsigned char *out, int maxLen) {
+	qint16 samples[FRAME_SIZE];
+	MixerMath::toInt16(pcm.constData(), samples, FRAME_SIZE);
+
+	return mcCodec->opus_encode(encoder, samples, FRAME_SIZE, out, maxLen);
+}
+
+void MixerWorker::send(Server *server, int channel, const QHash< unsigned int, QByteArray > &own,
+					   const QByteArray &common, quint32 sequence, bool terminator) {
+	char buffer[1024 + 64];
+
+	QReadLocker rl(&server->qrwlVoiceThread);
+
+	Channel *c = server->qhChannels.value(channel);
+	if (!c)
+		return;
+
+	foreach (User *p, c->qlUsers) {
+		ServerUser *u = static_cast< ServerUser * >(p);
+		if (u->bDeaf || u->bSelfDeaf || u->uiVersion < Mumble::Mixer::MIN_CLIENT_VERSION)
+			continue;
+
+		auto it                 = own.constFind(u->uiSession);
+		const QByteArray &frame = (it != own.constEnd()) ? *it : common;
+		if (frame.isEmpty())
+			continue;
+
+		buffer[0] = static_cast< char >((MessageHandler::UDPVoiceOpus << 5) | SpeechFlags::Normal);
+		PacketDataStream pds(buffer + 1, sizeof(buffer) - 1);
+		pds << Mumble::Mixer::MIXED_SESSION;
+		pds << sequence;
+		pds << (frame.size() | (terminator ? 0x2000 : 0));
+		pds.append(frame.constData(), static_cast< unsigned int >(frame.size()));
+
+		server->sendMessage(u, buffer, static_cast< int >(pds.size()) + 1);
+	}
+}
+
+OpusEncoder *MixerWorker::createEncoder() {
+	int error            = 0;
+	OpusEncoder *encoder = mcCodec->opus_encoder_create(SAMPLE_RATE, 1, OPUS_APPLICATION_VOIP, &error);
+	if (!encoder)
+		return nullptr;
+
+	mcCodec->opus_encoder_ctl(encoder, OPUS_SET_BITRATE(BITRATE));
+	mcCodec->opus_encoder_ctl(encoder, OPUS_SET_VBR(0));
+	return encoder;
+}
+
+void MixerWorker::destroy(MixedChannel &mc) {
+	for (Speaker &s : mc.qhSpeakers)
+		destroy(s);
+	mc.qhSpeakers.clear();
+
+	if (mc.oeMix)
+		mcCodec->opus_encoder_destroy(mc.oeMix);
+	mc.oeMix = nullptr;
+}
+
+void MixerWorker::destroy(Speaker &s) {
+	if (s.odDecoder)
+		mcCodec->opus_decoder_destroy(s.odDecoder);
+	if (s.oeMinusSelf)
+		mcCodec->opus_encoder_destroy(s.oeMinusSelf);
+	s.odDecoder   = nullptr;
+	s.oeMinusSelf = nullptr;
+}
+
+void MixerWorker::removeServer(Server *server) {
+	for (auto it = qhChannels.begin(); it != qhChannels.end();) {
+		if (it.key().first == server) {
+			destroy(*it);
+			it = qhChannels.erase(it);
+		} else {
+			++it;
+		}
+	}
+
+	QMutexLocker l(&qmInput);
+
+	for (auto it = qlInput.begin(); it != qlInput.end();) {
+		if (it->server == server)
+			it = qlInput.erase(it);
+		else
+			++it;
+	}
+
+	for (auto it = qhBypassed.begin(); it != qhBypassed.end();) {
+		if (it.key().first == server)
+			it = qhBypassed.erase(it);
+		else
+			++it;
+	}
+}
+
+MixerPool::MixerPool(int threads, int budget, QObject *p) : QObject(p) {
+	qRegisterMetaType< Server * >();
+
+	if (!mcCodec.isValid()) {
+		qWarning("MixerPool: Failed to load Opus, channels will not be mixed");
+		return;
+	}
+
+	qWarning("MixerPool: Using %s", qPrintable(mcCodec.version()));
+
+	if (threads <= 0)
+		threads = 1;
+
+	const quint64 frameUsec  = MixerWorker::FRAME_SIZE * 1000000ULL / MixerWorker::SAMPLE_RATE;
+	const quint64 budgetUsec = frameUsec * static_cast< quint64 >(qBound(1, budget, 100)) / 100;
+
+	for (int i = 0; i < threads; ++i) {
+		QThread *thread = new QThread(this);
+		thread->setObjectName(QString::fromLatin1("Mixer %1").arg(i));
+
+		MixerWorker *worker = new MixerWorker(&mcCodec, budgetUsec);
+		worker->moveToThread(thread);
+		thread->start(QThread::TimeCriticalPriority);
+
+		qlThreads << thread;
+		qlWorkers << worker;
+	}
+}
+
+MixerPool::~MixerPool() {
+	foreach (QThread *thread, qlThreads) {
+		thread->quit();
+		thread->wait();
+	}
+
+	qDeleteAll(qlWorkers);
+}
+
+bool MixerPool::isValid() const {
+	return !qlWorkers.isEmpty();
+}
+
+bool MixerPool::push(Server *server, int channel, unsigned int session, const char *frame, int len,
+					 bool terminator) {
+	if (qlWorkers.isEmpty())
+		return false;
+
+	// Held until the frame has been queued, so that removeServer() can't miss it
+	QReadLocker l(&qrwlRemoving);
+	if (qsRemoving.contains(server))
+		return false;
+
+	MixerWorker *worker = qlWorkers.at(static_cast< int >(qHash(qMakePair(server, channel)) % qlWorkers.size()));
+	return worker->push({ server, channel, session, QByteArray(frame, len), terminator });
+}
+
+void MixerPool::removeServer(Server *server) {
+	{
+		QWriteLocker l(&qrwlRemoving);
+		qsRemoving.insert(server);
+	}
+
+	foreach (MixerWorker *worker, qlWorkers)
+		QMetaObject::invokeMethod(worker, "removeServer", Qt::BlockingQueuedConnection, Q_ARG(Server *, server));
+
+	// The address may be reused by a server that is created later on
+	QWriteLocker l(&qrwlRemoving);
+	qsRemoving.remove(server);
+}
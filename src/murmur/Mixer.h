@@ -0,0 +1,202 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_MIXER_H_
+#define MUMBLE_MURMUR_MIXER_H_
+
+#include "Timer.h"
+
+#include <opus.h>
+
+#include <QtCore/QHash>
+#include <QtCore/QLibrary>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QObject>
+#include <QtCore/QPair>
+#include <QtCore/QReadWriteLock>
+#include <QtCore/QSet>
+#include <QtCore/QTimer>
+#include <QtCore/QVector>
+
+#ifndef Q_OS_WIN
+#	define __cdecl
+#endif
+
+class Server;
+
+/// Loads Opus from a shared library and acts as a wrapper for the functions the mixer needs (see OpusCodec in the
+/// client).
+class MixerCodec {
+private:
+	Q_DISABLE_COPY(MixerCodec)
+protected:
+	QLibrary qlOpus;
+	bool bValid;
+
+public:
+	MixerCodec();
+	~MixerCodec();
+
+	bool isValid() const;
+	QString version() const;
+
+	const char *(__cdecl *opus_get_version_string)();
+
+	OpusEncoder *(__cdecl *opus_encoder_create)(opus_int32 Fs, int channels, int application, int *error);
+	int(__cdecl *opus_encoder_ctl)(OpusEncoder *st, int request, ...);
+	void(__cdecl *opus_encoder_destroy)(OpusEncoder *st);
+	OpusDecoder *(__cdecl *opus_decoder_create)(opus_int32 Fs, int channels, int *error);
+	void(__cdecl *opus_decoder_destroy)(OpusDecoder *st);
+
+	int(__cdecl *opus_encode)(OpusEncoder *st, const opus_int16 *pcm, int frame_size, unsigned char *compressed,
+							  int nbCompressedBytes);
+	int(__cdecl *opus_decode_float)(OpusDecoder *st, const unsigned char *data, opus_int32 len, float *pcm,
+									int frame_size, int decode_fec);
+};
+
+/// Mixes the channels assigned to it. Lives in a thread of its own.
+///
+/// Every FRAME_SIZE samples (20 ms) the worker decodes the speech of everybody talking in a channel, mixes it and
+/// encodes the mix once for all listeners that aren't talking. Listeners that are talking get a mix without their
+/// own voice, so the amount of streams that are encoded depends on the amount of speakers, not on the amount of
+/// listeners. The mixed streams are sent with the reserved session Mumble::Mixer::MIXED_SESSION, and only to clients
+/// that know about it. Everybody else is sent the streams of the speakers as usual (see Server::routeMsg()).
+class MixerWorker : public QObject {
+private:
+	Q_OBJECT
+	Q_DISABLE_COPY(MixerWorker)
+
+public:
+	static const int SAMPLE_RATE = 48000;
+	/// The samples in a mixed frame (20 ms)
+	static const int FRAME_SIZE = SAMPLE_RATE / 50;
+	/// The most samples a single Opus packet can decode to (120 ms)
+	static const int MAX_DECODED = SAMPLE_RATE / 1000 * 120;
+	/// Samples a speaker has to have buffered before they are mixed in, in order to absorb jitter
+	static const int PREBUFFER = 2 * FRAME_SIZE;
+	/// Samples a speaker may have buffered at most. Older ones are dropped, so the delay doesn't grow.
+	static const int MAX_BUFFERED = 10 * FRAME_SIZE;
+	/// Frames a speaker may lack audio for before they are considered to have stopped talking
+	static const int MAX_UNDERRUNS = 10;
+	/// Bitrate of the mixed streams
+	static const int BITRATE = 40000;
+
+	/// An Opus frame received from a speaker
+	struct Input {
+		Server *server;
+		int iChannel;
+		unsigned int uiSession;
+		QByteArray qbaFrame;
+		bool bTerminator;
+	};
+
+	MixerWorker(MixerCodec *codec, quint64 budget);
+	~MixerWorker() Q_DECL_OVERRIDE;
+
+	/// Queues a frame. Called from the threads that route voice packets.
+	///
+	/// @returns False if the channel has been bypassed because the worker has been running over budget
+	bool push(const Input &input);
+
+protected:
+	typedef QPair< Server *, int > ChannelKey;
+
+	struct Speaker {
+		OpusDecoder *odDecoder;
+		/// Encodes the mix without this speaker for them. Only created once needed.
+		OpusEncoder *oeMinusSelf;
+		/// Decoded samples that are waiting to be mixed
+		QVector< float > qvBuffer;
+		/// This frame's samples of the speaker
+		QVector< float > qvFrame;
+		bool bPlaying;
+		bool bEnded;
+		int iUnderruns;
+		/// Whether the speaker was mixed in during the last frame
+		bool bMixed;
+	};
+
+	struct MixedChannel {
+		/// Encodes the mix for everybody who isn't speaking
+		OpusEncoder *oeMix;
+		QHash< unsigned int, Speaker > qhSpeakers;
+		/// In units of 10 ms, like the sequence numbers of clients
+		quint32 uiSequence;
+		bool bActive;
+	};
+
+	MixerCodec *mcCodec;
+	/// The time a frame may take to mix at most, in microseconds
+	quint64 uiBudget;
+
+	QMutex qmInput;
+	QList< Input > qlInput;
+	/// Whether the tick timer is stopped because there is nothing to mix
+	bool bIdle;
+	/// Channels that are forwarded instead of mixed, with the time they are bypassed until
+	QHash< ChannelKey, quint64 > qhBypassed;
+	Timer tClock;
+
+	QHash< ChannelKey, MixedChannel > qhChannels;
+	QTimer *qtTick;
+	/// Average time it takes to mix a frame, in microseconds
+	double dLoad;
+
+	void decode(const Input &input);
+	/// Mixes a frame of the given channel and sends it to its users.
+	///
+	/// @returns False if there is nobody left to mix
+	bool mix(const ChannelKey &key, MixedChannel &mc);
+	int encode(OpusEncoder *encoder, const QVector< float > &pcm, unsigned char *out, int maxLen);
+	void send(Server *server, int channel, const QHash< unsigned int, QByteArray > &own, const QByteArray &common,
+			  quint32 sequence, bool terminator);
+	OpusEncoder *createEncoder();
+	void destroy(MixedChannel &mc);
+	void destroy(Speaker &s);
+
+public slots:
+	void start();
+	void tick();
+	/// Drops the state of all channels of the given server. Has to be called before the server is deleted.
+	void removeServer(Server *server);
+};
+
+/// The threads channels are mixed on, see MixerWorker.
+class MixerPool : public QObject {
+private:
+	Q_OBJECT
+	Q_DISABLE_COPY(MixerPool)
+
+protected:
+	MixerCodec mcCodec;
+	QList< QThread * > qlThreads;
+	QList< MixerWorker * > qlWorkers;
+
+	/// Servers that are being removed, whose frames are rejected
+	QSet< Server * > qsRemoving;
+	QReadWriteLock qrwlRemoving;
+
+public:
+	/// @param threads The amount of worker threads
+	/// @param budget The share of the time of a frame a worker may spend on mixing, in percent. If mixing takes
+	/// 	longer, the worker stops mixing its busiest channel for a while and lets it be forwarded as usual.
+	MixerPool(int threads, int budget, QObject *p = nullptr);
+	~MixerPool() Q_DECL_OVERRIDE;
+
+	/// @returns Whether Opus could be loaded
+	bool isValid() const;
+
+	/// Hands an Opus frame sent to a channel over to the channel's worker. Thread-safe.
+	///
+	/// @returns False if the channel can't be mixed right now and the frame has to be forwarded
+	bool push(Server *server, int channel, unsigned int session, const char *frame, int len, bool terminator);
+
+	/// Drops the state of all channels of the given server and waits for the workers to do so. Frames of the server
+	/// that are pushed in the meantime are rejected. The server's voice thread has to be stopped already.
+	void removeServer(Server *server);
+};
+
+#endif
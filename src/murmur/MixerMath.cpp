@@ -0,0 +1,27 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "MixerMath.h"
+
+#include <cmath>
+
+namespace MixerMath {
+
+void add(float *mix, const float *frame, int samples) {
+	for (int i = 0; i < samples; ++i)
+		mix[i] += frame[i];
+}
+
+void subtract(const float *mix, const float *frame, float *out, int samples) {
+	for (int i = 0; i < samples; ++i)
+		out[i] = mix[i] - frame[i];
+}
+
+void toInt16(const float *pcm, qint16 *out, int samples) {
+	for (int i = 0; i < samples; ++i)
+		out[i] = static_cast< qint16 >(qBound(-32768L, lrintf(pcm[i] * 32768.0f), 32767L));
+}
+
+}; // namespace MixerMath
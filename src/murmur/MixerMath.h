@@ -0,0 +1,22 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_MIXERMATH_H_
+#define MUMBLE_MURMUR_MIXERMATH_H_
+
+#include <QtCore/QtGlobal>
+
+/// The sample arithmetic of MixerWorker. Samples are floats in the range of -1 to 1.
+namespace MixerMath {
+/// Adds a speaker's frame to the mix.
+void add(float *mix, const float *frame, int samples);
+/// Writes the mix without the given speaker's frame to out, which is what that speaker is sent.
+void subtract(const float *mix, const float *frame, float *out, int samples);
+/// Converts samples to 16 bit. The sum of several speakers can easily exceed the range, so samples outside of it are
+/// clipped.
+void toInt16(const float *pcm, qint16 *out, int samples);
+}; // namespace MixerMath
+
+#endif
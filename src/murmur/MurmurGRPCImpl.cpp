@@ -12,10 +12,12 @@
 #include "../Group.h"
 #include "../Message.h"
 #include "Channel.h"
+#include "Metrics.h"
 #include "MurmurGRPCImpl.h"
 #include "Server.h"
 #include "ServerDB.h"
 #include "ServerUser.h"
+#include "Supervisor.h"
 #include "Utils.h"
 
 #include <chrono>
@@ -1137,6 +1139,9 @@ template< class T > int MustServerID(const T &msg) {
 		throw ::grpc::Status(::grpc::INVALID_ARGUMENT, "missing server id");
 	}
 	auto id = msg.server().id();
+	if (!Supervisor::owns(id)) {
+		throw ::grpc::Status(::grpc::FAILED_PRECONDITION, "server is hosted by another worker");
+	}
 	if (!ServerDB::serverExists(id)) {
 		throw ::grpc::Status(::grpc::NOT_FOUND, "invalid server id");
 	}
@@ -1148,6 +1153,9 @@ int MustServerID(const ::MurmurRPC::Server &msg) {
 		throw ::grpc::Status(::grpc::INVALID_ARGUMENT, "missing server id");
 	}
 	auto id = msg.id();
+	if (!Supervisor::owns(id)) {
+		throw ::grpc::Status(::grpc::FAILED_PRECONDITION, "server is hosted by another worker");
+	}
 	if (!ServerDB::serverExists(id)) {
 		throw ::grpc::Status(::grpc::NOT_FOUND, "invalid server id");
 	}
@@ -1239,6 +1247,9 @@ namespace Wrapper {
 		::MurmurRPC::Server_List list;
 
 		foreach (int id, ServerDB::getAllServers()) {
+			if (!Supervisor::owns(id)) {
+				continue;
+			}
 			auto rpcServer = list.add_servers();
 			rpcServer->set_id(id);
 			try {
@@ -1324,6 +1335,12 @@ namespace Wrapper {
 		end(version);
 	}
 
+	void V1_GetMetrics::impl(bool) {
+		::MurmurRPC::Metrics metrics;
+		metrics.set_text(MetricsServer::exposition().toStdString());
+		end(metrics);
+	}
+
 	void V1_Events::impl(bool) { rpc->m_metaServiceListeners.insert(this); }
 
 	void V1_Events::done(bool) {
@@ -185,6 +185,8 @@ public:
 
 	virtual void getUptime_async(const ::Murmur::AMD_Meta_getUptimePtr &, const Ice::Current &);
 
+	virtual void getMetrics_async(const ::Murmur::AMD_Meta_getMetricsPtr &, const Ice::Current &);
+
 	virtual void getSlice_async(const ::Murmur::AMD_Meta_getSlicePtr &, const Ice::Current &);
 };
 
@@ -9,10 +9,12 @@
 #include "Channel.h"
 #include "Group.h"
 #include "Meta.h"
+#include "Metrics.h"
 #include "MurmurI.h"
 #include "Server.h"
 #include "ServerDB.h"
 #include "ServerUser.h"
+#include "Supervisor.h"
 #include "User.h"
 #include "Utils.h"
 
@@ -838,7 +840,12 @@ Ice::ObjectPtr ServerLocator::locate(const Ice::Current &, Ice::LocalObjectPtr &
 
 #define FIND_SERVER ::Server *server = meta->qhServers.value(server_id);
 
+// Servers that are hosted by another worker process (see Supervisor) can't be managed from here
 #define NEED_SERVER_EXISTS                                                     \
+	if (!Supervisor::owns(server_id)) {                                        \
+		cb->ice_exception(InvalidServerException());                           \
+		return;                                                                \
+	}                                                                          \
 	FIND_SERVER                                                                \
 	if (!server && !ServerDB::serverExists(server_id)) {                       \
 		cb->ice_exception(::Ice::ObjectNotExistException(__FILE__, __LINE__)); \
@@ -873,7 +880,7 @@ Ice::ObjectPtr ServerLocator::locate(const Ice::Current &, Ice::LocalObjectPtr &
 void ServerI::ice_ping(const Ice::Current &current) const {
 	// This is executed in the ice thread.
 	int server_id = u8(current.id.name).toInt();
-	if (!ServerDB::serverExists(server_id))
+	if (!Supervisor::owns(server_id) || !ServerDB::serverExists(server_id))
 		throw ::Ice::ObjectNotExistException(__FILE__, __LINE__);
 }
 
@@ -1867,7 +1874,7 @@ static void impl_Meta_getSliceChecksums(const ::Murmur::AMD_Meta_getSliceChecksu
 static void impl_Meta_getServer(const ::Murmur::AMD_Meta_getServerPtr cb, const Ice::ObjectAdapterPtr adapter,
 								::Ice::Int id) {
 	QList< int > server_list = ServerDB::getAllServers();
-	if (!server_list.contains(id))
+	if (!Supervisor::owns(id) || !server_list.contains(id))
 		cb->ice_response(nullptr);
 	else
 		cb->ice_response(idToProxy(id, adapter));
@@ -1881,8 +1888,10 @@ static void impl_Meta_newServer(const ::Murmur::AMD_Meta_newServerPtr cb, const
 static void impl_Meta_getAllServers(const ::Murmur::AMD_Meta_getAllServersPtr cb, const Ice::ObjectAdapterPtr adapter) {
 	::Murmur::ServerList sl;
 
-	foreach (int id, ServerDB::getAllServers())
-		sl.push_back(idToProxy(id, adapter));
+	foreach (int id, ServerDB::getAllServers()) {
+		if (Supervisor::owns(id))
+			sl.push_back(idToProxy(id, adapter));
+	}
 	cb->ice_response(sl);
 }
 
@@ -1903,8 +1912,10 @@ static void impl_Meta_getBootedServers(const ::Murmur::AMD_Meta_getBootedServers
 									   const Ice::ObjectAdapterPtr adapter) {
 	::Murmur::ServerList sl;
 
-	foreach (int id, meta->qhServers.keys())
-		sl.push_back(idToProxy(id, adapter));
+	foreach (int id, meta->qhServers.keys()) {
+		if (Supervisor::owns(id))
+			sl.push_back(idToProxy(id, adapter));
+	}
 	cb->ice_response(sl);
 }
 
@@ -1945,6 +1956,11 @@ static void impl_Meta_getUptime(const ::Murmur::AMD_Meta_getUptimePtr cb, const
 	cb->ice_response(static_cast< int >(meta->tUptime.elapsed() / 1000000LL));
 }
 
+#define ACCESS_Meta_getMetrics_READ
+static void impl_Meta_getMetrics(const ::Murmur::AMD_Meta_getMetricsPtr cb, const Ice::ObjectAdapterPtr) {
+	cb->ice_response(MetricsServer::exposition().toStdString());
+}
+
 #include "MurmurIceWrapper.cpp"
 
 #undef FIND_SERVER
@@ -1983,3 +1999,4 @@ static void impl_Meta_getUptime(const ::Murmur::AMD_Meta_getUptimePtr cb, const
 #undef ACCESS_Meta_getBootedServers_READ
 #undef ACCESS_Meta_getVersion_ALL
 #undef ACCESS_Meta_getUptime_ALL
+#undef ACCESS_Meta_getMetrics_READ
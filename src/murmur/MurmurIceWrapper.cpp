@@ -2196,6 +2196,38 @@ void ::Murmur::MetaI::getUptime_async(const ::Murmur::AMD_Meta_getUptimePtr &cb,
 	QCoreApplication::instance()->postEvent(mi, ie);
 }
 
+void ::Murmur::MetaI::getMetrics_async(const ::Murmur::AMD_Meta_getMetricsPtr &cb, const ::Ice::Current &current) {
+	// qWarning() << "getMetrics" << meta->mp.qsIceSecretRead.isNull() << meta->mp.qsIceSecretRead.isEmpty();
+#ifndef ACCESS_Meta_getMetrics_ALL
+#	ifdef ACCESS_Meta_getMetrics_READ
+	if (!meta->mp.qsIceSecretRead.isNull()) {
+		bool ok = !meta->mp.qsIceSecretRead.isEmpty();
+#	else
+	if (!meta->mp.qsIceSecretRead.isNull() || !meta->mp.qsIceSecretWrite.isNull()) {
+		bool ok = !meta->mp.qsIceSecretWrite.isEmpty();
+#	endif // ACCESS_Meta_getMetrics_READ
+		::Ice::Context::const_iterator i = current.ctx.find("secret");
+		ok                               = ok && (i != current.ctx.end());
+		if (ok) {
+			const QString &secret = u8((*i).second);
+#	ifdef ACCESS_Meta_getMetrics_READ
+			ok = ((secret == meta->mp.qsIceSecretRead) || (secret == meta->mp.qsIceSecretWrite));
+#	else
+			ok = (secret == meta->mp.qsIceSecretWrite);
+#	endif // ACCESS_Meta_getMetrics_READ
+		}
+
+		if (!ok) {
+			cb->ice_exception(InvalidSecretException());
+			return;
+		}
+	}
+#endif // ACCESS_Meta_getMetrics_ALL
+
+	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Meta_getMetrics, cb, current.adapter));
+	QCoreApplication::instance()->postEvent(mi, ie);
+}
+
 void ::Murmur::MetaI::getSliceChecksums_async(const ::Murmur::AMD_Meta_getSliceChecksumsPtr &cb,
 											  const ::Ice::Current &current) {
 	// qWarning() << "getSliceChecksums" << meta->mp.qsIceSecretRead.isNull() << meta->mp.qsIceSecretRead.isEmpty();
@@ -2351,5 +2383,6 @@ void ::Murmur::MetaI::getSlice_async(const ::Murmur::AMD_Meta_getSlicePtr &cb, c
 		"int minor, out int patch, out string text);\n\nvoid addCallback(MetaCallback *cb) throws "
 		"InvalidCallbackException, InvalidSecretException;\n\nvoid removeCallback(MetaCallback *cb) throws "
 		"InvalidCallbackException, InvalidSecretException;\n\nidempotent int getUptime();\n\nidempotent string "
-		"getSlice();\n\nidempotent Ice::SliceChecksumDict getSliceChecksums();\n};\n};\n"));
+		"getMetrics() throws InvalidSecretException;\n\nidempotent string getSlice();\n\nidempotent "
+		"Ice::SliceChecksumDict getSliceChecksums();\n};\n};\n"));
 }
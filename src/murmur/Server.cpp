@@ -11,9 +11,11 @@
 #include "EnvUtils.h"
 #include "Group.h"
 #include "HTMLFilter.h"
+#include "HandshakePool.h"
 #include "HostAddress.h"
 #include "Message.h"
 #include "Meta.h"
+#include "MumbleConstants.h"
 #include "PacketDataStream.h"
 #include "ServerDB.h"
 #include "ServerUser.h"
@@ -25,11 +27,14 @@
 #	include "Zeroconf.h"
 #endif
 
+#ifdef USE_MIXER
+#	include "Mixer.h"
+#endif
+
 #include "Utils.h"
 
 #include <QtCore/QCoreApplication>
 #include <QtCore/QSet>
-#include <QtCore/QXmlStreamAttributes>
 #include <QtCore/QtEndian>
 #include <QtNetwork/QHostInfo>
 #include <QtNetwork/QSslConfiguration>
@@ -124,7 +129,10 @@ Server::Server(int snum, QObject *p) : QThread(p) {
 #else
 	hNotify = nullptr;
 #endif
-	qtTimeout = new QTimer(this);
+	qtTimeout          = new QTimer(this);
+	qtLastChannelFlush = new QTimer(this);
+
+	uiHousekeepingSerial = uiBanExpirySerial = 0;
 
 	iCodecAlpha = iCodecBeta = 0;
 	bPreferAlpha             = false;
@@ -132,8 +140,14 @@ Server::Server(int snum, QObject *p) : QThread(p) {
 
 	qnamNetwork = nullptr;
 
+	bSnapshotConfig = false;
+	// Restoring the snapshot written on shutdown spares all the database queries below
+	const QString snapshotGeneration = takeSnapshotGeneration();
+	const bool warm                  = meta->bWarmBoot && loadSnapshot(snapshotGeneration);
+
 	readParams();
-	initialize();
+	if (!warm)
+		initialize();
 
 	foreach (const QHostAddress &qha, qlBind) {
 		SslServer *ss = new SslServer(this);
@@ -250,20 +264,29 @@ Server::Server(int snum, QObject *p) : QThread(p) {
 	hNotify = CreateEvent(nullptr, FALSE, FALSE, nullptr);
 #endif
 
-	connect(this, SIGNAL(tcpTransmit(QByteArray, unsigned int)), this, SLOT(tcpTransmitData(QByteArray, unsigned int)),
-			Qt::QueuedConnection);
+	connect(this, SIGNAL(tcpTransmit(unsigned int)), this, SLOT(tcpTransmitData(unsigned int)), Qt::QueuedConnection);
 	connect(this, SIGNAL(reqSync(unsigned int)), this, SLOT(doSync(unsigned int)));
 
 	for (int i = 1; i < iMaxUsers * 2; ++i)
 		qqIds.enqueue(i);
 
 	connect(qtTimeout, SIGNAL(timeout()), this, SLOT(checkTimeout()));
+	connect(qtLastChannelFlush, &QTimer::timeout, this, &Server::flushLastChannels);
+	qtLastChannelFlush->start(LAST_CHANNEL_FLUSH_INTERVAL);
 
-	getBans();
-	readChannels();
-	readLinks();
+	if (warm) {
+		scheduleBanExpiry();
+	} else {
+		getBans();
+		readChannels();
+		readLinks();
+	}
 	initializeCert();
 
+	// Everything that is read from the configuration later on has to come from the database again
+	bSnapshotConfig = false;
+	qmSnapshotConfig.clear();
+
 	int major, minor, patch;
 	QString release;
 	Meta::getVersion(major, minor, patch, release);
@@ -301,7 +324,7 @@ void Server::startThread() {
 #endif
 	}
 	if (!qtTimeout->isActive())
-		qtTimeout->start(15500);
+		qtTimeout->start(1000);
 }
 
 void Server::stopThread() {
@@ -331,6 +354,13 @@ Server::~Server() {
 
 	stopThread();
 
+#ifdef USE_MIXER
+	// The mixer threads may otherwise still access the server. The voice thread has to be stopped first, so it
+	// doesn't hand the mixer new frames of this server.
+	if (meta->mpMixer)
+		meta->mpMixer->removeServer(this);
+#endif
+
 	foreach (QSocketNotifier *qsn, qlUdpNotifier)
 		delete qsn;
 
@@ -350,6 +380,8 @@ Server::~Server() {
 #endif
 	clearACLCache();
 
+	flushLastChannels();
+
 	log("Stopped");
 }
 
@@ -395,6 +427,9 @@ void Server::readParams() {
 	iMaxBandwidth          = Meta::mp.iMaxBandwidth;
 	iMaxUsers              = Meta::mp.iMaxUsers;
 	iMaxUsersPerChannel    = Meta::mp.iMaxUsersPerChannel;
+	iMaxSpeakersPerChannel = Meta::mp.iMaxSpeakersPerChannel;
+	iMixChannelSize        = Meta::mp.iMixChannelSize;
+	bEgressPacing          = Meta::mp.bEgressPacing;
 	iMaxTextMessageLength  = Meta::mp.iMaxTextMessageLength;
 	iMaxImageMessageLength = Meta::mp.iMaxImageMessageLength;
 	bAllowHTML             = Meta::mp.bAllowHTML;
@@ -465,6 +500,9 @@ void Server::readParams() {
 	iMaxBandwidth          = getConf("bandwidth", iMaxBandwidth).toInt();
 	iMaxUsers              = getConf("users", iMaxUsers).toInt();
 	iMaxUsersPerChannel    = getConf("usersperchannel", iMaxUsersPerChannel).toInt();
+	iMaxSpeakersPerChannel = getConf("speakersperchannel", iMaxSpeakersPerChannel).toInt();
+	iMixChannelSize        = getConf("mixchannelsize", iMixChannelSize).toInt();
+	bEgressPacing          = getConf("egresspacing", bEgressPacing).toBool();
 	iMaxTextMessageLength  = getConf("textmessagelength", iMaxTextMessageLength).toInt();
 	iMaxImageMessageLength = getConf("imagemessagelength", iMaxImageMessageLength).toInt();
 	bAllowHTML             = getConf("allowhtml", bAllowHTML).toBool();
@@ -543,8 +581,19 @@ void Server::setLiveConf(const QString &key, const QString &value) {
 	int i     = v.toInt();
 	if ((key == "password") || (key == "serverpassword"))
 		qsPassword = !v.isNull() ? v : Meta::mp.qsPassword;
-	else if (key == "timeout")
-		iTimeout = i ? i : Meta::mp.iTimeout;
+	else if (key == "timeout") {
+		const int timeout = i ? i : Meta::mp.iTimeout;
+		if (timeout < iTimeout) {
+			// The scheduled checks would come too late otherwise
+			twHousekeeping.clear();
+			iTimeout = timeout;
+			foreach (ServerUser *u, qhUsers)
+				armTimeout(u);
+			scheduleBanExpiry();
+		} else {
+			iTimeout = timeout;
+		}
+	}
 	else if (key == "bandwidth") {
 		int length = i ? i : Meta::mp.iMaxBandwidth;
 		if (length != iMaxBandwidth) {
@@ -552,6 +601,9 @@ void Server::setLiveConf(const QString &key, const QString &value) {
 			MumbleProto::ServerConfig mpsc;
 			mpsc.set_max_bandwidth(length);
 			sendAll(mpsc);
+			// Everybody has just been told the new limit
+			foreach (ServerUser *u, qhUsers)
+				u->iBandwidthHint = 0;
 		}
 	} else if (key == "users") {
 		int newmax = i ? i : Meta::mp.iMaxUsers;
@@ -569,7 +621,32 @@ void Server::setLiveConf(const QString &key, const QString &value) {
 		sendAll(mpsc);
 	} else if (key == "usersperchannel")
 		iMaxUsersPerChannel = i ? i : Meta::mp.iMaxUsersPerChannel;
-	else if (key == "textmessagelength") {
+	else if (key == "speakersperchannel") {
+		iMaxSpeakersPerChannel = i ? i : Meta::mp.iMaxSpeakersPerChannel;
+		if (iMaxSpeakersPerChannel <= 0) {
+			QMutexLocker l(&qmSpeakerSelections);
+			qhSpeakerSelections.clear();
+		}
+	} else if (key == "mixchannelsize")
+		iMixChannelSize = i ? i : Meta::mp.iMixChannelSize;
+	else if (key == "egresspacing") {
+		bEgressPacing = !v.isNull() ? QVariant(v).toBool() : Meta::mp.bEgressPacing;
+		if (!bEgressPacing) {
+			// Nothing releases the packets that are waiting anymore, and the estimates would be stale by the time
+			// pacing is turned on again
+			foreach (ServerUser *u, qhUsers) {
+				QMutexLocker l(&u->qmEgress);
+				const int dropped = u->epEgress.reset();
+				if (dropped > 0)
+					smMetrics.mcVoicePacingDropped.add(static_cast< quint64 >(dropped));
+			}
+			{
+				QMutexLocker l(&qmPacedUsers);
+				qsPacedUsers.clear();
+			}
+			updateBandwidthHints();
+		}
+	} else if (key == "textmessagelength") {
 		int length = i ? i : Meta::mp.iMaxTextMessageLength;
 		if (length != iMaxTextMessageLength) {
 			iMaxTextMessageLength = length;
@@ -799,9 +876,21 @@ void Server::run() {
 	++nfds;
 
 	while (bRunning) {
+		bool paced;
+		{
+			QMutexLocker l(&qmPacedUsers);
+			paced = !qsPacedUsers.isEmpty();
+		}
+		if (paced && tPacing.elapsed() >= 1000ULL) {
+			tPacing.restart();
+			releasePacedPackets();
+		}
+
 #ifdef Q_OS_UNIX
-		int pret = poll(fds, nfds, -1);
-		if (pret <= 0) {
+		int pret = poll(fds, nfds, paced ? EgressPacer::RELEASE_INTERVAL : -1);
+		if (pret == 0)
+			continue;
+		if (pret < 0) {
 			if (errno == EINTR)
 				continue;
 			qCritical("poll failure");
@@ -814,7 +903,9 @@ void Server::run() {
 			unsigned char val;
 			while (::recv(aiNotify[0], &val, 1, MSG_DONTWAIT) == 1) {
 			};
-			break;
+			// Apart from stopThread(), the pipe is used to wake us up when there are packets to pace
+			if (!bRunning)
+				break;
 		}
 
 		for (int i = 0; i < nfds - 1; ++i) {
@@ -829,8 +920,9 @@ void Server::run() {
 #else
 		for (int i = 0; i < 1; ++i) {
 			{
-				DWORD ret = WaitForMultipleObjects(nfds, events, FALSE, INFINITE);
-				if (ret == (WAIT_OBJECT_0 + nfds - 1)) {
+				const DWORD timeout = paced ? static_cast< DWORD >(EgressPacer::RELEASE_INTERVAL) : INFINITE;
+				DWORD ret           = WaitForMultipleObjects(nfds, events, FALSE, timeout);
+				if (ret == WAIT_TIMEOUT || ret == (WAIT_OBJECT_0 + nfds - 1)) {
 					break;
 				}
 				if (ret == WAIT_FAILED) {
@@ -881,7 +973,11 @@ void Server::run() {
 					continue;
 				}
 
+				smMetrics.mcUdpReceived.add();
+
+				Timer tLock;
 				QReadLocker rl(&qrwlVoiceThread);
+				smMetrics.mhVoiceLockWait.record(tLock.elapsed());
 
 				quint32 *ping = reinterpret_cast< quint32 * >(encrypt);
 
@@ -912,6 +1008,7 @@ void Server::run() {
 				ServerUser *u = qhPeerUsers.value(key);
 				if (u) {
 					if (!checkDecrypt(u, encrypt, buffer, len)) {
+						smMetrics.mcDecryptFailures.add();
 						continue;
 					}
 				} else {
@@ -938,6 +1035,7 @@ void Server::run() {
 						}
 					}
 					if (!u) {
+						smMetrics.mcDecryptFailures.add();
 						continue;
 					}
 				}
@@ -960,8 +1058,7 @@ void Server::run() {
 						processMsg(u, buffer, len);
 					}
 				} else if (msgType == MessageHandler::UDPPing) {
-					QByteArray qba;
-					sendMessage(u, buffer, len, qba, true);
+					sendMessage(u, buffer, len, true);
 				}
 #ifdef Q_OS_UNIX
 				fds[i].revents = 0;
@@ -988,107 +1085,274 @@ bool Server::checkDecrypt(ServerUser *u, const char *encrypt, char *plain, unsig
 	if (u->csCrypt->tLastGood.elapsed() > 5000000ULL) {
 		if (u->csCrypt->tLastRequest.elapsed() > 5000000ULL) {
 			u->csCrypt->tLastRequest.restart();
+			smMetrics.mcCryptResyncs.add();
 			emit reqSync(u->uiSession);
 		}
 	}
 	return false;
 }
 
-void Server::sendMessage(ServerUser *u, const char *data, int len, QByteArray &cache, bool force) {
+void Server::sendMessage(ServerUser *u, const char *data, int len, bool force) {
 #if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
 	if ((u->aiUdpFlag.loadRelaxed() == 1 || force) && (u->sUdpSocket != INVALID_SOCKET)) {
 #else
 	// Qt 5.14 introduced QAtomicInteger::loadRelaxed() which deprecates QAtomicInteger::load()
 	if ((u->aiUdpFlag.load() == 1 || force) && (u->sUdpSocket != INVALID_SOCKET)) {
 #endif
+		if (!force && bEgressPacing && !pace(u, data, len))
+			return;
+
+		sendDatagram(u, data, len);
+	} else {
+		// The socket may only be written to from the main thread. So the packet is framed as UDPTunnel
+		// message right away and appended to the user's tunnel buffer. All packets that have piled up
+		// by the time the main thread gets to it are written in one go by tcpTransmitData().
+		bool schedule;
+		{
+			QMutexLocker l(&u->qmTunnel);
+
+			const int offset = u->qbaTunnel.size();
+			u->qbaTunnel.resize(offset + len + 6);
+
+			unsigned char *uc = reinterpret_cast< unsigned char * >(u->qbaTunnel.data()) + offset;
+			qToBigEndian< quint16 >(static_cast< quint16 >(MessageHandler::UDPTunnel), uc);
+			qToBigEndian< quint32 >(static_cast< quint32 >(len), uc + 2);
+			memcpy(uc + 6, data, len);
+
+			schedule               = !u->bTunnelFlushPending;
+			u->bTunnelFlushPending = true;
+		}
+
+		smMetrics.mcTunnelSent.add();
+
+		if (schedule)
+			emit tcpTransmit(u->uiSession);
+	}
+}
+
+void Server::sendDatagram(ServerUser *u, const char *data, int len) {
 #if defined(__LP64__)
-		STACKVAR(char, ebuffer, len + 4 + 16);
-		char *buffer = reinterpret_cast< char * >(((reinterpret_cast< quint64 >(ebuffer) + 8) & ~7) + 4);
+	STACKVAR(char, ebuffer, len + 4 + 16);
+	char *buffer = reinterpret_cast< char * >(((reinterpret_cast< quint64 >(ebuffer) + 8) & ~7) + 4);
 #else
-		STACKVAR(char, buffer, len + 4);
+	STACKVAR(char, buffer, len + 4);
 #endif
-		{
-			QMutexLocker wl(&u->qmCrypt);
+	{
+		QMutexLocker wl(&u->qmCrypt);
 
-			if (!u->csCrypt->isValid()) {
-				return;
-			}
+		if (!u->csCrypt->isValid()) {
+			return;
+		}
 
-			if (!u->csCrypt->encrypt(reinterpret_cast< const unsigned char * >(data),
-									 reinterpret_cast< unsigned char * >(buffer), len)) {
-				return;
-			}
+		if (!u->csCrypt->encrypt(reinterpret_cast< const unsigned char * >(data),
+								 reinterpret_cast< unsigned char * >(buffer), len)) {
+			return;
 		}
+	}
 #ifdef Q_OS_WIN
-		DWORD dwFlow = 0;
-		if (Meta::hQoS)
-			QOSAddSocketToFlow(Meta::hQoS, u->sUdpSocket, reinterpret_cast< struct sockaddr * >(&u->saiUdpAddress),
-							   QOSTrafficTypeVoice, QOS_NON_ADAPTIVE_FLOW, reinterpret_cast< PQOS_FLOWID >(&dwFlow));
+	DWORD dwFlow = 0;
+	if (Meta::hQoS)
+		QOSAddSocketToFlow(Meta::hQoS, u->sUdpSocket, reinterpret_cast< struct sockaddr * >(&u->saiUdpAddress),
+						   QOSTrafficTypeVoice, QOS_NON_ADAPTIVE_FLOW, reinterpret_cast< PQOS_FLOWID >(&dwFlow));
 #endif
 #ifdef Q_OS_LINUX
-		struct msghdr msg;
-		struct iovec iov[1];
-
-		iov[0].iov_base = buffer;
-		iov[0].iov_len  = len + 4;
-
-		uint8_t controldata[CMSG_SPACE(MAX(sizeof(struct in6_pktinfo), sizeof(struct in_pktinfo)))];
-		memset(controldata, 0, sizeof(controldata));
-
-		memset(&msg, 0, sizeof(msg));
-		msg.msg_name    = reinterpret_cast< struct sockaddr * >(&u->saiUdpAddress);
-		msg.msg_namelen = static_cast< socklen_t >(
-			(u->saiUdpAddress.ss_family == AF_INET6) ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in));
-		msg.msg_iov        = iov;
-		msg.msg_iovlen     = 1;
-		msg.msg_control    = controldata;
-		msg.msg_controllen = CMSG_SPACE((u->saiUdpAddress.ss_family == AF_INET6) ? sizeof(struct in6_pktinfo)
-																				 : sizeof(struct in_pktinfo));
-
-		struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
-		HostAddress tcpha(u->saiTcpLocalAddress);
-		if (u->saiUdpAddress.ss_family == AF_INET6) {
-			cmsg->cmsg_level            = IPPROTO_IPV6;
-			cmsg->cmsg_type             = IPV6_PKTINFO;
-			cmsg->cmsg_len              = CMSG_LEN(sizeof(struct in6_pktinfo));
-			struct in6_pktinfo *pktinfo = reinterpret_cast< struct in6_pktinfo * >(CMSG_DATA(cmsg));
-			memset(pktinfo, 0, sizeof(*pktinfo));
-			memcpy(&pktinfo->ipi6_addr.s6_addr[0], &tcpha.qip6.c[0], sizeof(pktinfo->ipi6_addr.s6_addr));
-		} else {
-			cmsg->cmsg_level           = IPPROTO_IP;
-			cmsg->cmsg_type            = IP_PKTINFO;
-			cmsg->cmsg_len             = CMSG_LEN(sizeof(struct in_pktinfo));
-			struct in_pktinfo *pktinfo = reinterpret_cast< struct in_pktinfo * >(CMSG_DATA(cmsg));
-			memset(pktinfo, 0, sizeof(*pktinfo));
-			if (tcpha.isV6())
-				return;
-			pktinfo->ipi_spec_dst.s_addr = tcpha.hash[3];
-		}
+	struct msghdr msg;
+	struct iovec iov[1];
+
+	iov[0].iov_base = buffer;
+	iov[0].iov_len  = len + 4;
 
+	uint8_t controldata[CMSG_SPACE(MAX(sizeof(struct in6_pktinfo), sizeof(struct in_pktinfo)))];
+	memset(controldata, 0, sizeof(controldata));
 
-		::sendmsg(u->sUdpSocket, &msg, 0);
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_name    = reinterpret_cast< struct sockaddr * >(&u->saiUdpAddress);
+	msg.msg_namelen = static_cast< socklen_t >(
+		(u->saiUdpAddress.ss_family == AF_INET6) ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in));
+	msg.msg_iov        = iov;
+	msg.msg_iovlen     = 1;
+	msg.msg_control    = controldata;
+	msg.msg_controllen = CMSG_SPACE((u->saiUdpAddress.ss_family == AF_INET6) ? sizeof(struct in6_pktinfo)
+																			 : sizeof(struct in_pktinfo));
+
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	HostAddress tcpha(u->saiTcpLocalAddress);
+	if (u->saiUdpAddress.ss_family == AF_INET6) {
+		cmsg->cmsg_level            = IPPROTO_IPV6;
+		cmsg->cmsg_type             = IPV6_PKTINFO;
+		cmsg->cmsg_len              = CMSG_LEN(sizeof(struct in6_pktinfo));
+		struct in6_pktinfo *pktinfo = reinterpret_cast< struct in6_pktinfo * >(CMSG_DATA(cmsg));
+		memset(pktinfo, 0, sizeof(*pktinfo));
+		memcpy(&pktinfo->ipi6_addr.s6_addr[0], &tcpha.qip6.c[0], sizeof(pktinfo->ipi6_addr.s6_addr));
+	} else {
+		cmsg->cmsg_level           = IPPROTO_IP;
+		cmsg->cmsg_type            = IP_PKTINFO;
+		cmsg->cmsg_len             = CMSG_LEN(sizeof(struct in_pktinfo));
+		struct in_pktinfo *pktinfo = reinterpret_cast< struct in_pktinfo * >(CMSG_DATA(cmsg));
+		memset(pktinfo, 0, sizeof(*pktinfo));
+		if (tcpha.isV6())
+			return;
+		pktinfo->ipi_spec_dst.s_addr = tcpha.hash[3];
+	}
+
+
+	::sendmsg(u->sUdpSocket, &msg, 0);
+	smMetrics.mcUdpSent.add();
 #else
-		::sendto(u->sUdpSocket, buffer, len + 4, 0, reinterpret_cast< struct sockaddr * >(&u->saiUdpAddress),
-				 (u->saiUdpAddress.ss_family == AF_INET6) ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in));
+	::sendto(u->sUdpSocket, buffer, len + 4, 0, reinterpret_cast< struct sockaddr * >(&u->saiUdpAddress),
+			 (u->saiUdpAddress.ss_family == AF_INET6) ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in));
+	smMetrics.mcUdpSent.add();
 #endif
 #ifdef Q_OS_WIN
-		if (Meta::hQoS && dwFlow)
-			QOSRemoveSocketFromFlow(Meta::hQoS, 0, dwFlow, 0);
+	if (Meta::hQoS && dwFlow)
+		QOSRemoveSocketFromFlow(Meta::hQoS, 0, dwFlow, 0);
 #else
 #endif
-	} else {
-		if (cache.isEmpty())
-			cache = QByteArray(data, len);
-		emit tcpTransmit(cache, u->uiSession);
+}
+
+bool Server::pace(ServerUser *u, const char *data, int len) {
+	bool wake = false;
+	{
+		QMutexLocker l(&u->qmEgress);
+
+		bool dropped;
+		if (u->epEgress.admit(tUptime.elapsed(), data, len, &dropped))
+			return true;
+
+		if (dropped) {
+			smMetrics.mcVoicePacingDropped.add();
+		} else if (u->epEgress.queued() == 1) {
+			QMutexLocker pl(&qmPacedUsers);
+			wake = qsPacedUsers.isEmpty();
+			qsPacedUsers.insert(u->uiSession);
+		}
+	}
+
+	smMetrics.mcVoicePaced.add();
+
+	// The voice thread may be waiting for packets without a timeout
+	if (wake) {
+#ifdef Q_OS_UNIX
+		unsigned char val = 0;
+		if (::write(aiNotify[1], &val, 1) != 1)
+			qWarning("Server: Failed to wake the voice thread");
+#else
+		SetEvent(hNotify);
+#endif
+	}
+
+	return false;
+}
+
+void Server::releasePacedPackets() {
+	QList< unsigned int > sessions;
+	{
+		QMutexLocker l(&qmPacedUsers);
+		sessions = qsPacedUsers.values();
+	}
+
+	QReadLocker rl(&qrwlVoiceThread);
+	const quint64 now = tUptime.elapsed();
+
+	foreach (unsigned int session, sessions) {
+		ServerUser *u = qhUsers.value(session);
+		if (!u) {
+			QMutexLocker l(&qmPacedUsers);
+			qsPacedUsers.remove(session);
+			continue;
+		}
+
+		QByteArray packet;
+		forever {
+			{
+				QMutexLocker l(&u->qmEgress);
+				if (!u->epEgress.release(now, packet)) {
+					if (u->epEgress.queued() == 0) {
+						QMutexLocker pl(&qmPacedUsers);
+						qsPacedUsers.remove(session);
+					}
+					break;
+				}
+			}
+			sendDatagram(u, packet.constData(), packet.size());
+		}
+	}
+}
+
+void Server::updateBandwidthHints() {
+	// The lowest capacity of the congested listeners in each channel
+	QHash< Channel *, double > capacities;
+	if (bEgressPacing) {
+		foreach (ServerUser *u, qhUsers) {
+			if (u->sState != ServerUser::Authenticated || u->bDeaf || u->bSelfDeaf)
+				continue;
+
+			double capacity;
+			{
+				QMutexLocker l(&u->qmEgress);
+				capacity = u->epEgress.capacity();
+			}
+
+			if (capacity > 0.0) {
+				auto it = capacities.find(u->cChannel);
+				if (it == capacities.end() || capacity < *it)
+					capacities.insert(u->cChannel, capacity);
+			}
+		}
+	}
+
+	QHash< Channel *, int > speakers;
+	foreach (ServerUser *u, qhUsers) {
+		if (u->sState != ServerUser::Authenticated)
+			continue;
+
+		int hint = 0;
+		auto it  = capacities.constFind(u->cChannel);
+		if (it != capacities.constEnd()) {
+			// The capacity is shared by everybody who is talking in the channel
+			auto sit = speakers.find(u->cChannel);
+			if (sit == speakers.end()) {
+				int count = 0;
+				foreach (User *p, u->cChannel->qlUsers) {
+					if (static_cast< ServerUser * >(p)->bwr.bandwidth() > 0)
+						++count;
+				}
+				sit = speakers.insert(u->cChannel, qMax(count, 1));
+			}
+
+			// Round down to steps of 8 kbit/s, so that the hint doesn't change with every small fluctuation
+			hint = static_cast< int >(*it * 8.0 / *sit) / 8000 * 8000;
+			hint = qMax(hint, 16000);
+			if (hint >= iMaxBandwidth)
+				hint = 0;
+		}
+
+		if (hint == u->iBandwidthHint)
+			continue;
+
+		// Clients tell their users whenever the bandwidth changes, so it is only raised again once in a while.
+		// Lowering it can't wait though. Once pacing is turned off, this is the last chance to lift the hints,
+		// so they are lifted right away.
+		const bool raise = (hint == 0) || (u->iBandwidthHint != 0 && hint > u->iBandwidthHint);
+		if (raise && bEgressPacing && u->tBandwidthHint.elapsed() < 30000000ULL)
+			continue;
+
+		u->iBandwidthHint = hint;
+		u->tBandwidthHint.restart();
+
+		MumbleProto::ServerConfig mpsc;
+		mpsc.set_max_bandwidth(hint ? hint : iMaxBandwidth);
+		sendMessage(u, mpsc);
 	}
 }
 
 #define SENDTO                                                 \
 	if ((!pDst->bDeaf) && (!pDst->bSelfDeaf) && (pDst != u)) { \
 		if ((poslen > 0) && (pDst->ssContext == u->ssContext)) \
-			sendMessage(pDst, buffer, len, qba);               \
+			sendMessage(pDst, buffer, len);                    \
 		else                                                   \
-			sendMessage(pDst, buffer, len - poslen, qba_npos); \
+			sendMessage(pDst, buffer, len - poslen);           \
+		++fanout;                                              \
 	}
 
 void Server::processMsg(ServerUser *u, const char *data, int len) {
@@ -1097,10 +1361,21 @@ void Server::processMsg(ServerUser *u, const char *data, int len) {
 	// this function.
 	// This function is currently called from Server::msgUDPTunnel, Server::run and
 	// Server::message
+
+	smMetrics.mcVoiceReceived.add();
+
+	Timer t;
+	unsigned int fanout = 0;
+	routeMsg(u, data, len, fanout);
+
+	smMetrics.mhVoiceProcessing.record(t.elapsed());
+	smMetrics.mhFanout.record(fanout);
+}
+
+void Server::routeMsg(ServerUser *u, const char *data, int len, unsigned int &fanout) {
 	if (u->sState != ServerUser::Authenticated || u->bMute || u->bSuppress || u->bSelfMute)
 		return;
 
-	QByteArray qba, qba_npos;
 	unsigned int counter;
 	char buffer[UDP_PACKET_SIZE];
 	PacketDataStream pdi(data + 1, len - 1);
@@ -1108,6 +1383,9 @@ void Server::processMsg(ServerUser *u, const char *data, int len) {
 	unsigned int type   = data[0] & 0xe0;
 	unsigned int target = data[0] & 0x1f;
 	unsigned int poslen;
+	bool terminator       = false;
+	const char *opusFrame = nullptr;
+	unsigned int opusLen  = 0;
 
 	// Check the voice data rate limit.
 	{
@@ -1130,11 +1408,17 @@ void Server::processMsg(ServerUser *u, const char *data, int len) {
 		do {
 			counter = pdi.next8();
 			pdi.skip(counter & 0x7f);
+			terminator = (counter & 0x7f) == 0;
 		} while ((counter & 0x80) && pdi.isValid());
 	} else {
 		int size;
 		pdi >> size;
-		pdi.skip(size & 0x1fff);
+		opusFrame = pdi.charPtr();
+		opusLen   = static_cast< unsigned int >(size & 0x1fff);
+		pdi.skip(opusLen);
+		terminator = (size & 0x2000) != 0;
+		if (!pdi.isValid())
+			opusFrame = nullptr;
 	}
 
 	// Save location of the positional audio data.
@@ -1161,11 +1445,31 @@ void Server::processMsg(ServerUser *u, const char *data, int len) {
 
 	if (target == 0x1f) { // Server loopback
 		buffer[0] = static_cast< char >(type | SpeechFlags::Normal);
-		sendMessage(u, buffer, len, qba);
+		sendMessage(u, buffer, len);
+		++fanout;
 		return;
 	} else if (target == 0) { // Normal speech
 		Channel *c = u->cChannel;
 
+		// Only forward the loudest speakers if there are too many talking at once
+		if (iMaxSpeakersPerChannel > 0) {
+			QMutexLocker l(&qmSpeakerSelections);
+			if (!qhSpeakerSelections[c->iId].admit(u->uiSession, tUptime.elapsed(), static_cast< unsigned int >(len),
+												   u->bPrioritySpeaker, terminator, iMaxSpeakersPerChannel)) {
+				smMetrics.mcVoiceSuppressed.add();
+				return;
+			}
+		}
+
+		// Large channels may be mixed on the server, in which case their users get a single mixed stream instead of
+		// the streams of all speakers. Listeners, linked channels and clients too old to play the mix are still sent
+		// the speaker's stream.
+		bool mixed = false;
+#ifdef USE_MIXER
+		if (iMixChannelSize > 0 && opusFrame && meta->mpMixer && c->qlUsers.count() >= iMixChannelSize)
+			mixed = meta->mpMixer->push(this, c->iId, u->uiSession, opusFrame, static_cast< int >(opusLen), terminator);
+#endif
+
 		buffer[0] = static_cast< char >(type | SpeechFlags::Normal);
 
 		// Send audio to all users that are listening to the channel
@@ -1184,18 +1488,18 @@ void Server::processMsg(ServerUser *u, const char *data, int len) {
 			// listener proxy
 			listeningUsers -= pDst;
 
+			if (mixed && pDst->uiVersion >= Mumble::Mixer::MIN_CLIENT_VERSION)
+				continue;
+
 			SENDTO;
 		}
 
 		// Send audio to all linked channels the user has speak-permission
 		if (!c->qhLinks.isEmpty()) {
-			QSet< Channel * > chans = c->allLinks();
-			chans.remove(c);
-
 			QMutexLocker qml(&qmCache);
 
-			foreach (Channel *l, chans) {
-				if (ChanACL::hasPermission(u, l, ChanACL::Speak, &acCache)) {
+			for (Channel *l : c->linkedChannels()) {
+				if (l != c && ChanACL::hasPermission(u, l, ChanACL::Speak, &acCache)) {
 					// Send the audio stream to all users that are listening to the linked channel but are not
 					// in the original channel the audio is coming from nor are they listening to the orignal
 					// channel (in these cases they have received the audio already).
@@ -1374,18 +1678,9 @@ void Server::newClient() {
 
 		HostAddress ha(adr);
 
-		QList< Ban > tmpBans = qlBans;
+		// Expired bans are removed by checkTimeout(), but one may have expired within the last second
 		foreach (const Ban &ban, qlBans) {
-			if (ban.isExpired())
-				tmpBans.removeOne(ban);
-		}
-		if (qlBans.count() != tmpBans.count()) {
-			qlBans = tmpBans;
-			saveBans();
-		}
-
-		foreach (const Ban &ban, qlBans) {
-			if (ban.haAddress.match(ha, ban.iMask)) {
+			if (ban.haAddress.match(ha, ban.iMask) && !ban.isExpired()) {
 				log(QString("Ignoring connection: %1, Reason: %2, Username: %3, Hash: %4 (Server ban)")
 						.arg(addressToString(sock->peerAddress(), sock->peerPort()), ban.qsReason, ban.qsUsername,
 							 ban.qsHash));
@@ -1395,66 +1690,6 @@ void Server::newClient() {
 			}
 		}
 
-#ifdef Q_OS_MAC
-		// One unexpected behavior of Qt's SSL backend is: it will add the key pair
-		// it uses in a connection into the default keychain, and when access the private
-		// key afterwards, a pop up will show up asking for user's permission.
-		// In some case (OS X 10.15.5), this pop up will be suppressed somehow and no private
-		// key is returned.
-		// This env variable will avoid Qt directly adding the key pair into the default keychain,
-		// using a temporary keychain instead.
-		// See #4298 and https://codereview.qt-project.org/c/qt/qtbase/+/184243
-		EnvUtils::setenv("QT_SSL_USE_TEMPORARY_KEYCHAIN", "1");
-#endif
-		sock->setPrivateKey(qskKey);
-		sock->setLocalCertificate(qscCert);
-
-		QSslConfiguration config;
-#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
-		config = sock->sslConfiguration();
-		// Qt 5.15 introduced QSslConfiguration::addCaCertificate(s) that should be preferred over the functions in
-		// QSslSocket
-
-		// Treat the leaf certificate as a root.
-		// This shouldn't strictly be necessary,
-		// and is a left-over from early on.
-		// Perhaps it is necessary for self-signed
-		// certs?
-		config.addCaCertificate(qscCert);
-
-		// Add CA certificates specified via
-		// murmur.ini's sslCA option.
-		config.addCaCertificates(Meta::mp.qlCA);
-
-		// Add intermediate CAs found in the PEM
-		// bundle used for this server's certificate.
-		config.addCaCertificates(qlIntermediates);
-#else
-		// Treat the leaf certificate as a root.
-		// This shouldn't strictly be necessary,
-		// and is a left-over from early on.
-		// Perhaps it is necessary for self-signed
-		// certs?
-		sock->addCaCertificate(qscCert);
-
-		// Add CA certificates specified via
-		// murmur.ini's sslCA option.
-		sock->addCaCertificates(Meta::mp.qlCA);
-
-		// Add intermediate CAs found in the PEM
-		// bundle used for this server's certificate.
-		sock->addCaCertificates(qlIntermediates);
-
-		// Must not get config from socket before setting CA certificates
-		config = sock->sslConfiguration();
-#endif
-
-		config.setCiphers(Meta::mp.qlCiphers);
-#if defined(USE_QSSLDIFFIEHELLMANPARAMETERS)
-		config.setDiffieHellmanParameters(qsdhpDHParams);
-#endif
-		sock->setSslConfiguration(config);
-
 		if (qqIds.isEmpty()) {
 			log(QString("Session ID pool (%1) empty, rejecting connection").arg(iMaxUsers));
 			sock->disconnectFromHost();
@@ -1462,39 +1697,126 @@ void Server::newClient() {
 			return;
 		}
 
-		ServerUser *u = new ServerUser(this, sock);
-		u->haAddress  = ha;
-		HostAddress(sock->localAddress()).toSockaddr(&u->saiTcpLocalAddress);
+		sock->setSslConfiguration(qscTlsConfig);
 
-		connect(u, SIGNAL(connectionClosed(QAbstractSocket::SocketError, const QString &)), this,
-				SLOT(connectionClosed(QAbstractSocket::SocketError, const QString &)));
-		connect(u, SIGNAL(message(unsigned int, const QByteArray &)), this,
-				SLOT(message(unsigned int, const QByteArray &)));
-		connect(u, SIGNAL(handleSslErrors(const QList< QSslError > &)), this,
-				SLOT(sslError(const QList< QSslError > &)));
-		connect(u, SIGNAL(encrypted()), this, SLOT(encrypted()));
+		// The handshake is done by one of the threads of the pool. Once it has completed, the socket
+		// is handed back via acceptClient().
+		meta->hpHandshakes->handshake(sock, iServerNum, addressToString(sock->peerAddress(), sock->peerPort()));
 
-		log(u, QString("New connection: %1").arg(addressToString(sock->peerAddress(), sock->peerPort())));
+		meta->successfulConnectionFrom(adr);
+	}
+}
+
+void Server::initializeTlsConfiguration() {
+#ifdef Q_OS_MAC
+	// One unexpected behavior of Qt's SSL backend is: it will add the key pair
+	// it uses in a connection into the default keychain, and when access the private
+	// key afterwards, a pop up will show up asking for user's permission.
+	// In some case (OS X 10.15.5), this pop up will be suppressed somehow and no private
+	// key is returned.
+	// This env variable will avoid Qt directly adding the key pair into the default keychain,
+	// using a temporary keychain instead.
+	// See #4298 and https://codereview.qt-project.org/c/qt/qtbase/+/184243
+	EnvUtils::setenv("QT_SSL_USE_TEMPORARY_KEYCHAIN", "1");
+#endif
+
+	QSslConfiguration config;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+	config = QSslConfiguration::defaultConfiguration();
+	// Qt 5.15 introduced QSslConfiguration::addCaCertificate(s) that should be preferred over the functions in
+	// QSslSocket
+
+	// Treat the leaf certificate as a root.
+	// This shouldn't strictly be necessary,
+	// and is a left-over from early on.
+	// Perhaps it is necessary for self-signed
+	// certs?
+	config.addCaCertificate(qscCert);
+
+	// Add CA certificates specified via
+	// murmur.ini's sslCA option.
+	config.addCaCertificates(Meta::mp.qlCA);
+
+	// Add intermediate CAs found in the PEM
+	// bundle used for this server's certificate.
+	config.addCaCertificates(qlIntermediates);
+#else
+	// The CA certificates can only be added via QSslSocket, so a
+	// socket that is never connected is used to put the
+	// configuration together.
+	QSslSocket sock;
+
+	// Treat the leaf certificate as a root.
+	// This shouldn't strictly be necessary,
+	// and is a left-over from early on.
+	// Perhaps it is necessary for self-signed
+	// certs?
+	sock.addCaCertificate(qscCert);
+
+	// Add CA certificates specified via
+	// murmur.ini's sslCA option.
+	sock.addCaCertificates(Meta::mp.qlCA);
+
+	// Add intermediate CAs found in the PEM
+	// bundle used for this server's certificate.
+	sock.addCaCertificates(qlIntermediates);
+
+	// Must not get config from socket before setting CA certificates
+	config = sock.sslConfiguration();
+#endif
 
-		u->setToS();
+	config.setPrivateKey(qskKey);
+	config.setLocalCertificate(qscCert);
+	config.setCiphers(Meta::mp.qlCiphers);
+#if defined(USE_QSSLDIFFIEHELLMANPARAMETERS)
+	config.setDiffieHellmanParameters(qsdhpDHParams);
+#endif
 
 #if QT_VERSION >= 0x050500
-		sock->setProtocol(QSsl::TlsV1_0OrLater);
+	config.setProtocol(QSsl::TlsV1_0OrLater);
 #elif QT_VERSION >= 0x050400
-		// In Qt 5.4, QSsl::SecureProtocols is equivalent
-		// to "TLSv1.0 or later", which we require.
-		sock->setProtocol(QSsl::SecureProtocols);
+	// In Qt 5.4, QSsl::SecureProtocols is equivalent
+	// to "TLSv1.0 or later", which we require.
+	config.setProtocol(QSsl::SecureProtocols);
 #else
-		sock->setProtocol(QSsl::TlsV1_0);
+	config.setProtocol(QSsl::TlsV1_0);
 #endif
-		sock->startServerEncryption();
 
-		meta->successfulConnectionFrom(adr);
+	qscTlsConfig = config;
+}
+
+void Server::acceptClient(QSslSocket *sock, bool verified) {
+	if (qqIds.isEmpty() || sock->state() != QAbstractSocket::ConnectedState) {
+		if (qqIds.isEmpty())
+			log(QString("Session ID pool (%1) empty, rejecting connection").arg(iMaxUsers));
+		sock->disconnectFromHost();
+		sock->deleteLater();
+		return;
 	}
+
+	ServerUser *u = new ServerUser(this, sock);
+	u->haAddress  = HostAddress(sock->peerAddress());
+	u->bVerified  = verified;
+	HostAddress(sock->localAddress()).toSockaddr(&u->saiTcpLocalAddress);
+
+	connect(u, SIGNAL(connectionClosed(QAbstractSocket::SocketError, const QString &)), this,
+			SLOT(connectionClosed(QAbstractSocket::SocketError, const QString &)));
+	connect(u, SIGNAL(message(unsigned int, const QByteArray &)), this,
+			SLOT(message(unsigned int, const QByteArray &)));
+	connect(u, SIGNAL(handleSslErrors(const QList< QSslError > &)), this, SLOT(sslError(const QList< QSslError > &)));
+
+	log(u, QString("New connection: %1").arg(addressToString(sock->peerAddress(), sock->peerPort())));
+
+	u->setToS();
+
+	encrypted(u);
+
+	// Whatever the client has sent right after the handshake arrived before anyone was connected to readyRead()
+	if (sock->bytesAvailable() > 0)
+		QMetaObject::invokeMethod(u, "socketRead", Qt::QueuedConnection);
 }
 
-void Server::encrypted() {
-	ServerUser *uSource = qobject_cast< ServerUser * >(sender());
+void Server::encrypted(ServerUser *uSource) {
 	int major, minor, patch;
 	QString release;
 
@@ -1549,29 +1871,13 @@ void Server::sslError(const QList< QSslError > &errors) {
 	if (!u)
 		return;
 
-	bool ok = true;
-	foreach (QSslError e, errors) {
-		switch (e.error()) {
-			case QSslError::InvalidPurpose:
-				// Allow email certificates.
-				break;
-			case QSslError::NoPeerCertificate:
-			case QSslError::SelfSignedCertificate:
-			case QSslError::SelfSignedCertificateInChain:
-			case QSslError::UnableToGetLocalIssuerCertificate:
-			case QSslError::UnableToVerifyFirstCertificate:
-			case QSslError::HostNameMismatch:
-			case QSslError::CertificateNotYetValid:
-			case QSslError::CertificateExpired:
-				u->bVerified = false;
-				break;
-			default:
-				log(u, QString("SSL Error: %1").arg(e.errorString()));
-				ok = false;
-		}
-	}
+	QList< QSslError > fatal;
+	HandshakePool::classifySslErrors(errors, u->bVerified, fatal);
+
+	foreach (const QSslError &e, fatal)
+		log(u, QString("SSL Error: %1").arg(e.errorString()));
 
-	if (ok) {
+	if (fatal.isEmpty()) {
 		u->proceedAnyway();
 	} else {
 		// Due to a regression in Qt 5 (QTBUG-53906),
@@ -1770,36 +2076,115 @@ void Server::message(unsigned int uiType, const QByteArray &qbaMsg, ServerUser *
 #undef MUMBLE_MH_MSG
 }
 
+void Server::armTimeout(ServerUser *u) {
+	u->uiTimeoutSerial = ++uiHousekeepingSerial;
+	twHousekeeping.schedule({ HousekeepingEntry::UserTimeout, u->uiSession, u->uiTimeoutSerial }, iTimeout + 1);
+}
+
+void Server::scheduleBanExpiry() {
+	const QDateTime now = QDateTime::currentDateTime().toUTC();
+
+	qint64 next = -1;
+	foreach (const Ban &ban, qlBans) {
+		if (ban.iDuration == 0)
+			continue;
+		const qint64 remaining = qMax< qint64 >(ban.iDuration - ban.qdtStart.secsTo(now), 0);
+		if (next < 0 || remaining < next)
+			next = remaining;
+	}
+
+	// Any entry that is still in the wheel is superseded by this one
+	++uiBanExpirySerial;
+	if (next >= 0)
+		twHousekeeping.schedule({ HousekeepingEntry::BanExpiry, 0, uiBanExpirySerial },
+								static_cast< quint64 >(next) + 1);
+}
+
 void Server::checkTimeout() {
 	QList< ServerUser * > qlClose;
+	bool expireBans = false;
 
-	qrwlVoiceThread.lockForRead();
-	foreach (ServerUser *u, qhUsers) {
-		if (u->activityTime() > (iTimeout * 1000)) {
+	// Users are only added to and removed from qhUsers by the main thread, so there is no need to lock the voice
+	// thread for reading it here.
+	foreach (const HousekeepingEntry &e, twHousekeeping.advance()) {
+		if (e.type == HousekeepingEntry::BanExpiry) {
+			expireBans = expireBans || (e.uiSerial == uiBanExpirySerial);
+			continue;
+		}
+
+		ServerUser *u = qhUsers.value(e.uiSession);
+		if (!u || u->uiTimeoutSerial != e.uiSerial)
+			continue;
+
+		const qint64 idle = u->activityTime();
+		if (idle > (iTimeout * 1000)) {
 			log(u, "Timeout");
 			qlClose.append(u);
+		} else {
+			// There has been activity since the entry was scheduled, so check again once the user may have timed out
+			twHousekeeping.schedule(e, static_cast< quint64 >((iTimeout * 1000 - idle) / 1000 + 1));
+		}
+	}
+
+	if (expireBans) {
+		const int count = qlBans.count();
+		for (auto it = qlBans.begin(); it != qlBans.end();) {
+			if (it->isExpired())
+				it = qlBans.erase(it);
+			else
+				++it;
 		}
+
+		if (qlBans.count() != count)
+			saveBans();
+		else
+			scheduleBanExpiry();
 	}
-	qrwlVoiceThread.unlock();
+
 	foreach (ServerUser *u, qlClose)
 		u->disconnectSocket(true);
+
+	if (bEgressPacing && tBandwidthHints.elapsed() >= 5000000ULL) {
+		tBandwidthHints.restart();
+		updateBandwidthHints();
+	}
+
+	if (tSpeakerSelections.elapsed() >= 5000000ULL) {
+		tSpeakerSelections.restart();
+
+		// A selection is created again as soon as somebody talks in the channel
+		const quint64 now = tUptime.elapsed();
+		QMutexLocker l(&qmSpeakerSelections);
+		for (auto it = qhSpeakerSelections.begin(); it != qhSpeakerSelections.end();) {
+			if (it->isIdle(now))
+				it = qhSpeakerSelections.erase(it);
+			else
+				++it;
+		}
+	}
 }
 
-void Server::tcpTransmitData(QByteArray a, unsigned int id) {
-	Connection *c = qhUsers.value(id);
-	if (c) {
-		QByteArray qba;
-		int len = a.size();
+void Server::tcpTransmitData(unsigned int id) {
+	ServerUser *u = qhUsers.value(id);
+	if (!u)
+		return;
 
-		qba.resize(len + 6);
-		unsigned char *uc                      = reinterpret_cast< unsigned char * >(qba.data());
-		*reinterpret_cast< quint16 * >(&uc[0]) = qToBigEndian(static_cast< quint16 >(MessageHandler::UDPTunnel));
-		*reinterpret_cast< quint32 * >(&uc[2]) = qToBigEndian(static_cast< quint32 >(len));
-		memcpy(uc + 6, a.constData(), len);
+	// The two buffers are swapped, so that the voice thread can go on appending to the (empty) spare one
+	// while this batch is written. Both keep their capacity, so no allocations are needed once they have
+	// grown large enough.
+	QByteArray &batch = u->qbaTunnelSpare;
+	{
+		QMutexLocker l(&u->qmTunnel);
 
-		c->sendMessage(qba);
-		c->forceFlush();
+		batch.swap(u->qbaTunnel);
+		u->bTunnelFlushPending = false;
 	}
+
+	u->sendMessage(batch);
+	u->forceFlush();
+
+	batch.reserve(batch.capacity());
+	batch.resize(0);
 }
 
 void Server::doSync(unsigned int id) {
@@ -1881,6 +2266,11 @@ void Server::removeChannel(Channel *chan, Channel *dest) {
 		sendAll(mpus);
 	}
 
+	{
+		QMutexLocker l(&qmSpeakerSelections);
+		qhSpeakerSelections.remove(chan->iId);
+	}
+
 	MumbleProto::ChannelRemove mpcr;
 	mpcr.set_channel_id(chan->iId);
 	sendAll(mpcr);
@@ -2255,34 +2645,12 @@ bool Server::isTextAllowed(QString &text, bool &changed) {
 		if (!text.contains(QLatin1Char('<')))
 			return false;
 
-		// Strip value from <img>s src attributes to check text-length only -
-		// we already ensured the img-length requirement is met
-		QString qsOut;
-		QXmlStreamReader qxsr(QString::fromLatin1("<document>%1</document>").arg(text));
-		QXmlStreamWriter qxsw(&qsOut);
-		while (!qxsr.atEnd()) {
-			switch (qxsr.readNext()) {
-				case QXmlStreamReader::Invalid:
-					return false;
-				case QXmlStreamReader::StartElement: {
-					if (qxsr.name() == QLatin1String("img")) {
-						qxsw.writeStartElement(qxsr.namespaceUri().toString(), qxsr.name().toString());
-						foreach (const QXmlStreamAttribute &a, qxsr.attributes())
-							if (a.name() != QLatin1String("src"))
-								qxsw.writeAttribute(a);
-					} else {
-						qxsw.writeCurrentToken(qxsr);
-					}
-				} break;
-				default:
-					qxsw.writeCurrentToken(qxsr);
-					break;
-			}
-		}
-
-		length = qsOut.length();
+		// Measure the length without the data in <img>s src attributes to check text-length only -
+		// we already ensured the img-length requirement is met. The message is scanned in place
+		// and scanning stops as soon as the text-length limit is exceeded.
+		length = HTMLFilter::textLength(text, iMaxTextMessageLength);
 
-		return (length <= iMaxTextMessageLength);
+		return (length >= 0) && (length <= iMaxTextMessageLength);
 	}
 }
 
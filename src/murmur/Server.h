@@ -16,15 +16,19 @@
 #include "Ban.h"
 #include "ChannelListenerManager.h"
 #include "HostAddress.h"
+#include "Metrics.h"
 #include "Message.h"
 #include "Mumble.pb.h"
+#include "SpeakerSelection.h"
 #include "Timer.h"
+#include "TimerWheel.h"
 #include "User.h"
 
 #ifndef Q_MOC_RUN
 #	include <boost/function.hpp>
 #endif
 
+#include <QtCore/QDateTime>
 #include <QtCore/QEvent>
 #include <QtCore/QMutex>
 #include <QtCore/QQueue>
@@ -35,6 +39,7 @@
 #include <QtCore/QTimer>
 #include <QtCore/QUrl>
 #include <QtNetwork/QSslCertificate>
+#include <QtNetwork/QSslConfiguration>
 #include <QtNetwork/QSslKey>
 #include <QtNetwork/QSslSocket>
 #include <QtNetwork/QTcpServer>
@@ -114,6 +119,9 @@ public:
 	int iMaxBandwidth;
 	int iMaxUsers;
 	int iMaxUsersPerChannel;
+	int iMaxSpeakersPerChannel;
+	int iMixChannelSize;
+	bool bEgressPacing;
 	int iDefaultChan;
 	bool bRememberChan;
 	int iRememberChanDuration;
@@ -164,6 +172,9 @@ public:
 #if defined(USE_QSSLDIFFIEHELLMANPARAMETERS)
 	QSslDiffieHellmanParameters qsdhpDHParams;
 #endif
+	/// The TLS configuration used for all incoming connections. It is put together once
+	/// by initializeTlsConfiguration() instead of for every new connection.
+	QSslConfiguration qscTlsConfig;
 
 	Timer tUptime;
 
@@ -183,6 +194,29 @@ public:
 	void initZeroconf();
 	void removeZeroconf();
 #endif
+	// Snapshots, implementation in Snapshot.cpp
+	/// @returns The file the snapshot of the given server is written to
+	static QString snapshotPath(int server);
+	/// Writes the channels (with their ACLs, groups and links), the bans and the configuration to a snapshot, so that
+	/// the next start doesn't have to read them from the database. Only called on shutdown.
+	void saveSnapshot();
+	/// Restores the state from the snapshot written by saveSnapshot(). The snapshot is removed afterwards, as it
+	/// would be outdated as soon as the server changes anything in the database.
+	///
+	/// @param generation The generation taken from the database by takeSnapshotGeneration(). Only a snapshot
+	/// 	written with the same generation is used.
+	/// @returns False if there is no usable snapshot, in which case nothing has been restored
+	bool loadSnapshot(const QString &generation);
+	/// Removes the generation that saveSnapshot() stored in the database. This is done on every boot, whether the
+	/// snapshot is used or not, so that a snapshot is never used once the server has run without it.
+	///
+	/// @returns The generation of the last snapshot, or an empty string if there is none
+	QString takeSnapshotGeneration();
+	/// The configuration restored from the snapshot. getConf() uses it instead of the database while bSnapshotConfig
+	/// is set, which is only the case while the server is being constructed.
+	QMap< QString, QString > qmSnapshotConfig;
+	bool bSnapshotConfig;
+
 	// Registration, implementation in Register.cpp
 	QTimer qtTick;
 	void initRegister();
@@ -205,21 +239,29 @@ public:
 	/// If no valid private key is found, a null QSslKey is returned.
 	static QSslKey privateKeyFromPEM(const QByteArray &buf, const QByteArray &pass = QByteArray());
 	void initializeCert();
+	/// Puts the TLS configuration for incoming connections together from the server's certificate
+	/// and the SSL settings in murmur.ini. Called by initializeCert().
+	void initializeTlsConfiguration();
 	const QString getDigest() const;
 
 public slots:
 	void newClient();
+	/// Takes over a connection whose TLS handshake has been completed by the HandshakePool.
+	///
+	/// @param sock The socket of the connection
+	/// @param verified Whether the client's certificate could be verified
+	void acceptClient(QSslSocket *sock, bool verified);
 	void connectionClosed(QAbstractSocket::SocketError, const QString &);
 	void sslError(const QList< QSslError > &);
 	void message(unsigned int, const QByteArray &, ServerUser *cCon = nullptr);
 	void checkTimeout();
-	void tcpTransmitData(QByteArray, unsigned int);
+	void tcpTransmitData(unsigned int);
 	void doSync(unsigned int);
-	void encrypted();
+	void encrypted(ServerUser *uSource);
 	void udpActivated(int);
 signals:
 	void reqSync(unsigned int);
-	void tcpTransmit(QByteArray, unsigned int id);
+	void tcpTransmit(unsigned int id);
 
 public:
 	int iServerNum;
@@ -227,6 +269,24 @@ public:
 	QList< SslServer * > qlServer;
 	QTimer *qtTimeout;
 
+	/// An entry of twHousekeeping
+	struct HousekeepingEntry {
+		enum Type { UserTimeout, BanExpiry } type;
+		unsigned int uiSession;
+		/// Entries whose serial doesn't match the one of the user (or uiBanExpirySerial) are stale and ignored
+		quint64 uiSerial;
+	};
+	/// Keeps track of when the connections may time out and of when the next ban expires, so that checkTimeout()
+	/// doesn't have to look at every single user. Advanced once a second by qtTimeout.
+	TimerWheel< HousekeepingEntry > twHousekeeping;
+	quint64 uiHousekeepingSerial;
+	quint64 uiBanExpirySerial;
+
+	/// Starts keeping track of whether the given user's connection times out.
+	void armTimeout(ServerUser *u);
+	/// Schedules the removal of the next ban that expires. Has to be called whenever qlBans changes.
+	void scheduleBanExpiry();
+
 #ifdef Q_OS_UNIX
 	int aiNotify[2];
 	QList< int > qlUdpSocket;
@@ -296,8 +356,44 @@ public:
 
 	QList< Ban > qlBans;
 
+	/// Statistics about the voice path, see MetricsServer
+	ServerMetrics smMetrics;
+
+	/// The speakers whose speech is forwarded to the channels, by channel ID. Only used if iMaxSpeakersPerChannel
+	/// is set. The selection is made per source channel rather than per recipient, so a user in linked channels
+	/// or listening to several channels may receive more than iMaxSpeakersPerChannel speakers in total. Voice
+	/// packets are routed by both the voice thread and the main thread, so access is guarded by qmSpeakerSelections.
+	QHash< int, SpeakerSelection > qhSpeakerSelections;
+	QMutex qmSpeakerSelections;
+	/// Time since checkTimeout() last dropped the selections of channels nobody is talking in
+	Timer tSpeakerSelections;
+
+	/// The sessions of the users that have paced packets waiting to be sent by the voice thread. Only used if
+	/// bEgressPacing is set. Lock the user's qmEgress before qmPacedUsers if you need both.
+	QSet< unsigned int > qsPacedUsers;
+	QMutex qmPacedUsers;
+	/// Time since the voice thread last released paced packets
+	Timer tPacing;
+	/// Time since updateBandwidthHints() last ran
+	Timer tBandwidthHints;
+
 	void processMsg(ServerUser *u, const char *data, int len);
-	void sendMessage(ServerUser *u, const char *data, int len, QByteArray &cache, bool force = false);
+	/// Sends a voice packet on to the users that receive it. Called by processMsg().
+	///
+	/// @param[out] fanout Incremented for every user the packet is sent to
+	void routeMsg(ServerUser *u, const char *data, int len, unsigned int &fanout);
+	void sendMessage(ServerUser *u, const char *data, int len, bool force = false);
+	/// Encrypts a packet and sends it to the user through UDP. Called by sendMessage().
+	void sendDatagram(ServerUser *u, const char *data, int len);
+	/// Hands a voice packet to the user's EgressPacer.
+	///
+	/// @returns False if the packet has been queued and will be sent by the voice thread later on
+	bool pace(ServerUser *u, const char *data, int len);
+	/// Sends the paced packets that are due. Called by the voice thread.
+	void releasePacedPackets();
+	/// Tells the speakers in channels with congested listeners to lower their bitrate, and the others to go back to
+	/// iMaxBandwidth. If bEgressPacing is not set, every speaker is sent back to iMaxBandwidth immediately.
+	void updateBandwidthHints();
 	void run();
 
 	bool validateChannelName(const QString &name);
@@ -436,6 +532,31 @@ public:
 
 	/// Set last_disconnect of a registered user to the current time
 	void setLastDisconnect(const User *u);
+
+	/// A registered user's last channel and last disconnect time, as cached by qhLastChannels
+	struct LastChannelRecord {
+		int iChannel = -1;
+		QDateTime qdtChannelChanged;
+		QDateTime qdtDisconnect;
+		bool bChannelDirty    = false;
+		bool bDisconnectDirty = false;
+	};
+
+	/// Write-behind cache of users' last channel and last disconnect time, keyed by user ID.
+	/// setLastChannel() and setLastDisconnect() only update this cache; the changes are written
+	/// to the database in a single transaction by flushLastChannels(), which runs every
+	/// LAST_CHANNEL_FLUSH_INTERVAL milliseconds and when the server is stopped. Only pending
+	/// changes are kept; the cache is emptied by every flush.
+	///
+	/// Should Murmur crash, changes made since the last flush are lost. The affected users are
+	/// then treated as if they were still in the channel that was stored before. The database
+	/// itself stays consistent, as every flush is a single transaction.
+	QHash< int, LastChannelRecord > qhLastChannels;
+	QTimer *qtLastChannelFlush;
+	static const int LAST_CHANNEL_FLUSH_INTERVAL = 5000;
+
+	/// Write all pending changes of qhLastChannels to the database
+	void flushLastChannels();
 	void dumpChannel(const Channel *c);
 	int getUserID(const QString &name);
 	QString getUserName(int id);
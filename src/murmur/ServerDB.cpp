@@ -21,12 +21,15 @@
 #include "PasswordGenerator.h"
 #include "Server.h"
 #include "ServerUser.h"
+#include "Supervisor.h"
 #include "User.h"
 
 #include <QtCore/QCoreApplication>
 #include <QtSql/QSqlError>
 #include <QtSql/QSqlQuery>
 
+#include <algorithm>
+
 #ifdef Q_OS_WIN
 #	include <winsock2.h>
 #else
@@ -65,6 +68,34 @@ public:
 QSqlDatabase *ServerDB::db = nullptr;
 Timer ServerDB::tLogClean;
 QString ServerDB::qsUpgradeSuffix;
+QHash< QString, QString > ServerDB::qhExpandedQueries;
+QHash< QString, ServerDB::QueryStatistics > ServerDB::qhQueryStatistics;
+
+void ServerDB::QueryStatistics::record(quint64 usec) {
+	int bucket = 0;
+	while ((bucket < BUCKETS - 1) && (usec >= (Q_UINT64_C(2) << bucket))) {
+		++bucket;
+	}
+
+	++uiBuckets[bucket];
+	++uiCount;
+	uiTotalUsec += usec;
+	uiMaxUsec = std::max(uiMaxUsec, usec);
+}
+
+quint64 ServerDB::QueryStatistics::percentile(double p) const {
+	const quint64 threshold = static_cast< quint64 >(p * static_cast< double >(uiCount));
+
+	quint64 seen = 0;
+	for (int i = 0; i < BUCKETS; ++i) {
+		seen += uiBuckets[i];
+		if (seen > threshold || seen == uiCount) {
+			return Q_UINT64_C(2) << i;
+		}
+	}
+
+	return uiMaxUsec;
+}
 
 void ServerDB::loadOrSetupMetaPBKDF2IterationCount(QSqlQuery &query) {
 	if (!Meta::mp.legacyPasswordHash) {
@@ -829,19 +860,29 @@ ServerDB::ServerDB() {
 		}
 	}
 	query.clear();
+
+	if (Meta::mp.iDBStatsInterval > 0) {
+		connect(&qtStatistics, &QTimer::timeout, this, &ServerDB::logStatistics);
+		qtStatistics.start(Meta::mp.iDBStatsInterval * 1000);
+	}
 }
 
 ServerDB::~ServerDB() {
+	if (Meta::mp.iDBStatsInterval > 0) {
+		logStatistics();
+	}
+
 	db->close();
 	delete db;
 	db = nullptr;
 }
 
-bool ServerDB::prepare(QSqlQuery &query, const QString &str, bool fatal, bool warn) {
-	if (!db->isValid()) {
-		qWarning("SQL [%s] rejected: Database is gone", qPrintable(str));
-		return false;
+QString ServerDB::expandQuery(const QString &str) {
+	QHash< QString, QString >::const_iterator it = qhExpandedQueries.constFind(str);
+	if (it != qhExpandedQueries.constEnd()) {
+		return it.value();
 	}
+
 	QString q;
 	if (str.contains(QLatin1String("%1"))) {
 		if (str.contains(QLatin1String("%2")))
@@ -856,6 +897,54 @@ bool ServerDB::prepare(QSqlQuery &query, const QString &str, bool fatal, bool wa
 		q.replace("`", "\"");
 	}
 
+	qhExpandedQueries.insert(str, q);
+
+	return q;
+}
+
+void ServerDB::recordQueryTime(const QString &query, quint64 usec) {
+	if (Meta::mp.iDBStatsInterval <= 0) {
+		return;
+	}
+
+	qhQueryStatistics[query].record(usec);
+}
+
+void ServerDB::logStatistics() {
+	QList< QPair< QString, QueryStatistics > > stats;
+	for (auto it = qhQueryStatistics.cbegin(); it != qhQueryStatistics.cend(); ++it) {
+		stats << qMakePair(it.key(), it.value());
+	}
+
+	if (stats.isEmpty()) {
+		return;
+	}
+
+	std::sort(stats.begin(), stats.end(),
+			  [](const QPair< QString, QueryStatistics > &a, const QPair< QString, QueryStatistics > &b) {
+				  return a.second.uiTotalUsec > b.second.uiTotalUsec;
+			  });
+
+	qWarning("ServerDB: Query latency statistics (top %d of %d queries by total time):", std::min(stats.size(), 10),
+			 stats.size());
+	for (int i = 0; i < std::min(stats.size(), 10); ++i) {
+		const QueryStatistics &qs = stats.at(i).second;
+		qWarning("ServerDB: %8llu calls, %10.1f ms total, %8llu us avg, p50 < %llu us, p99 < %llu us, max %llu us: %s",
+				 static_cast< unsigned long long >(qs.uiCount), static_cast< double >(qs.uiTotalUsec) / 1000.0,
+				 static_cast< unsigned long long >(qs.uiTotalUsec / qs.uiCount),
+				 static_cast< unsigned long long >(qs.percentile(0.5)),
+				 static_cast< unsigned long long >(qs.percentile(0.99)),
+				 static_cast< unsigned long long >(qs.uiMaxUsec), qPrintable(stats.at(i).first.simplified()));
+	}
+}
+
+bool ServerDB::prepare(QSqlQuery &query, const QString &str, bool fatal, bool warn) {
+	if (!db->isValid()) {
+		qWarning("SQL [%s] rejected: Database is gone", qPrintable(str));
+		return false;
+	}
+	const QString q = expandQuery(str);
+
 	if (query.prepare(q)) {
 		return true;
 	} else {
@@ -885,21 +974,13 @@ bool ServerDB::query(QSqlQuery &query, const QString &str, bool fatal, bool warn
 			qWarning("SQL [%s] rejected: Database is gone", qPrintable(str));
 			return false;
 		}
-		QString q;
-		if (str.contains(QLatin1String("%1"))) {
-			if (str.contains(QLatin1String("%2")))
-				q = str.arg(Meta::mp.qsDBPrefix, qsUpgradeSuffix);
-			else
-				q = str.arg(Meta::mp.qsDBPrefix);
-		} else {
-			q = str;
-		}
+		const QString q = expandQuery(str);
 
-		if (Meta::mp.qsDBDriver == "QPSQL") {
-			q.replace("`", "\"");
-		}
+		Timer t;
+		const bool ok = query.exec(q);
+		recordQueryTime(q, t.elapsed());
 
-		if (query.exec(q)) {
+		if (ok) {
 			return true;
 		} else {
 			if (fatal) {
@@ -918,7 +999,12 @@ bool ServerDB::query(QSqlQuery &query, const QString &str, bool fatal, bool warn
 bool ServerDB::exec(QSqlQuery &query, const QString &str, bool fatal, bool warn) {
 	if (!str.isEmpty())
 		prepare(query, str, fatal, warn);
-	if (query.exec()) {
+
+	Timer t;
+	const bool ok = query.exec();
+	recordQueryTime(query.lastQuery(), t.elapsed());
+
+	if (ok) {
 		return true;
 	} else {
 		if (fatal) {
@@ -934,7 +1020,12 @@ bool ServerDB::exec(QSqlQuery &query, const QString &str, bool fatal, bool warn)
 bool ServerDB::execBatch(QSqlQuery &query, const QString &str, bool fatal) {
 	if (!str.isEmpty())
 		prepare(query, str, fatal);
-	if (query.execBatch()) {
+
+	Timer t;
+	const bool ok = query.execBatch();
+	recordQueryTime(query.lastQuery(), t.elapsed());
+
+	if (ok) {
 		return true;
 	} else {
 		if (fatal) {
@@ -1139,6 +1230,8 @@ bool Server::unregisterUserDB(int id) {
 	query.addBindValue(id);
 	SQLEXEC();
 
+	qhLastChannels.remove(id);
+
 	SQLPREP("DELETE FROM `%1user_info` WHERE `server_id` = ? AND `user_id` = ?");
 	query.addBindValue(iServerNum);
 	query.addBindValue(id);
@@ -1157,6 +1250,9 @@ QList< UserInfo > Server::getRegisteredUsersEx() {
 		users.insert(it.key(), UserInfo(it.key(), it.value()));
 	}
 
+	// Make sure the database reflects the users' current last channels
+	flushLastChannels();
+
 	TransactionHolder th;
 
 	QSqlQuery &query = *th.qsqQuery;
@@ -1231,6 +1327,9 @@ QMap< int, QString > Server::getRegistration(int id) {
 	if (res >= 0)
 		return info;
 
+	// Make sure last_active reflects the user's current last channel
+	flushLastChannels();
+
 	TransactionHolder th;
 
 	QSqlQuery &query = *th.qsqQuery;
@@ -1834,6 +1933,13 @@ void Server::removeChannelDB(const Channel *c) {
 		query.addBindValue(iServerNum);
 		query.addBindValue(c->iId);
 		SQLEXEC();
+
+		// Like the channels_parent_del trigger does in the database, send users whose pending last
+		// channel was removed to the root channel
+		for (LastChannelRecord &record : qhLastChannels) {
+			if (record.bChannelDirty && record.iChannel == c->iId)
+				record.iChannel = 0;
+		}
 	}
 	qhChannels.remove(c->iId);
 }
@@ -2132,18 +2238,10 @@ void Server::setLastChannel(const User *p) {
 	if (p->cChannel->bTemporary)
 		return;
 
-	TransactionHolder th;
-	QSqlQuery &query = *th.qsqQuery;
-
-	if (Meta::mp.qsDBDriver == "QSQLITE") {
-		SQLPREP("UPDATE `%1users` SET `lastchannel`=? WHERE `server_id` = ? AND `user_id` = ?");
-	} else {
-		SQLPREP("UPDATE `%1users` SET `lastchannel`=?, `last_active` = now() WHERE `server_id` = ? AND `user_id` = ?");
-	}
-	query.addBindValue(p->cChannel->iId);
-	query.addBindValue(iServerNum);
-	query.addBindValue(p->iId);
-	SQLEXEC();
+	LastChannelRecord &record = qhLastChannels[p->iId];
+	record.iChannel           = p->cChannel->iId;
+	record.qdtChannelChanged  = QDateTime::currentDateTimeUtc();
+	record.bChannelDirty      = true;
 }
 
 int Server::readLastChannel(int id) {
@@ -2153,30 +2251,39 @@ int Server::readLastChannel(int id) {
 	if (!Meta::mp.bRememberChan)
 		return -1;
 
-	TransactionHolder th;
-	QSqlQuery &query = *th.qsqQuery;
+	// Only pending changes are cached, so anything that is not dirty comes from the database
+	LastChannelRecord record = qhLastChannels.value(id);
 
-	SQLPREP("SELECT `lastchannel`,`last_disconnect` FROM `%1users` WHERE `server_id` = ? AND `user_id` = ?");
-	query.addBindValue(iServerNum);
-	query.addBindValue(id);
-	SQLEXEC();
+	if (!record.bChannelDirty || !record.bDisconnectDirty) {
+		TransactionHolder th;
+		QSqlQuery &query = *th.qsqQuery;
 
-	if (query.next()) {
-		int cid = query.value(0).toInt();
-		if (query.value(1).isNull()) {
-			return qhChannels.contains(cid) ? cid : -1;
-		}
-		QDateTime last_disconnect = QDateTime::fromString(query.value(1).toString(), Qt::ISODate);
-		last_disconnect.setTimeSpec(Qt::UTC);
-		QDateTime now = QDateTime::currentDateTime();
-		now           = now.toTimeSpec(Qt::UTC);
-
-		int duration = Meta::mp.iRememberChanDuration;
-		if (duration <= 0 || last_disconnect.secsTo(now) <= duration) {
-			if (qhChannels.contains(cid))
-				return cid;
+		SQLPREP("SELECT `lastchannel`,`last_disconnect` FROM `%1users` WHERE `server_id` = ? AND `user_id` = ?");
+		query.addBindValue(iServerNum);
+		query.addBindValue(id);
+		SQLEXEC();
+
+		if (query.next()) {
+			if (!record.bChannelDirty) {
+				record.iChannel = query.value(0).toInt();
+			}
+			if (!record.bDisconnectDirty && !query.value(1).isNull()) {
+				record.qdtDisconnect = QDateTime::fromString(query.value(1).toString(), Qt::ISODate);
+				record.qdtDisconnect.setTimeSpec(Qt::UTC);
+			}
 		}
 	}
+
+	const int cid = record.iChannel;
+	if (record.qdtDisconnect.isNull()) {
+		return qhChannels.contains(cid) ? cid : -1;
+	}
+
+	int duration = Meta::mp.iRememberChanDuration;
+	if (duration <= 0 || record.qdtDisconnect.secsTo(QDateTime::currentDateTimeUtc()) <= duration) {
+		if (qhChannels.contains(cid))
+			return cid;
+	}
 	return -1;
 }
 
@@ -2185,18 +2292,70 @@ void Server::setLastDisconnect(const User *p) {
 	if (p->iId < 0)
 		return;
 
+	LastChannelRecord &record = qhLastChannels[p->iId];
+	record.qdtDisconnect      = QDateTime::currentDateTimeUtc();
+	record.bDisconnectDirty   = true;
+}
+
+void Server::flushLastChannels() {
+	const bool sqlite = (Meta::mp.qsDBDriver == "QSQLITE");
+
+	// SQLite stores dates as text in the format produced by datetime('now')
+	auto toDBTime = [sqlite](const QDateTime &dt) -> QVariant {
+		return sqlite ? QVariant(dt.toString(QLatin1String("yyyy-MM-dd HH:mm:ss"))) : QVariant(dt);
+	};
+
+	QVariantList channelIds, channelTimes, channelUsers, channelServers;
+	QVariantList disconnectTimes, disconnectUsers, disconnectServers;
+
+	for (auto it = qhLastChannels.cbegin(); it != qhLastChannels.cend(); ++it) {
+		const LastChannelRecord &record = it.value();
+
+		if (record.bChannelDirty) {
+			channelIds << record.iChannel;
+			channelTimes << toDBTime(record.qdtChannelChanged);
+			channelUsers << it.key();
+			channelServers << iServerNum;
+		}
+		if (record.bDisconnectDirty) {
+			disconnectTimes << toDBTime(record.qdtDisconnect);
+			disconnectUsers << it.key();
+			disconnectServers << iServerNum;
+		}
+	}
+
+	// Once written, the records are clean and readLastChannel() reads them from the database
+	qhLastChannels.clear();
+
+	if (channelUsers.isEmpty() && disconnectUsers.isEmpty())
+		return;
+
 	TransactionHolder th;
 	QSqlQuery &query = *th.qsqQuery;
 
-	if (Meta::mp.qsDBDriver == "QSQLITE") {
-		SQLPREP("UPDATE `%1users` SET `last_disconnect` = datetime('now') WHERE `server_id` = ? AND `user_id` = ?");
-	} else {
-		// MySQL or PostgreSQL
-		SQLPREP("UPDATE `%1users` SET `last_disconnect` = now() WHERE `server_id` = ? AND `user_id` = ?");
+	if (!channelUsers.isEmpty()) {
+		if (sqlite) {
+			// The users_update_timestamp trigger takes care of last_active
+			SQLPREP("UPDATE `%1users` SET `lastchannel`=? WHERE `server_id` = ? AND `user_id` = ?");
+		} else {
+			SQLPREP("UPDATE `%1users` SET `lastchannel`=?, `last_active` = ? WHERE `server_id` = ? AND `user_id` = ?");
+		}
+		query.addBindValue(channelIds);
+		if (!sqlite) {
+			query.addBindValue(channelTimes);
+		}
+		query.addBindValue(channelServers);
+		query.addBindValue(channelUsers);
+		SQLEXECBATCH();
+	}
+
+	if (!disconnectUsers.isEmpty()) {
+		SQLPREP("UPDATE `%1users` SET `last_disconnect` = ? WHERE `server_id` = ? AND `user_id` = ?");
+		query.addBindValue(disconnectTimes);
+		query.addBindValue(disconnectServers);
+		query.addBindValue(disconnectUsers);
+		SQLEXECBATCH();
 	}
-	query.addBindValue(iServerNum);
-	query.addBindValue(p->iId);
-	SQLEXEC();
 }
 
 void Server::dumpChannel(const Channel *c) {
@@ -2252,6 +2411,8 @@ void Server::getBans() {
 		if (ban.isValid())
 			qlBans << ban;
 	}
+
+	scheduleBanExpiry();
 }
 
 void Server::saveBans() {
@@ -2275,9 +2436,15 @@ void Server::saveBans() {
 		query.addBindValue(ban.iDuration);
 		SQLEXEC();
 	}
+
+	scheduleBanExpiry();
 }
 
 QVariant Server::getConf(const QString &key, QVariant def) {
+	if (bSnapshotConfig) {
+		auto it = qmSnapshotConfig.constFind(key);
+		return it != qmSnapshotConfig.constEnd() ? QVariant(*it) : def;
+	}
 	return ServerDB::getConf(iServerNum, key, def);
 }
 
@@ -2474,6 +2641,8 @@ int ServerDB::addServer() {
 	int id = 0;
 	if (query.next())
 		id = qMax(1, query.value(0).toInt());
+	// A worker process only creates servers it hosts itself, so that they can be started right away
+	id = Supervisor::nextOwned(id);
 	SQLPREP("INSERT INTO `%1servers` (`server_id`) VALUES (?)");
 	query.addBindValue(id);
 	SQLEXEC();
@@ -6,6 +6,8 @@
 #ifndef MUMBLE_MURMUR_DATABASE_H_
 #define MUMBLE_MURMUR_DATABASE_H_
 
+#include <QtCore/QHash>
+#include <QtCore/QTimer>
 #include <QtCore/QVariant>
 
 #include "Timer.h"
@@ -28,6 +30,21 @@ public:
 	/// code" into the ServerDB code.
 	static const int DB_STRUCTURE_VERSION = 8;
 
+	/// Latency statistics of a single query. Execution times are counted in buckets of
+	/// powers of two microseconds, which is precise enough to tell which queries dominate.
+	struct QueryStatistics {
+		static const int BUCKETS = 24;
+
+		quint64 uiCount            = 0;
+		quint64 uiTotalUsec        = 0;
+		quint64 uiMaxUsec          = 0;
+		quint64 uiBuckets[BUCKETS] = {};
+
+		void record(quint64 usec);
+		/// @returns The upper bound (in microseconds) of the bucket containing the given percentile
+		quint64 percentile(double p) const;
+	};
+
 	enum ChannelInfo { Channel_Description, Channel_Position, Channel_Max_Users };
 	enum UserInfo {
 		User_Name,
@@ -66,12 +83,23 @@ public:
 	ServerDB(const ServerDB &);
 
 private:
+	/// Cache of query templates (as used in the source) to the final SQL string with the table
+	/// prefix and driver-specific quoting applied. Like the rest of ServerDB, only used from the main thread.
+	static QHash< QString, QString > qhExpandedQueries;
+	static QHash< QString, QueryStatistics > qhQueryStatistics;
+
+	QTimer qtStatistics;
+
+	static QString expandQuery(const QString &str);
+	static void recordQueryTime(const QString &query, quint64 usec);
 	static void loadOrSetupMetaPBKDF2IterationCount(QSqlQuery &query);
 	static void writeSUPW(int srvnum, const QString &pwHash, const QString &saltHash, const QVariant &kdfIterations);
 
 public slots:
 	/// Clear last_disconnect date of every user of the server
 	void clearLastDisconnect(Server *);
+	/// Writes the latency statistics of the most expensive queries to the log
+	void logStatistics();
 };
 
 #endif
@@ -26,6 +26,9 @@ ServerUser::ServerUser(Server *p, QSslSocket *socket)
 	uiUDPPackets = uiTCPPackets = 0;
 
 	aiUdpFlag            = 1;
+	bTunnelFlushPending  = false;
+	iBandwidthHint       = 0;
+	uiTimeoutSerial      = 0;
 	uiVersion            = 0;
 	bVerified            = true;
 	iLastPermissionCheck = -1;
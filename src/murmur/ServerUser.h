@@ -13,11 +13,14 @@
 #endif
 
 #include "Connection.h"
+#include "EgressPacer.h"
 #include "HostAddress.h"
 #include "Timer.h"
 #include "User.h"
 
+#include <QtCore/QByteArray>
 #include <QtCore/QElapsedTimer>
+#include <QtCore/QMutex>
 #include <QtCore/QStringList>
 
 #ifdef Q_OS_WIN
@@ -137,6 +140,28 @@ public:
 	/// UDP.
 	QAtomicInt aiUdpFlag;
 
+	/// Voice packets that are to be sent through the TCP connection, already framed as UDPTunnel messages.
+	/// They are written to the socket in batches by Server::tcpTransmitData(). You have to lock qmTunnel
+	/// before accessing qbaTunnel or bTunnelFlushPending.
+	QMutex qmTunnel;
+	QByteArray qbaTunnel;
+	/// Whether a call to Server::tcpTransmitData() has been scheduled for qbaTunnel already
+	bool bTunnelFlushPending;
+	/// The buffer that is swapped with qbaTunnel when writing a batch. Only used by the main thread.
+	QByteArray qbaTunnelSpare;
+
+	/// Paces the voice packets sent to the user through UDP if their downstream can't keep up. You have to lock
+	/// qmEgress before accessing epEgress.
+	QMutex qmEgress;
+	EgressPacer epEgress;
+	/// The bandwidth the user has last been told to stay below in order to spare the listeners in their channel, or 0
+	/// if they have been told the server's limit. See Server::updateBandwidthHints().
+	int iBandwidthHint;
+	Timer tBandwidthHint;
+
+	/// Identifies the entry of Server::twHousekeeping that checks whether this user has timed out
+	quint64 uiTimeoutSerial;
+
 	QList< int > qlCodecs;
 	bool bOpus;
 
@@ -0,0 +1,225 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "ACL.h"
+#include "Channel.h"
+#include "Group.h"
+#include "Meta.h"
+#include "Server.h"
+#include "ServerDB.h"
+#include "SnapshotFile.h"
+#include "crypto/CryptographicRandom.h"
+
+#include <QtCore/QDataStream>
+#include <QtCore/QDir>
+
+// The payload of a snapshot (see SnapshotFile) holds the server's configuration from the database, the bans, the
+// permanent channels in pre-order (each with its groups and ACLs) and finally the channel links.
+//
+// The snapshot is only valid as long as the database hasn't been changed, which is why it is written on shutdown
+// and removed as soon as it has been read. On top of that, a random generation is stored in both the snapshot and
+// the server's configuration in the database. Every boot removes it from the database, so a snapshot left behind
+// by a run that didn't use it (e.g. because snapshotdir wasn't set) no longer matches.
+
+static SnapshotFile::Origin snapshotOrigin(int server, const QString &generation) {
+	return { server, Meta::mp.qsDBDriver, Meta::mp.qsDatabase, Meta::mp.qsDBPrefix, generation };
+}
+
+static void writeChannel(QDataStream &ds, const Channel *c, QList< const Channel * > &written) {
+	if (c->bTemporary)
+		return;
+
+	written << c;
+
+	ds << c->iId << (c->cParent ? c->cParent->iId : -1) << c->qsName << c->bInheritACL << c->qsDesc << c->iPosition
+	   << c->uiMaxUsers;
+
+	ds << c->qhGroups.count();
+	foreach (const Group *g, c->qhGroups)
+		ds << g->qsName << g->bInherit << g->bInheritable << g->qsAdd << g->qsRemove;
+
+	ds << c->qlACL.count();
+	foreach (const ChanACL *acl, c->qlACL)
+		ds << acl->iUserId << acl->qsGroup << acl->bApplyHere << acl->bApplySubs << static_cast< int >(acl->pAllow)
+		   << static_cast< int >(acl->pDeny);
+
+	foreach (const Channel *child, c->qlChannels)
+		writeChannel(ds, child, written);
+}
+
+QString Server::snapshotPath(int server) {
+	return QDir(Meta::mp.qsSnapshotDir).filePath(QString::fromLatin1("server%1.snapshot").arg(server));
+}
+
+void Server::saveSnapshot() {
+	Channel *root = qhChannels.value(0);
+	if (!root)
+		return;
+
+	QByteArray payload;
+	{
+		QDataStream ds(&payload, QIODevice::WriteOnly);
+		ds.setVersion(QDataStream::Qt_5_0);
+
+		ds << ServerDB::getAllConf(iServerNum);
+
+		ds << qlBans.count();
+		foreach (const Ban &ban, qlBans)
+			ds << ban.haAddress.toByteArray() << ban.iMask << ban.qsUsername << ban.qsHash << ban.qsReason
+			   << ban.qdtStart << ban.iDuration;
+
+		QList< const Channel * > channels;
+		QByteArray qbaChannels;
+		{
+			QDataStream cds(&qbaChannels, QIODevice::WriteOnly);
+			cds.setVersion(QDataStream::Qt_5_0);
+			writeChannel(cds, root, channels);
+		}
+		ds << channels.count();
+		ds.writeRawData(qbaChannels.constData(), qbaChannels.size());
+
+		QList< QPair< int, int > > links;
+		foreach (const Channel *c, channels) {
+			foreach (const Channel *l, c->qsPermLinks) {
+				if (!l->bTemporary && c->iId < l->iId)
+					links << qMakePair(c->iId, l->iId);
+			}
+		}
+		ds << links;
+	}
+
+	QByteArray random(16, Qt::Uninitialized);
+	CryptographicRandom::fillBuffer(random.data(), random.size());
+	const QString generation = QLatin1String(random.toHex());
+	ServerDB::setConf(iServerNum, QLatin1String("snapshot_generation"), generation);
+
+	const QString path = snapshotPath(iServerNum);
+	QString error;
+	if (!SnapshotFile::write(path, snapshotOrigin(iServerNum, generation), payload, error))
+		log(QString("Failed to write snapshot to %1: %2").arg(path, error));
+	else
+		log(QString("Wrote snapshot of %1 channels and %2 bans").arg(qhChannels.count()).arg(qlBans.count()));
+}
+
+QString Server::takeSnapshotGeneration() {
+	const QString generation = ServerDB::getConf(iServerNum, QLatin1String("snapshot_generation")).toString();
+	if (!generation.isEmpty())
+		ServerDB::setConf(iServerNum, QLatin1String("snapshot_generation"));
+	return generation;
+}
+
+bool Server::loadSnapshot(const QString &generation) {
+	const QString path = snapshotPath(iServerNum);
+	QByteArray payload;
+	switch (SnapshotFile::read(path, snapshotOrigin(iServerNum, generation), payload)) {
+		case SnapshotFile::Missing:
+			return false;
+		case SnapshotFile::Foreign:
+			log(QString("Ignoring snapshot %1, it doesn't belong to this server or version, or is outdated").arg(path));
+			return false;
+		case SnapshotFile::Damaged:
+			log(QString("Ignoring snapshot %1, it is damaged").arg(path));
+			return false;
+		case SnapshotFile::Ok:
+			break;
+	}
+
+	bool ok = true;
+
+	QDataStream ds(payload);
+	ds.setVersion(QDataStream::Qt_5_0);
+
+	QMap< QString, QString > config;
+	ds >> config;
+
+	QList< Ban > bans;
+	int count = 0;
+	ds >> count;
+	for (int i = 0; i < count && ds.status() == QDataStream::Ok; ++i) {
+		Ban ban;
+		QByteArray address;
+		ds >> address >> ban.iMask >> ban.qsUsername >> ban.qsHash >> ban.qsReason >> ban.qdtStart >> ban.iDuration;
+		ban.haAddress = HostAddress(address);
+		ban.qdtStart.setTimeSpec(Qt::UTC);
+		if (ban.isValid())
+			bans << ban;
+	}
+
+	Channel *root = nullptr;
+	ds >> count;
+	for (int i = 0; i < count && ds.status() == QDataStream::Ok; ++i) {
+		int id, parentId;
+		QString name;
+		bool inheritACL;
+		QString desc;
+		int position;
+		unsigned int maxUsers;
+		ds >> id >> parentId >> name >> inheritACL >> desc >> position >> maxUsers;
+
+		Channel *parent = qhChannels.value(parentId);
+		if (ds.status() != QDataStream::Ok || qhChannels.contains(id) || (root ? !parent : (id != 0))) {
+			ok = false;
+			break;
+		}
+
+		Channel *c = new Channel(id, name, parent);
+		if (!parent) {
+			c->setParent(this);
+			root = c;
+		}
+		qhChannels.insert(id, c);
+		c->bInheritACL = inheritACL;
+		hashAssign(c->qsDesc, c->qbaDescHash, desc);
+		c->iPosition  = position;
+		c->uiMaxUsers = maxUsers;
+
+		int groups = 0;
+		ds >> groups;
+		for (int j = 0; j < groups && ds.status() == QDataStream::Ok; ++j) {
+			QString groupName;
+			ds >> groupName;
+			Group *g = new Group(c, groupName);
+			ds >> g->bInherit >> g->bInheritable >> g->qsAdd >> g->qsRemove;
+		}
+
+		int acls = 0;
+		ds >> acls;
+		for (int j = 0; j < acls && ds.status() == QDataStream::Ok; ++j) {
+			ChanACL *acl = new ChanACL(c);
+			int allow, deny;
+			ds >> acl->iUserId >> acl->qsGroup >> acl->bApplyHere >> acl->bApplySubs >> allow >> deny;
+			acl->pAllow = static_cast< ChanACL::Permissions >(allow);
+			acl->pDeny  = static_cast< ChanACL::Permissions >(deny);
+		}
+	}
+
+	QList< QPair< int, int > > links;
+	ds >> links;
+
+	if (!ok || !root || ds.status() != QDataStream::Ok) {
+		log("Ignoring snapshot, it couldn't be read");
+		qhChannels.clear();
+		delete root;
+		return false;
+	}
+
+	{
+		QWriteLocker wl(&qrwlVoiceThread);
+		foreach (const auto &link, links) {
+			Channel *c = qhChannels.value(link.first);
+			Channel *l = qhChannels.value(link.second);
+			if (c && l)
+				c->link(l);
+		}
+	}
+
+	qlBans           = bans;
+	qmSnapshotConfig = config;
+	bSnapshotConfig  = true;
+
+	log(QString("Restored %1 channels and %2 bans from snapshot").arg(qhChannels.count()).arg(qlBans.count()));
+
+	return true;
+}
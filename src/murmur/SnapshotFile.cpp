@@ -0,0 +1,80 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "SnapshotFile.h"
+
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDataStream>
+#include <QtCore/QFile>
+#include <QtCore/QSaveFile>
+
+static const quint32 SNAPSHOT_MAGIC   = 0x4d534e50; // "MSNP"
+static const quint32 SNAPSHOT_VERSION = 2;
+
+bool SnapshotFile::write(const QString &path, const Origin &origin, const QByteArray &payload, QString &error) {
+	QSaveFile f(path);
+	if (!f.open(QIODevice::WriteOnly)) {
+		error = f.errorString();
+		return false;
+	}
+
+	// Before anything is written, as the temporary file is created with the default permissions
+	if (!f.setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner)) {
+		error = f.errorString();
+		f.cancelWriting();
+		return false;
+	}
+
+	QDataStream ds(&f);
+	ds.setVersion(QDataStream::Qt_5_0);
+	ds << SNAPSHOT_MAGIC << SNAPSHOT_VERSION << origin.iServer << origin.qsDriver << origin.qsDatabase
+	   << origin.qsPrefix << origin.qsGeneration;
+	ds << QCryptographicHash::hash(payload, QCryptographicHash::Sha1) << payload;
+
+	if (ds.status() != QDataStream::Ok || !f.commit()) {
+		error = f.errorString();
+		return false;
+	}
+
+	return true;
+}
+
+SnapshotFile::Result SnapshotFile::read(const QString &path, const Origin &origin, QByteArray &payload) {
+	QFile f(path);
+	if (!f.exists() || !f.open(QIODevice::ReadOnly))
+		return Missing;
+
+	QDataStream ds(&f);
+	ds.setVersion(QDataStream::Qt_5_0);
+
+	quint32 magic, version;
+	int server = -1;
+	QString driver, database, prefix, generation;
+	ds >> magic >> version;
+	if (ds.status() == QDataStream::Ok && magic == SNAPSHOT_MAGIC && version == SNAPSHOT_VERSION)
+		ds >> server >> driver >> database >> prefix >> generation;
+
+	Result result;
+	if (ds.status() != QDataStream::Ok || magic != SNAPSHOT_MAGIC || version != SNAPSHOT_VERSION
+		|| server != origin.iServer || driver != origin.qsDriver || database != origin.qsDatabase
+		|| prefix != origin.qsPrefix || generation != origin.qsGeneration) {
+		result = Foreign;
+	} else {
+		QByteArray hash;
+		ds >> hash >> payload;
+		if (ds.status() != QDataStream::Ok || hash != QCryptographicHash::hash(payload, QCryptographicHash::Sha1))
+			result = Damaged;
+		else
+			result = Ok;
+	}
+
+	// The snapshot is only ever used once
+	f.close();
+	f.remove();
+
+	if (result != Ok)
+		payload.clear();
+	return result;
+}
@@ -0,0 +1,50 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_SNAPSHOTFILE_H_
+#define MUMBLE_MURMUR_SNAPSHOTFILE_H_
+
+#include <QtCore/QByteArray>
+#include <QtCore/QString>
+
+/// The file a snapshot is kept in (see Server::saveSnapshot()).
+///
+/// The file starts with a header that identifies the format and the server and database the snapshot was taken from,
+/// followed by the SHA-1 of the payload and the payload itself. What the payload contains is up to the server.
+class SnapshotFile {
+public:
+	/// The server and database a snapshot belongs to
+	struct Origin {
+		int iServer;
+		QString qsDriver;
+		QString qsDatabase;
+		QString qsPrefix;
+		/// Identifies the state of the database the snapshot was taken from
+		QString qsGeneration;
+	};
+
+	enum Result {
+		/// There is no snapshot
+		Missing,
+		/// The snapshot has been taken from another server, database or generation, or is of another format version
+		Foreign,
+		/// The snapshot can't be read or its hash doesn't match
+		Damaged,
+		Ok
+	};
+
+	/// Writes a snapshot. The payload contains the server's private key and passwords, so only the owner may read the
+	/// file.
+	///
+	/// @param error Set to the reason if the snapshot couldn't be written
+	/// @returns Whether the snapshot has been written
+	static bool write(const QString &path, const Origin &origin, const QByteArray &payload, QString &error);
+	/// Reads a snapshot and removes it, whether it is usable or not.
+	///
+	/// @param payload Set to the payload if Ok is returned
+	static Result read(const QString &path, const Origin &origin, QByteArray &payload);
+};
+
+#endif
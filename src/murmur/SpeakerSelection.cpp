@@ -0,0 +1,103 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "SpeakerSelection.h"
+
+SpeakerSelection::SpeakerSelection() : iSelected(0), uiLastExpiry(0) {
+}
+
+bool SpeakerSelection::admit(unsigned int session, quint64 now, unsigned int bytes, bool priority, bool terminator,
+							 int maxSpeakers) {
+	expire(now);
+
+	auto it = qhSpeakers.find(session);
+	if (it == qhSpeakers.end()) {
+		// Assume 20 ms of audio per packet until we know better
+		it = qhSpeakers.insert(session, { bytes * 50.0, now, 0, false, priority });
+	} else {
+		const quint64 interval = qMax< quint64 >(now > it->uiLastPacket ? now - it->uiLastPacket : 0, 10000ULL);
+		it->dLevel             = it->dLevel * 0.875 + bytes * 1000000.0 / static_cast< double >(interval) * 0.125;
+		it->uiLastPacket       = now;
+		it->bPriority          = priority;
+	}
+
+	Speaker &s   = *it;
+	bool forward = true;
+
+	if (!s.bSelected) {
+		if (priority || iSelected < maxSpeakers) {
+			select(s, now);
+		} else {
+			// Look for the quietest speaker that may be replaced
+			Speaker *weakest = nullptr;
+			for (Speaker &other : qhSpeakers) {
+				if (other.bSelected && !other.bPriority && now - other.uiSelectedAt >= MIN_SELECTED_TIME
+					&& (!weakest || other.dLevel < weakest->dLevel))
+					weakest = &other;
+			}
+
+			if (weakest && s.dLevel > weakest->dLevel * HYSTERESIS) {
+				deselect(*weakest);
+				select(s, now);
+			} else {
+				forward = false;
+			}
+		}
+	}
+
+	if (terminator) {
+		// Frees the slot right away. The terminator itself still has to reach the listeners though.
+		if (s.bSelected)
+			deselect(s);
+		qhSpeakers.erase(it);
+	}
+
+	return forward;
+}
+
+int SpeakerSelection::selected() const {
+	return iSelected;
+}
+
+bool SpeakerSelection::isSelected(unsigned int session) const {
+	auto it = qhSpeakers.constFind(session);
+	return it != qhSpeakers.constEnd() && it->bSelected;
+}
+
+bool SpeakerSelection::isIdle(quint64 now) const {
+	for (const Speaker &s : qhSpeakers) {
+		if (now - s.uiLastPacket <= HOLD_TIME)
+			return false;
+	}
+	return true;
+}
+
+void SpeakerSelection::expire(quint64 now) {
+	// Speakers don't have to be expired with more precision than this
+	if (now - uiLastExpiry < HOLD_TIME / 4)
+		return;
+	uiLastExpiry = now;
+
+	for (auto it = qhSpeakers.begin(); it != qhSpeakers.end();) {
+		if (now - it->uiLastPacket > HOLD_TIME) {
+			if (it->bSelected)
+				deselect(*it);
+			it = qhSpeakers.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+void SpeakerSelection::select(Speaker &s, quint64 now) {
+	s.bSelected    = true;
+	s.uiSelectedAt = now;
+	iSelected++;
+}
+
+void SpeakerSelection::deselect(Speaker &s) {
+	s.bSelected = false;
+	iSelected--;
+}
@@ -0,0 +1,72 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_SPEAKERSELECTION_H_
+#define MUMBLE_MURMUR_SPEAKERSELECTION_H_
+
+#include <QtCore/QHash>
+
+/// Decides which of the users talking in a channel at the same time are forwarded to the channel's listeners.
+///
+/// Speakers are ranked by the rate of voice data they send. With VBR codecs like Opus that rate goes up with the
+/// level and complexity of the audio, so it serves as a (rough) hint at how loud somebody is. At most a given number
+/// of speakers is selected at a time:
+///  - A speaker that is selected stays selected until the end of the transmission, or until no packets have been
+///    received from them for HOLD_TIME.
+///  - If all slots are taken, a newcomer only replaces the quietest selected speaker if that speaker has been
+///    selected for at least MIN_SELECTED_TIME and the newcomer is louder by HYSTERESIS. This keeps the selection from
+///    flapping between speakers that are about equally loud.
+///  - Priority speakers are always selected and never replaced, even if that means selecting more speakers than
+///    allowed.
+class SpeakerSelection {
+public:
+	/// Time without packets after which a speaker is no longer considered to be talking, in microseconds
+	static const quint64 HOLD_TIME = 400000ULL;
+	/// Time a speaker is selected for at least, in microseconds
+	static const quint64 MIN_SELECTED_TIME = 1000000ULL;
+	/// Factor by which a newcomer has to be louder than a selected speaker in order to replace them
+	static constexpr double HYSTERESIS = 1.5;
+
+	SpeakerSelection();
+
+	/// Accounts a voice packet and decides whether it is forwarded.
+	///
+	/// @param session The session of the speaker
+	/// @param now The current time, in microseconds
+	/// @param bytes The size of the packet
+	/// @param priority Whether the speaker is a priority speaker
+	/// @param terminator Whether the packet ends the transmission
+	/// @param maxSpeakers The amount of speakers that may be selected at the same time
+	/// @returns Whether the packet should be forwarded
+	bool admit(unsigned int session, quint64 now, unsigned int bytes, bool priority, bool terminator,
+			   int maxSpeakers);
+
+	/// @returns The amount of currently selected speakers
+	int selected() const;
+	/// @returns Whether the given speaker is currently selected
+	bool isSelected(unsigned int session) const;
+	/// @returns Whether nobody has been talking for at least HOLD_TIME
+	bool isIdle(quint64 now) const;
+
+protected:
+	struct Speaker {
+		/// Smoothed rate of voice data, in bytes per second
+		double dLevel;
+		quint64 uiLastPacket;
+		quint64 uiSelectedAt;
+		bool bSelected;
+		bool bPriority;
+	};
+
+	QHash< unsigned int, Speaker > qhSpeakers;
+	int iSelected;
+	quint64 uiLastExpiry;
+
+	void expire(quint64 now);
+	void select(Speaker &s, quint64 now);
+	void deselect(Speaker &s);
+};
+
+#endif
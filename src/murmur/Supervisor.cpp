@@ -0,0 +1,157 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "Supervisor.h"
+
+#include "Meta.h"
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QTimer>
+
+#ifdef Q_OS_LINUX
+#	include <sched.h>
+#endif
+#ifdef Q_OS_UNIX
+#	include <signal.h>
+#endif
+
+Supervisor::Supervisor(const QStringList &arguments, QObject *p)
+	: QObject(p), qslArguments(arguments), bStopping(false) {
+}
+
+Supervisor::~Supervisor() {
+	stop();
+}
+
+void Supervisor::start() {
+	if (Meta::mp.qsDBDriver == QLatin1String("QSQLITE") && Meta::mp.iSQLiteWAL == 0)
+		qWarning("Supervisor: The workers share the SQLite database, but only one of them can write to it at a "
+				 "time. Consider enabling sqlite_wal or using a database server.");
+
+	for (int i = 0; i < Meta::mp.iWorkers; ++i) {
+		QProcess *qp = new QProcess(this);
+		// The workers log to the same file (or console) as we do
+		qp->setProcessChannelMode(QProcess::ForwardedChannels);
+		qp->setProperty("worker", i);
+		connect(qp, SIGNAL(finished(int, QProcess::ExitStatus)), this,
+				SLOT(workerFinished(int, QProcess::ExitStatus)));
+		qlWorkers << qp;
+		qlStarted << QElapsedTimer();
+		qlFailures << 0;
+
+		startWorker(i);
+	}
+}
+
+void Supervisor::stop() {
+	if (bStopping)
+		return;
+	bStopping = true;
+
+	foreach (QProcess *qp, qlWorkers) {
+		if (qp->state() != QProcess::NotRunning)
+			qp->terminate();
+	}
+
+	foreach (QProcess *qp, qlWorkers) {
+		if (qp->state() != QProcess::NotRunning && !qp->waitForFinished(STOP_TIMEOUT)) {
+			qWarning("Supervisor: Worker %d didn't shut down in time, killing it", qp->property("worker").toInt());
+			qp->kill();
+			qp->waitForFinished();
+		}
+	}
+}
+
+void Supervisor::signalWorkers(int signum) {
+#ifdef Q_OS_UNIX
+	foreach (QProcess *qp, qlWorkers) {
+		if (qp->state() == QProcess::Running)
+			::kill(static_cast< pid_t >(qp->processId()), signum);
+	}
+#else
+	Q_UNUSED(signum);
+#endif
+}
+
+void Supervisor::startWorker(int worker) {
+	if (bStopping)
+		return;
+
+	QStringList args;
+	args << QLatin1String("-ini") << Meta::mp.qsAbsSettingsFilePath << QLatin1String("-worker")
+		 << QString::number(worker);
+	args << qslArguments;
+
+	qlStarted[worker].start();
+	qlWorkers.at(worker)->start(QCoreApplication::applicationFilePath(), args);
+	qWarning("Supervisor: Started worker %d", worker);
+}
+
+void Supervisor::workerFinished(int exitCode, QProcess::ExitStatus exitStatus) {
+	QProcess *qp = qobject_cast< QProcess * >(sender());
+	if (!qp || bStopping)
+		return;
+
+	const int worker = qp->property("worker").toInt();
+	const char *how  = exitStatus == QProcess::CrashExit ? "crashed" : "exited";
+
+	// A worker that keeps failing right after it has been started most likely can't start at all (e.g. because of
+	// its configuration), so it is given more and more time until it is given up on
+	int &failures = qlFailures[worker];
+	if (qlStarted.at(worker).elapsed() >= STABLE_TIME)
+		failures = 0;
+	++failures;
+
+	if (failures > MAX_FAILURES) {
+		qCritical("Supervisor: Worker %d %s with code %d, giving up after %d failed starts in a row", worker, how,
+				  exitCode, MAX_FAILURES);
+		return;
+	}
+
+	const int delay = restartDelay(failures);
+	qWarning("Supervisor: Worker %d %s with code %d, restarting it in %d seconds", worker, how, exitCode,
+			 delay / 1000);
+
+	QTimer::singleShot(delay, this, [this, worker]() { startWorker(worker); });
+}
+
+bool Supervisor::owns(int server) {
+	return owns(server, Meta::mp.iWorkers, Meta::mp.iWorkerIndex);
+}
+
+int Supervisor::nextOwned(int server) {
+	return nextOwned(server, Meta::mp.iWorkers, Meta::mp.iWorkerIndex);
+}
+
+void Supervisor::pin(int worker) {
+	const QStringList sets = Meta::mp.qsWorkerCPUs.split(QLatin1Char(';'));
+	if (worker >= sets.count() || sets.at(worker).trimmed().isEmpty())
+		return;
+
+#ifdef Q_OS_LINUX
+	// A set is a list of CPUs and ranges of CPUs, e.g. "0-3,8"
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	foreach (const QString &item, sets.at(worker).split(QLatin1Char(','))) {
+		const QStringList range = item.trimmed().split(QLatin1Char('-'));
+		bool okFirst, okLast = true;
+		const int first = range.at(0).toInt(&okFirst);
+		const int last  = range.count() > 1 ? range.at(1).toInt(&okLast) : first;
+		if (!okFirst || !okLast || range.count() > 2 || first < 0 || last < first || last >= CPU_SETSIZE) {
+			qWarning("Supervisor: Invalid CPU set \"%s\" for worker %d", qPrintable(sets.at(worker)), worker);
+			return;
+		}
+		for (int cpu = first; cpu <= last; ++cpu)
+			CPU_SET(cpu, &cpus);
+	}
+
+	if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0)
+		qWarning("Supervisor: Failed to pin worker %d to CPUs %s", worker, qPrintable(sets.at(worker)));
+	else
+		qWarning("Supervisor: Pinned worker %d to CPUs %s", worker, qPrintable(sets.at(worker)));
+#else
+	qWarning("Supervisor: Pinning workers to CPUs is not supported on this platform");
+#endif
+}
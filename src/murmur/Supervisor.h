@@ -0,0 +1,92 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_SUPERVISOR_H_
+#define MUMBLE_MURMUR_SUPERVISOR_H_
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QList>
+#include <QtCore/QObject>
+#include <QtCore/QProcess>
+#include <QtCore/QStringList>
+
+/// Spreads the virtual servers over several worker processes, so that a busy server can't slow down the servers
+/// in other workers.
+///
+/// If the workers option is set, the murmur process that is started becomes the supervisor. It doesn't boot any
+/// servers itself but starts the given amount of workers (murmur processes with the -worker argument) and restarts
+/// them if they exit unexpectedly. Worker i hosts the servers whose ID modulo the amount of workers is i. The workers
+/// share the database and can each be pinned to a set of CPUs (workercpus option).
+///
+/// The supervisor keeps the privileges it has been started with, so that the workers it (re)starts can read the
+/// configuration and certificates before they give up their privileges.
+class Supervisor : public QObject {
+private:
+	Q_OBJECT;
+	Q_DISABLE_COPY(Supervisor);
+
+protected:
+	QStringList qslArguments;
+	QList< QProcess * > qlWorkers;
+	/// For each worker, the time since it has been started
+	QList< QElapsedTimer > qlStarted;
+	/// For each worker, the amount of times in a row it exited within STABLE_TIME
+	QList< int > qlFailures;
+	bool bStopping;
+
+public:
+	/// Time after which a worker that exited unexpectedly is started again the first time, in milliseconds. The
+	/// delay doubles with every further failure, up to MAX_RESTART_DELAY.
+	static const int RESTART_DELAY     = 5000;
+	static const int MAX_RESTART_DELAY = 300000;
+	/// Amount of failures in a row after which a worker isn't restarted anymore
+	static const int MAX_FAILURES = 10;
+	/// Time a worker has to run for before it exiting is no longer counted as a failure of its start, in milliseconds
+	static const int STABLE_TIME = 60000;
+	/// Time workers get to shut down before they are killed, in milliseconds
+	static const int STOP_TIMEOUT = 30000;
+
+	/// @param arguments Additional command line arguments for the workers
+	Supervisor(const QStringList &arguments, QObject *p = nullptr);
+	~Supervisor() Q_DECL_OVERRIDE;
+
+	/// Starts the workers
+	void start();
+	/// Asks the workers to shut down and waits for them to do so
+	void stop();
+	/// Passes a signal (SIGHUP to reopen the log, SIGUSR1 to reload the certificates) on to the running workers
+	void signalWorkers(int signum);
+
+	/// @returns Whether the given virtual server is hosted by this process
+	static bool owns(int server);
+	/// @returns The lowest server ID from the given one on that is hosted by this process, for new servers
+	static int nextOwned(int server);
+	/// Restricts this process to the CPUs configured for the given worker in Meta::mp.qsWorkerCPUs
+	static void pin(int worker);
+
+	// Partitioning, implementation in SupervisorPartition.cpp as it doesn't depend on Meta
+	/// @param workers The amount of workers, 0 if the servers aren't spread over workers
+	/// @param worker The index of the worker, -1 for the supervisor itself
+	/// @returns Whether the given virtual server is hosted by the given worker
+	static bool owns(int server, int workers, int worker);
+	/// @returns The lowest server ID from the given one on that is hosted by the given worker, or the given one if
+	/// 	the worker doesn't host any servers
+	static int nextOwned(int server, int workers, int worker);
+	/// Adds the given offset to the port(s) in a listen address, so that every worker can listen on its own port.
+	/// Handles both Ice endpoints ("tcp -h 127.0.0.1 -p 6502") and "host:port" addresses.
+	static QString offsetPort(const QString &address, int offset);
+	/// @returns The time after which a worker is started again after the given amount of failures in a row, in
+	/// 	milliseconds
+	static int restartDelay(int failures);
+
+protected slots:
+	void startWorker(int worker);
+	void workerFinished(int exitCode, QProcess::ExitStatus exitStatus);
+};
+
+/// The supervisor, if this process is one
+extern Supervisor *supervisor;
+
+#endif
@@ -0,0 +1,47 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "Supervisor.h"
+
+#include <QtCore/QRegularExpression>
+
+bool Supervisor::owns(int server, int workers, int worker) {
+	if (workers <= 0)
+		return true;
+	return worker >= 0 && (server % workers) == worker;
+}
+
+int Supervisor::nextOwned(int server, int workers, int worker) {
+	if (workers <= 0 || worker < 0 || worker >= workers)
+		return server;
+	return server + (worker - server % workers + workers) % workers;
+}
+
+QString Supervisor::offsetPort(const QString &address, int offset) {
+	const QRegularExpression iceEndpoint(QLatin1String("(-p\\s+)(\\d+)"));
+	const QRegularExpression hostPort(QLatin1String("(:)(\\d+)$"));
+
+	QRegularExpressionMatchIterator it =
+		(address.contains(iceEndpoint) ? iceEndpoint : hostPort).globalMatch(address);
+
+	QString result;
+	int last = 0;
+	while (it.hasNext()) {
+		const QRegularExpressionMatch match = it.next();
+		result += address.mid(last, match.capturedStart(2) - last);
+		result += QString::number(match.captured(2).toInt() + offset);
+		last = match.capturedEnd(2);
+	}
+	result += address.mid(last);
+
+	return result;
+}
+
+int Supervisor::restartDelay(int failures) {
+	int delay = RESTART_DELAY;
+	for (int i = 1; i < failures && delay < MAX_RESTART_DELAY; ++i)
+		delay *= 2;
+	return delay < MAX_RESTART_DELAY ? delay : MAX_RESTART_DELAY;
+}
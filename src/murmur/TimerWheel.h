@@ -0,0 +1,103 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_TIMERWHEEL_H_
+#define MUMBLE_MURMUR_TIMERWHEEL_H_
+
+#include <QtCore/QList>
+#include <QtCore/QVector>
+
+/// A hierarchical timing wheel.
+///
+/// Values are scheduled to expire after a given amount of ticks. Every level of the wheel has SLOTS slots, each
+/// covering SLOTS times the time span of a slot of the level below. Values that are far off are kept in the upper
+/// levels and only moved down once they come close, so advancing the wheel by one tick just visits the values that
+/// are due (plus, every SLOTS ticks, the ones that are moved down a level) instead of all scheduled values.
+///
+/// Values can't be removed from the wheel. Users are expected to check whether an expired value is still of
+/// interest and, if it isn't due yet after all (e.g. because there has been activity on a connection in the
+/// meantime), to simply schedule it again.
+template< typename T > class TimerWheel {
+public:
+	static const int SLOTS  = 64;
+	static const int LEVELS = 3;
+
+	TimerWheel() : qvSlots(SLOTS * LEVELS), uiNow(0), iCount(0) {}
+
+	/// @param value The value to schedule
+	/// @param ticks The amount of ticks after which the value expires. Values that would expire in more than
+	/// 	SLOTS^LEVELS ticks are held back until they come into range.
+	void schedule(const T &value, quint64 ticks) {
+		insert(Entry{ uiNow + qMax< quint64 >(ticks, 1), value });
+		iCount++;
+	}
+
+	/// Advances the wheel by a single tick.
+	///
+	/// @returns The values that have expired
+	QList< T > advance() {
+		uiNow++;
+
+		// Move the values of the upper levels that are coming close down, starting with the topmost level so that
+		// its values can move down more than one level at once.
+		for (int level = LEVELS - 1; level > 0; --level) {
+			const int shift = level * BITS;
+			if ((uiNow & ((Q_UINT64_C(1) << shift) - 1)) == 0) {
+				QList< Entry > entries;
+				entries.swap(qvSlots[level * SLOTS + static_cast< int >((uiNow >> shift) % SLOTS)]);
+				foreach (const Entry &e, entries)
+					insert(e);
+			}
+		}
+
+		QList< Entry > entries;
+		entries.swap(qvSlots[static_cast< int >(uiNow % SLOTS)]);
+
+		QList< T > expired;
+		foreach (const Entry &e, entries)
+			expired << e.value;
+		iCount -= expired.count();
+		return expired;
+	}
+
+	void clear() {
+		for (int i = 0; i < qvSlots.size(); ++i)
+			qvSlots[i].clear();
+		iCount = 0;
+	}
+
+	/// @returns The amount of scheduled values
+	int count() const { return iCount; }
+
+protected:
+	static const int BITS = 6;
+
+	struct Entry {
+		quint64 uiDeadline;
+		T value;
+	};
+
+	QVector< QList< Entry > > qvSlots;
+	quint64 uiNow;
+	int iCount;
+
+	void insert(const Entry &e) {
+		const quint64 delta = e.uiDeadline > uiNow ? e.uiDeadline - uiNow : 0;
+
+		for (int level = 0; level < LEVELS; ++level) {
+			const int shift = level * BITS;
+			if (delta < (Q_UINT64_C(1) << (shift + BITS))) {
+				qvSlots[level * SLOTS + static_cast< int >((e.uiDeadline >> shift) % SLOTS)] << e;
+				return;
+			}
+		}
+
+		// Out of range: park the value in the last slot of the topmost level that is reached before it wraps around
+		const int shift = (LEVELS - 1) * BITS;
+		qvSlots[(LEVELS - 1) * SLOTS + static_cast< int >(((uiNow >> shift) + SLOTS - 1) % SLOTS)] << e;
+	}
+};
+
+#endif
@@ -7,6 +7,7 @@
 
 #include "EnvUtils.h"
 #include "Meta.h"
+#include "Supervisor.h"
 
 #include <QtCore/QAbstractEventDispatcher>
 #include <QtCore/QCoreApplication>
@@ -228,6 +229,11 @@ void UnixMurmur::handleSigHup() {
 			qWarning("Log rotated successfully");
 		}
 	}
+
+	// The workers have their own handles to the log
+	if (supervisor)
+		supervisor->signalWorkers(SIGHUP);
+
 	qsnHup->setEnabled(true);
 }
 
@@ -261,6 +267,9 @@ void UnixMurmur::handleSigUsr1() {
 		}
 	}
 
+	if (supervisor)
+		supervisor->signalWorkers(SIGUSR1);
+
 	qsnUsr1->setEnabled(true);
 }
 
@@ -14,6 +14,7 @@
 #include "SSL.h"
 #include "Server.h"
 #include "ServerDB.h"
+#include "Supervisor.h"
 #include "Version.h"
 #include <csignal>
 
@@ -42,6 +43,7 @@
 #else
 #	include <fcntl.h>
 #	include <sys/syslog.h>
+#	include <sys/wait.h>
 #endif
 
 QFile *qfLog = nullptr;
@@ -59,6 +61,8 @@ static UnixMurmur *unixMurmur = nullptr;
 
 Meta *meta = nullptr;
 
+Supervisor *supervisor = nullptr;
+
 static LogEmitter le;
 
 static QStringList qlErrors;
@@ -172,7 +176,29 @@ void GRPCStart();
 void GRPCStop();
 #endif
 
+static void wipeDatabase(bool wipeSsl, bool wipeLogs) {
+	if (wipeSsl) {
+		qWarning("Removing all per-server SSL certificates from the database.");
+		foreach (int sid, ServerDB::getAllServers()) {
+			ServerDB::setConf(sid, "key");
+			ServerDB::setConf(sid, "certificate");
+			ServerDB::setConf(sid, "passphrase");
+			ServerDB::setConf(sid, "sslDHParams");
+		}
+	}
+
+	if (wipeLogs) {
+		qWarning("Removing all log entries from the database.");
+		ServerDB::wipeLogs();
+	}
+}
+
 void cleanup(int signum) {
+	if (supervisor) {
+		qWarning("Stopping workers");
+		supervisor->stop();
+	}
+
 	qWarning("Killing running servers");
 
 	meta->killAll();
@@ -285,6 +311,7 @@ int main(int argc, char **argv) {
 #endif
 	bool logGroups = false;
 	bool logACL    = false;
+	int worker     = -1;
 
 #if QT_VERSION < QT_VERSION_CHECK(5, 10, 0)
 	// For Qt >= 5.10 we use QRandomNumberGenerator that is seeded automatically
@@ -342,6 +369,9 @@ int main(int argc, char **argv) {
 		} else if ((arg == "-ini") && (i + 1 < args.size())) {
 			i++;
 			inifile = args.at(i);
+		} else if ((arg == "-worker") && (i + 1 < args.size())) {
+			i++;
+			worker = args.at(i).toInt();
 		} else if ((arg == "-wipessl")) {
 			wipeSsl = true;
 		} else if ((arg == "-wipelogs")) {
@@ -406,6 +436,7 @@ int main(int argc, char **argv) {
 				  "  -wipelogs              Remove all log entries from database.\n"
 				  "  -loggroups             Turns on logging for group changes for all servers."
 				  "  -logacls               Turns on logging for ACL changes for all servers."
+				  "  -worker <n>            Run as worker n of a supervisor (see the workers option).\n"
 				  "  -version               Show version information.\n"
 				  "\n"
 				  "  -license               Show Murmur's license.\n"
@@ -458,6 +489,24 @@ int main(int argc, char **argv) {
 		Meta::mp.bLogACLChanges = logACL;
 	}
 
+	if (worker >= 0) {
+		if (worker >= Meta::mp.iWorkers)
+			qFatal("Worker %d doesn't exist, there are %d workers", worker, Meta::mp.iWorkers);
+
+		// The supervisor writes the pid file, and only one process can own the D-Bus service
+		Meta::mp.iWorkerIndex = worker;
+		Meta::mp.qsPid.clear();
+		Meta::mp.qsDBus.clear();
+		Meta::mp.qsIceEndpoint    = Supervisor::offsetPort(Meta::mp.qsIceEndpoint, worker);
+		Meta::mp.qsGRPCAddress    = Supervisor::offsetPort(Meta::mp.qsGRPCAddress, worker);
+		Meta::mp.qsMetricsAddress = Supervisor::offsetPort(Meta::mp.qsMetricsAddress, worker);
+
+		Supervisor::pin(worker);
+	} else if (Meta::mp.iWorkers > 0) {
+		// The workers serve the metrics of their servers
+		Meta::mp.qsMetricsAddress.clear();
+	}
+
 	// need to open log file early so log dir can be root owned:
 	// http://article.gmane.org/gmane.comp.security.oss.general/4404
 #ifdef Q_OS_UNIX
@@ -496,8 +545,15 @@ int main(int argc, char **argv) {
 		detach = false;
 	}
 
+	// A supervisor keeps its privileges, as it has to be able to start workers (again) that can read the
+	// configuration and certificates. The workers give up their privileges themselves, just like a single
+	// process does. The supervisor itself doesn't serve any clients and doesn't open the database.
+	bool supervising = (Meta::mp.iWorkers > 0) && (worker < 0) && supw.isNull() && !disableSu;
 #ifdef Q_OS_UNIX
-	unixhandler.setuid();
+	supervising = supervising && !readPw;
+
+	if (!supervising)
+		unixhandler.setuid();
 #endif
 
 #ifdef Q_OS_UNIX
@@ -513,7 +569,9 @@ int main(int argc, char **argv) {
 	// (because nothing is locked) and database corruption can (and likely will!)
 	// ensue. This is particularly nasty if you have WAL mode enabled, because the
 	// WAL file is deleted when the last connection to the database closes.
-	if (detach) {
+	//
+	// Workers don't fork, they are already detached by the supervisor.
+	if (detach && worker < 0) {
 		if (fork() != 0) {
 			_exit(0);
 		}
@@ -550,11 +608,62 @@ int main(int argc, char **argv) {
 		dup2(fd, 2);
 		close(fd);
 	}
-	unixhandler.finalcap();
+	if (!supervising)
+		unixhandler.finalcap();
 #endif
 
 	MumbleSSL::addSystemCA();
 
+	if (supervising) {
+		if (wipeSsl || wipeLogs) {
+#ifdef Q_OS_UNIX
+			// The database is only ever opened without privileges, so that its files are owned by the workers' user
+			const pid_t pid = fork();
+			if (pid == 0) {
+				unixhandler.setuid();
+				{
+					ServerDB db;
+					wipeDatabase(wipeSsl, wipeLogs);
+				}
+				_exit(0);
+			} else if (pid > 0) {
+				waitpid(pid, nullptr, 0);
+			} else {
+				qCritical("Failed to fork, the database has not been wiped");
+			}
+#else
+			ServerDB db;
+			wipeDatabase(wipeSsl, wipeLogs);
+#endif
+		}
+
+		QStringList workerArgs;
+		if (!detach)
+			workerArgs << QLatin1String("-fg");
+		if (bVerbose)
+			workerArgs << QLatin1String("-v");
+		if (logGroups)
+			workerArgs << QLatin1String("-loggroups");
+		if (logACL)
+			workerArgs << QLatin1String("-logacls");
+
+		qWarning("Starting %d workers", Meta::mp.iWorkers);
+
+		meta = new Meta();
+
+		supervisor = new Supervisor(workerArgs);
+		supervisor->start();
+
+		signal(SIGTERM, cleanup);
+		signal(SIGINT, cleanup);
+
+		res = a.exec();
+
+		cleanup(0);
+
+		return res;
+	}
+
 	ServerDB db;
 
 	meta = new Meta();
@@ -598,20 +707,7 @@ int main(int argc, char **argv) {
 		return 0;
 	}
 
-	if (wipeSsl) {
-		qWarning("Removing all per-server SSL certificates from the database.");
-		foreach (int sid, ServerDB::getAllServers()) {
-			ServerDB::setConf(sid, "key");
-			ServerDB::setConf(sid, "certificate");
-			ServerDB::setConf(sid, "passphrase");
-			ServerDB::setConf(sid, "sslDHParams");
-		}
-	}
-
-	if (wipeLogs) {
-		qWarning("Removing all log entries from the database.");
-		ServerDB::wipeLogs();
-	}
+	wipeDatabase(wipeSsl, wipeLogs);
 
 #ifdef USE_DBUS
 	MurmurDBus::registerTypes();
@@ -0,0 +1,1019 @@
+// Copyright 2007-2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+/**
+ * Load generator for Murmur.
+ *
+ * Connects a configurable amount of clients to a server and runs them through
+ * a series of phases, each of which simulates a scenario like a few people
+ * talking in a crowded channel, users hopping between channels, whispering,
+ * text spam or a reconnect storm. All clients are driven by a single event
+ * loop, so thousands of them can be simulated by one process.
+ *
+ * Every voice packet carries an ID, so that the end-to-end latency and the
+ * loss can be measured: when a packet is sent, the amount of our own clients
+ * that should receive it is derived from the channel tree as seen by the
+ * clients. The results of every phase are written as a JSON object on a line
+ * of its own, so they can be compared against those of earlier runs.
+ *
+ * The phases are either given as a list of built-in scenarios (--scenario) or
+ * read from a JSON file (--script) along the lines of
+ *
+ *   { "phases": [ { "name": "warmup", "duration": 10, "speakers": 2 },
+ *                 { "name": "hop", "duration": 30, "speakers": 5, "hopRate": 6 },
+ *                 { "name": "storm", "duration": 30, "reconnect": 500 } ] }
+ *
+ * See Phase for the available keys.
+ */
+
+#include "Message.h"
+#include "MetricsHistogram.h"
+#include "Mumble.pb.h"
+#include "PacketDataStream.h"
+#include "Timer.h"
+#include "crypto/CryptStateOCB2.h"
+
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QFile>
+#include <QtCore/QHash>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QSet>
+#include <QtCore/QTimer>
+#include <QtCore/QtEndian>
+#include <QtNetwork/QHostAddress>
+#include <QtNetwork/QSslSocket>
+#include <QtNetwork/QUdpSocket>
+
+#include <algorithm>
+#include <memory>
+#include <random>
+
+class LoadGenerator;
+
+/// The clock all timestamps are taken from
+static Timer tClock;
+
+/// A histogram of latencies, which unlike Murmur's MetricsHistogram can be cleared and remembers the largest value.
+class LatencyHistogram {
+public:
+	LatencyHistogram() { clear(); }
+
+	void clear() {
+		mhValues.reset(new MetricsHistogram());
+		uiMax = 0;
+	}
+
+	void record(quint64 value) {
+		mhValues->record(value);
+		uiMax = qMax(uiMax, value);
+	}
+
+	QJsonObject toJson(double scale) const {
+		QJsonObject o;
+		o.insert(QLatin1String("count"), static_cast< double >(mhValues->count()));
+		o.insert(QLatin1String("p50"), static_cast< double >(quantile(0.5)) * scale);
+		o.insert(QLatin1String("p90"), static_cast< double >(quantile(0.9)) * scale);
+		o.insert(QLatin1String("p99"), static_cast< double >(quantile(0.99)) * scale);
+		o.insert(QLatin1String("max"), static_cast< double >(uiMax) * scale);
+		return o;
+	}
+
+protected:
+	std::unique_ptr< MetricsHistogram > mhValues;
+	quint64 uiMax;
+
+	quint64 quantile(double q) const { return qMin(mhValues->quantile(q), uiMax); }
+};
+
+/// A phase of a load test.
+struct Phase {
+	QString qsName;
+	/// Duration of the phase, in seconds
+	int iDuration;
+	/// The amount of clients that talk all the time
+	int iSpeakers;
+	/// The share of speakers that whisper to a few random clients instead of talking to their channel
+	double dWhisper;
+	/// The amount of channel changes per client and minute
+	double dHopRate;
+	/// Whether all clients are moved to random channels when the phase starts
+	bool bSpread;
+	/// Whether clients are only ever moved to channels that are linked to others
+	bool bLinked;
+	/// The amount of text messages sent per second, by all clients together
+	double dTextRate;
+	/// The amount of clients that are disconnected and immediately reconnected when the phase starts
+	int iReconnect;
+
+	Phase()
+		: iDuration(30), iSpeakers(5), dWhisper(0.0), dHopRate(0.0), bSpread(false), bLinked(false), dTextRate(0.0),
+		  iReconnect(0) {}
+
+	static Phase fromJson(const QJsonObject &o, const Phase &defaults);
+	static bool fromScenario(const QString &name, const Phase &defaults, Phase &phase);
+};
+
+Phase Phase::fromJson(const QJsonObject &o, const Phase &defaults) {
+	Phase p;
+	p.qsName     = o.value(QLatin1String("name")).toString(QLatin1String("phase"));
+	p.iDuration  = o.value(QLatin1String("duration")).toInt(defaults.iDuration);
+	p.iSpeakers  = o.value(QLatin1String("speakers")).toInt(defaults.iSpeakers);
+	p.dWhisper   = o.value(QLatin1String("whisper")).toDouble(0.0);
+	p.dHopRate   = o.value(QLatin1String("hopRate")).toDouble(0.0);
+	p.bSpread    = o.value(QLatin1String("spread")).toBool(false);
+	p.bLinked    = o.value(QLatin1String("linked")).toBool(false);
+	p.dTextRate  = o.value(QLatin1String("textRate")).toDouble(0.0);
+	p.iReconnect = o.value(QLatin1String("reconnect")).toInt(0);
+	return p;
+}
+
+bool Phase::fromScenario(const QString &name, const Phase &defaults, Phase &p) {
+	p        = defaults;
+	p.qsName = name;
+
+	if (name == QLatin1String("steady")) {
+		// Just talking
+	} else if (name == QLatin1String("spread")) {
+		p.bSpread = true;
+	} else if (name == QLatin1String("hop")) {
+		p.bSpread  = true;
+		p.dHopRate = 6.0;
+	} else if (name == QLatin1String("whisper")) {
+		p.dWhisper = 0.5;
+	} else if (name == QLatin1String("linked")) {
+		p.bSpread = true;
+		p.bLinked = true;
+	} else if (name == QLatin1String("text")) {
+		p.dTextRate = 50.0;
+	} else if (name == QLatin1String("storm")) {
+		p.iReconnect = -1;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+/// A simulated client.
+class LoadClient : public QObject {
+	Q_OBJECT
+	Q_DISABLE_COPY(LoadClient)
+public:
+	enum State { Disconnected, Connecting, Synced };
+
+	LoadGenerator *lgGenerator;
+	int iIndex;
+	bool bTcpOnly;
+	State sState;
+	unsigned int uiSession;
+	QList< unsigned int > qlWhisperTargets;
+	Timer tConnect;
+
+	LoadClient(LoadGenerator *generator, int index, bool tcpOnly);
+
+	void open();
+	void close();
+
+	void sendVoice(quint32 packet, bool whisper, int frameSize);
+	void sendPing();
+	void sendText(const QString &text);
+	void joinChannel(unsigned int channel);
+	void setWhisperTargets(const QList< unsigned int > &sessions);
+
+protected:
+	QSslSocket *qssTcp;
+	QUdpSocket *qusUdp;
+	CryptStateOCB2 csCrypt;
+	QByteArray qbaBuffer;
+	quint32 uiSequence;
+
+	void sendMessage(const ::google::protobuf::Message &msg, unsigned int msgType);
+	void sendUdp(const char *data, int len);
+	void handleMessage(unsigned int type, const char *data, int len);
+	void handleVoice(const char *data, int len);
+
+protected slots:
+	void encrypted();
+	void tcpReadyRead();
+	void udpReadyRead();
+	void disconnected();
+};
+
+/// Runs the phases of a load test against a server.
+class LoadGenerator : public QObject {
+	Q_OBJECT
+	Q_DISABLE_COPY(LoadGenerator)
+public:
+	QHostAddress qhaServer;
+	quint16 usPort;
+	QString qsPrefix;
+	int iFrameSize;
+
+	LoadGenerator(const QHostAddress &server, quint16 port, int clients, double tcpOnly, int connectRate,
+				  const QList< Phase > &phases, QFile *output);
+
+	void start();
+
+	unsigned int userChannel(unsigned int session) const;
+
+	// Called by the clients
+	void clientSynced(LoadClient *c);
+	void clientFailed(LoadClient *c, bool whileConnecting);
+	void channelState(const MumbleProto::ChannelState &msg);
+	void channelRemoved(unsigned int channel);
+	void userState(const MumbleProto::UserState &msg);
+	void userRemoved(unsigned int session);
+	void voiceReceived(LoadClient *c, quint32 packet);
+
+protected:
+	struct Packet {
+		quint64 uiSent;
+		int iExpected;
+		int iReceived;
+	};
+
+	QList< LoadClient * > qlClients;
+	int iConnectRate;
+	QList< Phase > qlPhases;
+	QFile *qfOutput;
+	std::mt19937 mtRandom;
+
+	QHash< unsigned int, LoadClient * > qhSessions;
+	QHash< unsigned int, unsigned int > qhUserChannels;
+	QHash< unsigned int, QSet< unsigned int > > qhChannelLinks;
+
+	int iPhase;
+	bool bDraining;
+	Timer tPhase;
+	QList< LoadClient * > qlSpeakers;
+	QHash< quint32, Packet > qhPackets;
+	quint32 uiNextPacket;
+
+	// The statistics of the current phase
+	quint64 uiSent, uiExpected, uiDelivered, uiUnexpected, uiLate;
+	quint64 uiHops, uiTexts, uiDisconnects, uiConnects, uiFailedConnects;
+	LatencyHistogram lhLatency;
+	LatencyHistogram lhConnect;
+	double dHopBudget, dTextBudget;
+
+	QTimer qtConnect;
+	QTimer qtVoice;
+	QTimer qtTick;
+	Timer tPing;
+
+	int random(int bound) { return std::uniform_int_distribution< int >(0, bound - 1)(mtRandom); }
+	QList< LoadClient * > syncedClients() const;
+	QList< unsigned int > channels(bool linkedOnly) const;
+	int expectedReceivers(LoadClient *speaker) const;
+
+	void startPhase();
+	void finishPhase();
+	void resetStatistics();
+	void expirePackets(quint64 olderThan);
+
+protected slots:
+	void connectNext();
+	void voiceTick();
+	void tick();
+};
+
+LoadClient::LoadClient(LoadGenerator *generator, int index, bool tcpOnly)
+	: QObject(generator), lgGenerator(generator), iIndex(index), bTcpOnly(tcpOnly), sState(Disconnected),
+	  uiSession(0), tConnect(false), qssTcp(nullptr), qusUdp(nullptr), uiSequence(0) {
+	if (!bTcpOnly) {
+		qusUdp = new QUdpSocket(this);
+		connect(qusUdp, SIGNAL(readyRead()), this, SLOT(udpReadyRead()));
+		qusUdp->bind();
+	}
+}
+
+void LoadClient::open() {
+	if (qssTcp)
+		close();
+
+	sState = Connecting;
+	tConnect.restart();
+	qbaBuffer.clear();
+
+	qssTcp = new QSslSocket(this);
+	qssTcp->setPeerVerifyMode(QSslSocket::VerifyNone);
+	connect(qssTcp, SIGNAL(encrypted()), this, SLOT(encrypted()));
+	connect(qssTcp, SIGNAL(readyRead()), this, SLOT(tcpReadyRead()));
+	connect(qssTcp, SIGNAL(disconnected()), this, SLOT(disconnected()));
+	connect(qssTcp, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(disconnected()));
+
+	qssTcp->connectToHostEncrypted(lgGenerator->qhaServer.toString(), lgGenerator->usPort);
+}
+
+void LoadClient::close() {
+	if (!qssTcp)
+		return;
+
+	qssTcp->disconnect(this);
+	qssTcp->abort();
+	qssTcp->deleteLater();
+	qssTcp = nullptr;
+
+	sState    = Disconnected;
+	uiSession = 0;
+	qlWhisperTargets.clear();
+}
+
+void LoadClient::encrypted() {
+	MumbleProto::Version mpv;
+	mpv.set_release(u8(QLatin1String("1.4.0 LoadGenerator")));
+	mpv.set_version(0x010400);
+	sendMessage(mpv, MessageHandler::Version);
+
+	MumbleProto::Authenticate mpa;
+	mpa.set_username(u8(QString::fromLatin1("%1-%2").arg(lgGenerator->qsPrefix).arg(iIndex)));
+	mpa.set_opus(true);
+	sendMessage(mpa, MessageHandler::Authenticate);
+}
+
+void LoadClient::disconnected() {
+	if (sState == Disconnected)
+		return;
+
+	const bool connecting = (sState == Connecting);
+	close();
+	lgGenerator->clientFailed(this, connecting);
+}
+
+void LoadClient::sendMessage(const ::google::protobuf::Message &msg, unsigned int msgType) {
+	if (!qssTcp)
+		return;
+
+	const int len = msg.ByteSize();
+
+	QByteArray qba(len + 6, Qt::Uninitialized);
+	unsigned char *uc = reinterpret_cast< unsigned char * >(qba.data());
+	qToBigEndian< quint16 >(static_cast< quint16 >(msgType), uc);
+	qToBigEndian< quint32 >(static_cast< quint32 >(len), uc + 2);
+	msg.SerializeToArray(uc + 6, len);
+
+	qssTcp->write(qba);
+}
+
+void LoadClient::sendUdp(const char *data, int len) {
+	if (bTcpOnly || !csCrypt.isValid()) {
+		// Voice goes through the TCP tunnel instead
+		if (((data[0] >> 5) & 0x7) == MessageHandler::UDPPing || !qssTcp)
+			return;
+
+		QByteArray qba(len + 6, Qt::Uninitialized);
+		unsigned char *uc = reinterpret_cast< unsigned char * >(qba.data());
+		qToBigEndian< quint16 >(static_cast< quint16 >(MessageHandler::UDPTunnel), uc);
+		qToBigEndian< quint32 >(static_cast< quint32 >(len), uc + 2);
+		memcpy(uc + 6, data, len);
+
+		qssTcp->write(qba);
+		return;
+	}
+
+	unsigned char crypted[2048];
+	csCrypt.encrypt(reinterpret_cast< const unsigned char * >(data), crypted, len);
+	qusUdp->writeDatagram(reinterpret_cast< const char * >(crypted), len + 4, lgGenerator->qhaServer,
+						  lgGenerator->usPort);
+}
+
+void LoadClient::sendVoice(quint32 packet, bool whisper, int frameSize) {
+	char buffer[1024];
+	char frame[1024];
+
+	frameSize = qBound(4, frameSize, 512);
+	memset(frame, 0, frameSize);
+	qToBigEndian< quint32 >(packet, reinterpret_cast< unsigned char * >(frame));
+
+	buffer[0] = static_cast< char >((MessageHandler::UDPVoiceOpus << 5) | (whisper ? 1 : 0));
+	PacketDataStream pds(buffer + 1, sizeof(buffer) - 1);
+	pds << uiSequence++;
+	pds << frameSize;
+	pds.append(frame, frameSize);
+
+	sendUdp(buffer, pds.size() + 1);
+}
+
+void LoadClient::sendPing() {
+	if (sState != Synced)
+		return;
+
+	char buffer[64];
+	buffer[0] = static_cast< char >(MessageHandler::UDPPing << 5);
+	PacketDataStream pds(buffer + 1, sizeof(buffer) - 1);
+	pds << tClock.elapsed();
+	sendUdp(buffer, pds.size() + 1);
+
+	MumbleProto::Ping mpp;
+	mpp.set_timestamp(tClock.elapsed());
+	sendMessage(mpp, MessageHandler::Ping);
+}
+
+void LoadClient::sendText(const QString &text) {
+	MumbleProto::TextMessage mptm;
+	mptm.add_channel_id(lgGenerator->userChannel(uiSession));
+	mptm.set_message(u8(text));
+	sendMessage(mptm, MessageHandler::TextMessage);
+}
+
+void LoadClient::joinChannel(unsigned int channel) {
+	MumbleProto::UserState mpus;
+	mpus.set_session(uiSession);
+	mpus.set_channel_id(channel);
+	sendMessage(mpus, MessageHandler::UserState);
+}
+
+void LoadClient::setWhisperTargets(const QList< unsigned int > &sessions) {
+	qlWhisperTargets = sessions;
+
+	MumbleProto::VoiceTarget mpvt;
+	mpvt.set_id(1);
+	MumbleProto::VoiceTarget_Target *target = mpvt.add_targets();
+	foreach (unsigned int session, sessions)
+		target->add_session(session);
+	sendMessage(mpvt, MessageHandler::VoiceTarget);
+}
+
+void LoadClient::tcpReadyRead() {
+	qbaBuffer.append(qssTcp->readAll());
+
+	int offset = 0;
+	while (qbaBuffer.size() - offset >= 6) {
+		const unsigned char *uc = reinterpret_cast< const unsigned char * >(qbaBuffer.constData()) + offset;
+		const unsigned int type = qFromBigEndian< quint16 >(uc);
+		const int len           = static_cast< int >(qFromBigEndian< quint32 >(uc + 2));
+
+		if (qbaBuffer.size() - offset - 6 < len)
+			break;
+
+		handleMessage(type, qbaBuffer.constData() + offset + 6, len);
+		// The message may have closed the connection
+		if (!qssTcp)
+			return;
+
+		offset += 6 + len;
+	}
+
+	qbaBuffer.remove(0, offset);
+}
+
+void LoadClient::udpReadyRead() {
+	char encrypted[2048];
+	char plain[2048];
+
+	while (qusUdp->hasPendingDatagrams()) {
+		const qint64 len = qusUdp->readDatagram(encrypted, sizeof(encrypted));
+		if (len < 5 || !csCrypt.isValid())
+			continue;
+
+		if (!csCrypt.decrypt(reinterpret_cast< const unsigned char * >(encrypted),
+							 reinterpret_cast< unsigned char * >(plain), static_cast< unsigned int >(len)))
+			continue;
+
+		handleVoice(plain, static_cast< int >(len) - 4);
+	}
+}
+
+void LoadClient::handleVoice(const char *data, int len) {
+	if (len < 2 || ((data[0] >> 5) & 0x7) != MessageHandler::UDPVoiceOpus)
+		return;
+
+	PacketDataStream pds(data + 1, len - 1);
+	unsigned int session, sequence;
+	int size;
+	pds >> session >> sequence >> size;
+	size &= 0x1fff;
+
+	if (!pds.isValid() || size < 4 || static_cast< int >(pds.left()) < size)
+		return;
+
+	lgGenerator->voiceReceived(this, qFromBigEndian< quint32 >(pds.dataPtr()));
+}
+
+void LoadClient::handleMessage(unsigned int type, const char *data, int len) {
+	switch (type) {
+		case MessageHandler::CryptSetup: {
+			MumbleProto::CryptSetup msg;
+			if (!msg.ParseFromArray(data, len))
+				break;
+
+			if (msg.has_key() && msg.has_client_nonce() && msg.has_server_nonce()) {
+				csCrypt.setKey(msg.key(), msg.client_nonce(), msg.server_nonce());
+			} else if (msg.has_server_nonce()) {
+				csCrypt.uiResync++;
+				csCrypt.setDecryptIV(msg.server_nonce());
+			} else {
+				MumbleProto::CryptSetup mpcs;
+				mpcs.set_client_nonce(csCrypt.getEncryptIV());
+				sendMessage(mpcs, MessageHandler::CryptSetup);
+			}
+			break;
+		}
+		case MessageHandler::ServerSync: {
+			MumbleProto::ServerSync msg;
+			if (!msg.ParseFromArray(data, len))
+				break;
+
+			uiSession = msg.session();
+			sState    = Synced;
+			lgGenerator->clientSynced(this);
+			break;
+		}
+		case MessageHandler::Reject: {
+			MumbleProto::Reject msg;
+			msg.ParseFromArray(data, len);
+			qWarning("Client %d rejected: %s", iIndex, msg.reason().c_str());
+			disconnected();
+			break;
+		}
+		case MessageHandler::ChannelState: {
+			MumbleProto::ChannelState msg;
+			if (msg.ParseFromArray(data, len))
+				lgGenerator->channelState(msg);
+			break;
+		}
+		case MessageHandler::ChannelRemove: {
+			MumbleProto::ChannelRemove msg;
+			if (msg.ParseFromArray(data, len))
+				lgGenerator->channelRemoved(msg.channel_id());
+			break;
+		}
+		case MessageHandler::UserState: {
+			MumbleProto::UserState msg;
+			if (msg.ParseFromArray(data, len))
+				lgGenerator->userState(msg);
+			break;
+		}
+		case MessageHandler::UserRemove: {
+			MumbleProto::UserRemove msg;
+			if (msg.ParseFromArray(data, len))
+				lgGenerator->userRemoved(msg.session());
+			break;
+		}
+		case MessageHandler::UDPTunnel:
+			handleVoice(data, len);
+			break;
+		default:
+			break;
+	}
+}
+
+LoadGenerator::LoadGenerator(const QHostAddress &server, quint16 port, int clients, double tcpOnly, int connectRate,
+							 const QList< Phase > &phases, QFile *output)
+	: qhaServer(server), usPort(port), iFrameSize(60), iConnectRate(qMax(1, connectRate)), qlPhases(phases),
+	  qfOutput(output), mtRandom(std::random_device()()), iPhase(-1), bDraining(false), uiNextPacket(0) {
+	qsPrefix = QString::fromLatin1("loadgen-%1").arg(QCoreApplication::applicationPid());
+
+	const int tcpClients = static_cast< int >(clients * tcpOnly + 0.5);
+	for (int i = 0; i < clients; ++i)
+		qlClients << new LoadClient(this, i, i < tcpClients);
+
+	resetStatistics();
+
+	connect(&qtConnect, SIGNAL(timeout()), this, SLOT(connectNext()));
+	connect(&qtVoice, SIGNAL(timeout()), this, SLOT(voiceTick()));
+	connect(&qtTick, SIGNAL(timeout()), this, SLOT(tick()));
+
+	// Opus frames are sent every 20 ms
+	qtVoice.setTimerType(Qt::PreciseTimer);
+	qtVoice.setInterval(20);
+}
+
+void LoadGenerator::start() {
+	qWarning("Connecting %d clients at %d/s", qlClients.count(), iConnectRate);
+
+	// Connects are spread over ticks of 10 ms
+	tPhase.restart();
+	qtConnect.start(10);
+	qtTick.start(100);
+}
+
+void LoadGenerator::connectNext() {
+	const int perTick = qMax(1, iConnectRate / 100);
+
+	int started = 0;
+	foreach (LoadClient *c, qlClients) {
+		if (c->sState == LoadClient::Disconnected && started < perTick) {
+			c->open();
+			started++;
+		}
+	}
+
+	if (started == 0)
+		qtConnect.stop();
+}
+
+unsigned int LoadGenerator::userChannel(unsigned int session) const {
+	return qhUserChannels.value(session);
+}
+
+void LoadGenerator::clientSynced(LoadClient *c) {
+	qhSessions.insert(c->uiSession, c);
+	lhConnect.record(c->tConnect.elapsed());
+	uiConnects++;
+}
+
+void LoadGenerator::clientFailed(LoadClient *c, bool whileConnecting) {
+	qhSessions.remove(c->uiSession);
+	qlSpeakers.removeAll(c);
+
+	if (whileConnecting)
+		uiFailedConnects++;
+	else
+		uiDisconnects++;
+
+	// Reconnect at the configured rate
+	if (!qtConnect.isActive())
+		qtConnect.start(10);
+}
+
+void LoadGenerator::channelState(const MumbleProto::ChannelState &msg) {
+	const unsigned int id = msg.channel_id();
+	QSet< unsigned int > &links = qhChannelLinks[id];
+
+	if (msg.links_size() > 0)
+		links.clear();
+	for (int i = 0; i < msg.links_size(); ++i)
+		links.insert(msg.links(i));
+	for (int i = 0; i < msg.links_add_size(); ++i) {
+		links.insert(msg.links_add(i));
+		qhChannelLinks[msg.links_add(i)].insert(id);
+	}
+	for (int i = 0; i < msg.links_remove_size(); ++i) {
+		links.remove(msg.links_remove(i));
+		qhChannelLinks[msg.links_remove(i)].remove(id);
+	}
+}
+
+void LoadGenerator::channelRemoved(unsigned int channel) {
+	qhChannelLinks.remove(channel);
+}
+
+void LoadGenerator::userState(const MumbleProto::UserState &msg) {
+	if (msg.has_channel_id())
+		qhUserChannels.insert(msg.session(), msg.channel_id());
+	else if (!qhUserChannels.contains(msg.session()))
+		qhUserChannels.insert(msg.session(), 0);
+}
+
+void LoadGenerator::userRemoved(unsigned int session) {
+	qhUserChannels.remove(session);
+}
+
+QList< LoadClient * > LoadGenerator::syncedClients() const {
+	QList< LoadClient * > clients;
+	foreach (LoadClient *c, qlClients) {
+		if (c->sState == LoadClient::Synced)
+			clients << c;
+	}
+	return clients;
+}
+
+QList< unsigned int > LoadGenerator::channels(bool linkedOnly) const {
+	QList< unsigned int > channels;
+	for (auto it = qhChannelLinks.constBegin(); it != qhChannelLinks.constEnd(); ++it) {
+		if (!linkedOnly || !it->isEmpty())
+			channels << it.key();
+	}
+	if (channels.isEmpty())
+		channels << 0;
+	return channels;
+}
+
+int LoadGenerator::expectedReceivers(LoadClient *speaker) const {
+	int expected = 0;
+
+	if (!speaker->qlWhisperTargets.isEmpty()) {
+		foreach (unsigned int session, speaker->qlWhisperTargets) {
+			if (session != speaker->uiSession && qhSessions.contains(session))
+				expected++;
+		}
+		return expected;
+	}
+
+	// The speaker's channel and everything linked to it, directly or not
+	QSet< unsigned int > reached;
+	QList< unsigned int > pending;
+	pending << qhUserChannels.value(speaker->uiSession);
+	while (!pending.isEmpty()) {
+		const unsigned int channel = pending.takeLast();
+		if (reached.contains(channel))
+			continue;
+		reached.insert(channel);
+		foreach (unsigned int link, qhChannelLinks.value(channel))
+			pending << link;
+	}
+
+	for (auto it = qhSessions.constBegin(); it != qhSessions.constEnd(); ++it) {
+		if (it.key() != speaker->uiSession && reached.contains(qhUserChannels.value(it.key())))
+			expected++;
+	}
+	return expected;
+}
+
+void LoadGenerator::voiceReceived(LoadClient *, quint32 packet) {
+	auto it = qhPackets.find(packet);
+	if (it == qhPackets.end()) {
+		// Arrived after the packet had been given up on already
+		uiLate++;
+		return;
+	}
+
+	it->iReceived++;
+	lhLatency.record(tClock.elapsed() - it->uiSent);
+}
+
+void LoadGenerator::expirePackets(quint64 olderThan) {
+	const quint64 now = tClock.elapsed();
+	for (auto it = qhPackets.begin(); it != qhPackets.end();) {
+		if (now - it->uiSent >= olderThan) {
+			// Receivers that weren't expected (e.g. because they joined the channel in the meantime) don't make up for
+			// the ones that missed the packet
+			uiExpected += static_cast< quint64 >(it->iExpected);
+			uiDelivered += static_cast< quint64 >(qMin(it->iReceived, it->iExpected));
+			uiUnexpected += static_cast< quint64 >(qMax(0, it->iReceived - it->iExpected));
+			it = qhPackets.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+void LoadGenerator::resetStatistics() {
+	uiSent = uiExpected = uiDelivered = uiUnexpected = uiLate = 0;
+	uiHops = uiTexts = uiDisconnects = uiConnects = uiFailedConnects = 0;
+	lhLatency.clear();
+	lhConnect.clear();
+	dHopBudget = dTextBudget = 0.0;
+}
+
+void LoadGenerator::startPhase() {
+	const Phase &p = qlPhases.at(iPhase);
+	qWarning("Starting phase %d/%d: %s (%d s)", iPhase + 1, qlPhases.count(), qPrintable(p.qsName), p.iDuration);
+
+	QList< LoadClient * > clients = syncedClients();
+	std::shuffle(clients.begin(), clients.end(), mtRandom);
+
+	resetStatistics();
+
+	if (p.iReconnect != 0) {
+		const int count = p.iReconnect < 0 ? clients.count() : qMin(p.iReconnect, clients.count());
+		for (int i = 0; i < count; ++i) {
+			LoadClient *c = clients.at(i);
+			qhSessions.remove(c->uiSession);
+			c->close();
+		}
+		qWarning("Reconnecting %d clients", count);
+
+		// All of them at once
+		foreach (LoadClient *c, qlClients) {
+			if (c->sState == LoadClient::Disconnected)
+				c->open();
+		}
+		clients = clients.mid(count);
+	}
+
+	if (p.bSpread) {
+		const QList< unsigned int > targets = channels(p.bLinked);
+		foreach (LoadClient *c, clients)
+			c->joinChannel(targets.at(random(targets.count())));
+	}
+
+	qlSpeakers = clients.mid(0, p.iSpeakers);
+	const int whisperers = static_cast< int >(qlSpeakers.count() * p.dWhisper + 0.5);
+	for (int i = 0; i < qlSpeakers.count(); ++i) {
+		LoadClient *c = qlSpeakers.at(i);
+		if (i < whisperers && clients.count() > 1) {
+			// Five distinct clients other than the speaker
+			QList< LoadClient * > others = clients;
+			others.removeAll(c);
+			std::shuffle(others.begin(), others.end(), mtRandom);
+
+			QList< unsigned int > targets;
+			foreach (LoadClient *target, others.mid(0, 5))
+				targets << target->uiSession;
+			c->setWhisperTargets(targets);
+		} else if (!c->qlWhisperTargets.isEmpty()) {
+			c->qlWhisperTargets.clear();
+		}
+	}
+
+	bDraining = false;
+	tPhase.restart();
+	qtVoice.start();
+}
+
+void LoadGenerator::finishPhase() {
+	const Phase &p = qlPhases.at(iPhase);
+	expirePackets(0);
+
+	QJsonObject voice;
+	voice.insert(QLatin1String("sent"), static_cast< double >(uiSent));
+	voice.insert(QLatin1String("expected"), static_cast< double >(uiExpected));
+	voice.insert(QLatin1String("delivered"), static_cast< double >(uiDelivered));
+	voice.insert(QLatin1String("unexpected"), static_cast< double >(uiUnexpected));
+	voice.insert(QLatin1String("late"), static_cast< double >(uiLate));
+	voice.insert(QLatin1String("loss"),
+				 uiExpected > 0 ? 1.0 - static_cast< double >(uiDelivered) / static_cast< double >(uiExpected) : 0.0);
+	voice.insert(QLatin1String("latency_ms"), lhLatency.toJson(0.001));
+
+	QJsonObject connects;
+	connects.insert(QLatin1String("completed"), static_cast< double >(uiConnects));
+	connects.insert(QLatin1String("failed"), static_cast< double >(uiFailedConnects));
+	connects.insert(QLatin1String("disconnects"), static_cast< double >(uiDisconnects));
+	connects.insert(QLatin1String("time_ms"), lhConnect.toJson(0.001));
+
+	QJsonObject o;
+	o.insert(QLatin1String("phase"), p.qsName);
+	o.insert(QLatin1String("duration"), static_cast< double >(tPhase.elapsed()) / 1000000.0);
+	o.insert(QLatin1String("clients"), qhSessions.count());
+	o.insert(QLatin1String("speakers"), qlSpeakers.count());
+	o.insert(QLatin1String("voice"), voice);
+	o.insert(QLatin1String("connects"), connects);
+	o.insert(QLatin1String("hops"), static_cast< double >(uiHops));
+	o.insert(QLatin1String("texts"), static_cast< double >(uiTexts));
+
+	qfOutput->write(QJsonDocument(o).toJson(QJsonDocument::Compact));
+	qfOutput->write("\n");
+	qfOutput->flush();
+}
+
+void LoadGenerator::voiceTick() {
+	const Phase &p = qlPhases.at(iPhase);
+	const quint64 now = tClock.elapsed();
+
+	foreach (LoadClient *c, qlSpeakers) {
+		if (c->sState != LoadClient::Synced)
+			continue;
+
+		const quint32 id = uiNextPacket++;
+		qhPackets.insert(id, { now, expectedReceivers(c), 0 });
+		c->sendVoice(id, !c->qlWhisperTargets.isEmpty(), iFrameSize);
+		uiSent++;
+	}
+
+	// Channel hops and text messages are spread evenly over the ticks
+	const QList< LoadClient * > clients = syncedClients();
+	if (clients.isEmpty())
+		return;
+
+	dHopBudget += p.dHopRate * clients.count() / 60.0 / 50.0;
+	if (dHopBudget >= 1.0) {
+		const QList< unsigned int > targets = channels(p.bLinked);
+		while (dHopBudget >= 1.0) {
+			clients.at(random(clients.count()))->joinChannel(targets.at(random(targets.count())));
+			dHopBudget -= 1.0;
+			uiHops++;
+		}
+	}
+
+	dTextBudget += p.dTextRate / 50.0;
+	while (dTextBudget >= 1.0) {
+		clients.at(random(clients.count()))->sendText(QString::fromLatin1("Load test message %1").arg(uiTexts));
+		dTextBudget -= 1.0;
+		uiTexts++;
+	}
+}
+
+void LoadGenerator::tick() {
+	if (tPing.isElapsed(5000000ULL)) {
+		foreach (LoadClient *c, qlClients)
+			c->sendPing();
+	}
+
+	// Packets that haven't arrived after 2 seconds are lost
+	expirePackets(2000000ULL);
+
+	if (iPhase < 0) {
+		// Wait for the initial connects, but don't let a few clients that can't connect hold up the test
+		const int synced       = syncedClients().count();
+		const quint64 patience = (static_cast< quint64 >(qlClients.count()) / iConnectRate + 30) * 1000000ULL;
+		if (synced == qlClients.count() || tPhase.elapsed() > patience) {
+			qWarning("%d of %d clients connected", synced, qlClients.count());
+			iPhase = 0;
+			startPhase();
+		}
+		return;
+	}
+
+	const Phase &p = qlPhases.at(iPhase);
+	if (!bDraining && tPhase.elapsed() >= static_cast< quint64 >(p.iDuration) * 1000000ULL) {
+		// Let the last packets arrive
+		qtVoice.stop();
+		bDraining = true;
+		return;
+	}
+
+	if (bDraining && tPhase.elapsed() >= static_cast< quint64 >(p.iDuration) * 1000000ULL + 2000000ULL) {
+		finishPhase();
+
+		if (++iPhase < qlPhases.count()) {
+			startPhase();
+		} else {
+			foreach (LoadClient *c, qlClients)
+				c->close();
+			QCoreApplication::quit();
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	QCoreApplication a(argc, argv);
+	a.setApplicationName(QLatin1String("murmur-loadgen"));
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription(QLatin1String("Generates load on a Murmur server and measures voice latency and "
+												   "loss. Writes the results of every phase as a line of JSON."));
+	parser.addHelpOption();
+	parser.addPositionalArgument(QLatin1String("host"), QLatin1String("Address of the server"));
+	parser.addPositionalArgument(QLatin1String("port"), QLatin1String("Port of the server"), QLatin1String("[port]"));
+
+	const QCommandLineOption clientsOption(QLatin1String("clients"), QLatin1String("Amount of clients (100)."),
+										   QLatin1String("n"), QLatin1String("100"));
+	const QCommandLineOption speakersOption(QLatin1String("speakers"),
+											QLatin1String("Default amount of speakers per phase (5)."),
+											QLatin1String("n"), QLatin1String("5"));
+	const QCommandLineOption tcpOption(QLatin1String("tcp-only"),
+									   QLatin1String("Share of clients that only use TCP (0.0)."),
+									   QLatin1String("ratio"), QLatin1String("0.0"));
+	const QCommandLineOption rateOption(QLatin1String("connect-rate"),
+										QLatin1String("Initial connects per second (100)."), QLatin1String("n"),
+										QLatin1String("100"));
+	const QCommandLineOption durationOption(QLatin1String("duration"),
+											QLatin1String("Default duration of a phase in seconds (30)."),
+											QLatin1String("s"), QLatin1String("30"));
+	const QCommandLineOption frameOption(QLatin1String("frame-size"),
+										 QLatin1String("Size of the voice frames in bytes (60)."),
+										 QLatin1String("bytes"), QLatin1String("60"));
+	const QCommandLineOption scenarioOption(
+		QLatin1String("scenario"),
+		QLatin1String("Comma separated list of built-in phases: steady, spread, hop, whisper, linked, text, storm "
+					  "(steady)."),
+		QLatin1String("list"), QLatin1String("steady"));
+	const QCommandLineOption scriptOption(QLatin1String("script"),
+										  QLatin1String("JSON file describing the phases. Overrides --scenario."),
+										  QLatin1String("file"));
+	const QCommandLineOption outputOption(QLatin1String("output"),
+										  QLatin1String("File the results are written to (standard output)."),
+										  QLatin1String("file"));
+
+	parser.addOptions({ clientsOption, speakersOption, tcpOption, rateOption, durationOption, frameOption,
+						scenarioOption, scriptOption, outputOption });
+	parser.process(a);
+
+	const QStringList args = parser.positionalArguments();
+	if (args.isEmpty())
+		parser.showHelp(1);
+
+	const QHostAddress host(args.at(0));
+	const quint16 port = static_cast< quint16 >(args.count() > 1 ? args.at(1).toUInt() : 64738);
+	if (host.isNull())
+		qFatal("Invalid host address %s", qPrintable(args.at(0)));
+
+	Phase defaults;
+	defaults.iDuration = parser.value(durationOption).toInt();
+	defaults.iSpeakers = parser.value(speakersOption).toInt();
+
+	QList< Phase > phases;
+	if (parser.isSet(scriptOption)) {
+		QFile f(parser.value(scriptOption));
+		if (!f.open(QIODevice::ReadOnly))
+			qFatal("Failed to open %s", qPrintable(f.fileName()));
+
+		const QJsonDocument doc = QJsonDocument::fromJson(f.readAll());
+		foreach (const QJsonValue &v, doc.object().value(QLatin1String("phases")).toArray())
+			phases << Phase::fromJson(v.toObject(), defaults);
+	} else {
+		foreach (const QString &name, parser.value(scenarioOption).split(QLatin1Char(','))) {
+			Phase p;
+			if (!Phase::fromScenario(name.trimmed(), defaults, p))
+				qFatal("Unknown scenario %s", qPrintable(name));
+			phases << p;
+		}
+	}
+
+	if (phases.isEmpty())
+		qFatal("No phases to run");
+
+	QFile output;
+	if (parser.isSet(outputOption)) {
+		output.setFileName(parser.value(outputOption));
+		if (!output.open(QIODevice::WriteOnly | QIODevice::Append))
+			qFatal("Failed to open %s", qPrintable(output.fileName()));
+	} else {
+		output.open(stdout, QIODevice::WriteOnly);
+	}
+
+	LoadGenerator lg(host, port, parser.value(clientsOption).toInt(), parser.value(tcpOption).toDouble(),
+					 parser.value(rateOption).toInt(), phases, &output);
+	lg.iFrameSize = parser.value(frameOption).toInt();
+	lg.start();
+
+	return a.exec();
+}
+
+#include "LoadGenerator.moc"
@@ -0,0 +1,142 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+/**
+ * Benchmark of the ways positional audio plugins can read the memory of a
+ * game: one peek() per value, a single batched peek() and a cached pointer
+ * chain.
+ *
+ * The "game" is a forked copy of this process, so all addresses are known
+ * up front. Linux only; it is built if both the tests and benchmarks options
+ * are enabled.
+ */
+
+#include "ProcessLinux.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+#include <errno.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define ITER 100000
+
+struct Player {
+	float rotation[3];
+	char padding1[116];
+	float origin[3];
+	char padding2[500];
+	float eyes[3];
+	bool dead;
+};
+
+struct Client {
+	char padding[64];
+	Player *player;
+};
+
+struct Engine {
+	char padding[16];
+	Client *client;
+};
+
+// The chain a plugin would follow to get to the player: [[engine] + client] + player
+static Engine *engine;
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsed(const Clock::time_point &start) {
+	return std::chrono::duration< double, std::micro >(Clock::now() - start).count() / ITER;
+}
+
+int main(int, char **argv) {
+	engine                 = new Engine();
+	engine->client         = new Client();
+	engine->client->player = new Player();
+
+	Player *player      = engine->client->player;
+	player->rotation[0] = 1.0f;
+	player->origin[0]   = 2.0f;
+	player->eyes[0]     = 3.0f;
+
+	const pid_t pid = fork();
+	if (pid == -1) {
+		perror("fork");
+		return 1;
+	}
+
+	if (pid == 0) {
+		// The stand-in game just keeps its memory around until it is killed
+		for (;;) {
+			pause();
+		}
+	}
+
+	const char *name = strrchr(argv[0], '/');
+	ProcessLinux proc(pid, name ? name + 1 : argv[0]);
+	if (!proc.isOk()) {
+		fprintf(stderr, "Failed to attach to the stand-in game (is ptrace restricted?)\n");
+		kill(pid, SIGKILL);
+		return 1;
+	}
+
+	const auto address = reinterpret_cast< procptr_t >(player);
+
+	float rotation[3], origin[3], eyes[3];
+	bool dead;
+
+	auto start = Clock::now();
+	for (int i = 0; i < ITER; ++i) {
+		proc.peek(address + offsetof(Player, rotation), rotation);
+		proc.peek(address + offsetof(Player, origin), origin);
+		proc.peek(address + offsetof(Player, eyes), eyes);
+		proc.peek(address + offsetof(Player, dead), dead);
+	}
+	printf("Separate reads:       %8.3f us\n", elapsed(start));
+
+	start = Clock::now();
+	for (int i = 0; i < ITER; ++i) {
+		const PeekRequests requests = { Process::request(address + offsetof(Player, rotation), rotation),
+										Process::request(address + offsetof(Player, origin), origin),
+										Process::request(address + offsetof(Player, eyes), eyes),
+										Process::request(address + offsetof(Player, dead), dead) };
+		proc.peek(requests);
+	}
+	printf("Batched reads:        %8.3f us\n", elapsed(start));
+
+	if (rotation[0] != 1.0f || origin[0] != 2.0f || eyes[0] != 3.0f) {
+		fprintf(stderr, "Read unexpected values from the stand-in game\n");
+	}
+
+	const auto base = reinterpret_cast< procptr_t >(&engine);
+
+	procptr_t resolved = 0;
+	start              = Clock::now();
+	for (int i = 0; i < ITER; ++i) {
+		resolved = proc.peekPtr(proc.peekPtr(base) + offsetof(Engine, client));
+		resolved = proc.peekPtr(resolved + offsetof(Client, player));
+	}
+	printf("Pointer chain:        %8.3f us\n", elapsed(start));
+
+	PointerChain chain(base, { offsetof(Engine, client), offsetof(Client, player), 0 });
+	start = Clock::now();
+	for (int i = 0; i < ITER; ++i) {
+		resolved = chain.resolve(proc);
+	}
+	printf("Cached pointer chain: %8.3f us\n", elapsed(start));
+
+	if (resolved != address) {
+		fprintf(stderr, "Pointer chain resolved to an unexpected address\n");
+	}
+
+	kill(pid, SIGKILL);
+	waitpid(pid, nullptr, 0);
+
+	return 0;
+}
@@ -0,0 +1,193 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include <QtCore>
+#include <QtTest>
+
+#include "EgressPacer.h"
+
+/// 20 ms, the usual interval between voice packets
+static const quint64 FRAME = 20000;
+static const int PACKET_SIZE = 1000;
+
+class TestEgressPacer : public QObject {
+	Q_OBJECT
+private:
+	QByteArray qbaPacket;
+
+	/// Sends a packet every FRAME for the given time, starting at now
+	void stream(EgressPacer &ep, quint64 &now, quint64 duration);
+
+private slots:
+	void initTestCase();
+	void noLossNoPacing();
+	void tooFewPackets();
+	void lossStartsPacing();
+	void pacedRate();
+	void queueLimit();
+	void recovery();
+	void statisticsReset();
+	void reset();
+};
+
+void TestEgressPacer::stream(EgressPacer &ep, quint64 &now, quint64 duration) {
+	const quint64 end = now + duration;
+	for (; now < end; now += FRAME)
+		QVERIFY(ep.admit(now, qbaPacket.constData(), qbaPacket.size()));
+}
+
+void TestEgressPacer::initTestCase() {
+	qbaPacket = QByteArray(PACKET_SIZE, 'x');
+}
+
+void TestEgressPacer::noLossNoPacing() {
+	EgressPacer ep;
+	quint64 now = 0;
+
+	stream(ep, now, 2000000ULL);
+	ep.report(now, 100, 0, 0);
+	stream(ep, now, 2000000ULL);
+
+	QCOMPARE(ep.capacity(), 0.0);
+	QCOMPARE(ep.queued(), 0);
+	// About 50 packets per second
+	QVERIFY(ep.rate(now) > 40000.0);
+	QVERIFY(ep.rate(now) < 60000.0);
+}
+
+void TestEgressPacer::tooFewPackets() {
+	EgressPacer ep;
+	quint64 now = 0;
+
+	stream(ep, now, 1000000ULL);
+	ep.report(now, 5, 0, 5);
+	QCOMPARE(ep.capacity(), 0.0);
+
+	// The loss is computed once there are enough packets
+	ep.report(now, 20, 0, 10);
+	QVERIFY(ep.capacity() > 0.0);
+}
+
+void TestEgressPacer::lossStartsPacing() {
+	EgressPacer ep;
+	quint64 now = 0;
+
+	stream(ep, now, 2000000ULL);
+	const double rate = ep.rate(now);
+	ep.report(now, 90, 0, 10);
+
+	QVERIFY(ep.capacity() > 0.0);
+	QVERIFY(ep.capacity() < rate);
+
+	// Less loss than LOSS_HIGH doesn't make it any lower
+	const double capacity = ep.capacity();
+	ep.report(now, 188, 2, 10);
+	QVERIFY(ep.capacity() >= capacity);
+}
+
+void TestEgressPacer::pacedRate() {
+	EgressPacer ep;
+	quint64 now = 0;
+
+	stream(ep, now, 2000000ULL);
+	ep.report(now, 90, 0, 10);
+	const double capacity = ep.capacity();
+
+	// Keep sending more than the capacity, releasing queued packets in between
+	const quint64 duration = 2000000ULL;
+	const quint64 end      = now + duration;
+	int sent               = 0;
+	for (; now < end; now += 5000) {
+		QByteArray packet;
+		while (ep.release(now, packet))
+			sent += packet.size();
+		if ((now % FRAME) == 0 && ep.admit(now, qbaPacket.constData(), qbaPacket.size()))
+			sent += PACKET_SIZE;
+	}
+
+	const double expected = capacity * duration / 1000000.0;
+	QVERIFY(sent <= expected + 3000.0);
+	QVERIFY(sent >= expected * 0.8);
+	QVERIFY(ep.queued() > 0);
+}
+
+void TestEgressPacer::queueLimit() {
+	EgressPacer ep;
+	quint64 now = 0;
+
+	stream(ep, now, 2000000ULL);
+	ep.report(now, 50, 0, 50);
+
+	bool dropped = false;
+	int admitted = 0;
+	for (int i = 0; i < 100; ++i) {
+		if (ep.admit(now, qbaPacket.constData(), qbaPacket.size(), &dropped))
+			++admitted;
+	}
+
+	QVERIFY(dropped);
+	QCOMPARE(ep.queued(), EgressPacer::MAX_QUEUED);
+	QVERIFY(admitted < 100 - EgressPacer::MAX_QUEUED);
+}
+
+void TestEgressPacer::recovery() {
+	EgressPacer ep;
+	quint64 now = 0;
+
+	stream(ep, now, 2000000ULL);
+	ep.report(now, 90, 0, 10);
+	QVERIFY(ep.capacity() > 0.0);
+
+	// Hardly anything is sent and nothing gets lost anymore
+	quint32 good = 90;
+	for (int i = 0; i < 100 && ep.capacity() > 0.0; ++i) {
+		now += 5000000ULL;
+		good += 100;
+		QByteArray packet;
+		while (ep.release(now, packet)) {
+		}
+		ep.report(now, good, 0, 10);
+	}
+
+	QCOMPARE(ep.capacity(), 0.0);
+	QVERIFY(ep.admit(now, qbaPacket.constData(), qbaPacket.size()));
+}
+
+void TestEgressPacer::statisticsReset() {
+	EgressPacer ep;
+	quint64 now = 0;
+
+	stream(ep, now, 2000000ULL);
+	ep.report(now, 1000, 0, 0);
+
+	// The client reconnected and started counting from scratch. This mustn't be taken for loss.
+	ep.report(now, 10, 0, 0);
+	ep.report(now, 110, 0, 0);
+	QCOMPARE(ep.capacity(), 0.0);
+}
+
+void TestEgressPacer::reset() {
+	EgressPacer ep;
+	quint64 now = 0;
+
+	stream(ep, now, 2000000ULL);
+	ep.report(now, 50, 0, 50);
+	for (int i = 0; i < 10; ++i)
+		ep.admit(now, qbaPacket.constData(), qbaPacket.size());
+	const int queued = ep.queued();
+	QVERIFY(queued > 0);
+
+	QCOMPARE(ep.reset(), queued);
+	QCOMPARE(ep.queued(), 0);
+	QCOMPARE(ep.capacity(), 0.0);
+	QVERIFY(ep.admit(now, qbaPacket.constData(), qbaPacket.size()));
+
+	// The earlier loss is not counted again
+	ep.report(now, 150, 0, 50);
+	QCOMPARE(ep.capacity(), 0.0);
+}
+
+QTEST_MAIN(TestEgressPacer)
+#include "TestEgressPacer.moc"
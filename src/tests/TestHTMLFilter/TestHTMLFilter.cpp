@@ -0,0 +1,132 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include <QtCore>
+#include <QtTest>
+
+#include "HTMLFilter.h"
+
+/// Builds an <img> tag embedding the given number of bytes of
+/// (fake) base64 encoded PNG data, as sent by the Mumble client.
+static QString imageTag(int payloadSize) {
+	return QString::fromLatin1("<img src=\"data:image/png;base64,%1\" />")
+		.arg(QString(payloadSize, QLatin1Char('A')));
+}
+
+/// A selection of messages as they are typically sent by Mumble clients.
+static QStringList messageCorpus() {
+	QStringList corpus;
+
+	corpus << QLatin1String("gg");
+	corpus << QLatin1String("brb, getting coffee");
+	corpus << QLatin1String("<a href=\"https://www.mumble.info/\">https://www.mumble.info/</a>");
+	corpus << QLatin1String("<p>Raid starts at <b>20:00</b> in <span style=\"color:#ff0000\">Channel 2</span>.<br />"
+							"Bring <i>potions</i>!</p>");
+	corpus << QString::fromLatin1("<p>Check this out:</p>%1").arg(imageTag(4 * 1024));
+	corpus << QString::fromLatin1("<p>Screenshot of the bug</p>%1<p>happens every time</p>").arg(imageTag(96 * 1024));
+	corpus << QString::fromLatin1("%1%2").arg(imageTag(200 * 1024), imageTag(200 * 1024));
+	corpus << QString(4000, QLatin1Char('x'));
+
+	return corpus;
+}
+
+/// A chat log as saved by the Mumble client: Qt rich text with nested formatting, links, a list,
+/// a table and embedded images, as it ends up being sent when pasted into the chat bar.
+static QString savedLog() {
+	QFile f(QLatin1String(":/log.html"));
+	if (!f.open(QIODevice::ReadOnly)) {
+		return QString();
+	}
+	return QString::fromUtf8(f.readAll());
+}
+
+class TestHTMLFilter : public QObject {
+	Q_OBJECT
+private slots:
+	void textLength_data();
+	void textLength();
+	void textLengthStopsEarly();
+	void textLengthSavedLog();
+	void benchmarkTextLength();
+	void benchmarkTextLengthSavedLog();
+};
+
+void TestHTMLFilter::textLength_data() {
+	QTest::addColumn< QString >("input");
+	QTest::addColumn< int >("expected");
+
+	QTest::newRow("plain") << QString::fromLatin1("hello world") << 11;
+	QTest::newRow("markup") << QString::fromLatin1("<b>bold</b>") << 11;
+	QTest::newRow("image") << QString::fromLatin1("<img src=\"data:abc\">") << 12;
+	QTest::newRow("image single quotes") << QString::fromLatin1("<img src='data:abc'>") << 12;
+	QTest::newRow("image unquoted") << QString::fromLatin1("<img src=data:abc>") << 10;
+	QTest::newRow("image uppercase") << QString::fromLatin1("<IMG SRC=\"data:abc\">") << 12;
+	QTest::newRow("image other attributes") << QString::fromLatin1("<img alt=\"x\" src=\"data:abc\" width=\"1\" />")
+											<< 32;
+	QTest::newRow("src of other tags") << QString::fromLatin1("<a src=\"data:abc\">") << 18;
+	QTest::newRow("unterminated tag") << QString::fromLatin1("a < b") << -1;
+	QTest::newRow("unterminated attribute") << QString::fromLatin1("<img src=\"data:abc>") << -1;
+}
+
+void TestHTMLFilter::textLength() {
+	QFETCH(QString, input);
+	QFETCH(int, expected);
+
+	QCOMPARE(HTMLFilter::textLength(input), expected);
+}
+
+void TestHTMLFilter::textLengthStopsEarly() {
+	const QString text = QString(100, QLatin1Char('x')) + imageTag(1024) + QString(100, QLatin1Char('y'));
+
+	const int length = HTMLFilter::textLength(text);
+	QVERIFY(length > 200);
+	QVERIFY(length < 300);
+
+	// Crossing the limit in front of the image must not require scanning the rest of the message
+	const int limited = HTMLFilter::textLength(text, 50);
+	QVERIFY(limited > 50);
+	QVERIFY(limited <= 100);
+}
+
+void TestHTMLFilter::textLengthSavedLog() {
+	const QString log = savedLog();
+	QVERIFY(!log.isEmpty());
+
+	int imageLength = 0;
+	QRegularExpressionMatchIterator it =
+		QRegularExpression(QLatin1String("<img src=\"([^\"]*)\"")).globalMatch(log);
+	while (it.hasNext()) {
+		imageLength += it.next().capturedLength(1);
+	}
+	QVERIFY(imageLength > 0);
+
+	QCOMPARE(HTMLFilter::textLength(log), log.size() - imageLength);
+}
+
+void TestHTMLFilter::benchmarkTextLength() {
+	const QStringList corpus = messageCorpus();
+
+	qint64 total = 0;
+	QBENCHMARK {
+		for (const QString &message : corpus) {
+			total += HTMLFilter::textLength(message, 5000);
+		}
+	}
+
+	QVERIFY(total > 0);
+}
+
+void TestHTMLFilter::benchmarkTextLengthSavedLog() {
+	const QString log = savedLog();
+	QVERIFY(!log.isEmpty());
+
+	int length = 0;
+	QBENCHMARK { length = HTMLFilter::textLength(log); }
+
+	QVERIFY(length > 0);
+}
+
+QTEST_MAIN(TestHTMLFilter)
+#include "TestHTMLFilter.moc"
@@ -0,0 +1,97 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include <QtCore>
+#include <QtTest>
+
+#include "MixerMath.h"
+
+static const int SAMPLES = 4;
+
+class TestMixerMath : public QObject {
+	Q_OBJECT
+private slots:
+	void mix();
+	void minusSelf();
+	void clipping();
+	void rounding();
+};
+
+void TestMixerMath::mix() {
+	const float a[SAMPLES] = { 0.1f, -0.2f, 0.3f, 0.0f };
+	const float b[SAMPLES] = { 0.2f, 0.2f, -0.5f, 0.0f };
+	float mixed[SAMPLES]   = {};
+
+	MixerMath::add(mixed, a, SAMPLES);
+	MixerMath::add(mixed, b, SAMPLES);
+
+	for (int i = 0; i < SAMPLES; ++i)
+		QCOMPARE(mixed[i], a[i] + b[i]);
+}
+
+void TestMixerMath::minusSelf() {
+	const float speakers[3][SAMPLES] = { { 0.1f, 0.2f, 0.3f, 0.4f },
+										 { -0.4f, 0.1f, 0.0f, 0.25f },
+										 { 0.05f, -0.3f, 0.5f, -0.6f } };
+	float mixed[SAMPLES]             = {};
+	for (const auto &s : speakers)
+		MixerMath::add(mixed, s, SAMPLES);
+
+	// Every speaker gets exactly what the others said
+	for (int self = 0; self < 3; ++self) {
+		float minus[SAMPLES];
+		MixerMath::subtract(mixed, speakers[self], minus, SAMPLES);
+
+		for (int i = 0; i < SAMPLES; ++i) {
+			float others = 0.0f;
+			for (int s = 0; s < 3; ++s) {
+				if (s != self)
+					others += speakers[s][i];
+			}
+			QVERIFY(qAbs(minus[i] - others) < 1e-6f);
+		}
+	}
+}
+
+void TestMixerMath::clipping() {
+	// Two loud speakers exceed the range in both directions
+	const float a[SAMPLES] = { 0.8f, -0.8f, 1.0f, -1.0f };
+	float mixed[SAMPLES]   = {};
+	MixerMath::add(mixed, a, SAMPLES);
+	MixerMath::add(mixed, a, SAMPLES);
+
+	qint16 out[SAMPLES];
+	MixerMath::toInt16(mixed, out, SAMPLES);
+
+	QCOMPARE(out[0], static_cast< qint16 >(32767));
+	QCOMPARE(out[1], static_cast< qint16 >(-32768));
+	QCOMPARE(out[2], static_cast< qint16 >(32767));
+	QCOMPARE(out[3], static_cast< qint16 >(-32768));
+
+	// The mix without one of them fits again
+	float minus[SAMPLES];
+	MixerMath::subtract(mixed, a, minus, SAMPLES);
+	MixerMath::toInt16(minus, out, SAMPLES);
+
+	QCOMPARE(out[0], static_cast< qint16 >(26214));
+	QCOMPARE(out[1], static_cast< qint16 >(-26214));
+	QCOMPARE(out[2], static_cast< qint16 >(32767));
+	QCOMPARE(out[3], static_cast< qint16 >(-32768));
+}
+
+void TestMixerMath::rounding() {
+	const float pcm[SAMPLES] = { 0.0f, 0.5f, -0.5f, 1.0f / 32768.0f };
+
+	qint16 out[SAMPLES];
+	MixerMath::toInt16(pcm, out, SAMPLES);
+
+	QCOMPARE(out[0], static_cast< qint16 >(0));
+	QCOMPARE(out[1], static_cast< qint16 >(16384));
+	QCOMPARE(out[2], static_cast< qint16 >(-16384));
+	QCOMPARE(out[3], static_cast< qint16 >(1));
+}
+
+QTEST_MAIN(TestMixerMath)
+#include "TestMixerMath.moc"
@@ -0,0 +1,134 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include <QtCore>
+#include <QtTest>
+
+#include "SpeakerSelection.h"
+
+/// 20 ms, the usual interval between voice packets
+static const quint64 FRAME = 20000;
+
+class TestSpeakerSelection : public QObject {
+	Q_OBJECT
+private slots:
+	void limit();
+	void hysteresis();
+	void louderReplacesQuieter();
+	void prioritySpeaker();
+	void terminatorFreesSlot();
+	void silenceFreesSlot();
+	void idle();
+};
+
+void TestSpeakerSelection::limit() {
+	SpeakerSelection ss;
+
+	QVERIFY(ss.admit(1, 0, 100, false, false, 2));
+	QVERIFY(ss.admit(2, 0, 100, false, false, 2));
+	QVERIFY(!ss.admit(3, 0, 100, false, false, 2));
+	QCOMPARE(ss.selected(), 2);
+
+	// Selected speakers keep being forwarded
+	QVERIFY(ss.admit(1, FRAME, 100, false, false, 2));
+	QVERIFY(ss.admit(2, FRAME, 100, false, false, 2));
+	QVERIFY(!ss.admit(3, FRAME, 100, false, false, 2));
+}
+
+void TestSpeakerSelection::hysteresis() {
+	SpeakerSelection ss;
+
+	// Slightly louder newcomers don't replace anybody
+	quint64 now = 0;
+	for (int i = 0; i < 200; ++i, now += FRAME) {
+		QVERIFY(ss.admit(1, now, 100, false, false, 1));
+		QVERIFY(!ss.admit(2, now, 120, false, false, 1));
+	}
+	QVERIFY(ss.isSelected(1));
+}
+
+void TestSpeakerSelection::louderReplacesQuieter() {
+	SpeakerSelection ss;
+
+	quint64 now = 0;
+	QVERIFY(ss.admit(1, now, 50, false, false, 1));
+
+	// Not before the selected speaker has had their minimum time
+	for (now = FRAME; now < SpeakerSelection::MIN_SELECTED_TIME; now += FRAME) {
+		ss.admit(1, now, 50, false, false, 1);
+		QVERIFY(!ss.admit(2, now, 200, false, false, 1));
+	}
+
+	bool replaced = false;
+	for (int i = 0; i < 10 && !replaced; ++i, now += FRAME) {
+		ss.admit(1, now, 50, false, false, 1);
+		replaced = ss.admit(2, now, 200, false, false, 1);
+	}
+	QVERIFY(replaced);
+	QVERIFY(!ss.isSelected(1));
+	QVERIFY(ss.isSelected(2));
+	QCOMPARE(ss.selected(), 1);
+}
+
+void TestSpeakerSelection::prioritySpeaker() {
+	SpeakerSelection ss;
+
+	QVERIFY(ss.admit(1, 0, 100, false, false, 1));
+	// Priority speakers are forwarded regardless of the limit
+	QVERIFY(ss.admit(2, 0, 10, true, false, 1));
+	QCOMPARE(ss.selected(), 2);
+
+	// And are never replaced, even by much louder speakers
+	for (quint64 now = FRAME; now < 3 * SpeakerSelection::MIN_SELECTED_TIME; now += FRAME) {
+		QVERIFY(ss.admit(2, now, 10, true, false, 1));
+		ss.admit(1, now, 100, false, false, 1);
+		ss.admit(3, now, 1000, false, false, 1);
+	}
+	QVERIFY(ss.isSelected(2));
+	QVERIFY(!ss.isSelected(1));
+	QVERIFY(ss.isSelected(3));
+}
+
+void TestSpeakerSelection::terminatorFreesSlot() {
+	SpeakerSelection ss;
+
+	QVERIFY(ss.admit(1, 0, 100, false, false, 1));
+	QVERIFY(!ss.admit(2, 0, 100, false, false, 1));
+
+	// The terminator is still forwarded
+	QVERIFY(ss.admit(1, FRAME, 100, false, true, 1));
+	QVERIFY(!ss.isSelected(1));
+	QCOMPARE(ss.selected(), 0);
+
+	QVERIFY(ss.admit(2, 2 * FRAME, 100, false, false, 1));
+}
+
+void TestSpeakerSelection::silenceFreesSlot() {
+	SpeakerSelection ss;
+
+	QVERIFY(ss.admit(1, 0, 100, false, false, 1));
+	QVERIFY(!ss.admit(2, FRAME, 100, false, false, 1));
+
+	// Speaker 1 stops sending without a terminator (e.g. because the packet got lost)
+	const quint64 now = FRAME + SpeakerSelection::HOLD_TIME * 2;
+	QVERIFY(ss.admit(2, now, 100, false, false, 1));
+	QVERIFY(!ss.isSelected(1));
+}
+
+void TestSpeakerSelection::idle() {
+	SpeakerSelection ss;
+	QVERIFY(ss.isIdle(0));
+
+	QVERIFY(ss.admit(1, 0, 100, false, false, 1));
+	QVERIFY(!ss.isIdle(SpeakerSelection::HOLD_TIME));
+	QVERIFY(ss.isIdle(SpeakerSelection::HOLD_TIME + 1));
+
+	// A terminator ends the transmission right away
+	QVERIFY(ss.admit(1, FRAME, 100, false, true, 1));
+	QVERIFY(ss.isIdle(FRAME));
+}
+
+QTEST_MAIN(TestSpeakerSelection)
+#include "TestSpeakerSelection.moc"
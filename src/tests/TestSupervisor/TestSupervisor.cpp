@@ -0,0 +1,103 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include <QtCore>
+#include <QtTest>
+
+#include "Supervisor.h"
+
+class TestSupervisor : public QObject {
+	Q_OBJECT
+private slots:
+	void ownsWithoutWorkers();
+	void ownsPartition();
+	void supervisorOwnsNothing();
+	void nextOwned();
+	void offsetPort_data();
+	void offsetPort();
+	void restartDelay();
+};
+
+void TestSupervisor::ownsWithoutWorkers() {
+	for (int server = 0; server < 10; ++server)
+		QVERIFY(Supervisor::owns(server, 0, -1));
+}
+
+void TestSupervisor::ownsPartition() {
+	// Every server is hosted by exactly one of the workers
+	const int workers = 3;
+	for (int server = 0; server < 20; ++server) {
+		int owners = 0;
+		for (int worker = 0; worker < workers; ++worker) {
+			if (Supervisor::owns(server, workers, worker)) {
+				QCOMPARE(server % workers, worker);
+				++owners;
+			}
+		}
+		QCOMPARE(owners, 1);
+	}
+}
+
+void TestSupervisor::supervisorOwnsNothing() {
+	for (int server = 0; server < 10; ++server)
+		QVERIFY(!Supervisor::owns(server, 4, -1));
+}
+
+void TestSupervisor::nextOwned() {
+	QCOMPARE(Supervisor::nextOwned(5, 0, -1), 5);
+	QCOMPARE(Supervisor::nextOwned(5, 4, -1), 5);
+
+	for (int workers = 1; workers <= 4; ++workers) {
+		for (int worker = 0; worker < workers; ++worker) {
+			for (int server = 1; server < 20; ++server) {
+				const int next = Supervisor::nextOwned(server, workers, worker);
+				QVERIFY(next >= server);
+				QVERIFY(next < server + workers);
+				QVERIFY(Supervisor::owns(next, workers, worker));
+			}
+		}
+	}
+}
+
+void TestSupervisor::offsetPort_data() {
+	QTest::addColumn< QString >("address");
+	QTest::addColumn< int >("offset");
+	QTest::addColumn< QString >("expected");
+
+	QTest::newRow("ice") << QString::fromLatin1("tcp -h 127.0.0.1 -p 6502") << 2
+						 << QString::fromLatin1("tcp -h 127.0.0.1 -p 6504");
+	QTest::newRow("ice multiple") << QString::fromLatin1("tcp -h 127.0.0.1 -p 6502:ssl -h 127.0.0.1 -p 6503") << 1
+								  << QString::fromLatin1("tcp -h 127.0.0.1 -p 6503:ssl -h 127.0.0.1 -p 6504");
+	QTest::newRow("host:port") << QString::fromLatin1("127.0.0.1:50051") << 3
+							   << QString::fromLatin1("127.0.0.1:50054");
+	QTest::newRow("ipv6") << QString::fromLatin1("[::1]:9000") << 1 << QString::fromLatin1("[::1]:9001");
+	QTest::newRow("zero offset") << QString::fromLatin1("127.0.0.1:9000") << 0
+								 << QString::fromLatin1("127.0.0.1:9000");
+	QTest::newRow("empty") << QString() << 1 << QString();
+}
+
+void TestSupervisor::offsetPort() {
+	QFETCH(QString, address);
+	QFETCH(int, offset);
+	QFETCH(QString, expected);
+
+	QCOMPARE(Supervisor::offsetPort(address, offset), expected);
+}
+
+void TestSupervisor::restartDelay() {
+	const int first = Supervisor::RESTART_DELAY;
+	const int max   = Supervisor::MAX_RESTART_DELAY;
+
+	QCOMPARE(Supervisor::restartDelay(1), first);
+	QCOMPARE(Supervisor::restartDelay(2), first * 2);
+	QCOMPARE(Supervisor::restartDelay(3), first * 4);
+
+	for (int failures = 2; failures <= 100; ++failures)
+		QVERIFY(Supervisor::restartDelay(failures) >= Supervisor::restartDelay(failures - 1));
+	QCOMPARE(Supervisor::restartDelay(100), max);
+}
+
+QTEST_MAIN(TestSupervisor)
+#include "TestSupervisor.moc"
@@ -0,0 +1,86 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include <QtCore>
+#include <QtTest>
+
+#include "TimerWheel.h"
+
+class TestTimerWheel : public QObject {
+	Q_OBJECT
+private slots:
+	void expiresOnTime_data();
+	void expiresOnTime();
+	void manyValues();
+	void clear();
+};
+
+void TestTimerWheel::expiresOnTime_data() {
+	QTest::addColumn< quint64 >("ticks");
+
+	QTest::newRow("1") << Q_UINT64_C(1);
+	QTest::newRow("63") << Q_UINT64_C(63);
+	QTest::newRow("64") << Q_UINT64_C(64);
+	QTest::newRow("4095") << Q_UINT64_C(4095);
+	QTest::newRow("4096") << Q_UINT64_C(4096);
+	QTest::newRow("100000") << Q_UINT64_C(100000);
+	// Beyond the range of the wheel
+	QTest::newRow("1000000") << Q_UINT64_C(1000000);
+}
+
+void TestTimerWheel::expiresOnTime() {
+	QFETCH(quint64, ticks);
+
+	TimerWheel< int > tw;
+	// Don't start at a slot boundary
+	for (int i = 0; i < 10; ++i)
+		tw.advance();
+
+	tw.schedule(42, ticks);
+	QCOMPARE(tw.count(), 1);
+
+	for (quint64 i = 1; i < ticks; ++i)
+		QVERIFY(tw.advance().isEmpty());
+
+	const QList< int > expired = tw.advance();
+	QCOMPARE(expired.count(), 1);
+	QCOMPARE(expired.at(0), 42);
+	QCOMPARE(tw.count(), 0);
+}
+
+void TestTimerWheel::manyValues() {
+	TimerWheel< quint64 > tw;
+
+	// The values are the ticks at which they are due
+	quint64 now = 0;
+	for (quint64 i = 0; i < 20000; ++i) {
+		const quint64 ticks = (i * 7919) % 10000 + 1;
+		tw.schedule(now + ticks, ticks);
+
+		now++;
+		foreach (quint64 value, tw.advance())
+			QCOMPARE(value, now);
+	}
+
+	while (tw.count() > 0) {
+		now++;
+		foreach (quint64 value, tw.advance())
+			QCOMPARE(value, now);
+	}
+}
+
+void TestTimerWheel::clear() {
+	TimerWheel< int > tw;
+	tw.schedule(1, 5);
+	tw.schedule(2, 500);
+	tw.clear();
+	QCOMPARE(tw.count(), 0);
+
+	for (int i = 0; i < 1000; ++i)
+		QVERIFY(tw.advance().isEmpty());
+}
+
+QTEST_MAIN(TestTimerWheel)
+#include "TestTimerWheel.moc"